@@ -8,7 +8,13 @@ DEPENDPATH += .
 INCLUDEPATH += .
 
 # Input
-HEADERS += gl_viewer.h viewer.h
+HEADERS += gl_viewer.h viewer.h object_list_model.h scene.h command_protocol.h command_server.h cow_array.h scene_data.h scene_animation.h io_progress.h scene_io.h scene_codec.h scene_preview.h scene_open_dialog.h timeline_widget.h streamed_scene.h scene_streamer.h scene_journal.h scene_generators.h autosave.h scene_math.h occlusion.h scene_bvh.h lighting_bake.h lighting_baker.h interference.h interference_checker.h camera_input.h camera_path.h primitive_geometry.h mesh_optimizer.h mesh_simplifier.h mesh_lod.h mesh_buffers.h memory_stats.h render_queue.h renderer.h render_thread.h poster_renderer.h video_exporter.h trace.h farm_protocol.h farm_coordinator.h farm_worker.h half_edge_mesh.h subdivision_surface.h mesh_editor.h scene_meshes.h
 FORMS += viewer.ui
-SOURCES += gl_viewer.cc main.cc viewer.cc
-QT += opengl
+SOURCES += gl_viewer.cc main.cc viewer.cc object_list_model.cc scene.cc scene_animation.cc command_server.cc scene_io.cc scene_codec.cc scene_preview.cc scene_open_dialog.cc timeline_widget.cc streamed_scene.cc scene_streamer.cc scene_journal.cc scene_generators.cc autosave.cc occlusion.cc scene_bvh.cc lighting_bake.cc lighting_baker.cc interference.cc interference_checker.cc camera_input.cc camera_path.cc primitive_geometry.cc mesh_optimizer.cc mesh_simplifier.cc mesh_lod.cc mesh_buffers.cc memory_stats.cc render_queue.cc renderer.cc render_thread.cc poster_renderer.cc video_exporter.cc trace.cc farm_protocol.cc farm_coordinator.cc farm_worker.cc half_edge_mesh.cc subdivision_surface.cc mesh_editor.cc scene_meshes.cc
+QT += opengl network
+QMAKE_CXXFLAGS += -std=c++14
+
+# qmake CONFIG+=tracing records trace scopes, saved from Help > Save Trace
+CONFIG(tracing) {
+  DEFINES += VOXEL_TRACE
+}
@@ -0,0 +1,123 @@
+#include "autosave.h"
+#include "scene_io.h"
+#include <QtConcurrentRun>
+#ifdef Q_OS_WIN
+#include <windows.h>
+#else
+#include <signal.h>
+#include <cerrno>
+#endif
+
+AutoSaver::AutoSaver(QObject *parent) : QObject(parent)
+{
+  hasPending = false;
+  connect(&watcher, SIGNAL(finished()), this, SLOT(writeFinished()));
+}
+
+AutoSaver::~AutoSaver()
+{
+  watcher.waitForFinished();
+}
+
+static QString autosaveDir()
+{
+  QString dirName = QDir::homePath() + "/.voxel_playground";
+  QDir().mkpath(dirName);
+  return dirName;
+}
+
+// A process id may be reused, in which case a crashed session's file waits
+// until that process exits
+static bool processRunning(qint64 pid)
+{
+#ifdef Q_OS_WIN
+  HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, (DWORD)pid);
+  if (!process)
+    return false;
+  bool running = WaitForSingleObject(process, 0) == WAIT_TIMEOUT;
+  CloseHandle(process);
+  return running;
+#else
+  return kill((pid_t)pid, 0) == 0 || errno == EPERM;
+#endif
+}
+
+// One file per session, so sessions running side by side keep their own
+QString AutoSaver::autosavePath()
+{
+  return autosaveDir() + QString("/autosave-%1.vox").arg(QCoreApplication::applicationPid());
+}
+
+// The newest autosave whose session is gone; files from before sessions
+// had their own have no owner to ask
+QString AutoSaver::recoveryFile()
+{
+  QDir dir(autosaveDir());
+  QFileInfoList files = dir.entryInfoList(QStringList() << "autosave-*.vox" << "autosave.vox", QDir::Files, QDir::Time);
+  for (int i = 0; i < files.size(); i++)
+  {
+    QString owner = files[i].completeBaseName().section('-', 1);
+    bool isNumber = false;
+    qint64 pid = owner.toLongLong(&isNumber);
+    if (!isNumber || (pid != QCoreApplication::applicationPid() && !processRunning(pid)))
+      return files[i].filePath();
+  }
+  return QString();
+}
+
+// Takes over a crashed session's file: it becomes this session's autosave,
+// so the next autosave replaces it and a clean exit removes it
+bool AutoSaver::claim(const QString &fileName)
+{
+  QFile::remove(autosavePath());
+  return QFile::rename(fileName, autosavePath());
+}
+
+bool AutoSaver::isBusy() const
+{
+  return watcher.isRunning() || hasPending;
+}
+
+void AutoSaver::save(const SceneData &snapshot, const SceneEncoding &encoding)
+{
+  if (watcher.isRunning())
+  {
+    // Keep only the newest snapshot around
+    pending = snapshot;
+    pendingEncoding = encoding;
+    hasPending = true;
+    return;
+  }
+  startWrite(snapshot, encoding);
+}
+
+void AutoSaver::startWrite(const SceneData &snapshot, const SceneEncoding &sceneEncoding)
+{
+  SceneEncoding encoding = sceneEncoding;
+  encoding.preview = false; // Nobody browses autosaves
+
+  writeTimer.start();
+  watcher.setFuture(QtConcurrent::run(writeSceneFile, autosavePath(), snapshot, encoding, (IoProgress *)0));
+}
+
+void AutoSaver::writeFinished()
+{
+  emit saved(watcher.result(), writeTimer.elapsed());
+
+  if (hasPending)
+  {
+    SceneData snapshot = pending;
+    pending = SceneData(); // Release our reference so edits stop detaching
+    hasPending = false;
+    startWrite(snapshot, pendingEncoding);
+  }
+}
+
+// Called on clean exit, nothing to recover after that
+void AutoSaver::discard()
+{
+  hasPending = false;
+  pending = SceneData();
+  watcher.waitForFinished();
+  QFile::remove(autosavePath());
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <QtCore>
+#include <QFutureWatcher>
+#include "scene_codec.h"
+#include "scene_data.h"
+
+// Writes scene snapshots to the autosave file on a worker thread.
+// Only one write is in flight at a time; a snapshot handed over while the
+// previous one is still being written replaces any older pending one.
+class AutoSaver : public QObject
+{
+
+  Q_OBJECT
+
+public:
+  AutoSaver(QObject *parent = 0);
+  ~AutoSaver();
+
+  static QString autosavePath(); // This session's
+  static QString recoveryFile(); // Left by a session that didn't exit cleanly, or empty
+  static bool claim(const QString &fileName);
+
+  bool isBusy() const;
+
+  // In the encoding saves use, so recovery gives back the scene as it would
+  // have been saved; compact files round transforms and colors
+  void save(const SceneData &snapshot, const SceneEncoding &encoding);
+
+public slots:
+  void discard();
+
+signals:
+  void saved(bool ok, qint64 msec);
+
+private slots:
+  void writeFinished();
+
+private:
+  void startWrite(const SceneData &snapshot, const SceneEncoding &encoding);
+
+  QFutureWatcher<bool> watcher;
+  QElapsedTimer writeTimer;
+  SceneData pending;
+  SceneEncoding pendingEncoding;
+  bool hasPending;
+};
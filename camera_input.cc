@@ -0,0 +1,96 @@
+#include "camera_input.h"
+#include <cmath>
+
+static const double flySpeed = 5.0;     // Units per second
+static const double fastFactor = 4.0;   // With shift held
+static const double acceleration = 12.0; // How quickly velocity follows the keys
+
+CameraInput::CameraInput()
+{
+  panX = panY = rotateX = rotateY = dolly = 0.0;
+  velocity[0] = velocity[1] = velocity[2] = 0.0;
+  keys = 0;
+}
+
+void CameraInput::addMouseDelta(double dx, double dy, Qt::MouseButtons buttons)
+{
+  if ((buttons & Qt::RightButton) && (buttons & Qt::LeftButton))
+  {
+    dolly += dy;
+  }
+  else if (buttons & Qt::RightButton)
+  {
+    rotateX += dx;
+    rotateY += dy;
+  }
+  else if (buttons & Qt::LeftButton)
+  {
+    panX += dx;
+    panY += dy;
+  }
+}
+
+bool CameraInput::setKey(int key, bool pressed)
+{
+  int flag = 0;
+  switch (key)
+  {
+  case Qt::Key_W: flag = Forward; break;
+  case Qt::Key_S: flag = Back; break;
+  case Qt::Key_A: flag = Left; break;
+  case Qt::Key_D: flag = Right; break;
+  case Qt::Key_E: flag = Up; break;
+  case Qt::Key_Q: flag = Down; break;
+  case Qt::Key_Shift: flag = Fast; break;
+  default: return false;
+  }
+
+  if (pressed)
+    keys |= flag;
+  else
+    keys &= ~flag;
+  return true;
+}
+
+void CameraInput::releaseAll()
+{
+  keys = 0;
+}
+
+void CameraInput::takeMouse(double &outPanX, double &outPanY, double &outRotateX, double &outRotateY, double &outDolly)
+{
+  outPanX = panX; outPanY = panY;
+  outRotateX = rotateX; outRotateY = rotateY;
+  outDolly = dolly;
+  panX = panY = rotateX = rotateY = dolly = 0.0;
+}
+
+void CameraInput::step(double dt, double move[3])
+{
+  double speed = flySpeed * ((keys & Fast) ? fastFactor : 1.0);
+  double target[3] = {
+    speed * (((keys & Right) ? 1.0 : 0.0) - ((keys & Left) ? 1.0 : 0.0)),
+    speed * (((keys & Up) ? 1.0 : 0.0) - ((keys & Down) ? 1.0 : 0.0)),
+    speed * (((keys & Forward) ? 1.0 : 0.0) - ((keys & Back) ? 1.0 : 0.0))
+  };
+
+  // Ease towards the target velocity so starting and stopping is smooth
+  double blend = 1.0 - exp(-acceleration * dt);
+  for (int i = 0; i < 3; i++)
+  {
+    velocity[i] += (target[i] - velocity[i]) * blend;
+    if (target[i] == 0.0 && fabs(velocity[i]) < 1e-3)
+      velocity[i] = 0.0;
+    move[i] = velocity[i] * dt;
+  }
+}
+
+bool CameraInput::hasMouse() const
+{
+  return panX != 0.0 || panY != 0.0 || rotateX != 0.0 || rotateY != 0.0 || dolly != 0.0;
+}
+
+bool CameraInput::isActive() const
+{
+  return (keys & ~Fast) != 0 || hasMouse() || velocity[0] != 0.0 || velocity[1] != 0.0 || velocity[2] != 0.0;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <QtCore>
+
+// Collects raw mouse and keyboard input between frames.
+// GLViewer drains it once per frame: mouse deltas are applied as a whole,
+// keyboard fly motion is integrated in fixed timesteps.
+class CameraInput
+{
+public:
+  enum { Forward = 1, Back = 2, Left = 4, Right = 8, Up = 16, Down = 32, Fast = 64 };
+
+  CameraInput();
+
+  void addMouseDelta(double dx, double dy, Qt::MouseButtons buttons);
+  bool setKey(int key, bool pressed); // False if the key is not a fly control
+  void releaseAll();
+
+  // Take the accumulated mouse deltas (normalized to the widget size)
+  void takeMouse(double &panX, double &panY, double &rotateX, double &rotateY, double &dolly);
+
+  // Advance the fly velocity by one fixed step and return the displacement
+  // along the camera's right, up and forward axes
+  void step(double dt, double move[3]);
+
+  bool hasMouse() const;
+  bool isActive() const;
+
+private:
+  double panX, panY, rotateX, rotateY, dolly;
+  double velocity[3]; // Right, up, forward
+  int keys;
+};
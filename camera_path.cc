@@ -0,0 +1,79 @@
+#include "camera_path.h"
+#include <cmath>
+#include "interference.h"
+#include "scene_math.h"
+
+static const double turntablePitch = -M_PI / 6.0;          // Looking down 30 degrees
+static const double turntableStart = M_PI + M_PI / 4.0;    // Where GLViewer's camera starts
+static const double halfFieldOfView = 22.5 * M_PI / 180.0; // Of the 45 degree perspective
+static const double turntableMargin = 1.1;                  // Room around the bounds
+
+void sceneBounds(const SceneData &scene, Vec3 &boundsMin, Vec3 &boundsMax)
+{
+  boundsMin = boundsMax = makeVec3(0.0, 0.0, 0.0);
+  for (int i = 0; i < scene.size(); i++)
+  {
+    WorldBox box = objectBox(scene, i);
+    for (int k = 0; k < 3; k++)
+    {
+      boundsMin[k] = i == 0 ? box.min[k] : qMin(boundsMin[k], (double)box.min[k]);
+      boundsMax[k] = i == 0 ? box.max[k] : qMax(boundsMax[k], (double)box.max[k]);
+    }
+  }
+}
+
+CameraKey turntableCamera(const Vec3 &boundsMin, const Vec3 &boundsMax, double t)
+{
+  double center[3], radius = 0.0;
+  for (int k = 0; k < 3; k++)
+  {
+    center[k] = 0.5 * (boundsMin[k] + boundsMax[k]);
+    radius += 0.25 * (boundsMax[k] - boundsMin[k]) * (boundsMax[k] - boundsMin[k]);
+  }
+  radius = qMax(sqrt(radius), 1.0);
+  double distance = turntableMargin * radius / sin(halfFieldOfView);
+
+  CameraKey key;
+  key.rotation[0] = fmod(turntableStart + 2.0 * M_PI * t, 2.0 * M_PI);
+  key.rotation[1] = turntablePitch;
+  double forward[3], right[3], up[3];
+  cameraAxes(key.rotation[0], key.rotation[1], forward, right, up);
+  for (int k = 0; k < 3; k++)
+    key.position[k] = center[k] - distance * forward[k];
+  return key;
+}
+
+// Uniform Catmull-Rom between p1 and p2
+static double catmullRom(double p0, double p1, double p2, double p3, double u)
+{
+  return 0.5 * (2.0 * p1 + (p2 - p0) * u + (2.0 * p0 - 5.0 * p1 + 4.0 * p2 - p3) * u * u
+                + (3.0 * p1 - p0 - 3.0 * p2 + p3) * u * u * u);
+}
+
+CameraKey flythroughCamera(const QVector<CameraKey> &keys, double t)
+{
+  int count = keys.size();
+  if (count == 1)
+    return keys[0];
+
+  // Each angle is moved to within half a turn of the one before
+  QVector<CameraKey> path = keys;
+  for (int i = 1; i < count; i++)
+    for (int a = 0; a < 2; a++)
+    {
+      double &angle = path[i].rotation[a];
+      angle -= 2.0 * M_PI * floor((angle - path[i - 1].rotation[a] + M_PI) / (2.0 * M_PI));
+    }
+
+  double x = qBound(0.0, t, 1.0) * (count - 1);
+  int i = qMin((int)x, count - 2);
+  double u = x - i;
+  const CameraKey &k0 = path[qMax(i - 1, 0)], &k1 = path[i], &k2 = path[i + 1], &k3 = path[qMin(i + 2, count - 1)];
+
+  CameraKey key;
+  for (int k = 0; k < 3; k++)
+    key.position[k] = catmullRom(k0.position[k], k1.position[k], k2.position[k], k3.position[k], u);
+  for (int a = 0; a < 2; a++)
+    key.rotation[a] = catmullRom(k0.rotation[a], k1.rotation[a], k2.rotation[a], k3.rotation[a], u);
+  return key;
+}
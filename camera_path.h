@@ -0,0 +1,26 @@
+#pragma once
+
+#include <QtCore>
+#include "scene_data.h"
+
+// A perspective camera as GLViewer holds it: position, and horizontal and
+// vertical angles in radians (camPosition and camRotation)
+struct CameraKey
+{
+  double position[3];
+  double rotation[2];
+};
+Q_DECLARE_TYPEINFO(CameraKey, Q_PRIMITIVE_TYPE);
+
+// World box around every object of the scene; zero when it is empty
+void sceneBounds(const SceneData &scene, Vec3 &boundsMin, Vec3 &boundsMax);
+
+// Once around the box's center as t goes from 0 to 1, looking down at it
+// from 30 degrees and far enough back that the whole box stays in view.
+// t = 1 is t = 0 again, so the frames of [0, 1) loop.
+CameraKey turntableCamera(const Vec3 &boundsMin, const Vec3 &boundsMax, double t);
+
+// Through the keys in order as t goes from 0 to 1, evenly spaced in t, on
+// Catmull-Rom splines so the camera doesn't stop at each key. Angles turn
+// the shorter way round. keys must not be empty.
+CameraKey flythroughCamera(const QVector<CameraKey> &keys, double t);
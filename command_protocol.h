@@ -0,0 +1,37 @@
+#pragma once
+
+// Wire format of the scene command server, shared with the tools. All
+// integers and doubles are little-endian.
+//
+// A batch is a u32 byte count followed by that many bytes of commands.
+// The server answers every batch with a u32 byte count, a u8 status, a u32
+// (commands applied, or the byte offset of the bad command when the status
+// is Malformed) and then the results of the commands that return
+// something, in order. A malformed batch is rejected as a whole.
+//
+// Objects are addressed by their index in the scene. Removes take effect
+// at the end of the batch, highest index first, so every index in a batch
+// refers to the scene as it was before the batch plus the objects the
+// batch created.
+namespace CommandProtocol {
+
+enum Opcode
+{
+  Create = 1, // u8 type (0 = Plane ... 6 = Wedge) -> u32 index
+  Translate,  // u32 index, 3 x f64
+  Rotate,     // u32 index, 3 x f64 (degrees)
+  Scale,      // u32 index, 3 x f64
+  Color,      // u32 index, 3 x f64 (0..1)
+  Remove,     // u32 index
+  Query,      // u32 index -> u8 type, 12 x f64 (translate, rotate, scale, color)
+  Count,      // -> u32 objects
+  Save        // u16 byte count, UTF-8 file name -> u8 1 if the save started
+};
+
+enum Status { Ok = 0, Malformed = 1 };
+
+enum { HeaderSize = 4, ReplyHeaderSize = 9, MaxBatchSize = 64 << 20 };
+
+inline const char *defaultServerName() { return "voxel_playground"; }
+
+} // namespace CommandProtocol
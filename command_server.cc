@@ -0,0 +1,247 @@
+#include "command_server.h"
+#include <QtEndian>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include "trace.h"
+
+using namespace CommandProtocol;
+
+static quint32 readU32(const uchar *data)
+{
+  return qFromLittleEndian<quint32>(data);
+}
+
+static double readDouble(const uchar *data)
+{
+  quint64 bits = qFromLittleEndian<quint64>(data);
+  double value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+static void appendU32(QByteArray &out, quint32 value)
+{
+  uchar bytes[4];
+  qToLittleEndian(value, bytes);
+  out.append((const char *)bytes, 4);
+}
+
+static void appendDouble(QByteArray &out, double value)
+{
+  quint64 bits;
+  memcpy(&bits, &value, sizeof(bits));
+  uchar bytes[8];
+  qToLittleEndian(bits, bytes);
+  out.append((const char *)bytes, 8);
+}
+
+static void appendVector(QByteArray &out, const Vec3 &vec)
+{
+  for (int i = 0; i < 3; i++)
+    appendDouble(out, vec[i]);
+}
+
+// Size of the command at data, or 0 if it is unknown or runs past end
+static int commandSize(const uchar *data, const uchar *end)
+{
+  int size = 0;
+  switch (data[0])
+  {
+  case Create: size = 2; break;
+  case Translate:
+  case Rotate:
+  case Scale:
+  case Color: size = 29; break;
+  case Remove:
+  case Query: size = 5; break;
+  case Count: size = 1; break;
+  case Save:
+    if (end - data >= 3)
+      size = 3 + qFromLittleEndian<quint16>(data + 1);
+    break;
+  default: break;
+  }
+  return (size > 0 && size <= end - data) ? size : 0;
+}
+
+CommandServer::CommandServer(Scene *scene, QObject *parent) : QObject(parent), scene(scene)
+{
+  server = new QLocalServer(this);
+  connect(server, SIGNAL(newConnection()), this, SLOT(newConnection()));
+}
+
+bool CommandServer::listen(const QString &name)
+{
+  if (server->isListening())
+    server->close();
+  if (server->listen(name))
+    return true;
+
+  // A crashed session may have left its socket file behind, but only
+  // remove it if no running session answers on it
+  if (server->serverError() != QAbstractSocket::AddressInUseError)
+    return false;
+  QLocalSocket probe;
+  probe.connectToServer(name);
+  if (probe.waitForConnected(500))
+  {
+    probe.disconnectFromServer();
+    return false;
+  }
+  QLocalServer::removeServer(name);
+  return server->listen(name);
+}
+
+void CommandServer::close()
+{
+  server->close();
+}
+
+void CommandServer::newConnection()
+{
+  while (server->hasPendingConnections())
+  {
+    QLocalSocket *socket = server->nextPendingConnection();
+    connect(socket, SIGNAL(readyRead()), this, SLOT(readClient()));
+    connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+  }
+}
+
+// Batches are applied as soon as they are complete; a client may queue
+// several before reading the replies
+void CommandServer::readClient()
+{
+  QLocalSocket *socket = qobject_cast<QLocalSocket *>(sender());
+  if (!socket)
+    return;
+
+  while (socket->bytesAvailable() >= HeaderSize)
+  {
+    uchar header[HeaderSize];
+    socket->peek((char *)header, HeaderSize);
+    quint32 size = readU32(header);
+    if (size > (quint32)MaxBatchSize)
+    {
+      socket->abort();
+      return;
+    }
+    if (socket->bytesAvailable() < HeaderSize + (qint64)size)
+      return;
+
+    socket->read(HeaderSize);
+    socket->write(runBatch(socket->read(size)));
+  }
+}
+
+// Checks the whole batch before anything is applied, so a bad command
+// rejects the batch instead of leaving half of it behind
+bool CommandServer::validate(const QByteArray &batch, int &badOffset) const
+{
+  const uchar *begin = (const uchar *)batch.constData();
+  const uchar *end = begin + batch.size();
+  quint32 count = scene->data().size();
+
+  for (const uchar *p = begin; p < end; )
+  {
+    badOffset = p - begin;
+    int size = commandSize(p, end);
+    if (size == 0)
+      return false;
+    if (p[0] == Create)
+    {
+      if (p[1] > 6)
+        return false;
+      count++;
+    }
+    else if (size >= 5 && p[0] != Save && readU32(p + 1) >= count)
+      return false;
+    p += size;
+  }
+  return true;
+}
+
+QByteArray CommandServer::runBatch(const QByteArray &batch)
+{
+  TRACE_SCOPE("CommandServer::runBatch");
+  QByteArray results;
+  quint8 status = Ok;
+  quint32 applied = 0;
+  int badOffset = 0;
+
+  if (!validate(batch, badOffset))
+  {
+    status = Malformed;
+    applied = badOffset;
+  }
+  else
+  {
+    const uchar *p = (const uchar *)batch.constData();
+    const uchar *end = p + batch.size();
+    std::vector<int> removes;
+
+    scene->beginBatch();
+    while (p < end)
+    {
+      int size = commandSize(p, end);
+      switch (p[0])
+      {
+      case Create:
+        scene->createObject(p[1]);
+        appendU32(results, scene->data().size() - 1);
+        break;
+      case Translate:
+        scene->receiveTranslation(readU32(p + 1), readDouble(p + 5), readDouble(p + 13), readDouble(p + 21));
+        break;
+      case Rotate:
+        scene->receiveRotation(readU32(p + 1), readDouble(p + 5), readDouble(p + 13), readDouble(p + 21));
+        break;
+      case Scale:
+        scene->receiveScale(readU32(p + 1), readDouble(p + 5), readDouble(p + 13), readDouble(p + 21));
+        break;
+      case Color:
+        scene->receiveColor(readU32(p + 1), readDouble(p + 5), readDouble(p + 13), readDouble(p + 21));
+        break;
+      case Remove:
+        removes.push_back(readU32(p + 1));
+        break;
+      case Query: {
+        const SceneData &data = scene->data();
+        int index = readU32(p + 1);
+        results.append((char)data.objects[index]);
+        appendVector(results, data.translates[index]);
+        appendVector(results, data.rotations[index]);
+        appendVector(results, data.scales[index]);
+        appendVector(results, data.colors[index]);
+        break;
+      }
+      case Count:
+        appendU32(results, scene->data().size());
+        break;
+      case Save: {
+        bool started = !scene->isBusy();
+        scene->saveFile(QString::fromUtf8((const char *)p + 3, size - 3));
+        results.append((char)(started ? 1 : 0));
+        break;
+      }
+      }
+      p += size;
+      applied++;
+    }
+
+    // Highest index first, so the indices still to go stay put
+    std::sort(removes.begin(), removes.end());
+    removes.erase(std::unique(removes.begin(), removes.end()), removes.end());
+    for (int i = (int)removes.size() - 1; i >= 0; i--)
+      scene->removeObject(removes[i]);
+    scene->endBatch();
+  }
+
+  QByteArray reply;
+  reply.reserve(ReplyHeaderSize + results.size());
+  appendU32(reply, ReplyHeaderSize - HeaderSize + results.size());
+  reply.append((char)status);
+  appendU32(reply, applied);
+  reply.append(results);
+  return reply;
+}
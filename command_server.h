@@ -0,0 +1,36 @@
+#pragma once
+
+#include <QtCore>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include "scene.h"
+#include "command_protocol.h"
+
+// Applies batches of scripted edits from local clients to the scene; see
+// command_protocol.h for the format. Each batch is one Scene batch, so the
+// views redraw and the object list updates once per batch.
+class CommandServer : public QObject
+{
+
+  Q_OBJECT
+
+public:
+  CommandServer(Scene *scene, QObject *parent = 0);
+
+  bool listen(const QString &name);
+  void close();
+  bool isListening() const { return server->isListening(); }
+  QString fullServerName() const { return server->fullServerName(); }
+  QString errorString() const { return server->errorString(); } // Why listen() failed
+
+private slots:
+  void newConnection();
+  void readClient();
+
+private:
+  bool validate(const QByteArray &batch, int &badOffset) const;
+  QByteArray runBatch(const QByteArray &batch);
+
+  Scene *scene;
+  QLocalServer *server;
+};
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <QVector>
+
+// Chunked copy-on-write array.
+// Copies share every chunk. Writing through a copy only detaches the outer
+// chunk list and the one chunk that holds the element, so snapshotting a
+// large scene never copies the object data itself. Chunks are full up to
+// the last, so an element is found with a shift; the price is erase(),
+// which moves an element across every later chunk and so detaches all of
+// them while a copy is alive.
+template <typename T, int ChunkShift = 12>
+class CowArray
+{
+public:
+  enum { ChunkSize = 1 << ChunkShift, ChunkMask = ChunkSize - 1 };
+
+  CowArray() : count(0) {}
+
+  int size() const { return count; }
+  bool empty() const { return count == 0; }
+
+  // Read access never detaches; use it (through a const reference) on hot paths
+  const T &operator[](int index) const { return chunks.at(index >> ChunkShift).at(index & ChunkMask); }
+  T &operator[](int index) { return chunks[index >> ChunkShift][index & ChunkMask]; }
+
+  void push_back(const T &value)
+  {
+    if ((count & ChunkMask) == 0)
+    {
+      chunks.append(QVector<T>());
+      chunks.last().reserve(ChunkSize);
+    }
+    chunks.last().append(value);
+    count++;
+  }
+
+  // Append a whole chunk without copying it; only while size() is a
+  // multiple of ChunkSize, e.g. when filling an array block by block
+  void appendChunk(const QVector<T> &values)
+  {
+    Q_ASSERT((count & ChunkMask) == 0 && values.size() <= ChunkSize);
+    if (values.isEmpty())
+      return;
+    chunks.append(values);
+    count += values.size();
+  }
+
+  // Append all of another array; its chunks are shared while size() is a
+  // multiple of ChunkSize (e.g. when empty), copied element-wise otherwise
+  void append(const CowArray &other)
+  {
+    if ((count & ChunkMask) == 0)
+    {
+      int chunkTotal = other.chunks.size();
+      for (int i = 0; i < chunkTotal; i++)
+        appendChunk(other.chunks.at(i));
+      return;
+    }
+    int total = other.size();
+    for (int i = 0; i < total; i++)
+      push_back(other[i]);
+  }
+
+  // O(size() - index), and while a copy shares the chunks, every chunk from
+  // index's on is copied too; removing from the front of a large snapshot
+  // costs about as much as copying it
+  void erase(int index)
+  {
+    int chunk = index >> ChunkShift;
+    chunks[chunk].remove(index & ChunkMask);
+
+    // Pull the first element of every following chunk down by one
+    for (int i = chunk + 1; i < chunks.size(); i++)
+    {
+      chunks[i - 1].append(chunks.at(i).first());
+      chunks[i].remove(0);
+    }
+    if (chunks.last().isEmpty())
+      chunks.removeLast();
+    count--;
+  }
+
+  void clear()
+  {
+    chunks.clear();
+    count = 0;
+  }
+
+  // Raw chunk access for bulk loops (serialization, rendering)
+  int chunkCount() const { return chunks.size(); }
+  const QVector<T> &chunk(int index) const { return chunks.at(index); }
+
+  // Detaches a chunk and returns its elements, for parallel writers that
+  // each own a part of it; take every pointer before the writers start
+  T *chunkData(int index) { return chunks[index].data(); }
+
+  // Heap bytes held, counting shared chunks in full
+  qint64 memoryUsage() const
+  {
+    qint64 bytes = (qint64)chunks.capacity() * sizeof(QVector<T>);
+    for (int i = 0; i < chunks.size(); i++)
+      bytes += (qint64)chunks.at(i).capacity() * sizeof(T);
+    return bytes;
+  }
+
+private:
+  QVector<QVector<T> > chunks;
+  int count;
+};
@@ -0,0 +1,446 @@
+#include "farm_coordinator.h"
+#include <cstdio>
+#include "poster_renderer.h"
+#include "video_exporter.h"
+
+using namespace FarmProtocol;
+
+static const int farmVideoWidth = 1280;
+static const int farmVideoHeight = 720;
+static const double farmFrameRate = 30.0;
+static const int framesPerUnit = 30;             // A second of video per unit
+static const int maxPosterSide = 32768;          // Pixels
+static const int maxAttempts = 3;                // Workers a unit is tried on
+static const qint64 unitTimeout = 10 * 60 * 1000; // Milliseconds before a worker counts as hung
+
+FarmCoordinator::FarmCoordinator(QObject *parent) : QObject(parent)
+{
+  restarts = 0;
+  retries = 0;
+  initialWorkers = 0;
+  maxRestarts = 0;
+  server = new QLocalServer(this);
+  connect(server, SIGNAL(newConnection()), this, SLOT(newConnection()));
+  timeoutTimer = new QTimer(this);
+  timeoutTimer->setInterval(1000);
+  connect(timeoutTimer, SIGNAL(timeout()), this, SLOT(checkTimeouts()));
+}
+
+FarmCoordinator::~FarmCoordinator()
+{
+  foreach (Worker *worker, workers)
+  {
+    if (!worker->exited)
+    {
+      worker->process->kill();
+      worker->process->waitForFinished();
+    }
+    delete worker;
+  }
+}
+
+/********/
+/* JOBS */
+/********/
+
+// "x,y,z,h,v"
+static bool parseCamera(const QString &text, CameraKey &key)
+{
+  QStringList values = text.split(',');
+  if (values.size() != 5)
+    return false;
+  bool ok = true;
+  for (int k = 0; k < 5 && ok; k++)
+  {
+    double value = values[k].toDouble(&ok);
+    if (k < 3)
+      key.position[k] = value;
+    else
+      key.rotation[k - 3] = value;
+  }
+  return ok;
+}
+
+bool FarmCoordinator::parseJobs(const QString &fileName)
+{
+  QFile file(fileName);
+  if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+  {
+    fprintf(stderr, "could not read %s\n", fileName.toLocal8Bit().constData());
+    return false;
+  }
+  QDir dir = QFileInfo(fileName).dir();
+  QTextStream in(&file);
+  for (int line = 1; !in.atEnd(); line++)
+  {
+    QString text = in.readLine().trimmed();
+    if (text.isEmpty() || text.startsWith('#'))
+      continue;
+    QStringList fields = text.split(QRegExp("\\s+"), QString::SkipEmptyParts);
+
+    Unit unit;
+    unit.id = 0;
+    unit.sceneFile = fields.size() > 1 ? dir.absoluteFilePath(fields[1]) : QString();
+    unit.seconds = 0.0;
+    unit.frameRate = farmFrameRate;
+    unit.loopLength = 0.0;
+    unit.turntable = fields[0] == "turntable";
+    unit.first = unit.end = 0;
+    bool ok = false;
+
+    // The loop length may follow the output of either kind of video
+    bool loopOk = true;
+    if (fields.size() > 4 && fields[4].startsWith("loop=") && fields[0] != "poster")
+    {
+      unit.loopLength = fields[4].mid(5).toDouble(&loopOk);
+      loopOk = loopOk && unit.loopLength >= 0.0;
+      fields.removeAt(4);
+    }
+
+    if (loopOk && ((fields[0] == "turntable" && fields.size() == 4) || (fields[0] == "flythrough" && fields.size() >= 5)))
+    {
+      unit.kind = VideoFrames;
+      unit.seconds = fields[2].toDouble(&ok);
+      ok = ok && unit.seconds > 0.0;
+      unit.output = dir.absoluteFilePath(fields[3]);
+      unit.width = farmVideoWidth;
+      unit.height = farmVideoHeight;
+      for (int f = 4; f < fields.size() && ok; f++)
+      {
+        CameraKey key;
+        ok = parseCamera(fields[f], key);
+        unit.keys.append(key);
+      }
+      if (ok)
+      {
+        jobs.append(Job());
+        addUnits(unit, jobs.size() - 1, VideoExporter::frameCount(unit.seconds, unit.frameRate), framesPerUnit);
+      }
+    }
+    else if (fields[0] == "poster" && (fields.size() == 5 || fields.size() == 6))
+    {
+      unit.kind = PosterTiles;
+      bool heightOk;
+      unit.width = fields[2].toInt(&ok);
+      unit.height = fields[3].toInt(&heightOk);
+      ok = ok && heightOk && unit.width > 0 && unit.height > 0 && unit.width <= maxPosterSide && unit.height <= maxPosterSide;
+      unit.output = dir.absoluteFilePath(fields[4]);
+      if (ok && fields.size() == 6)
+      {
+        CameraKey key;
+        ok = parseCamera(fields[5], key);
+        unit.keys.append(key);
+      }
+      if (ok && !PosterRenderer::createFile(unit.output, unit.width, unit.height))
+      {
+        fprintf(stderr, "could not write %s\n", unit.output.toLocal8Bit().constData());
+        return false;
+      }
+      if (ok)
+      {
+        jobs.append(Job());
+        addUnits(unit, jobs.size() - 1, PosterRenderer::tileCount(unit.width, unit.height), 1);
+      }
+    }
+
+    if (!ok)
+    {
+      fprintf(stderr, "%s:%d: expected turntable <scene> <seconds> <frames.png> [loop=<seconds>], flythrough <scene> "
+              "<seconds> <frames.png> [loop=<seconds>] <x,y,z,h,v>..., or poster <scene> <width> <height> <poster.ppm> [<x,y,z,h,v>]\n",
+              fileName.toLocal8Bit().constData(), line);
+      return false;
+    }
+    jobs.last().description = QString("%1 %2").arg(fields[0]).arg(fields[1]);
+  }
+  return true;
+}
+
+// Splits the job's frames or tiles into units of perUnit
+void FarmCoordinator::addUnits(const Unit &unit, int job, int count, int perUnit)
+{
+  Job &info = jobs[job];
+  info.units = info.done = info.failed = 0;
+  for (int first = 0; first < count; first += perUnit)
+  {
+    UnitInfo next;
+    next.unit = unit;
+    next.unit.id = units.size();
+    next.unit.first = first;
+    next.unit.end = qMin(first + perUnit, count);
+    next.job = job;
+    next.attempts = 0;
+    next.state = Pending;
+    pending.append(units.size());
+    units.append(next);
+    info.units++;
+  }
+}
+
+/***********/
+/* WORKERS */
+/***********/
+
+bool FarmCoordinator::start(const QString &jobFile, int workerCount)
+{
+  if (!parseJobs(jobFile))
+    return false;
+  if (units.isEmpty())
+  {
+    fprintf(stderr, "no jobs in %s\n", jobFile.toLocal8Bit().constData());
+    return false;
+  }
+
+  // Unique per coordinator, so several farms can run at once
+  QString name = QString("voxel_farm_%1").arg(QCoreApplication::applicationPid());
+  QLocalServer::removeServer(name);
+  if (!server->listen(name))
+  {
+    fprintf(stderr, "could not listen on %s\n", name.toLocal8Bit().constData());
+    return false;
+  }
+
+  // Once the event loop runs, so a worker that fails right away can end the farm
+  initialWorkers = qMin(workerCount, units.size());
+  maxRestarts = 2 * initialWorkers;
+  QMetaObject::invokeMethod(this, "startWorkers", Qt::QueuedConnection);
+  return true;
+}
+
+void FarmCoordinator::startWorkers()
+{
+  clock.start();
+  timeoutTimer->start();
+  for (int w = 0; w < initialWorkers; w++)
+    startWorker();
+}
+
+void FarmCoordinator::startWorker()
+{
+  Worker *worker = new Worker;
+  worker->process = new QProcess(this);
+  worker->socket = 0;
+  worker->unit = -1;
+  worker->lifeMsec = 0;
+  worker->exited = false;
+  worker->unitsDone = worker->frames = worker->tiles = worker->failures = 0;
+  worker->busyMsec = 0;
+  worker->life.start();
+  workers.append(worker);
+
+  worker->process->setProcessChannelMode(QProcess::ForwardedChannels);
+  connect(worker->process, SIGNAL(finished(int, QProcess::ExitStatus)), this, SLOT(workerFinished()));
+  connect(worker->process, SIGNAL(error(QProcess::ProcessError)), this, SLOT(workerError(QProcess::ProcessError)));
+  QStringList args;
+  args << "--farm-worker" << server->serverName() << QString::number(workers.size() - 1);
+  worker->process->start(QCoreApplication::applicationFilePath(), args);
+}
+
+// Workers introduce themselves by index, as the connection can't tell
+void FarmCoordinator::newConnection()
+{
+  while (server->hasPendingConnections())
+  {
+    QLocalSocket *socket = server->nextPendingConnection();
+    connect(socket, SIGNAL(readyRead()), this, SLOT(readWorker()));
+    connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+  }
+}
+
+void FarmCoordinator::readWorker()
+{
+  QLocalSocket *socket = qobject_cast<QLocalSocket *>(sender());
+  QByteArray message;
+  while (socket && receive(socket, message))
+  {
+    QDataStream in(message);
+    qint32 type;
+    in >> type;
+    if (type == Hello)
+    {
+      qint32 index;
+      in >> index;
+      if (index < 0 || index >= workers.size() || workers[index]->socket)
+      {
+        socket->abort();
+        return;
+      }
+      workers[index]->socket = socket;
+      dispatch(workers[index]);
+      continue;
+    }
+
+    Worker *worker = 0;
+    foreach (Worker *candidate, workers)
+      if (candidate->socket == socket && !candidate->exited)
+        worker = candidate;
+    if (!worker || type != Result)
+    {
+      socket->abort();
+      return;
+    }
+
+    qint32 id;
+    bool ok;
+    QString text;
+    qint64 msec;
+    in >> id >> ok >> text >> msec;
+    if (id != worker->unit)
+      continue;
+    worker->unit = -1;
+    worker->busyMsec += msec;
+    if (ok)
+    {
+      const Unit &unit = units[id].unit;
+      units[id].state = Done;
+      jobs[units[id].job].done++;
+      worker->unitsDone++;
+      (unit.kind == VideoFrames ? worker->frames : worker->tiles) += unit.end - unit.first;
+    }
+    else
+    {
+      worker->failures++;
+      retry(id, text);
+    }
+    dispatch(worker);
+  }
+  checkFinished();
+}
+
+// The next unit, or quit once there are none
+void FarmCoordinator::dispatch(Worker *worker)
+{
+  QByteArray message;
+  QDataStream out(&message, QIODevice::WriteOnly);
+  if (pending.isEmpty())
+    out << (qint32)Quit;
+  else
+  {
+    int id = pending.takeFirst();
+    units[id].state = Running;
+    units[id].attempts++;
+    worker->unit = id;
+    worker->unitClock.start();
+    out << (qint32)Work << units[id].unit;
+  }
+  send(worker->socket, message);
+}
+
+void FarmCoordinator::retry(int unit, const QString &report)
+{
+  UnitInfo &info = units[unit];
+  fprintf(stderr, "unit %d of %s: %s\n", unit, jobs[info.job].description.toLocal8Bit().constData(), report.toLocal8Bit().constData());
+  if (info.attempts < maxAttempts)
+  {
+    info.state = Pending;
+    pending.append(unit);
+    retries++;
+  }
+  else
+  {
+    info.state = Failed;
+    jobs[info.job].failed++;
+  }
+}
+
+void FarmCoordinator::workerFinished()
+{
+  foreach (Worker *worker, workers)
+    if (worker->process == sender())
+      workerGone(worker);
+}
+
+// Processes that never started don't finish
+void FarmCoordinator::workerError(QProcess::ProcessError error)
+{
+  if (error != QProcess::FailedToStart)
+    return;
+  foreach (Worker *worker, workers)
+    if (worker->process == sender())
+      workerGone(worker);
+}
+
+// Its unit goes to another worker, and a replacement starts if there is
+// work left
+void FarmCoordinator::workerGone(Worker *worker)
+{
+  if (worker->exited)
+    return;
+  worker->exited = true;
+  worker->lifeMsec = worker->life.elapsed();
+  if (worker->unit >= 0)
+  {
+    worker->busyMsec += worker->unitClock.elapsed();
+    worker->failures++;
+    retry(worker->unit, "worker exited");
+    worker->unit = -1;
+  }
+  if (!pending.isEmpty() && restarts < maxRestarts)
+  {
+    restarts++;
+    startWorker();
+  }
+  checkFinished();
+}
+
+void FarmCoordinator::checkTimeouts()
+{
+  foreach (Worker *worker, workers)
+    if (!worker->exited && worker->unit >= 0 && worker->unitClock.elapsed() > unitTimeout)
+      worker->process->kill();
+}
+
+void FarmCoordinator::checkFinished()
+{
+  foreach (Worker *worker, workers)
+    if (!worker->exited)
+      return;
+
+  // No worker left to take what is still pending
+  foreach (int unit, pending)
+  {
+    units[unit].state = Failed;
+    jobs[units[unit].job].failed++;
+  }
+  pending.clear();
+
+  timeoutTimer->stop();
+  report();
+  bool failed = false;
+  foreach (const Job &job, jobs)
+    failed = failed || job.failed > 0;
+  QCoreApplication::exit(failed ? 1 : 0);
+}
+
+/**********/
+/* REPORT */
+/**********/
+
+void FarmCoordinator::report()
+{
+  double seconds = clock.elapsed() / 1000.0;
+  int done = 0, failed = 0;
+  foreach (const Job &job, jobs)
+  {
+    done += job.done;
+    failed += job.failed;
+  }
+
+  QTextStream out(stdout);
+  out << QString("Render farm: %1 of %2 units in %3 s on %4 workers (%5 replaced), %6 retries, %7 failed")
+         .arg(done).arg(units.size()).arg(seconds, 0, 'f', 1).arg(workers.size() - restarts).arg(restarts).arg(retries)
+         .arg(failed) << endl;
+  for (int j = 0; j < jobs.size(); j++)
+    out << QString("  Job %1, %2: %3 of %4 units done%5").arg(j + 1).arg(jobs[j].description).arg(jobs[j].done)
+           .arg(jobs[j].units).arg(jobs[j].failed ? QString(", %1 failed").arg(jobs[j].failed) : QString()) << endl;
+
+  // Utilization is the time spent on units over the time the worker lived
+  for (int w = 0; w < workers.size(); w++)
+  {
+    const Worker *worker = workers[w];
+    double busy = worker->busyMsec / 1000.0, life = qMax(worker->lifeMsec, (qint64)1) / 1000.0;
+    out << QString("  Worker %1: %2 units (%3 frames, %4 tiles), busy %5 s of %6 s (%7%), %8 frames/s, %9 tiles/s, %10 failures")
+           .arg(w + 1).arg(worker->unitsDone).arg(worker->frames).arg(worker->tiles).arg(busy, 0, 'f', 1)
+           .arg(life, 0, 'f', 1).arg(100.0 * busy / life, 0, 'f', 0).arg(worker->frames / qMax(busy, 0.001), 0, 'f', 1)
+           .arg(worker->tiles / qMax(busy, 0.001), 0, 'f', 2).arg(worker->failures) << endl;
+  }
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <QtCore>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include "farm_protocol.h"
+
+// Renders a batch of jobs on local worker processes of this binary
+// (started with --farm-worker), to keep machines with many cores busy.
+// Jobs come from a text file, one per line:
+//
+//   turntable <scene.vox> <seconds> <frames.png> [loop=<seconds>]
+//   flythrough <scene.vox> <seconds> <frames.png> [loop=<seconds>] <camera> <camera> ...
+//   poster <scene.vox> <width> <height> <poster.ppm> [<camera>]
+//
+// where a camera is "x,y,z,h,v" as GLViewer's camPosition and camRotation,
+// and files are relative to the job file. Animation in videos wraps around
+// at the loop length or the last key, whichever is later, as exports from
+// the timeline do; scene files don't store the timeline's length. Videos are split into units of
+// a second of frames and posters into tiles; each worker asks for the next
+// unit when it finishes one, and writes the unit's output itself. A unit
+// that fails, or whose worker dies or hangs, goes to another worker, a few
+// times at most, and dead workers are replaced. Per-worker throughput and
+// utilization are printed at the end, and the application exits.
+class FarmCoordinator : public QObject
+{
+
+  Q_OBJECT
+
+public:
+  FarmCoordinator(QObject *parent = 0);
+  ~FarmCoordinator();
+
+  // False, with the reason on stderr, if the jobs can't be read or the
+  // coordinator can't listen
+  bool start(const QString &jobFile, int workerCount);
+
+private slots:
+  void startWorkers();
+  void newConnection();
+  void readWorker();
+  void workerFinished();
+  void workerError(QProcess::ProcessError error);
+  void checkTimeouts();
+
+private:
+  enum UnitState { Pending, Running, Done, Failed };
+
+  struct Job
+  {
+    QString description;
+    int units;
+    int done;
+    int failed;
+  };
+
+  struct UnitInfo
+  {
+    FarmProtocol::Unit unit;
+    int job;
+    int attempts;
+    UnitState state;
+  };
+
+  struct Worker
+  {
+    QProcess *process;
+    QLocalSocket *socket;
+    int unit; // Running on it, or -1
+    QElapsedTimer unitClock;
+    QElapsedTimer life;
+    qint64 lifeMsec; // Once it exited
+    bool exited;
+    int unitsDone;
+    int frames, tiles;
+    int failures;
+    qint64 busyMsec;
+  };
+
+  bool parseJobs(const QString &fileName);
+  void addUnits(const FarmProtocol::Unit &unit, int job, int count, int perUnit);
+  void startWorker();
+  void dispatch(Worker *worker);
+  void retry(int unit, const QString &report);
+  void workerGone(Worker *worker);
+  void checkFinished();
+  void report();
+
+  QLocalServer *server;
+  QTimer *timeoutTimer;
+  QList<Job> jobs;
+  QVector<UnitInfo> units;
+  QList<int> pending; // Units waiting for a worker
+  QList<Worker *> workers;
+  int restarts;
+  int retries;
+  int initialWorkers;
+  int maxRestarts;
+  QElapsedTimer clock;
+};
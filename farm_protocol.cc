@@ -0,0 +1,59 @@
+#include "farm_protocol.h"
+#include <QtEndian>
+
+namespace FarmProtocol {
+
+QDataStream &operator<<(QDataStream &out, const Unit &unit)
+{
+  out << unit.id << unit.kind << unit.sceneFile << unit.output << unit.width << unit.height << unit.seconds << unit.frameRate
+      << unit.loopLength << unit.turntable << (qint32)unit.keys.size();
+  for (int k = 0; k < unit.keys.size(); k++)
+  {
+    const CameraKey &key = unit.keys[k];
+    out << key.position[0] << key.position[1] << key.position[2] << key.rotation[0] << key.rotation[1];
+  }
+  return out << unit.first << unit.end;
+}
+
+QDataStream &operator>>(QDataStream &in, Unit &unit)
+{
+  qint32 keys = 0;
+  in >> unit.id >> unit.kind >> unit.sceneFile >> unit.output >> unit.width >> unit.height >> unit.seconds >> unit.frameRate
+     >> unit.loopLength >> unit.turntable >> keys;
+  unit.keys.resize(qBound(0, keys, MaxMessageSize / 40));
+  for (int k = 0; k < unit.keys.size(); k++)
+  {
+    CameraKey &key = unit.keys[k];
+    in >> key.position[0] >> key.position[1] >> key.position[2] >> key.rotation[0] >> key.rotation[1];
+  }
+  return in >> unit.first >> unit.end;
+}
+
+void send(QLocalSocket *socket, const QByteArray &message)
+{
+  uchar header[HeaderSize];
+  qToLittleEndian((quint32)message.size(), header);
+  socket->write((const char *)header, HeaderSize);
+  socket->write(message);
+}
+
+bool receive(QLocalSocket *socket, QByteArray &message)
+{
+  if (socket->bytesAvailable() < HeaderSize)
+    return false;
+  uchar header[HeaderSize];
+  socket->peek((char *)header, HeaderSize);
+  quint32 size = qFromLittleEndian<quint32>(header);
+  if (size > (quint32)MaxMessageSize)
+  {
+    socket->abort();
+    return false;
+  }
+  if (socket->bytesAvailable() < HeaderSize + (qint64)size)
+    return false;
+  socket->read(HeaderSize);
+  message = socket->read(size);
+  return true;
+}
+
+} // namespace FarmProtocol
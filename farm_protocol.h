@@ -0,0 +1,49 @@
+#pragma once
+
+#include <QtCore>
+#include <QLocalSocket>
+#include "camera_path.h"
+
+// Messages between a render farm coordinator and its worker processes
+// (farm_coordinator.h) on a local socket. A message is a u32 little-endian
+// byte count, then a QDataStream of a Message and its fields. Both ends
+// are the same binary, so the stream needs no version of its own.
+namespace FarmProtocol {
+
+enum Message
+{
+  Hello = 1, // Worker: qint32 worker index; ready for a unit
+  Work,      // Coordinator: Unit
+  Result,    // Worker: qint32 unit id, bool ok, QString report, qint64 busy msec; ready for the next
+  Quit       // Coordinator: there are no more units
+};
+
+enum { HeaderSize = 4, MaxMessageSize = 1 << 20 };
+
+enum UnitKind { VideoFrames, PosterTiles };
+
+// A range of frames of a video, or of tiles of a poster, for one worker
+struct Unit
+{
+  qint32 id;
+  qint32 kind;
+  QString sceneFile;
+  QString output; // The video's frame name (video_exporter.h), or the poster
+  qint32 width, height;
+  double seconds, frameRate; // Videos only
+  double loopLength;         // Animation wraps around at this or the last key, whichever is later
+  bool turntable;            // Else a flythrough of keys
+  QVector<CameraKey> keys;   // Or the poster's camera; none frames the whole scene
+  qint32 first, end;         // Frames or tiles
+};
+
+QDataStream &operator<<(QDataStream &out, const Unit &unit);
+QDataStream &operator>>(QDataStream &in, Unit &unit);
+
+void send(QLocalSocket *socket, const QByteArray &message);
+
+// Takes the next whole message off the socket; false until one has
+// arrived. An oversized one aborts the connection.
+bool receive(QLocalSocket *socket, QByteArray &message);
+
+} // namespace FarmProtocol
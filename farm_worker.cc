@@ -0,0 +1,162 @@
+#include "farm_worker.h"
+#include "poster_renderer.h"
+#include "scene_io.h"
+#include "scene_journal.h"
+#include "video_exporter.h"
+
+using namespace FarmProtocol;
+
+FarmWorker::FarmWorker(QObject *parent) : QObject(parent)
+{
+  socket = new QLocalSocket(this);
+  videoExporter = 0;
+  posterRenderer = 0;
+  unit = -1;
+  connect(socket, SIGNAL(readyRead()), this, SLOT(readCoordinator()));
+  connect(socket, SIGNAL(disconnected()), this, SLOT(coordinatorGone()));
+}
+
+FarmWorker::~FarmWorker()
+{
+  delete videoExporter;
+  delete posterRenderer;
+}
+
+bool FarmWorker::start(const QString &serverName, int index)
+{
+  socket->connectToServer(serverName);
+  if (!socket->waitForConnected(5000))
+    return false;
+  QByteArray message;
+  QDataStream out(&message, QIODevice::WriteOnly);
+  out << (qint32)Hello << (qint32)index;
+  send(socket, message);
+  return true;
+}
+
+void FarmWorker::readCoordinator()
+{
+  QByteArray message;
+  while (receive(socket, message))
+  {
+    QDataStream in(message);
+    qint32 type;
+    in >> type;
+    if (type == Quit)
+    {
+      QCoreApplication::exit(0);
+      return;
+    }
+    if (type != Work || unit >= 0)
+    {
+      QCoreApplication::exit(1);
+      return;
+    }
+    Unit next;
+    in >> next;
+    startUnit(next);
+  }
+}
+
+// Nobody is left to hand in the unit to
+void FarmWorker::coordinatorGone()
+{
+  if (videoExporter)
+    videoExporter->cancel();
+  if (posterRenderer)
+    posterRenderer->cancel();
+  QCoreApplication::exit(1);
+}
+
+void FarmWorker::startUnit(const Unit &next)
+{
+  unit = next.id;
+  unitClock.start();
+  delete videoExporter;
+  delete posterRenderer;
+  videoExporter = 0;
+  posterRenderer = 0;
+
+  if (next.sceneFile != sceneFile)
+  {
+    sceneFile.clear();
+    scene = SceneData();
+    if (!readSceneFile(next.sceneFile, scene))
+    {
+      finishUnit(false, "Could not read " + next.sceneFile);
+      return;
+    }
+    // Edits saved since the last compaction are only in the journal, as Scene::loadFile
+    SceneJournal::replay(next.sceneFile, scene, 0, false);
+    sceneFile = next.sceneFile;
+  }
+
+  if (next.kind == VideoFrames)
+  {
+    VideoSettings settings;
+    settings.fileName = next.output;
+    settings.width = next.width;
+    settings.height = next.height;
+    settings.seconds = next.seconds;
+    settings.frameRate = next.frameRate;
+    settings.turntable = next.turntable;
+    settings.keys = next.keys;
+    settings.firstFrame = next.first;
+    settings.endFrame = next.end;
+    if (!settings.turntable && settings.keys.isEmpty())
+    {
+      finishUnit(false, "A flythrough needs camera keys");
+      return;
+    }
+    double animationLength = qMax(next.loopLength, scene.animation.duration()); // As Viewer::exportVideo
+    videoExporter = new VideoExporter(settings, scene, animationLength, BakedColors(), 0, this);
+    connect(videoExporter, SIGNAL(exported(QString)), this, SLOT(unitFinished(QString)));
+    videoExporter->start();
+  }
+  else if (next.kind == PosterTiles)
+  {
+    // Posed at time 0, as videos start
+    SceneData posed = scene;
+    if (!scene.animation.isEmpty())
+      scene.animation.evaluate(0.0, posed);
+
+    PosterSettings settings;
+    settings.fileName = next.output;
+    settings.width = next.width;
+    settings.height = next.height;
+    if (next.keys.isEmpty())
+    {
+      Vec3 boundsMin, boundsMax;
+      sceneBounds(posed, boundsMin, boundsMax);
+      settings.camera = turntableCamera(boundsMin, boundsMax, 0.0);
+    }
+    else
+      settings.camera = next.keys[0];
+    settings.firstTile = next.first;
+    settings.endTile = next.end;
+    posterRenderer = new PosterRenderer(settings, posed, BakedColors(), 0, this);
+    connect(posterRenderer, SIGNAL(rendered(QString)), this, SLOT(unitFinished(QString)));
+    posterRenderer->start();
+  }
+  else
+    finishUnit(false, "Unknown kind of unit");
+}
+
+void FarmWorker::unitFinished(QString report)
+{
+  if (videoExporter)
+    videoExporter->wait();
+  if (posterRenderer)
+    posterRenderer->wait();
+  bool ok = videoExporter ? videoExporter->isComplete() : posterRenderer && posterRenderer->isComplete();
+  finishUnit(ok, report);
+}
+
+void FarmWorker::finishUnit(bool ok, const QString &report)
+{
+  QByteArray message;
+  QDataStream out(&message, QIODevice::WriteOnly);
+  out << (qint32)Result << unit << ok << report << (qint64)unitClock.elapsed();
+  unit = -1;
+  send(socket, message);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <QtCore>
+#include <QLocalSocket>
+#include "farm_protocol.h"
+#include "scene_data.h"
+
+class PosterRenderer;
+class VideoExporter;
+
+// The process a FarmCoordinator starts (--farm-worker): renders the units
+// it is sent, one at a time, and reports each back. It has no window, so
+// it renders in a context of its own and without baked lighting. The
+// application exits once the coordinator says there is no more work, or
+// goes away.
+class FarmWorker : public QObject
+{
+
+  Q_OBJECT
+
+public:
+  FarmWorker(QObject *parent = 0);
+  ~FarmWorker();
+
+  // False if the coordinator can't be reached
+  bool start(const QString &serverName, int index);
+
+private slots:
+  void readCoordinator();
+  void coordinatorGone();
+  void unitFinished(QString report);
+
+private:
+  void startUnit(const FarmProtocol::Unit &unit);
+  void finishUnit(bool ok, const QString &report);
+
+  QLocalSocket *socket;
+  VideoExporter *videoExporter;
+  PosterRenderer *posterRenderer;
+  qint32 unit; // Running, or -1
+  QElapsedTimer unitClock;
+
+  // Consecutive units are usually of the same scene
+  QString sceneFile;
+  SceneData scene;
+};
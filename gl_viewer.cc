@@ -4,14 +4,27 @@
 #include <fstream>
 #include <iostream>
 #include <QTextStream>
-#include <QFile>
+#include "lighting_baker.h"
+#include "scene_math.h"
+#include "trace.h"
+
+static const double fixedTimestep = 1.0 / 120.0; // Seconds per camera integration step
+static const int benchmarkFrameCount = 60; // Frames averaged for the steady-state time
 
 /****************/
 /* GL FUNCTIONS */
 /****************/
 
-GLViewer::GLViewer(QWidget *parent) : QGLWidget(parent)
+GLViewer::GLViewer(Scene *scene, ViewKind kind, QWidget *parent, const QGLWidget *shareWidget)
+  : QGLWidget(parent, shareWidget), scene(scene), kind(kind)
 {
+  // All GL work happens on the render thread, which also swaps buffers
+  setAutoBufferSwap(false);
+  renderThread = new RenderThread(this);
+  connect(renderThread, SIGNAL(frameRendered(int, int, double, int)), this, SLOT(renderFinished(int, int, double, int)));
+  connect(renderThread, SIGNAL(stateChanges(int, int)), this, SIGNAL(stateChanges(int, int)));
+  connect(renderThread, SIGNAL(trianglesDrawn(int)), this, SIGNAL(trianglesDrawn(int)));
+
   // Mouse/Keyboard event tracking
   setMouseTracking(true);
   setFocusPolicy(Qt::StrongFocus);
@@ -27,861 +40,392 @@ GLViewer::GLViewer(QWidget *parent) : QGLWidget(parent)
   upVec.push_back(0.0); upVec.push_back(0.0); upVec.push_back(0.0);
   rotateSpeed = 50.0;
   moveSpeed = 50.0;
+  orthoSize = 6.0;
+  updateCameraRotation();
+  if (kind != PerspectiveView)
+  {
+    // Orthographic views look at the origin from far out along their axis
+    for (int i = 0; i < 3; i++)
+      camPosition[i] = -forwardVec[i] * 500.0;
+  }
+  occlusionCulling = true;
+  levelOfDetail = true;
+  benchmarkRevision = -1;
+
+  // Camera input is drained by a frame timer instead of per event
+  frameTimer = new QTimer(this);
+  frameTimer->setInterval(16);
+  connect(frameTimer, SIGNAL(timeout()), this, SLOT(tickFrame()));
+  frameAccumulator = 0.0;
+  coordsChanged = false;
+
+  connect(scene, SIGNAL(changed(SceneRegion)), this, SLOT(sceneChanged(SceneRegion)));
+  connect(scene->lighting(), SIGNAL(colorsChanged()), this, SLOT(updateGL()));
 }
 
 GLViewer::~GLViewer()
 {
-  // Empty
-}
-
-void GLViewer::initializeGL()
-{
-  glClearColor(0.8, 0.8, 0.8, 0.0);
-  glShadeModel(GL_FLAT);
-
-  glEnable(GL_DEPTH_TEST);
-  glDepthFunc(GL_LEQUAL);
-  glClearDepth(1.0);
-
-  glEnable(GL_LIGHTING);
-  glEnable(GL_LIGHT0);
-  //glEnable(GL_LIGHT1);
-  glEnable(GL_NORMALIZE);
-
-  // Ambient light
-  float ambientColor[] = {0.2, 0.2, 0.2, 1.0};
-  glLightModelfv(GL_LIGHT_MODEL_AMBIENT, ambientColor);
-
-  // Add positioned light
-  float posLightColor[] = {0.8, 0.8, 0.8, 1.0}; // Diffuse color
-  float posLightSpecular[] = {1.0, 1.0, 1.0, 1.0}; // Specular color
-  float posLightPosition[] = {25, 50.0, 25, 1.0}; // Fourth float dictates that this is a positioned light
-  glLightfv(GL_LIGHT0, GL_DIFFUSE, posLightColor);
-  //glLightfv(GL_LIGHT0, GL_SPECULAR, posLightSpecular);
-  glLightfv(GL_LIGHT0, GL_POSITION,  posLightPosition);
-
-  /*
-  // Add directed light
-  float dirLightColor[] = {0.5, 0.2, 0.2, 1.0};
-  float dirLightPosition[] = {25.0, 50.0, -25.0, 0.0}; // Fourth float dictates that this light is a directed light
-  glLightfv(GL_LIGHT1, GL_DIFFUSE, dirLightColor);
-  glLightfv(GL_LIGHT1, GL_POSITION, dirLightPosition);
-  */
-
-  glEnable(GL_COLOR_MATERIAL);
-  glColorMaterial(GL_FRONT, GL_AMBIENT_AND_DIFFUSE);
-  glMaterialfv(GL_FRONT, GL_SPECULAR, posLightSpecular);
-  glMateriali(GL_FRONT, GL_SHININESS, 128);
+  stopRendering();
 }
 
-void GLViewer::paintGL()
+void GLViewer::showEvent(QShowEvent *event)
 {
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); // Get depth buffer higher??
-  glLoadIdentity();
-
-
-  gluLookAt(camPosition[0], camPosition[1], camPosition[2], camPosition[0] + forwardVec[0], camPosition[1] + forwardVec[1], camPosition[2] + forwardVec[2], upVec[0], upVec[1], upVec[2]);
-
-  // Render floor grid
-  glColor3f(0.4, 0.4, 0.4);
-  for (double i = -5.0; i <= 5.0; i++)
+  // The context has to be released before another thread can take it
+  if (!renderThread->isRunning())
   {
-    glNormal3f(0.0, 1.0, 0.0);
-    glBegin(GL_LINES);
-    glVertex3f(i, 0.0, 5.0);
-    glVertex3f(i, 0.0, -5.0);
-    glEnd();
-    glBegin(GL_LINES);
-    glVertex3f(5.0, 0.0, i);
-    glVertex3f(-5.0, 0.0, i);
-    glEnd();
-  }
-
-  // Render objects
-  for (unsigned int i = 0; i < objects.size(); i++)
-  {
-    glPushMatrix(); // Save matrix before transformations
-
-    // Translate, rotate, scale
-    glTranslated(translates[i][0], translates[i][1], translates[i][2]);
-    glRotated(rotations[i][0], 1.0, 0.0, 0.0);
-    glRotated(rotations[i][1], 0.0, 1.0, 0.0);
-    glRotated(rotations[i][2], 0.0, 0.0, 1.0);
-    glScaled(scales[i][0], scales[i][1], scales[i][2]);
-
-    switch (objects[i])
-    {
-    // Plane
-    case 0:
-      glColor3f(colors[i][0], colors[i][1], colors[i][2]);
-      glBegin(GL_POLYGON);
-      glNormal3f(0.0, 1.0, 0.0); // Normals used for lighting
-      glVertex3f(0.5, 0.0, -0.5);
-      glVertex3f(0.5, 0.0, 0.5);
-      glVertex3f(-0.5, 0.0, 0.5);
-      glVertex3f(-0.5, 0.0, -0.5);
-      glEnd();
-      break;
-
-    // Cube
-    case 1:
-      glColor3f(colors[i][0], colors[i][1], colors[i][2]);
-      // Front
-      glNormal3f(0.0, 0.0, -1.0);
-      glBegin(GL_POLYGON);
-      glVertex3f(0.5, -0.5, -0.5);
-      glVertex3f(0.5, 0.5, -0.5);
-      glVertex3f(-0.5, 0.5, -0.5);
-      glVertex3f(-0.5, -0.5, -0.5);
-      glEnd();
-      // Back
-      glNormal3f(0.0, 0.0, 1.0);
-      glBegin(GL_POLYGON);
-      glVertex3f(0.5, -0.5, 0.5);
-      glVertex3f(0.5, 0.5, 0.5);
-      glVertex3f(-0.5, 0.5, 0.5);
-      glVertex3f(-0.5, -0.5, 0.5);
-      glEnd();
-      // Right
-      glNormal3f(1.0, 0.0, 0.0);
-      glBegin(GL_POLYGON);
-      glVertex3f(0.5, -0.5, -0.5);
-      glVertex3f(0.5, 0.5, -0.5);
-      glVertex3f(0.5, 0.5, 0.5);
-      glVertex3f(0.5, -0.5, 0.5);
-      glEnd();
-      // Left
-      glNormal3f(-1.0, 0.0, 0.0);
-      glBegin(GL_POLYGON);
-      glVertex3f(-0.5, -0.5, 0.5);
-      glVertex3f(-0.5, 0.5, 0.5);
-      glVertex3f(-0.5, 0.5, -0.5);
-      glVertex3f(-0.5, -0.5, -0.5);
-      glEnd();
-      //Top
-      glBegin(GL_POLYGON);
-      glNormal3f(0.0, 1.0, 0.0);
-      glVertex3f(0.5, 0.5, 0.5);
-      glVertex3f(0.5, 0.5, -0.5);
-      glVertex3f(-0.5, 0.5, -0.5);
-      glVertex3f(-0.5, 0.5, 0.5);
-      glEnd();
-      // Bottom
-      glNormal3f(0.0, -1.0, 0.0);
-      glBegin(GL_POLYGON);
-      glVertex3f(0.5, -0.5, -0.5);
-      glVertex3f(0.5, -0.5, 0.5);
-      glVertex3f(-0.5, -0.5, 0.5);
-      glVertex3f(-0.5, -0.5, -0.5);
-      glEnd();
-      break;
-
-    // Sphere
-    case 2:
-      glColor3f(colors[i][0], colors[i][1], colors[i][2]);
-      gluSphere(gluNewQuadric(), 0.5, 16, 16);
-      break;
-
-    // Cone
-    case 3:
-      glColor3f(colors[i][0], colors[i][1], colors[i][2]);
-      glTranslated(0.0, 0.0, -0.5);
-      gluCylinder(gluNewQuadric(), 0.5, 0.0, 1.0, 16, 16);
-      glTranslated(0.0, 0.0, 0.5);
-
-      // Bottom
-      glNormal3f(0.0, 0.0, -1.0);
-      glTranslated(0.0, 0.0, -0.5);
-      glBegin(GL_TRIANGLE_FAN);
-      for (int j = 0; j < 16; j++)
-      {
-        glVertex2f(0 + (0.5 * cos(j * 2.0 * M_PI / 16)), 0 + (0.5 * sin(j * 2.0 * M_PI / 16)));
-      }
-      glEnd();
-      glTranslated(0.0, 0.0, 0.5);
-      break;
-
-    // Cylinder
-    case 4:
-      glColor3f(colors[i][0], colors[i][1], colors[i][2]);
-      // Sides
-      glTranslated(0.0, 0.0, -0.5);
-      gluCylinder(gluNewQuadric(), 0.5, 0.5, 1.0, 16, 16);
-      glTranslated(0.0, 0.0, 0.5);
-
-      // Top
-      glNormal3f(0.0, 0.0, 1.0);
-      glTranslated(0.0, 0.0, 0.5);
-      glBegin(GL_TRIANGLE_FAN);
-      for (int j = 0; j < 16; j++)
-      {
-        glVertex2f(0 + (0.5 * cos(j * 2.0 * M_PI / 16)), 0 + (0.5 * sin(j * 2.0 * M_PI / 16)));
-      }
-      glEnd();
-      glTranslated(0.0, 0.0, -0.5);
-
-      // Bottom
-      glNormal3f(0.0, 0.0, -1.0);
-      glTranslated(0.0, 0.0, -0.5);
-      glBegin(GL_TRIANGLE_FAN);
-      for (int j = 0; j < 16; j++)
-      {
-        glVertex2f(0 + (0.5 * cos(j * 2.0 * M_PI / 16)), 0 + (0.5 * sin(j * 2.0 * M_PI / 16)));
-      }
-      glEnd();
-      glTranslated(0.0, 0.0, 0.5);
-      break;
-
-    case 5:
-      glColor3f(colors[i][0], colors[i][1], colors[i][2]);
-      // Bottom
-      glNormal3f(0.0, -1.0, 0.0);
-      glBegin(GL_POLYGON);
-      glVertex3f(0.5, -0.5, -0.5);
-      glVertex3f(0.5, -0.5, 0.5);
-      glVertex3f(-0.5, -0.5, 0.5);
-      glVertex3f(-0.5, -0.5, -0.5);
-      glEnd();
-      // First Triangle
-      glNormal3f(0.5, 1.0, 0.0);
-      glBegin(GL_POLYGON);
-      glVertex3f(0.5, -0.5, -0.5);
-      glVertex3f(0.5, -0.5, 0.5);
-      glVertex3f(0.0, 0.5, 0.0);
-      glEnd();
-      // Second Triangle
-      glNormal3f(0.0, 1.0, 0.5);
-      glBegin(GL_POLYGON);
-      glVertex3f(0.5, -0.5, 0.5);
-      glVertex3f(-0.5, -0.5, 0.5);
-      glVertex3f(0.0, 0.5, 0.0);
-      glEnd();
-      // Third Triangle
-      glNormal3f(-0.5, 1.0, 0.0);
-      glBegin(GL_POLYGON);
-      glVertex3f(-0.5, -0.5, 0.5);
-      glVertex3f(-0.5, -0.5, -0.5);
-      glVertex3f(0.0, 0.5, 0.0);
-      glEnd();
-      // Fourth Triangle
-      glNormal3f(0.0, 1.0, -0.5);
-      glBegin(GL_POLYGON);
-      glVertex3f(0.5, -0.5, -0.5);
-      glVertex3f(-0.5, -0.5, -0.5);
-      glVertex3f(0.0, 0.5, 0.0);
-      glEnd();
-      break;
-
-
-    case 6:
-      glColor3f(colors[i][0], colors[i][1], colors[i][2]);
-      // Bottom
-      glBegin(GL_POLYGON);
-      glNormal3f(0.0, -1.0, 0.0);
-      glVertex3f(0.5, -0.5, -0.5);
-      glVertex3f(0.5, -0.5, 0.5);
-      glVertex3f(-0.5, -0.5, 0.5);
-      glVertex3f(-0.5, -0.5, -0.5);
-      glEnd();
-
-      // Right
-      glBegin(GL_POLYGON);
-      glNormal3f(1.0, 0.0, 0.0);
-      glVertex3f(0.5, -0.5, -0.5);
-      glVertex3f(0.5, 0.5, -0.5);
-      glVertex3f(0.5, 0.5, 0.5);
-      glVertex3f(0.5, -0.5, 0.5);
-      glEnd();
-
-      // Slant
-      glNormal3f(-1.0, 1.0, 0.0);
-      glBegin(GL_POLYGON);
-      glVertex3f(0.5, 0.5, -0.5);
-      glVertex3f(0.5, 0.5, 0.5);
-      glVertex3f(-0.5, -0.5, 0.5);
-      glVertex3f(-0.5, -0.5, -0.5);
-      glEnd();
-
-      // Left Triangle
-      glNormal3f(0.0, 0.0, 1.0);
-      glBegin(GL_POLYGON);
-      glVertex3f(0.5, -0.5, 0.5);
-      glVertex3f(0.5, 0.5, 0.5);
-      glVertex3f(-0.5, -0.5, 0.5);
-      glEnd();
-
-      // Right Triangle
-      glNormal3f(0.0, 0.0, -1.0);
-      glBegin(GL_TRIANGLES);
-      glVertex3f(0.5, -0.5, -0.5);
-      glVertex3f(0.5, 0.5, -0.5);
-      glVertex3f(-0.5, -0.5, -0.5);
-      glEnd();
-      break;
-
-    default:
-      break;
-    }
-
-    glPopMatrix(); // Get old matrix bac (before transformations)
+    doneCurrent();
+    renderThread->start();
   }
+  QGLWidget::showEvent(event);
+  updateGL();
 }
 
-void GLViewer::resizeGL(int width, int height)
+// Qt's own repaint and resize paths would draw on this thread; just
+// publish a new frame instead
+void GLViewer::paintEvent(QPaintEvent *event)
 {
-  glClear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-  glViewport(0, 0, width, height);
-  glMatrixMode(GL_PROJECTION);
-  glLoadIdentity();
-  gluPerspective(45, (GLdouble)width / (GLdouble)height, 0.01, 100.0); // GLU is old and doesn't work on some systems
-  glMatrixMode(GL_MODELVIEW);
-  glLoadIdentity();
-  updateCameraRotation();
+  updateGL();
 }
 
-/******************/
-/* INPUT HANDLING */
-/******************/
-
-void GLViewer::mousePressEvent(QMouseEvent *event)
+void GLViewer::resizeEvent(QResizeEvent *event)
 {
-  // Mouse press event
-  this->setCursor(Qt::BlankCursor);
-
-  QPoint localCenter = QPoint(width() / 2.0, height() / 2.0);
-  QPoint globalCenter = mapToGlobal(localCenter);
-  QCursor::setPos(globalCenter);
-  lastPos = localCenter;
-
+  TRACE_SCOPE("GLViewer::resizeEvent");
+  updateGL();
 }
 
-void GLViewer::mouseMoveEvent(QMouseEvent *event)
+// Publish the current scene and camera to the render thread. Copying the
+// scene only shares its chunks, so this returns immediately. Hidden views
+// render again when they are shown.
+void GLViewer::updateGL()
 {
-  emit changeCoords(event->x(), event->y());
-
-  double dx = GLdouble(event->x() - lastPos.x()) / width();
-  double dy = GLdouble(event->y() - lastPos.y()) / height();
-
-  if ((event->buttons() & Qt::RightButton) && (event->buttons() & Qt::LeftButton))
-  {
-    // Forward/Backwards
-    camPosition[0] -= forwardVec[0] * moveSpeed * dy;
-    camPosition[1] -= forwardVec[1] * moveSpeed * dy;
-    camPosition[2] -= forwardVec[2] * moveSpeed * dy;
-
-    QPoint localCenter = QPoint(width() / 2.0, height() / 2.0);
-    QPoint globalCenter = mapToGlobal(localCenter);
-    QCursor::setPos(globalCenter);
-    lastPos = localCenter;
-  }
-
-  else if (event->buttons() & Qt::RightButton)
+  TRACE_SCOPE("GLViewer::updateGL");
+  if (!isVisible())
+    return;
+
+  FrameState frame;
+  frame.scene = scene->displayed();
+  fillCamera(frame);
+  frame.occlusionCulling = occlusionCulling;
+  frame.levelOfDetail = levelOfDetail;
+  frame.revision = scene->revision();
+  frame.baked = scene->lighting()->colors();
+
+  // Streamed chunks load around the perspective camera
+  SceneStreamer *streamer = scene->streaming();
+  if (streamer->isOpen())
   {
-
-    // Make sure rotation is always between 0 and 360.0 degrees
-    camRotation[0] -= rotateSpeed * (dx * M_PI / 180.0);
-    if (camRotation[0] < 0.0)
-      camRotation[0] += (2 * M_PI);
-    else if (camRotation[0] > (2 * M_PI))
-      camRotation[0] -= (2 * M_PI);
-
-    camRotation[1] -= rotateSpeed * (dy * M_PI / 180.0);
-    if (camRotation[1] < 0.0)
-      camRotation[1] += (2 * M_PI);
-    else if (camRotation[1] > (2 * M_PI))
-      camRotation[1] -= (2 * M_PI);
-
-    updateCameraRotation();
-
-    QPoint localCenter = QPoint(width() / 2.0, height() / 2.0);
-    QPoint globalCenter = mapToGlobal(localCenter);
-    QCursor::setPos(globalCenter);
-    lastPos = localCenter;
+    if (kind == PerspectiveView)
+      streamer->setFocus(&camPosition[0]);
+    frame.streamed = streamer->view();
   }
+  renderThread->publish(frame);
+}
 
-  else if (event->buttons() & Qt::LeftButton)
+void GLViewer::fillCamera(FrameState &frame) const
+{
+  for (int i = 0; i < 3; i++)
   {
-    // Right/Left
-    camPosition[0] += rightVec[0] * moveSpeed * dx;
-    camPosition[1] += rightVec[1] * moveSpeed * dx;
-    camPosition[2] += rightVec[2] * moveSpeed * dx;
-
-    // Up/Down
-    camPosition[0] -= upVec[0] * moveSpeed * dy;
-    camPosition[1] -= upVec[1] * moveSpeed * dy;
-    camPosition[2] -= upVec[2] * moveSpeed * dy;
-
-    QPoint localCenter = QPoint(width() / 2.0, height() / 2.0);
-    QPoint globalCenter = mapToGlobal(localCenter);
-    QCursor::setPos(globalCenter);
-    lastPos = localCenter;
+    frame.camPosition[i] = camPosition[i];
+    frame.forwardVec[i] = forwardVec[i];
+    frame.upVec[i] = upVec[i];
   }
-
-  updateGL();
+  frame.width = qMax(1, width());
+  frame.height = qMax(1, height());
+  frame.orthographic = kind != PerspectiveView;
+  frame.orthoSize = orthoSize;
+  frame.tileX = frame.tileY = 0;
+  frame.tileWidth = frame.tileHeight = 0;
 }
 
-void GLViewer::mouseReleaseEvent(QMouseEvent *event)
+CameraKey GLViewer::cameraKey() const
 {
-  // Mouse released event
-  this->setCursor(Qt::CrossCursor);
+  CameraKey key;
+  for (int i = 0; i < 3; i++)
+    key.position[i] = camPosition[i];
+  key.rotation[0] = camRotation[0];
+  key.rotation[1] = camRotation[1];
+  return key;
 }
 
-/*******************/
-/* OBJECT CREATION */
-/*******************/
-
-void GLViewer::createPlane()
+// Whether the edited region is in this view's frustum
+bool GLViewer::canSee(const SceneRegion &region) const
 {
-  // Push object properties to respective vectors
-  objects.push_back(0);
-  std::vector<double> zeroVector(3, 0.0);
-  translates.push_back(zeroVector);
-  rotations.push_back(zeroVector);
-  std::vector<double> oneVector(3, 1.0);
-  scales.push_back(oneVector);
-  std::vector<double> colorVector(3, 0.8);
-  colors.push_back(colorVector);
-
-  // Add to object list
-  emit addToList("Plane");
-
-  updateGL();
+  if (region.everything)
+    return true;
+
+  FrameState frame;
+  fillCamera(frame);
+  double projection[16], view[16], viewProj[16];
+  frameMatrices(frame, projection, view);
+  multiplyMatrix(projection, view, viewProj);
+  return !boxOutsideFrustum(viewProj, region.min, region.max);
 }
 
-void GLViewer::createCube()
+// Only views that can see the edit render again
+void GLViewer::sceneChanged(SceneRegion region)
 {
-  // Push object properties to respective vectors
-  objects.push_back(1);
-  std::vector<double> zeroVector(3, 0.0);
-  translates.push_back(zeroVector);
-  rotations.push_back(zeroVector);
-  std::vector<double> oneVector(3, 1.0);
-  scales.push_back(oneVector);
-  std::vector<double> colorVector(3, 0.8);
-  colors.push_back(colorVector);
-
-  // Add to object list
-  emit addToList("Cube");
-
-  updateGL();
+  TRACE_SCOPE("GLViewer::sceneChanged");
+  if (canSee(region))
+    updateGL();
 }
 
-void GLViewer::createSphere()
+void GLViewer::stopRendering()
 {
-  // Push object properties to respective vectors
-  objects.push_back(2);
-  std::vector<double> zeroVector(3, 0.0);
-  translates.push_back(zeroVector);
-  rotations.push_back(zeroVector);
-  std::vector<double> oneVector(3, 1.0);
-  scales.push_back(oneVector);
-  std::vector<double> colorVector(3, 0.8);
-  colors.push_back(colorVector);
-
-  // Add to object list
-  emit addToList("Sphere");
-
-  updateGL();
+  if (renderThread->isRunning())
+    renderThread->stop();
 }
 
-void GLViewer::createCone()
+// Time the first frame and the steady state after a generator ran
+void GLViewer::startBenchmark(QString report)
 {
-  // Push object properties to respective vectors
-  objects.push_back(3);
-  std::vector<double> zeroVector(3, 0.0);
-  translates.push_back(zeroVector);
-  rotations.push_back(zeroVector);
-  std::vector<double> oneVector(3, 1.0);
-  scales.push_back(oneVector);
-  std::vector<double> colorVector(3, 0.8);
-  colors.push_back(colorVector);
-
-  // Add to object list
-  emit addToList("Cone");
-
+  benchmarkText = report;
+  benchmarkRevision = scene->revision();
+  benchmarkFrames = 0;
+  benchmarkTotal = 0.0;
+  benchmarkClock.start();
   updateGL();
 }
 
-void GLViewer::createCylinder()
+void GLViewer::renderFinished(int drawn, int culled, double msec, int revision)
 {
-  // Push object properties to respective vectors
-  objects.push_back(4);
-  std::vector<double> zeroVector(3, 0.0);
-  translates.push_back(zeroVector);
-  rotations.push_back(zeroVector);
-  std::vector<double> oneVector(3, 1.0);
-  scales.push_back(oneVector);
-  std::vector<double> colorVector(3, 0.8);
-  colors.push_back(colorVector);
-
-  // Add to object list
-  emit addToList("Cylinder");
+  emit cullStats(drawn, culled);
+  emit frameTime(msec);
 
-  updateGL();
+  // Frames already in flight when the scene was generated don't count
+  if (benchmarkRevision < 0 || revision < benchmarkRevision)
+    return;
+
+  if (benchmarkFrames == 0)
+    benchmarkText += QString(", first frame %1 ms (render %2 ms)").arg(benchmarkClock.elapsed()).arg(msec, 0, 'f', 1);
+  else
+    benchmarkTotal += msec;
+
+  if (benchmarkFrames++ < benchmarkFrameCount)
+  {
+    updateGL(); // Keep frames coming until the average is in
+    return;
+  }
+
+  benchmarkText += QString(", steady-state frame %1 ms").arg(benchmarkTotal / benchmarkFrameCount, 0, 'f', 2);
+  benchmarkRevision = -1;
+  QTextStream(stdout) << benchmarkText << endl;
+  emit benchmarkReport(benchmarkText);
 }
 
-void GLViewer::createPyramid()
+void GLViewer::setOcclusionCulling(bool enabled)
 {
-  // Push object properties to respective vectors
-  objects.push_back(5);
-  std::vector<double> zeroVector(3, 0.0);
-  translates.push_back(zeroVector);
-  rotations.push_back(zeroVector);
-  std::vector<double> oneVector(3, 1.0);
-  scales.push_back(oneVector);
-  std::vector<double> colorVector(3, 0.8);
-  colors.push_back(colorVector);
-
-  // Add to object list
-  emit addToList("Pyramid");
-
+  occlusionCulling = enabled;
   updateGL();
 }
 
-void GLViewer::createWedge()
+void GLViewer::setLevelOfDetail(bool enabled)
 {
-  // Push object properties to respective vectors
-  objects.push_back(6);
-  std::vector<double> zeroVector(3, 0.0);
-  translates.push_back(zeroVector);
-  rotations.push_back(zeroVector);
-  std::vector<double> oneVector(3, 1.0);
-  scales.push_back(oneVector);
-  std::vector<double> colorVector(3, 0.8);
-  colors.push_back(colorVector);
-
-  // Add to object list
-  emit addToList("Wedge");
-
+  levelOfDetail = enabled;
   updateGL();
 }
 
-/*****************/
-/* SIGNALS/SLOTS */
-/*****************/
+/******************/
+/* INPUT HANDLING */
+/******************/
 
-void GLViewer::removeObject(int index)
+void GLViewer::mousePressEvent(QMouseEvent *event)
 {
-  //qDebug() << "\nIndex: " << index;
-  if (index > -1)
-  {
-    objects.erase(objects.begin() + index);
-    translates.erase(translates.begin() + index);
-    rotations.erase(rotations.begin() + index);
-    scales.erase(scales.begin() + index);
-    colors.erase(colors.begin() + index);
+  // Mouse press event
+  this->setCursor(Qt::BlankCursor);
+
+  QPoint localCenter = QPoint(width() / 2.0, height() / 2.0);
+  QPoint globalCenter = mapToGlobal(localCenter);
+  QCursor::setPos(globalCenter);
+  lastPos = localCenter;
 
-    updateGL();
-  }
 }
 
-//Translate Function
-void GLViewer::receiveTranslation(int index, double x, double y, double z)
+void GLViewer::mouseMoveEvent(QMouseEvent *event)
 {
-  if (index > -1)
+  // Only record the motion here; the camera moves once per frame in tickFrame
+  coordsPos = event->pos();
+  coordsChanged = true;
+
+  if (!(event->buttons() & (Qt::LeftButton | Qt::RightButton)))
   {
-    translates[index][0] = x;
-    translates[index][1] = y;
-    translates[index][2] = z;
-    //qDebug() << "Update Translation: " << index << x << y << z;
+    requestFrame();
+    return;
+  }
 
-    updateGL();
+  double dx = GLdouble(event->x() - lastPos.x()) / width();
+  double dy = GLdouble(event->y() - lastPos.y()) / height();
+  cameraInput.addMouseDelta(dx, dy, event->buttons());
+  lastPos = event->pos();
+
+  // Re-center the hidden cursor only when it gets close to the edge, instead
+  // of warping (and generating another move event) on every event
+  QPoint localCenter = QPoint(width() / 2.0, height() / 2.0);
+  QPoint offset = lastPos - localCenter;
+  if (qAbs(offset.x()) > width() / 4 || qAbs(offset.y()) > height() / 4)
+  {
+    QCursor::setPos(mapToGlobal(localCenter));
+    lastPos = localCenter;
   }
+
+  requestFrame();
 }
 
-//Rotation Function
-void GLViewer::receiveRotation(int index, double x, double y, double z)
+void GLViewer::mouseReleaseEvent(QMouseEvent *event)
 {
-  if (index > -1)
-  {
-    rotations[index][0] = x;
-    rotations[index][1] = y;
-    rotations[index][2] = z;
-    //qDebug() << "Update Rotation: " << index << x << y << z;
-
-    updateGL();
-  }
+  // Mouse released event
+  this->setCursor(Qt::CrossCursor);
 }
 
-//Scale Function
-void GLViewer::receiveScale(int index, double x, double y, double z)
+void GLViewer::keyPressEvent(QKeyEvent *event)
 {
-  if (index > -1)
+  if (event->isAutoRepeat() || !cameraInput.setKey(event->key(), true))
   {
-    scales[index][0] = x;
-    scales[index][1] = y;
-    scales[index][2] = z;
-    //qDebug() << "Update Scale: " << index << x << y << z;
-
-    updateGL();
+    QGLWidget::keyPressEvent(event);
+    return;
   }
+  requestFrame();
 }
 
-void GLViewer::receiveColor(int index, double r, double g, double b)
+void GLViewer::keyReleaseEvent(QKeyEvent *event)
 {
-  if (index > -1)
-  {
-    colors[index][0] = r;
-    colors[index][1] = g;
-    colors[index][2] = b;
-    //qDebug() << "Update Color: " << index << r << g << b;
+  if (event->isAutoRepeat() || !cameraInput.setKey(event->key(), false))
+    QGLWidget::keyReleaseEvent(event);
+}
 
-    updateGL();
-  }
+void GLViewer::focusOutEvent(QFocusEvent *event)
+{
+  // Key releases go elsewhere once focus is lost
+  cameraInput.releaseAll();
+  QGLWidget::focusOutEvent(event);
 }
 
-void GLViewer::answerInfo(int index)
+/*******************/
+/* FRAME SCHEDULER */
+/*******************/
+
+void GLViewer::requestFrame()
 {
-  if (index > -1)
+  if (!frameTimer->isActive())
   {
-    std::vector<double> info;
-    info.push_back(translates[index][0]);
-    info.push_back(translates[index][1]);
-    info.push_back(translates[index][2]);
-    info.push_back(rotations[index][0]);
-    info.push_back(rotations[index][1]);
-    info.push_back(rotations[index][2]);
-    info.push_back(scales[index][0]);
-    info.push_back(scales[index][1]);
-    info.push_back(scales[index][2]);
-    info.push_back(colors[index][0]);
-    info.push_back(colors[index][1]);
-    info.push_back(colors[index][2]);
-    emit sendInfo(info);
-    //qDebug() << "Info: " << info[0] << info[1] << info[2] << info[3] << info[4] << info[5] << info[6] << info[7] << info[8];
+    frameClock.start();
+    frameTimer->start();
   }
-  //qDebug() << "\nIndex: " << index;
-  //qDebug() << "Translations: " << translates.size();
-  //qDebug() << "Rotations: " << rotations.size();
-  //qDebug() << "Scales: " << scales.size();
-  //qDebug() << "Color: " << colors.size();
 }
 
-void GLViewer::updateCameraRotation()
+// Runs once per frame while there is input to process
+void GLViewer::tickFrame()
 {
-  double horizontalAngle = camRotation[0];
-  double verticalAngle = camRotation[1];
+  TRACE_SCOPE("GLViewer::tickFrame");
+  double elapsed = qMin(frameClock.restart() / 1000.0, 0.25); // Don't spiral after a stall
+  frameAccumulator += elapsed;
+  bool moved = false;
 
-  // Compute forward vector
-  forwardVec[0] = (cos(verticalAngle) * sin(horizontalAngle));
-  forwardVec[1] = sin(verticalAngle);
-  forwardVec[2] = cos(verticalAngle) * cos(horizontalAngle);
-
-  // Compute right vector
-  rightVec[0] = sin(horizontalAngle - M_PI / 2.0);
-  rightVec[2] = cos(horizontalAngle - M_PI / 2.0);
-
-  // Compute up vector using cross product
-  upVec[0] = rightVec[1] * forwardVec[2] - rightVec[2] * forwardVec[1];
-  upVec[1] = rightVec[2] * forwardVec[0] - rightVec[0] * forwardVec[2];
-  upVec[2] = rightVec[0] * forwardVec[1] - rightVec[1] * forwardVec[0];
+  if (coordsChanged)
+  {
+    emit changeCoords(coordsPos.x(), coordsPos.y());
+    coordsChanged = false;
+  }
 
-  //qDebug() << "ForwardVec: " << forwardVec[0] << forwardVec[1] << forwardVec[2];
-  //qDebug() << "RightVec: " << rightVec[0] << rightVec[1] << rightVec[2];
-  //qDebug() << "UpVec: " << upVec[0] << upVec[1] << upVec[2];
-}
+  // Orthographic views only pan and zoom, so they stay axis aligned
+  if (kind != PerspectiveView && cameraInput.hasMouse())
+  {
+    double panX, panY, rotateX, rotateY, dolly;
+    cameraInput.takeMouse(panX, panY, rotateX, rotateY, dolly);
+    for (int i = 0; i < 3; i++)
+    {
+      camPosition[i] += rightVec[i] * orthoSize * 2.0 * panX;
+      camPosition[i] -= upVec[i] * orthoSize * 2.0 * panY;
+    }
+    orthoSize = qBound(0.1, orthoSize * exp(dolly * 2.0), 1000.0);
+    moved = true;
+  }
 
-// Save scene to .vox file
-void GLViewer::saveFile(QString fileName)
-{
-  QFile outFile(fileName);
-  if (outFile.open(QIODevice::ReadWrite))
+  // Mouse deltas are displacements, so they are applied as a whole
+  if (kind == PerspectiveView && cameraInput.hasMouse())
   {
-    QTextStream outStream(&outFile);
+    double panX, panY, rotateX, rotateY, dolly;
+    cameraInput.takeMouse(panX, panY, rotateX, rotateY, dolly);
 
-    for (int i = 0; i < objects.size(); i++)
-      outStream << objects[i] << ',';
-    outStream << endl;
+    // Make sure rotation is always between 0 and 360.0 degrees
+    camRotation[0] -= rotateSpeed * (rotateX * M_PI / 180.0);
+    if (camRotation[0] < 0.0)
+      camRotation[0] += (2 * M_PI);
+    else if (camRotation[0] > (2 * M_PI))
+      camRotation[0] -= (2 * M_PI);
 
-    for (int j = 0; j < translates.size(); j++)
-    {
-      for (int i = 0; i < translates[j].size(); i++)
-        outStream << translates[j][i] << ',';
-      outStream << ';';
-    }
-    outStream << endl;
+    camRotation[1] -= rotateSpeed * (rotateY * M_PI / 180.0);
+    if (camRotation[1] < 0.0)
+      camRotation[1] += (2 * M_PI);
+    else if (camRotation[1] > (2 * M_PI))
+      camRotation[1] -= (2 * M_PI);
+
+    updateCameraRotation();
 
-    for (int j = 0; j < rotations.size(); j++)
+    for (int i = 0; i < 3; i++)
     {
-      for (int i = 0; i < rotations[j].size(); i++)
-        outStream << rotations[j][i] << ',';
-      outStream << ';';
+      camPosition[i] -= forwardVec[i] * moveSpeed * dolly; // Forward/Backwards
+      camPosition[i] += rightVec[i] * moveSpeed * panX;    // Right/Left
+      camPosition[i] -= upVec[i] * moveSpeed * panY;       // Up/Down
     }
-    outStream << endl;
+    moved = true;
+  }
 
-    for (int j = 0; j < scales.size(); j++)
+  // Keyboard fly motion is integrated in fixed steps, independent of frame rate
+  while (frameAccumulator >= fixedTimestep)
+  {
+    double move[3];
+    cameraInput.step(fixedTimestep, move);
+    if (kind == PerspectiveView)
     {
-      for (int i = 0; i < scales[j].size(); i++)
-        outStream << scales[j][i] << ',';
-      outStream << ';';
+      for (int i = 0; i < 3; i++)
+        camPosition[i] += rightVec[i] * move[0] + upVec[i] * move[1] + forwardVec[i] * move[2];
     }
-    outStream << endl;
-
-    for (int j = 0; j < colors.size(); j++)
+    else
     {
-      for (int i = 0; i < colors[j].size(); i++)
-        outStream << colors[j][i] << ',';
-      outStream << ';';
+      // Forward zooms, up/down pans along the screen's vertical
+      for (int i = 0; i < 3; i++)
+        camPosition[i] += rightVec[i] * move[0] + upVec[i] * move[1];
+      orthoSize = qBound(0.1, orthoSize * exp(-move[2] * 0.2), 1000.0);
     }
-    outStream.flush();
+    if (move[0] != 0.0 || move[1] != 0.0 || move[2] != 0.0)
+      moved = true;
+    frameAccumulator -= fixedTimestep;
   }
-  outFile.close();
-}
 
-// Read scene from vox file
-void GLViewer::loadFile(QString fileName)
-{
-  QFile inFile(fileName);
-  if (inFile.open(QIODevice::ReadWrite))
+  if (moved)
+    updateGL();
+
+  if (!cameraInput.isActive())
   {
-    //qDebug() << "Input file opened";
-    QTextStream inStream(&inFile);
-    int lineCount = 0;
-    while (!inStream.atEnd() && lineCount < 5)
-    {
-      QString line = inStream.readLine();
-      QStringList elements = line.split(";");
-
-      // Check for line type
-      // 0 = objects, 1 = translates, 2 = rotates, 3 = scales, 4 = colors
-      switch (lineCount)
-      {
-      // OBJECTS
-      case 0: {
-        //qDebug() << "Objects: case";
-        QStringList numbers = line.split(",");
-        for (int i = 0; i < numbers.size() - 1; i++)
-        {
-          //qDebug() << "Objects: i loop";
-          objects.push_back(numbers.at(i).toInt());
-          emit addToList();
-        }
-        lineCount++;
-        break;
-      }
-
-      // TRANSLATES
-      case 1:
-        //qDebug() << "Translation: case";
-        for (int i = 0; i < elements.size() - 1; i++)
-        {
-          //qDebug() << "Translation: i loop";
-          std::vector<double> tempVector;
-          tempVector.push_back(0.0); tempVector.push_back(0.0); tempVector.push_back(0.0);
-          translates.push_back(tempVector);
-          QStringList numbers = elements.at(i).split(",");
-          for (int j = 0; j < numbers.size() - 1; j++)
-          {
-            //qDebug() << "Translation: j loop";
-            translates[i][j] = numbers.at(j).toDouble();
-          }
-        }
-        lineCount++;
-        break;
-        
-        // ROTATIONS
-        case 2:
-        //qDebug() << "Rotation: case";
-        for (int i = 0; i < elements.size() - 1; i++)
-        {
-          //qDebug() << "Rotation: i loop";
-          std::vector<double> tempVector;
-          tempVector.push_back(0.0); tempVector.push_back(0.0); tempVector.push_back(0.0);
-          rotations.push_back(tempVector);
-          QStringList numbers = elements.at(i).split(",");
-          for (int j = 0; j < numbers.size() - 1; j++)
-          {
-            //qDebug() << "Rotation: j loop";
-            rotations[i][j] = numbers.at(j).toDouble();
-          }
-        }
-        lineCount++;
-        break;
-
-        // SCALES
-        case 3:
-        //qDebug() << "Scale: case";
-        for (int i = 0; i < elements.size() - 1; i++)
-        {
-          //qDebug() << "Scale: i loop";
-          std::vector<double> tempVector;
-          tempVector.push_back(0.0); tempVector.push_back(0.0); tempVector.push_back(0.0);
-          scales.push_back(tempVector);
-          QStringList numbers = elements.at(i).split(",");
-          for (int j = 0; j < numbers.size() - 1; j++)
-          {
-            //qDebug() << "Scale: j loop";
-            scales[i][j] = numbers.at(j).toDouble();
-          }
-        }
-        lineCount++;
-        break;
-
-        // COLORS
-        case 4:
-        //qDebug() << "Color: case";
-        for (int i = 0; i < elements.size() - 1; i++)
-        {
-          //qDebug() << "Color: i loop";
-          std::vector<double> tempVector;
-          tempVector.push_back(0.0); tempVector.push_back(0.0); tempVector.push_back(0.0);
-          colors.push_back(tempVector);
-          QStringList numbers = elements.at(i).split(",");
-          for (int j = 0; j < numbers.size() - 1; j++)
-          {
-            //qDebug() << "Color: j loop";
-            colors[i][j] = numbers.at(j).toDouble();
-          }
-        }
-        lineCount++;
-        break;
-
-        // DEFAULT
-        default:
-          break;
-      }
-    }
+    frameTimer->stop();
+    frameAccumulator = 0.0;
   }
-  inFile.close();
-  updateGL();
-  //printInfo();
 }
 
-void GLViewer::printInfo()
+void GLViewer::updateCameraRotation()
 {
-  qDebug() << "\nObjects: ";
-  for (int i = 0; i < objects.size(); i++)
-    qDebug() << objects[i] << ",";
-
-  qDebug() << "\nTranslation: ";
-  for (int i = 0; i < translates.size(); i++)
+  // Fixed axes for the orthographic views
+  static const double axes[4][3][3] = {
+    {{0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}},   // Perspective (unused)
+    {{0.0, -1.0, 0.0}, {1.0, 0.0, 0.0}, {0.0, 0.0, -1.0}}, // Top: forward, right, up
+    {{0.0, 0.0, -1.0}, {1.0, 0.0, 0.0}, {0.0, 1.0, 0.0}},  // Front
+    {{-1.0, 0.0, 0.0}, {0.0, 0.0, -1.0}, {0.0, 1.0, 0.0}}  // Side
+  };
+  if (kind != PerspectiveView)
   {
-    for (int j = 0; j < translates[i].size(); j++)
-      qDebug() << translates[i][j] << ",";
-    qDebug() << ";";
+    for (int i = 0; i < 3; i++)
+    {
+      forwardVec[i] = axes[kind][0][i];
+      rightVec[i] = axes[kind][1][i];
+      upVec[i] = axes[kind][2][i];
+    }
+    return;
   }
 
-  qDebug() << "\nRotation: ";
-  for (int i = 0; i < rotations.size(); i++)
-  {
-    for (int j = 0; j < rotations[i].size(); j++)
-      qDebug() << rotations[i][j] << ",";
-    qDebug() << ";";
-  }
+  cameraAxes(camRotation[0], camRotation[1], &forwardVec[0], &rightVec[0], &upVec[0]);
 
-  qDebug() << "\nScale: ";
-  for (int i = 0; i < scales.size(); i++)
-  {
-    for (int j = 0; j < scales[i].size(); j++)
-      qDebug() << scales[i][j] << ",";
-    qDebug() << ";";
-  }
+  //qDebug() << "ForwardVec: " << forwardVec[0] << forwardVec[1] << forwardVec[2];
+  //qDebug() << "RightVec: " << rightVec[0] << rightVec[1] << rightVec[2];
+  //qDebug() << "UpVec: " << upVec[0] << upVec[1] << upVec[2];
+}
 
-  qDebug() << "\nColor: ";
-  for (int i = 0; i < colors.size(); i++)
-  {
-    for (int j = 0; j < colors[i].size(); j++)
-      qDebug() << colors[i][j] << ",";
-    qDebug() << ";";
-  }
-}
\ No newline at end of file
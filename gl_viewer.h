@@ -4,6 +4,10 @@
 #include <QtGui>
 #include <QGLWidget>
 #include <vector>
+#include "scene.h"
+#include "render_thread.h"
+#include "camera_input.h"
+#include "camera_path.h"
 
 // Need some more includes for OSX
 #ifdef __APPLE__
@@ -12,58 +16,72 @@
 #include <GLUT/glut.h>
 #endif
 
+// One viewport onto a Scene, with its own camera and projection
 class GLViewer : public QGLWidget
 {
 
     Q_OBJECT
 
 public:
-    GLViewer(QWidget *parent = 0);
+    enum ViewKind { PerspectiveView, TopView, FrontView, SideView };
+
+    // Views created with the same shareWidget share their GL resources
+    GLViewer(Scene *scene, ViewKind kind = PerspectiveView, QWidget *parent = 0, const QGLWidget *shareWidget = 0);
     ~GLViewer();
 
+    // Where the perspective camera is, for flythrough keys
+    CameraKey cameraKey() const;
+
 protected:
-    void initializeGL();
-    void resizeGL(int width, int height);
-    void paintGL();
+    void showEvent(QShowEvent *event);
+    void paintEvent(QPaintEvent *event);
+    void resizeEvent(QResizeEvent *event);
     void mousePressEvent(QMouseEvent *event);
     void mouseMoveEvent(QMouseEvent *event);
     void mouseReleaseEvent(QMouseEvent *event);
+    void keyPressEvent(QKeyEvent *event);
+    void keyReleaseEvent(QKeyEvent *event);
+    void focusOutEvent(QFocusEvent *event);
+    void requestFrame();
     void updateCameraRotation();
-    void printInfo();
+    void fillCamera(FrameState &frame) const;
+    bool canSee(const SceneRegion &region) const;
 
 public slots:
-    void createPlane();
-    void createCube();
-    void createSphere();
-    void createCone();
-    void createCylinder();
-    void createPyramid();
-    void createWedge();
-    void removeObject(int index);
-    void receiveTranslation(int index, double x, double y, double z);
-    void receiveRotation(int index, double x, double y, double z);
-    void receiveScale(int index, double x, double y, double z);
-    void receiveColor(int index, double r, double g, double b);
-    void answerInfo(int index);
-    //void deleteObject(QListWidget *list);
-
-    void saveFile(QString fileName);
-    void loadFile(QString fileName);
+    void updateGL();
+    void stopRendering();
+    void sceneChanged(SceneRegion region);
+    void setOcclusionCulling(bool enabled);
+    void setLevelOfDetail(bool enabled);
+    void startBenchmark(QString report);
+    void tickFrame();
 
 signals:
     void changeCoords(double x, double y);
-    void addToList(QString str);
-    void removeFromList(int index);
-    void sendInfo(std::vector<double> info);
-    void addToList();
+    void cullStats(int drawn, int culled);
+    void stateChanges(int sorted, int unsorted);
+    void trianglesDrawn(int triangles);
+    void frameTime(double msec);
+    void benchmarkReport(QString text);
+
+private slots:
+    void renderFinished(int drawn, int culled, double msec, int revision);
 
 private:
-    // Modelling variables
-    std::vector<int> objects; // Holds the object types; 0 = Plane, 1 = Cube, 2 = Sphere, 3 = Cone, 4 = Cylinder
-    std::vector<std::vector<double> > translates;
-    std::vector<std::vector<double> > rotations;
-    std::vector<std::vector<double> > scales;
-    std::vector<std::vector<double> > colors;
+    Scene *scene;
+    ViewKind kind;
+
+    // Rendering
+    RenderThread *renderThread;
+    bool occlusionCulling;
+    bool levelOfDetail;
+
+    // Frame timing after generating a scene
+    int benchmarkRevision; // -1 while idle
+    int benchmarkFrames;
+    double benchmarkTotal;
+    QString benchmarkText;
+    QElapsedTimer benchmarkClock;
 
     // Camera variables
     std::vector<double> camPosition;
@@ -73,6 +91,14 @@ private:
     std::vector<double> upVec;
     double rotateSpeed;
     double moveSpeed;
+    double orthoSize; // Half the visible height of orthographic views
     QPoint lastPos;
-};
 
+    // Input
+    CameraInput cameraInput;
+    QTimer *frameTimer;
+    QElapsedTimer frameClock;
+    double frameAccumulator;
+    QPoint coordsPos;
+    bool coordsChanged;
+};
@@ -0,0 +1,374 @@
+#include "half_edge_mesh.h"
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include "primitive_geometry.h"
+
+/*********/
+/* BUILD */
+/*********/
+
+bool HalfEdgeMesh::build(const std::vector<float> &inPositions, const std::vector<int> &faceStarts, const std::vector<int> &corners)
+{
+  int faces = faceStarts.empty() ? 0 : (int)faceStarts.size() - 1;
+  int inVertices = (int)inPositions.size() / 3;
+  int halves = faces > 0 ? faceStarts[faces] : 0;
+  if (faces > 0 && (faceStarts[0] != 0 || halves != (int)corners.size()))
+    return false;
+
+  // Used vertices keep their order
+  std::vector<int> remap(inVertices, -1);
+  for (int c = 0; c < halves; c++)
+  {
+    if (corners[c] < 0 || corners[c] >= inVertices)
+      return false;
+    remap[corners[c]] = 0;
+  }
+  std::vector<float> outPositions;
+  int used = 0;
+  for (int v = 0; v < inVertices; v++)
+  {
+    if (remap[v] < 0)
+      continue;
+    remap[v] = used++;
+    outPositions.insert(outPositions.end(), &inPositions[v * 3], &inPositions[v * 3] + 3);
+  }
+
+  // Every corner starts a half-edge; sorting them by their undirected edge
+  // brings the two halves of an edge together
+  std::vector<int> cornerOrigin(halves), cornerTarget(halves), cornerFace(halves), cornerNext(halves);
+  std::vector<std::pair<long long, int> > keys(halves);
+  for (int f = 0; f < faces; f++)
+  {
+    int first = faceStarts[f], size = faceStarts[f + 1] - first;
+    if (size < 3)
+      return false;
+    for (int i = 0; i < size; i++)
+    {
+      int c = first + i, a = remap[corners[c]], b = remap[corners[first + (i + 1) % size]];
+      if (a == b)
+        return false;
+      cornerOrigin[c] = a;
+      cornerTarget[c] = b;
+      cornerFace[c] = f;
+      cornerNext[c] = first + (i + 1) % size;
+      keys[c] = std::make_pair((long long)std::min(a, b) << 32 | std::max(a, b), c);
+    }
+  }
+  std::sort(keys.begin(), keys.end());
+
+  // Corners become the even half of their edge, or the odd one if the
+  // edge's other corner came first
+  std::vector<int> cornerEdge(halves);
+  std::vector<int> outVertices, outFaces, outNexts;
+  int edges = 0;
+  for (int k = 0; k < halves; edges++)
+  {
+    int c = keys[k].second;
+    cornerEdge[c] = 2 * edges;
+    if (k + 1 < halves && keys[k + 1].first == keys[k].first)
+    {
+      int d = keys[k + 1].second;
+      if (cornerTarget[c] == cornerTarget[d] || (k + 2 < halves && keys[k + 2].first == keys[k].first))
+        return false; // Two faces the same way round, or more than two
+      cornerEdge[d] = 2 * edges + 1;
+      k += 2;
+    }
+    else
+      k++;
+  }
+  outVertices.assign(2 * edges, -1);
+  outFaces.assign(2 * edges, -1);
+  outNexts.assign(2 * edges, -1);
+  for (int c = 0; c < halves; c++)
+  {
+    int h = cornerEdge[c];
+    outVertices[h] = cornerTarget[c];
+    outFaces[h] = cornerFace[c];
+    outNexts[h] = cornerEdge[cornerNext[c]];
+    if (outVertices[h ^ 1] < 0)
+      outVertices[h ^ 1] = cornerOrigin[c]; // The rim half, unless a corner fills it
+  }
+
+  // Rim halves leave each rim vertex once; a vertex with two is where two
+  // fans touch
+  std::vector<int> rimOut(used, -1);
+  for (int h = 0; h < 2 * edges; h++)
+  {
+    if (outFaces[h] >= 0)
+      continue;
+    int from = outVertices[h ^ 1];
+    if (rimOut[from] >= 0)
+      return false;
+    rimOut[from] = h;
+  }
+  for (int h = 0; h < 2 * edges; h++)
+    if (outFaces[h] < 0)
+      outNexts[h] = rimOut[outVertices[h]];
+
+  std::vector<int> outVertexEdges(used, -1), outgoing(used, 0);
+  for (int h = 0; h < 2 * edges; h++)
+  {
+    int from = outVertices[h ^ 1];
+    outVertexEdges[from] = h;
+    outgoing[from]++;
+  }
+
+  // One fan per vertex: going round it must meet every edge leaving it
+  for (int v = 0; v < used; v++)
+  {
+    int h = outVertexEdges[v], steps = 0;
+    do
+    {
+      h = outNexts[h ^ 1];
+      steps++;
+    } while (h != outVertexEdges[v] && steps <= outgoing[v]);
+    if (steps != outgoing[v])
+      return false;
+  }
+
+  std::vector<int> outFaceEdges(faces);
+  for (int f = 0; f < faces; f++)
+    outFaceEdges[f] = cornerEdge[faceStarts[f]];
+
+  positions.swap(outPositions);
+  vertexEdges.swap(outVertexEdges);
+  faceEdges.swap(outFaceEdges);
+  edgeVertices.swap(outVertices);
+  edgeFaces.swap(outFaces);
+  edgeNexts.swap(outNexts);
+  return true;
+}
+
+static float length(const float v[3])
+{
+  return std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+}
+
+bool HalfEdgeMesh::buildPrimitive(int type)
+{
+  const MeshData &mesh = primitiveMesh(std::max(0, std::min(type, 6)), CoarseTessellation);
+
+  // The tables split vertices where normals differ; the cage is welded by
+  // position alone
+  typedef std::vector<long> Key;
+  std::map<Key, int> welded;
+  std::vector<int> remap(mesh.vertexCount);
+  std::vector<float> welds;
+  for (int v = 0; v < mesh.vertexCount; v++)
+  {
+    Key key(3);
+    for (int a = 0; a < 3; a++)
+      key[a] = lround(mesh.positions[v * 3 + a] * 65536.0);
+    std::map<Key, int>::iterator found = welded.find(key);
+    if (found == welded.end())
+    {
+      found = welded.insert(std::make_pair(key, (int)welds.size() / 3)).first;
+      welds.insert(welds.end(), &mesh.positions[v * 3], &mesh.positions[v * 3] + 3);
+    }
+    remap[v] = found->second;
+  }
+
+  std::vector<int> starts(1, 0), corners;
+  for (int t = 0; t < mesh.indexCount / 3; t++)
+  {
+    int a = remap[mesh.indices[t * 3]], b = remap[mesh.indices[t * 3 + 1]], c = remap[mesh.indices[t * 3 + 2]];
+    if (a == b || b == c || a == c)
+      continue;
+    corners.push_back(a);
+    corners.push_back(b);
+    corners.push_back(c);
+    starts.push_back((int)corners.size());
+  }
+  HalfEdgeMesh triangles;
+  if (!triangles.build(welds, starts, corners))
+    return false;
+
+  // Catmull-Clark gives quads a far better surface than triangles, so
+  // coplanar pairs (the cube's sides, the sphere's bands) become one quad.
+  // Each face keeps the half of the edge it shares with its partner.
+  std::vector<int> merged(triangles.faceCount(), -1);
+  for (int h = 0; h < triangles.halfEdgeCount(); h += 2)
+  {
+    int f0 = triangles.face(h), f1 = triangles.face(h ^ 1);
+    if (f0 < 0 || f1 < 0 || merged[f0] >= 0 || merged[f1] >= 0)
+      continue;
+    float n0[3], n1[3];
+    triangles.faceNormal(f0, n0);
+    triangles.faceNormal(f1, n1);
+    float scale = length(n0) * length(n1);
+    if (scale > 0.0f && n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2] >= 0.9999f * scale)
+    {
+      merged[f0] = h;
+      merged[f1] = h ^ 1;
+    }
+  }
+
+  starts.assign(1, 0);
+  corners.clear();
+  for (int f = 0; f < triangles.faceCount(); f++)
+  {
+    int h = merged[f];
+    if (h < 0)
+    {
+      h = triangles.faceEdge(f);
+      for (int i = 0; i < 3; i++, h = triangles.next(h))
+        corners.push_back(triangles.origin(h));
+    }
+    else if ((h & 1) == 0)
+    {
+      // x -> y -> p and y -> x -> q make y -> p -> x -> q
+      corners.push_back(triangles.target(h));
+      corners.push_back(triangles.target(triangles.next(h)));
+      corners.push_back(triangles.origin(h));
+      corners.push_back(triangles.target(triangles.next(h ^ 1)));
+    }
+    else
+      continue;
+    starts.push_back((int)corners.size());
+  }
+  return build(triangles.positions, starts, corners);
+}
+
+/***********/
+/* QUERIES */
+/***********/
+
+int HalfEdgeMesh::faceSize(int f) const
+{
+  int h = faceEdges[f], size = 0;
+  do
+  {
+    h = edgeNexts[h];
+    size++;
+  } while (h != faceEdges[f]);
+  return size;
+}
+
+int HalfEdgeMesh::valence(int v) const
+{
+  int h = vertexEdges[v], count = 0;
+  do
+  {
+    h = rotate(h);
+    count++;
+  } while (h != vertexEdges[v]);
+  return count;
+}
+
+void HalfEdgeMesh::setPosition(int v, float x, float y, float z)
+{
+  positions[v * 3] = x;
+  positions[v * 3 + 1] = y;
+  positions[v * 3 + 2] = z;
+}
+
+void HalfEdgeMesh::faceNormal(int f, float normal[3]) const
+{
+  normal[0] = normal[1] = normal[2] = 0.0f;
+  int h = faceEdges[f];
+  do
+  {
+    const float *p = position(origin(h)), *q = position(target(h));
+    normal[0] += (p[1] - q[1]) * (p[2] + q[2]);
+    normal[1] += (p[2] - q[2]) * (p[0] + q[0]);
+    normal[2] += (p[0] - q[0]) * (p[1] + q[1]);
+    h = edgeNexts[h];
+  } while (h != faceEdges[f]);
+}
+
+void HalfEdgeMesh::faceCenter(int f, float center[3]) const
+{
+  center[0] = center[1] = center[2] = 0.0f;
+  int h = faceEdges[f], size = 0;
+  do
+  {
+    const float *p = position(origin(h));
+    for (int a = 0; a < 3; a++)
+      center[a] += p[a];
+    h = edgeNexts[h];
+    size++;
+  } while (h != faceEdges[f]);
+  for (int a = 0; a < 3; a++)
+    center[a] /= size;
+}
+
+void HalfEdgeMesh::polygons(std::vector<int> &faceStarts, std::vector<int> &corners) const
+{
+  faceStarts.assign(1, 0);
+  corners.clear();
+  corners.reserve(halfEdgeCount());
+  for (int f = 0; f < faceCount(); f++)
+  {
+    int h = faceEdges[f];
+    do
+    {
+      corners.push_back(origin(h));
+      h = edgeNexts[h];
+    } while (h != faceEdges[f]);
+    faceStarts.push_back((int)corners.size());
+  }
+}
+
+/*********/
+/* EDITS */
+/*********/
+
+bool HalfEdgeMesh::extrudeFace(int f, float distance)
+{
+  if (f < 0 || f >= faceCount())
+    return false;
+  std::vector<int> starts, corners;
+  polygons(starts, corners);
+  float normal[3];
+  faceNormal(f, normal);
+  float scale = length(normal);
+  if (scale == 0.0f)
+    return false;
+
+  // The face moves onto copies of its corners
+  std::vector<float> extruded = positions;
+  int first = starts[f], size = starts[f + 1] - first;
+  std::vector<int> ring(corners.begin() + first, corners.begin() + first + size);
+  for (int i = 0; i < size; i++)
+  {
+    const float *p = position(ring[i]);
+    for (int a = 0; a < 3; a++)
+      extruded.push_back(p[a] + normal[a] / scale * distance);
+    corners[first + i] = vertexCount() + i;
+  }
+
+  // Each side runs along its edge the way the face did, so it pairs with
+  // the neighbor across the edge and with the moved face
+  for (int i = 0; i < size; i++)
+  {
+    int j = (i + 1) % size;
+    corners.push_back(ring[i]);
+    corners.push_back(ring[j]);
+    corners.push_back(vertexCount() + j);
+    corners.push_back(vertexCount() + i);
+    starts.push_back((int)corners.size());
+  }
+  return build(extruded, starts, corners);
+}
+
+bool HalfEdgeMesh::removeFace(int f)
+{
+  if (f < 0 || f >= faceCount())
+    return false;
+  std::vector<int> starts, corners;
+  polygons(starts, corners);
+  int first = starts[f], size = starts[f + 1] - first;
+  corners.erase(corners.begin() + first, corners.begin() + first + size);
+  starts.erase(starts.begin() + f + 1);
+  for (int g = f + 1; g < (int)starts.size(); g++)
+    starts[g] -= size;
+  return build(positions, starts, corners);
+}
+
+long long HalfEdgeMesh::memoryUsage() const
+{
+  return (long long)positions.capacity() * sizeof(float) +
+         (long long)(vertexEdges.capacity() + faceEdges.capacity() + edgeVertices.capacity() + edgeFaces.capacity() +
+                     edgeNexts.capacity()) * sizeof(int);
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <vector>
+
+// Polygon mesh with half-edge connectivity, kept in flat index arrays: no
+// element is allocated on its own, and copying the mesh copies a handful
+// of vectors. The two halves of edge k are half-edges 2k and 2k + 1, so a
+// half-edge's twin is h ^ 1. Every edge has both halves; the half along a
+// hole or the rim of an open surface has no face (-1), and those halves
+// are linked into loops like a face's, so walking around any vertex needs
+// no special cases.
+//
+// Faces wind counter-clockwise seen from outside, as the primitives do.
+// Only manifold meshes can be built: every edge is shared by at most two
+// faces, in opposite directions, and the faces around a vertex form one
+// fan.
+class HalfEdgeMesh
+{
+public:
+  HalfEdgeMesh() {}
+
+  // From polygons: face f has the corners corners[faceStarts[f]] up to
+  // corners[faceStarts[f + 1]]. Vertices no face uses are dropped; the
+  // others keep their order. False, and the mesh unchanged, if the
+  // polygons are not a manifold mesh.
+  bool build(const std::vector<float> &positions, const std::vector<int> &faceStarts, const std::vector<int> &corners);
+
+  // Primitive type 0-6 (primitive_geometry.h) at its coarse tessellation,
+  // with its split vertices welded and coplanar triangle pairs merged into
+  // quads; in the primitive's unit box
+  bool buildPrimitive(int type);
+
+  int vertexCount() const { return (int)vertexEdges.size(); }
+  int faceCount() const { return (int)faceEdges.size(); }
+  int edgeCount() const { return (int)edgeVertices.size() / 2; }
+  int halfEdgeCount() const { return (int)edgeVertices.size(); }
+
+  // Half-edges: the vertex each points to, the face on its left (or -1)
+  // and the next one around that face or hole
+  int target(int h) const { return edgeVertices[h]; }
+  int origin(int h) const { return edgeVertices[h ^ 1]; }
+  int face(int h) const { return edgeFaces[h]; }
+  int next(int h) const { return edgeNexts[h]; }
+  static int twin(int h) { return h ^ 1; }
+
+  // The next half-edge out of the same vertex, counter-clockwise
+  int rotate(int h) const { return edgeNexts[h ^ 1]; }
+
+  int vertexEdge(int v) const { return vertexEdges[v]; } // One going out of it
+  int faceEdge(int f) const { return faceEdges[f]; }
+  int faceSize(int f) const;
+  int valence(int v) const;
+  bool isBoundaryEdge(int h) const { return edgeFaces[h] < 0 || edgeFaces[h ^ 1] < 0; }
+
+  const float *position(int v) const { return &positions[v * 3]; }
+  const std::vector<float> &vertexPositions() const { return positions; }
+  void setPosition(int v, float x, float y, float z);
+
+  // Area-weighted (Newell) normal and average of the corners
+  void faceNormal(int f, float normal[3]) const;
+  void faceCenter(int f, float center[3]) const;
+
+  void polygons(std::vector<int> &faceStarts, std::vector<int> &corners) const;
+
+  // Topology edits, through polygons and a rebuild, so vertex and face
+  // indices may change. Extruding moves a copy of the face distance along
+  // its normal and closes the sides with quads; removing a face leaves a
+  // hole. False, and the mesh unchanged, if the result isn't manifold.
+  bool extrudeFace(int f, float distance);
+  bool removeFace(int f);
+
+  // Heap bytes of the arrays
+  long long memoryUsage() const;
+
+private:
+  std::vector<float> positions;  // xyz per vertex
+  std::vector<int> vertexEdges;
+  std::vector<int> faceEdges;
+  std::vector<int> edgeVertices;
+  std::vector<int> edgeFaces;
+  std::vector<int> edgeNexts;
+};
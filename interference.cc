@@ -0,0 +1,686 @@
+#include "interference.h"
+#include <QtConcurrentMap>
+#include <algorithm>
+#include <cmath>
+#include "scene_math.h"
+#include "trace.h"
+
+static const double contactShrink = 1e-6;    // Shapes are tested this fraction smaller, so touching ones don't interfere
+static const int maxGjkIterations = 64;      // Reached only by touching round shapes
+static const int cellLimit = (1 << 20) - 1;  // Cell coordinates are clamped to 21 bits
+static const int gridPercentile = 90;        // Cells fit this many percent of the objects
+static const int maxParts = 8;               // Longer objects go a level up
+static const int minGridObjects = 32;        // Fewer are swept instead
+static const int sweepJobSize = 256;         // Objects per sweep job
+static const int jobSize = 4096;             // Boxes or grid entries per job
+
+/**********/
+/* SHAPES */
+/**********/
+
+static Vec3 subtract(const Vec3 &a, const Vec3 &b)
+{
+  return makeVec3(a[0] - b[0], a[1] - b[1], a[2] - b[2]);
+}
+
+static Vec3 negate(const Vec3 &a)
+{
+  return makeVec3(-a[0], -a[1], -a[2]);
+}
+
+static double dot(const Vec3 &a, const Vec3 &b)
+{
+  return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+static Vec3 cross(const Vec3 &a, const Vec3 &b)
+{
+  return makeVec3(a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0]);
+}
+
+// Corners of the flat sided primitives (primitive_geometry.h)
+static const double pyramidCorners[5][3] = {
+  {-0.5, -0.5, -0.5}, {0.5, -0.5, -0.5}, {0.5, -0.5, 0.5}, {-0.5, -0.5, 0.5}, {0.0, 0.5, 0.0}
+};
+static const double wedgeCorners[6][3] = {
+  {-0.5, -0.5, -0.5}, {0.5, -0.5, -0.5}, {0.5, 0.5, -0.5}, {-0.5, -0.5, 0.5}, {0.5, -0.5, 0.5}, {0.5, 0.5, 0.5}
+};
+
+static Vec3 farthestCorner(const double corners[][3], int count, const Vec3 &d)
+{
+  int best = 0;
+  double bestDot = -HUGE_VAL;
+  for (int i = 0; i < count; i++)
+  {
+    double along = corners[i][0] * d[0] + corners[i][1] * d[1] + corners[i][2] * d[2];
+    if (along > bestDot)
+    {
+      best = i;
+      bestDot = along;
+    }
+  }
+  return makeVec3(corners[best][0], corners[best][1], corners[best][2]);
+}
+
+// Point of the rim of radius 0.5 around z farthest along d
+static Vec3 rimPoint(const Vec3 &d, double z)
+{
+  double length = sqrt(d[0] * d[0] + d[1] * d[1]);
+  if (length < 1e-300)
+    return makeVec3(0.0, 0.0, z);
+  return makeVec3(0.5 * d[0] / length, 0.5 * d[1] / length, z);
+}
+
+// Farthest point of the primitive along d, in object space
+static Vec3 localSupport(int type, const Vec3 &d)
+{
+  switch (type)
+  {
+  case 0: // Plane
+    return makeVec3(d[0] >= 0.0 ? 0.5 : -0.5, 0.0, d[2] >= 0.0 ? 0.5 : -0.5);
+  case 2: // Sphere
+  {
+    double length = sqrt(dot(d, d));
+    return length < 1e-300 ? makeVec3(0.5, 0.0, 0.0) : makeVec3(0.5 * d[0] / length, 0.5 * d[1] / length, 0.5 * d[2] / length);
+  }
+  case 3: // Cone, apex up z
+  {
+    Vec3 rim = rimPoint(d, -0.5);
+    return dot(rim, d) >= 0.5 * d[2] ? rim : makeVec3(0.0, 0.0, 0.5);
+  }
+  case 4: // Cylinder
+    return rimPoint(d, d[2] >= 0.0 ? 0.5 : -0.5);
+  case 5: return farthestCorner(pyramidCorners, 5, d);
+  case 6: return farthestCorner(wedgeCorners, 6, d);
+  default: // Cube
+    return makeVec3(d[0] >= 0.0 ? 0.5 : -0.5, d[1] >= 0.0 ? 0.5 : -0.5, d[2] >= 0.0 ? 0.5 : -0.5);
+  }
+}
+
+// Farthest cage vertex along d; a cage's hull holds its subdivision surface
+static Vec3 cageSupport(const HalfEdgeMesh &cage, const Vec3 &d)
+{
+  int best = 0;
+  double bestDot = -HUGE_VAL;
+  for (int v = 0; v < cage.vertexCount(); v++)
+  {
+    const float *p = cage.position(v);
+    double along = p[0] * d[0] + p[1] * d[1] + p[2] * d[2];
+    if (along > bestDot)
+    {
+      best = v;
+      bestDot = along;
+    }
+  }
+  const float *p = cage.position(best);
+  return makeVec3(p[0], p[1], p[2]);
+}
+
+// A primitive, or the hull of a mesh's cage, under an object's transform
+struct Shape
+{
+  int type;
+  const HalfEdgeMesh *cage; // Or 0
+  double model[16];
+
+  Shape(const SceneData &scene, int index, double shrink = 0.0)
+  {
+    type = qBound(0, scene.objects[index], 6);
+    const MeshObject *mesh = scene.meshes.isEmpty() ? 0 : scene.meshes.find(index);
+    cage = mesh && mesh->cage.vertexCount() > 0 ? &mesh->cage : 0;
+    double scale[3];
+    for (int a = 0; a < 3; a++)
+      scale[a] = scene.scales[index][a] * (1.0 - shrink);
+    objectMatrix(scene.translates[index].v, scene.rotations[index].v, scale, model);
+  }
+
+  Vec3 center() const { return makeVec3(model[12], model[13], model[14]); }
+
+  // The farthest point of an affine image along d is the image of the
+  // farthest point along d turned back by the transpose
+  Vec3 support(const Vec3 &d) const
+  {
+    Vec3 local, point;
+    for (int c = 0; c < 3; c++)
+      local[c] = model[c * 4] * d[0] + model[c * 4 + 1] * d[1] + model[c * 4 + 2] * d[2];
+    Vec3 p = cage ? cageSupport(*cage, local) : localSupport(type, local);
+    for (int r = 0; r < 3; r++)
+      point[r] = model[r] * p[0] + model[4 + r] * p[1] + model[8 + r] * p[2] + model[12 + r];
+    return point;
+  }
+};
+
+WorldBox objectBox(const SceneData &scene, int index)
+{
+  Shape shape(scene, index);
+  WorldBox box;
+  for (int a = 0; a < 3; a++)
+  {
+    Vec3 axis = makeVec3(0.0, 0.0, 0.0);
+    axis[a] = 1.0;
+    double high = shape.support(axis)[a];
+    axis[a] = -1.0;
+    double low = shape.support(axis)[a];
+    box.min[a] = (float)low;
+    box.max[a] = (float)high;
+    if (box.min[a] > low)
+      box.min[a] = nextafterf(box.min[a], -HUGE_VALF);
+    if (box.max[a] < high)
+      box.max[a] = nextafterf(box.max[a], HUGE_VALF);
+  }
+  return box;
+}
+
+static bool boxesOverlap(const WorldBox &a, const WorldBox &b)
+{
+  return a.min[0] <= b.max[0] && b.min[0] <= a.max[0] && a.min[1] <= b.max[1] && b.min[1] <= a.max[1] && a.min[2] <= b.max[2] && b.min[2] <= a.max[2];
+}
+
+/*******/
+/* GJK */
+/*******/
+
+// Simplex of the Minkowski difference a - b, newest point first. Each
+// step keeps the feature closest to the origin and points d at the origin
+// from it; true when the origin is enclosed.
+struct Simplex
+{
+  Vec3 points[4];
+  int size;
+
+  void set(const Vec3 &a) { points[0] = a; size = 1; }
+  void set(const Vec3 &a, const Vec3 &b) { points[0] = a; points[1] = b; size = 2; }
+  void set(const Vec3 &a, const Vec3 &b, const Vec3 &c) { points[0] = a; points[1] = b; points[2] = c; size = 3; }
+
+  void push(const Vec3 &p)
+  {
+    for (int i = size; i > 0; i--)
+      points[i] = points[i - 1];
+    points[0] = p;
+    size++;
+  }
+
+  bool line(Vec3 &d)
+  {
+    Vec3 a = points[0], ab = subtract(points[1], a), ao = negate(a);
+    if (dot(ab, ao) > 0.0)
+      d = cross(cross(ab, ao), ab);
+    else
+    {
+      set(a);
+      d = ao;
+    }
+    return false;
+  }
+
+  bool triangle(Vec3 &d)
+  {
+    Vec3 a = points[0], b = points[1], c = points[2];
+    Vec3 ab = subtract(b, a), ac = subtract(c, a), ao = negate(a), abc = cross(ab, ac);
+    if (dot(cross(abc, ac), ao) > 0.0)
+    {
+      if (dot(ac, ao) > 0.0)
+      {
+        set(a, c);
+        d = cross(cross(ac, ao), ac);
+        return false;
+      }
+      set(a, b);
+      return line(d);
+    }
+    if (dot(cross(ab, abc), ao) > 0.0)
+    {
+      set(a, b);
+      return line(d);
+    }
+    if (dot(abc, ao) > 0.0)
+      d = abc;
+    else
+    {
+      set(a, c, b);
+      d = negate(abc);
+    }
+    return false;
+  }
+
+  bool tetrahedron(Vec3 &d)
+  {
+    Vec3 a = points[0], b = points[1], c = points[2], e = points[3];
+    Vec3 ab = subtract(b, a), ac = subtract(c, a), ae = subtract(e, a), ao = negate(a);
+    if (dot(cross(ab, ac), ao) > 0.0)
+    {
+      set(a, b, c);
+      return triangle(d);
+    }
+    if (dot(cross(ac, ae), ao) > 0.0)
+    {
+      set(a, c, e);
+      return triangle(d);
+    }
+    if (dot(cross(ae, ab), ao) > 0.0)
+    {
+      set(a, e, b);
+      return triangle(d);
+    }
+    return true;
+  }
+
+  bool next(Vec3 &d)
+  {
+    switch (size)
+    {
+    case 2: return line(d);
+    case 3: return triangle(d);
+    default: return tetrahedron(d);
+    }
+  }
+};
+
+static bool shapesInterfere(const Shape &a, const Shape &b)
+{
+  Vec3 d = subtract(a.center(), b.center());
+  if (dot(d, d) < 1e-24)
+    d = makeVec3(1.0, 0.0, 0.0);
+  Simplex simplex;
+  simplex.set(subtract(a.support(d), b.support(negate(d))));
+  d = negate(simplex.points[0]);
+  for (int i = 0; i < maxGjkIterations; i++)
+  {
+    double length = sqrt(dot(d, d));
+    if (length < 1e-12)
+      return true; // The origin lies on the simplex, inside the overlap
+    Vec3 p = subtract(a.support(d), b.support(negate(d)));
+    if (dot(p, d) <= 0.0)
+      return false; // d separates them
+    simplex.push(p);
+    if (simplex.next(d))
+      return true;
+  }
+  return false;
+}
+
+// Unturned cubes are their own bounds, which makes a cheaper exact test
+static bool isAlignedCube(const SceneData &scene, int index)
+{
+  const Vec3 &rotation = scene.rotations[index];
+  return scene.objects[index] == 1 && rotation[0] == 0.0 && rotation[1] == 0.0 && rotation[2] == 0.0 && !scene.meshes.contains(index);
+}
+
+bool objectsInterfere(const SceneData &scene, int a, int b)
+{
+  if (isAlignedCube(scene, a) && isAlignedCube(scene, b))
+  {
+    for (int k = 0; k < 3; k++)
+    {
+      double reach = 0.5 * (1.0 - contactShrink) * (fabs(scene.scales[a][k]) + fabs(scene.scales[b][k]));
+      if (fabs(scene.translates[a][k] - scene.translates[b][k]) >= reach)
+        return false;
+    }
+    return true;
+  }
+  return shapesInterfere(Shape(scene, a, contactShrink), Shape(scene, b, contactShrink));
+}
+
+/********/
+/* GRID */
+/********/
+
+// An object, or a part of a longer one, filed under the grid cell of its
+// low corner
+struct CellEntry
+{
+  quint64 cell;
+  int object;
+  int part; // Index along each axis in a byte each, or -1 for whole objects
+
+  bool operator<(const CellEntry &other) const { return cell < other.cell || (cell == other.cell && object < other.object); }
+};
+Q_DECLARE_TYPEINFO(CellEntry, Q_PRIMITIVE_TYPE);
+
+struct GridLevel
+{
+  const SceneData *scene;
+  const QVector<WorldBox> *boxes;
+  double cellSize[3];
+  double partSize[3];           // A little under a cell
+  QVector<CellEntry> entries;   // Sorted
+  QVector<WorldBox> entryBoxes; // The box of each entry's object, in entry order
+  const QVector<int> *objects;  // Too long for parts; tested against the entries
+};
+
+// A range of boxes, entries or objects, and the pairs it found
+struct InterferenceJob
+{
+  const GridLevel *level;
+  int begin, end;
+  QVector<ObjectPair> found;
+};
+
+static int cellCoordinate(double value, double cellSize)
+{
+  return (int)qBound(-(double)cellLimit, floor(value / cellSize), (double)cellLimit);
+}
+
+// Coordinates pack into one number, so moving by a cell is adding a
+// constant, and neighbours of cells in order are in order too
+static qint64 cellKey(int x, int y, int z)
+{
+  return ((qint64)(x + cellLimit + 1) << 42) + ((qint64)(y + cellLimit + 1) << 21) + (qint64)(z + cellLimit + 1);
+}
+
+static void addPair(QVector<ObjectPair> &found, int a, int b)
+{
+  ObjectPair pair = { qMin(a, b), qMax(a, b) };
+  found.append(pair);
+}
+
+// Two objects with parts can meet in several of them; they are tested
+// only by the parts holding the low corner of their boxes' overlap
+static bool holdsOverlapCorner(const GridLevel &level, const CellEntry &entry, const WorldBox &box, const WorldBox &other)
+{
+  if (entry.part < 0)
+    return true;
+  for (int a = 0; a < 3; a++)
+  {
+    int part = (int)((qMax(box.min[a], other.min[a]) - box.min[a]) / level.partSize[a]);
+    int parts = (int)ceil((box.max[a] - box.min[a]) / level.partSize[a]);
+    if (qBound(0, part, qMax(parts - 1, 0)) != ((entry.part >> (8 * a)) & 0xff))
+      return false;
+  }
+  return true;
+}
+
+static void testEntries(const GridLevel &level, int p, int q, QVector<ObjectPair> &found)
+{
+  const CellEntry &a = level.entries[p], &b = level.entries[q];
+  const WorldBox &boxA = level.entryBoxes[p], &boxB = level.entryBoxes[q];
+  if (a.object != b.object && boxesOverlap(boxA, boxB) && holdsOverlapCorner(level, a, boxA, boxB) && holdsOverlapCorner(level, b, boxB, boxA)
+      && objectsInterfere(*level.scene, a.object, b.object))
+    addPair(found, a.object, b.object);
+}
+
+static int findCell(const QVector<CellEntry> &entries, quint64 cell)
+{
+  CellEntry first = { cell, -1, -1 };
+  return std::lower_bound(entries.constBegin(), entries.constEnd(), first) - entries.constBegin();
+}
+
+// Entries no longer than a cell can only meet entries of their own cell
+// or the 26 around it; each cell takes its own pairs and those with the 13
+// neighbours that come after it
+static void testCells(InterferenceJob &job)
+{
+  const GridLevel &level = *job.level;
+  const CellEntry *entries = level.entries.constData();
+  int count = level.entries.size();
+  int neighbours[13];
+  qint64 offsets[13];
+  int n = 0;
+  for (int dx = -1; dx <= 1; dx++)
+    for (int dy = -1; dy <= 1; dy++)
+      for (int dz = -1; dz <= 1; dz++)
+        if (dx > 0 || (dx == 0 && (dy > 0 || (dy == 0 && dz > 0))))
+          offsets[n++] = cellKey(dx, dy, dz) - cellKey(0, 0, 0);
+  for (int k = 0; k < 13; k++)
+    neighbours[k] = findCell(level.entries, entries[job.begin].cell + offsets[k]);
+
+  for (int first = job.begin; first < job.end;)
+  {
+    int next = first + 1;
+    while (next < job.end && entries[next].cell == entries[first].cell)
+      next++;
+    for (int p = first; p < next; p++)
+      for (int q = p + 1; q < next; q++)
+        testEntries(level, p, q, job.found);
+    for (int k = 0; k < 13; k++)
+    {
+      quint64 cell = entries[first].cell + offsets[k];
+      int &other = neighbours[k];
+      while (other < count && entries[other].cell < cell)
+        other++;
+      for (int q = other; q < count && entries[q].cell == cell; q++)
+        for (int p = first; p < next; p++)
+          testEntries(level, p, q, job.found);
+    }
+    first = next;
+  }
+}
+
+// Objects too long for parts against every entry whose low corner could
+// lie under them, a column of cells at a time
+static void testBigObjects(InterferenceJob &job)
+{
+  const GridLevel &level = *job.level;
+  int count = level.entries.size();
+  for (int k = job.begin; k < job.end; k++)
+  {
+    int i = (*level.objects)[k];
+    const WorldBox &box = (*level.boxes)[i];
+    int low[3], high[3];
+    for (int a = 0; a < 3; a++)
+    {
+      low[a] = cellCoordinate(box.min[a] - level.cellSize[a], level.cellSize[a]);
+      high[a] = cellCoordinate(box.max[a], level.cellSize[a]);
+    }
+    bool scan = (qint64)(high[0] - low[0] + 1) * (high[1] - low[1] + 1) > count;
+    for (int x = low[0]; x <= high[0] && !scan; x++)
+      for (int y = low[1]; y <= high[1]; y++)
+      {
+        quint64 lastCell = cellKey(x, y, high[2]);
+        for (int e = findCell(level.entries, cellKey(x, y, low[2])); e < count && level.entries[e].cell <= lastCell; e++)
+          if (boxesOverlap(box, level.entryBoxes[e]) && holdsOverlapCorner(level, level.entries[e], level.entryBoxes[e], box)
+              && objectsInterfere(*level.scene, i, level.entries[e].object))
+            addPair(job.found, i, level.entries[e].object);
+      }
+    for (int e = 0; e < count && scan; e++)
+      if (boxesOverlap(box, level.entryBoxes[e]) && holdsOverlapCorner(level, level.entries[e], level.entryBoxes[e], box)
+          && objectsInterfere(*level.scene, i, level.entries[e].object))
+        addPair(job.found, i, level.entries[e].object);
+  }
+}
+
+static QVector<InterferenceJob> makeJobs(const GridLevel *level, int count, int size)
+{
+  QVector<InterferenceJob> jobs;
+  for (int begin = 0; begin < count; begin += size)
+  {
+    InterferenceJob job = { level, begin, qMin(begin + size, count), QVector<ObjectPair>() };
+    jobs.append(job);
+  }
+  return jobs;
+}
+
+static void gatherPairs(const QVector<InterferenceJob> &jobs, QVector<ObjectPair> &pairs)
+{
+  for (int j = 0; j < jobs.size(); j++)
+    pairs += jobs[j].found;
+}
+
+// Orders objects by the low x of their boxes
+struct MinXLess
+{
+  const QVector<WorldBox> &boxes;
+
+  bool operator()(int a, int b) const { return boxes[a].min[0] < boxes[b].min[0]; }
+};
+
+// Objects sorted by the low x of their boxes, each against those after
+// it that start before it ends
+static void sweepObjects(InterferenceJob &job)
+{
+  const GridLevel &level = *job.level;
+  const QVector<WorldBox> &boxes = *level.boxes;
+  const QVector<int> &objects = *level.objects;
+  for (int k = job.begin; k < job.end; k++)
+  {
+    int i = objects[k];
+    for (int l = k + 1; l < objects.size() && boxes[objects[l]].min[0] <= boxes[i].max[0]; l++)
+      if (boxesOverlap(boxes[i], boxes[objects[l]]) && objectsInterfere(*level.scene, i, objects[l]))
+        addPair(job.found, i, objects[l]);
+  }
+}
+
+// For the few objects, or ones no grid fits, e.g. rods crossing each other
+static void sweepPairs(const SceneData &scene, const QVector<WorldBox> &boxes, const QVector<int> &objects, QVector<ObjectPair> &pairs)
+{
+  TRACE_SCOPE("sweepPairs");
+  QVector<int> sorted = objects;
+  MinXLess less = { boxes };
+  std::sort(sorted.begin(), sorted.end(), less);
+  GridLevel level = { &scene, &boxes, { 0.0, 0.0, 0.0 }, { 0.0, 0.0, 0.0 }, QVector<CellEntry>(), QVector<WorldBox>(), &sorted };
+  QVector<InterferenceJob> jobs = makeJobs(&level, sorted.size(), sweepJobSize);
+  QtConcurrent::blockingMap(jobs, sweepObjects);
+  gatherPairs(jobs, pairs);
+}
+
+// Grids the objects with cells, along each axis, the size of most of
+// them. Objects up to a few cells long go in as parts; longer ones are
+// tested against the grid, then among themselves the same way a level up,
+// with parts at least twice as long as this level's. Few objects, or
+// ones that are all too long, are swept instead.
+static void gridPairs(const SceneData &scene, const QVector<WorldBox> &boxes, const QVector<int> &objects, const double minPartSize[3],
+                      QVector<ObjectPair> &pairs)
+{
+  TRACE_SCOPE("gridPairs");
+  if (objects.size() < 2)
+    return;
+  if (objects.size() < minGridObjects)
+  {
+    sweepPairs(scene, boxes, objects, pairs);
+    return;
+  }
+  GridLevel level = { &scene, &boxes, { 0.0, 0.0, 0.0 }, { 0.0, 0.0, 0.0 }, QVector<CellEntry>(), QVector<WorldBox>(), 0 };
+  std::vector<float> extents(objects.size());
+  for (int a = 0; a < 3; a++)
+  {
+    for (int k = 0; k < objects.size(); k++)
+      extents[k] = boxes[objects[k]].max[a] - boxes[objects[k]].min[a];
+    std::vector<float>::iterator cut = extents.begin() + (extents.size() - 1) * gridPercentile / 100;
+    std::nth_element(extents.begin(), cut, extents.end());
+    level.partSize[a] = qMax(qMax((double)*cut, 1e-6), minPartSize[a]);
+    level.cellSize[a] = level.partSize[a] * 1.001; // So rounding never puts touching parts two cells apart
+  }
+
+  QVector<int> big;
+  level.entries.reserve(objects.size() * 2);
+  for (int k = 0; k < objects.size(); k++)
+  {
+    int i = objects[k];
+    const WorldBox &box = boxes[i];
+    int parts[3];
+    for (int a = 0; a < 3; a++)
+      parts[a] = qMax((int)ceil((box.max[a] - box.min[a]) / level.partSize[a]), 1);
+    if (parts[0] * parts[1] * parts[2] > maxParts)
+    {
+      big.append(i);
+      continue;
+    }
+    bool whole = parts[0] * parts[1] * parts[2] == 1;
+    for (int x = 0; x < parts[0]; x++)
+      for (int y = 0; y < parts[1]; y++)
+        for (int z = 0; z < parts[2]; z++)
+        {
+          int corner[3] = { cellCoordinate(box.min[0] + x * level.partSize[0], level.cellSize[0]),
+                            cellCoordinate(box.min[1] + y * level.partSize[1], level.cellSize[1]),
+                            cellCoordinate(box.min[2] + z * level.partSize[2], level.cellSize[2]) };
+          CellEntry entry = { (quint64)cellKey(corner[0], corner[1], corner[2]), i, whole ? -1 : x | (y << 8) | (z << 16) };
+          level.entries.append(entry);
+        }
+  }
+  if (big.size() == objects.size())
+  {
+    sweepPairs(scene, boxes, objects, pairs);
+    return;
+  }
+  std::sort(level.entries.begin(), level.entries.end());
+  level.entryBoxes.resize(level.entries.size());
+  for (int e = 0; e < level.entries.size(); e++)
+    level.entryBoxes[e] = boxes[level.entries[e].object];
+  level.objects = &big;
+
+  // Jobs end where a cell does
+  QVector<InterferenceJob> jobs;
+  for (int begin = 0; begin < level.entries.size();)
+  {
+    int end = qMin(begin + jobSize, level.entries.size());
+    while (end < level.entries.size() && level.entries[end].cell == level.entries[end - 1].cell)
+      end++;
+    InterferenceJob job = { &level, begin, end, QVector<ObjectPair>() };
+    jobs.append(job);
+    begin = end;
+  }
+  QtConcurrent::blockingMap(jobs, testCells);
+  gatherPairs(jobs, pairs);
+
+  QVector<InterferenceJob> bigJobs = makeJobs(&level, big.size(), 1);
+  QtConcurrent::blockingMap(bigJobs, testBigObjects);
+  gatherPairs(bigJobs, pairs);
+  double nextPartSize[3] = { level.partSize[0] * 2.0, level.partSize[1] * 2.0, level.partSize[2] * 2.0 };
+  gridPairs(scene, boxes, big, nextPartSize, pairs);
+}
+
+struct BoxJob
+{
+  const SceneData *scene;
+  WorldBox *boxes;
+  int begin, end;
+};
+
+static void computeBoxes(BoxJob &job)
+{
+  for (int i = job.begin; i < job.end; i++)
+    job.boxes[i] = objectBox(*job.scene, i);
+}
+
+QVector<ObjectPair> findInterference(const SceneData &scene, QVector<WorldBox> &boxes)
+{
+  TRACE_SCOPE("findInterference");
+  int count = scene.size();
+  boxes.resize(count);
+  QVector<BoxJob> boxJobs;
+  for (int begin = 0; begin < count; begin += jobSize)
+  {
+    BoxJob job = { &scene, boxes.data(), begin, qMin(begin + jobSize, count) };
+    boxJobs.append(job);
+  }
+  QtConcurrent::blockingMap(boxJobs, computeBoxes);
+
+  QVector<int> objects(count);
+  for (int i = 0; i < count; i++)
+    objects[i] = i;
+  QVector<ObjectPair> pairs;
+  double minPartSize[3] = { 0.0, 0.0, 0.0 };
+  gridPairs(scene, boxes, objects, minPartSize, pairs);
+
+  // Clamped far cells can turn up a pair twice
+  std::sort(pairs.begin(), pairs.end());
+  pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+  return pairs;
+}
+
+// Pairs of two listed objects are tested by the lower one
+static void scanObjects(InterferenceJob &job)
+{
+  const GridLevel &level = *job.level;
+  const QVector<WorldBox> &boxes = *level.boxes;
+  const QVector<int> &objects = *level.objects;
+  for (int k = job.begin; k < job.end; k++)
+  {
+    int i = objects[k];
+    for (int j = 0; j < boxes.size(); j++)
+      if (j != i && boxesOverlap(boxes[i], boxes[j]) && !(j < i && std::binary_search(objects.begin(), objects.end(), j)) && objectsInterfere(*level.scene, i, j))
+        addPair(job.found, i, j);
+  }
+}
+
+QVector<ObjectPair> findInterference(const SceneData &scene, const QVector<WorldBox> &boxes, const QVector<int> &objects)
+{
+  TRACE_SCOPE("findInterference objects");
+  GridLevel level = { &scene, &boxes, { 0.0, 0.0, 0.0 }, { 0.0, 0.0, 0.0 }, QVector<CellEntry>(), QVector<WorldBox>(), &objects };
+  QVector<InterferenceJob> jobs = makeJobs(&level, objects.size(), 1);
+  QtConcurrent::blockingMap(jobs, scanObjects);
+  QVector<ObjectPair> pairs;
+  gatherPairs(jobs, pairs);
+  std::sort(pairs.begin(), pairs.end());
+  return pairs;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <QtCore>
+#include "scene_data.h"
+
+// Two objects whose shapes overlap, first < second
+struct ObjectPair
+{
+  int first, second;
+
+  bool operator<(const ObjectPair &other) const { return first < other.first || (first == other.first && second < other.second); }
+  bool operator==(const ObjectPair &other) const { return first == other.first && second == other.second; }
+};
+Q_DECLARE_TYPEINFO(ObjectPair, Q_PRIMITIVE_TYPE);
+
+// World space bounds of an object's shape, rounded outwards to floats
+struct WorldBox
+{
+  float min[3], max[3];
+};
+Q_DECLARE_TYPEINFO(WorldBox, Q_PRIMITIVE_TYPE);
+
+WorldBox objectBox(const SceneData &scene, int index);
+
+// Exact test of the two objects' shapes, with GJK on the support functions
+// of the true primitives (round ones are not tessellated). Meshes are
+// tested by the convex hull of their cage, which holds their surface.
+// Shapes that only touch don't interfere.
+bool objectsInterfere(const SceneData &scene, int a, int b);
+
+// Every interfering pair of the scene, sorted; boxes is filled in for
+// later checks of a few objects. Objects are filed under the grid cell of
+// their low corner, with cells as big as most objects, and only objects in
+// neighbouring cells are tested. Somewhat longer objects go in as a few
+// parts; the longest are tested against the grid, then among themselves
+// on a coarser one. Cells and long objects are shared out over every core.
+QVector<ObjectPair> findInterference(const SceneData &scene, QVector<WorldBox> &boxes);
+
+// The interfering pairs involving any of the sorted objects, against every
+// box of boxes, which must be up to date for them
+QVector<ObjectPair> findInterference(const SceneData &scene, const QVector<WorldBox> &boxes, const QVector<int> &objects);
@@ -0,0 +1,190 @@
+#include "interference_checker.h"
+#include <QtConcurrentRun>
+#include <algorithm>
+#include "trace.h"
+
+static const int maxPendingRegions = 64;              // Past this many edits a check covers everything
+static const int checkDelay = 250;                    // Milliseconds an edit waits for more edits
+static const qint64 maxScanTests = 64 * 1000 * 1000; // Box tests past which a full check is quicker
+
+InterferenceChecker::InterferenceChecker(Scene *scene) : QObject(scene), scene(scene), charge(InterferenceMemory)
+{
+  enabled = false;
+  everything = false;
+  removedWhileChecking = false;
+  delay = new QTimer(this);
+  delay->setSingleShot(true);
+  delay->setInterval(checkDelay);
+  connect(delay, SIGNAL(timeout()), this, SLOT(start()));
+  connect(&watcher, SIGNAL(finished()), this, SLOT(checkFinished()));
+  connect(scene, SIGNAL(animationTimeChanged(double)), this, SLOT(animationTimeChanged()));
+}
+
+InterferenceChecker::~InterferenceChecker()
+{
+  watcher.waitForFinished();
+}
+
+void InterferenceChecker::setEnabled(bool enabled)
+{
+  if (enabled == this->enabled)
+    return;
+  this->enabled = enabled;
+  pending.clear();
+  everything = enabled;
+  if (enabled)
+  {
+    start();
+    return;
+  }
+  delay->stop();
+  found.clear();
+  boxes.clear();
+  charge.resize(0);
+  emit pairsChanged();
+}
+
+void InterferenceChecker::edited(const SceneRegion &region)
+{
+  if (!enabled)
+    return;
+  if (region.everything || pending.size() >= maxPendingRegions)
+  {
+    pending.clear();
+    everything = true;
+  }
+  else if (!everything)
+    pending.append(region);
+  delay->start();
+}
+
+// Playback keeps restarting the delay, so this checks once it stops
+void InterferenceChecker::animationTimeChanged()
+{
+  if (!scene->data().animation.isEmpty())
+    edited(SceneRegion::all());
+}
+
+// The object's pairs go with it, and the others move down an index
+void InterferenceChecker::objectRemoved(int index)
+{
+  if (!enabled)
+    return;
+  if (index < boxes.size())
+    boxes.remove(index);
+  QVector<ObjectPair> kept;
+  for (int p = 0; p < found.size(); p++)
+  {
+    ObjectPair pair = found[p];
+    if (pair.first == index || pair.second == index)
+      continue;
+    pair.first -= pair.first > index ? 1 : 0;
+    pair.second -= pair.second > index ? 1 : 0;
+    kept.append(pair);
+  }
+  bool changed = kept.size() != found.size();
+  found = kept;
+  if (watcher.isRunning())
+    removedWhileChecking = true;
+  if (changed)
+    emit pairsChanged();
+}
+
+void InterferenceChecker::start()
+{
+  TRACE_SCOPE("InterferenceChecker::start");
+  if (!enabled || watcher.isRunning())
+    return; // checkFinished starts again if edits came in
+  if (!everything && pending.isEmpty())
+    return;
+  removedWhileChecking = false;
+  watcher.setFuture(QtConcurrent::run(runCheck, SceneData(scene->displayed()), boxes, pending, everything));
+  pending.clear();
+  everything = false;
+}
+
+static bool boxMeets(const WorldBox &box, const SceneRegion &region)
+{
+  for (int a = 0; a < 3; a++)
+    if (box.max[a] < region.min[a] || box.min[a] > region.max[a])
+      return false;
+  return true;
+}
+
+InterferenceResult InterferenceChecker::runCheck(SceneData pose, QVector<WorldBox> boxes, QVector<SceneRegion> regions, bool everything)
+{
+  TRACE_SCOPE("InterferenceChecker::runCheck");
+  QElapsedTimer timer;
+  timer.start();
+  InterferenceResult result;
+  result.everything = everything || boxes.size() > pose.size();
+
+  // Objects whose last box meets an edit may have moved; new ones are due
+  // anyway
+  if (!result.everything)
+  {
+    for (int i = 0; i < boxes.size(); i++)
+      for (int r = 0; r < regions.size(); r++)
+        if (boxMeets(boxes[i], regions[r]))
+        {
+          result.objects.append(i);
+          break;
+        }
+    for (int i = boxes.size(); i < pose.size(); i++)
+      result.objects.append(i);
+    result.everything = (qint64)result.objects.size() * pose.size() > maxScanTests;
+  }
+
+  if (result.everything)
+  {
+    result.objects.clear();
+    result.pairs = findInterference(pose, result.boxes);
+  }
+  else
+  {
+    boxes.resize(pose.size());
+    for (int k = 0; k < result.objects.size(); k++)
+      boxes[result.objects[k]] = objectBox(pose, result.objects[k]);
+    result.pairs = findInterference(pose, boxes, result.objects);
+    result.boxes = boxes;
+  }
+  result.msec = timer.elapsed();
+  return result;
+}
+
+void InterferenceChecker::checkFinished()
+{
+  TRACE_SCOPE("InterferenceChecker::checkFinished");
+  InterferenceResult result = watcher.result();
+  if (!enabled)
+    return;
+  if (removedWhileChecking)
+  {
+    everything = true;
+    start();
+    return;
+  }
+
+  boxes = result.boxes;
+  if (result.everything)
+    found = result.pairs;
+  else
+  {
+    // The checked objects' pairs are replaced
+    QVector<ObjectPair> kept;
+    for (int p = 0; p < found.size(); p++)
+      if (!std::binary_search(result.objects.begin(), result.objects.end(), found[p].first)
+          && !std::binary_search(result.objects.begin(), result.objects.end(), found[p].second))
+        kept.append(found[p]);
+    kept += result.pairs;
+    std::sort(kept.begin(), kept.end());
+    found = kept;
+  }
+  charge.resize((qint64)boxes.capacity() * sizeof(WorldBox) + (qint64)found.capacity() * sizeof(ObjectPair));
+
+  emit pairsChanged();
+  int checked = result.everything ? boxes.size() : result.objects.size();
+  emit finished(QString("Checked %1 objects for interference: %2 pairs (%3 ms)").arg(checked).arg(found.size()).arg(result.msec));
+  if (everything || !pending.isEmpty())
+    start();
+}
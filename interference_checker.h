@@ -0,0 +1,70 @@
+#pragma once
+
+#include <QtCore>
+#include <QFutureWatcher>
+#include "interference.h"
+#include "memory_stats.h"
+#include "scene.h"
+
+struct InterferenceResult
+{
+  bool everything;           // The pairs cover the whole scene
+  QVector<int> objects;      // Or only these objects, sorted
+  QVector<ObjectPair> pairs;
+  QVector<WorldBox> boxes;   // Of every object, as checked
+  qint64 msec;
+};
+
+// Keeps the list of interfering objects up to date while enabled
+// (interference.h). The first check covers the whole scene; after that, an
+// edit only re-checks the objects whose last boxes meet the edited region,
+// against every other object. Checks run on worker threads against a
+// snapshot of the posed scene; a new animation time re-checks everything
+// once it stops changing. Lives on the UI thread.
+class InterferenceChecker : public QObject
+{
+
+  Q_OBJECT
+
+public:
+  InterferenceChecker(Scene *scene);
+  ~InterferenceChecker();
+
+  bool isEnabled() const { return enabled; }
+
+  // Sorted; empty while disabled
+  const QVector<ObjectPair> &pairs() const { return found; }
+
+  // Called by the scene as it changes
+  void edited(const SceneRegion &region);
+  void objectRemoved(int index);
+
+public slots:
+  void setEnabled(bool enabled);
+
+signals:
+  void pairsChanged();
+  void finished(QString report);
+
+private slots:
+  void start();
+  void checkFinished();
+  void animationTimeChanged();
+
+private:
+  static InterferenceResult runCheck(SceneData pose, QVector<WorldBox> boxes, QVector<SceneRegion> regions, bool everything);
+
+  Scene *scene;
+  bool enabled;
+  QVector<ObjectPair> found;
+  QVector<WorldBox> boxes; // As of the last check, to find what an edit may have moved
+  MemoryCharge charge;
+
+  // Edits since the last check started; too many become "everything"
+  QVector<SceneRegion> pending;
+  bool everything;
+  QTimer *delay; // Collects the edits of a drag before checking
+
+  QFutureWatcher<InterferenceResult> watcher;
+  bool removedWhileChecking; // The result's indices are stale, so it is checked again
+};
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <QtCore>
+
+// Progress of a load or save running on worker threads. Workers report
+// finished units of the current phase, the UI thread polls percent(), and
+// either side may cancel; workers check isCancelled() between pieces of
+// work and give up early.
+class IoProgress
+{
+public:
+  enum Phase { Reading, Decoding, Encoding, Writing };
+
+  IoProgress() : phaseValue(Reading), done(0), total(1), cancelled(0) {}
+
+  // Starts a phase of the given number of units; only the worker driving
+  // the job calls this, helpers it spawns only advance
+  void begin(Phase phase, qint64 units)
+  {
+    done = 0;
+    total = (int)qBound((qint64)1, units, (qint64)INT_MAX);
+    phaseValue = phase;
+  }
+  void advance(int units) { done.fetchAndAddRelaxed(units); }
+
+  Phase phase() const { return (Phase)(int)phaseValue; }
+  int percent() const { return (int)qMin((qint64)100, (qint64)(int)done * 100 / (int)total); }
+
+  void reset() { cancelled = 0; begin(Reading, 1); }
+  void cancel() { cancelled = 1; }
+  bool isCancelled() const { return (int)cancelled != 0; }
+
+private:
+  QAtomicInt phaseValue;
+  QAtomicInt done;
+  QAtomicInt total;
+  QAtomicInt cancelled;
+};
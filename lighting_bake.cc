@@ -0,0 +1,130 @@
+#include "lighting_bake.h"
+#include <QtConcurrentMap>
+#include <cmath>
+#include "primitive_geometry.h"
+#include "scene_bvh.h"
+#include "scene_math.h"
+#include "trace.h"
+
+static const int bakeBatch = 8; // Objects taken off the counter at a time
+
+struct BakeWork
+{
+  const SceneData *scene;
+  const SceneBvh *bvh;
+  const QVector<int> *objects;
+  const BakeSettings *settings;
+  QAtomicInt *next;
+  QVector<quint8> *results; // Detached up front, one per listed object
+};
+
+static void bakeObject(const BakeWork &work, int object, QVector<quint8> &out)
+{
+  const SceneData &scene = *work.scene;
+  const BakeSettings &settings = *work.settings;
+  int type = scene.objects[object];
+  if (type < 0 || type > 6)
+    return;
+  double model[16], inverse[16];
+  objectMatrix(scene.translates[object].v, scene.rotations[object].v, scene.scales[object].v, model);
+  if (!invertAffine(model, inverse))
+    return;
+
+  const MeshData &mesh = primitiveMesh(type);
+  const Vec3 &color = scene.colors[object];
+  out.resize(mesh.vertexCount * 3);
+  for (int v = 0; v < mesh.vertexCount; v++)
+  {
+    // World position, and the normal through the inverse transpose
+    const float *position = &mesh.positions[v * 3], *normal = &mesh.normals[v * 3];
+    double p[3], n[3];
+    for (int a = 0; a < 3; a++)
+    {
+      p[a] = model[a] * position[0] + model[4 + a] * position[1] + model[8 + a] * position[2] + model[12 + a];
+      n[a] = inverse[a * 4] * normal[0] + inverse[a * 4 + 1] * normal[1] + inverse[a * 4 + 2] * normal[2];
+    }
+    double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    if (length < 1e-12)
+      length = 1.0;
+    for (int a = 0; a < 3; a++)
+      n[a] /= length;
+
+    // Occlusion: cosine weighted directions around the normal, stratified,
+    // and turned by a per-vertex angle so neighbours don't band
+    double helper[3] = { fabs(n[0]) < 0.9 ? 1.0 : 0.0, fabs(n[0]) < 0.9 ? 0.0 : 1.0, 0.0 };
+    double tangent[3] = { helper[1] * n[2] - helper[2] * n[1], helper[2] * n[0] - helper[0] * n[2], helper[0] * n[1] - helper[1] * n[0] };
+    double tangentLength = sqrt(tangent[0] * tangent[0] + tangent[1] * tangent[1] + tangent[2] * tangent[2]);
+    for (int a = 0; a < 3; a++)
+      tangent[a] /= tangentLength;
+    double bitangent[3] = { n[1] * tangent[2] - n[2] * tangent[1], n[2] * tangent[0] - n[0] * tangent[2], n[0] * tangent[1] - n[1] * tangent[0] };
+    double turn = (((quint32)object * 2654435761u) ^ ((quint32)v * 40503u)) % 65536 / 65536.0;
+
+    int hits = 0;
+    for (int s = 0; s < settings.occlusionRays; s++)
+    {
+      double u = (s + 0.5) / settings.occlusionRays;
+      double angle = 2.0 * M_PI * (s * 0.6180339887 + turn);
+      double radius = sqrt(u), x = radius * cos(angle), y = radius * sin(angle), z = sqrt(1.0 - u);
+      double direction[3];
+      for (int a = 0; a < 3; a++)
+        direction[a] = x * tangent[a] + y * bitangent[a] + z * n[a];
+      if (work.bvh->occluded(p, direction, settings.occlusionDistance, object))
+        hits++;
+    }
+    double occlusion = settings.occlusionRays > 0 ? 1.0 - (double)hits / settings.occlusionRays : 1.0;
+
+    // Direct light, if nothing is in between
+    double toLight[3], distance = 0.0;
+    for (int a = 0; a < 3; a++)
+    {
+      toLight[a] = settings.lightPosition[a] - p[a];
+      distance += toLight[a] * toLight[a];
+    }
+    distance = sqrt(distance);
+    double facing = 0.0;
+    if (distance > 1e-9)
+    {
+      for (int a = 0; a < 3; a++)
+        toLight[a] /= distance;
+      facing = n[0] * toLight[0] + n[1] * toLight[1] + n[2] * toLight[2];
+      if (facing > 0.0 && work.bvh->occluded(p, toLight, distance, object))
+        facing = 0.0;
+    }
+
+    double light = settings.ambient * occlusion + settings.diffuse * qMax(facing, 0.0);
+    for (int c = 0; c < 3; c++)
+      out[v * 3 + c] = (quint8)qBound(0, qRound(color[c] * light * 255.0), 255);
+  }
+}
+
+static void bakeWorker(BakeWork &work)
+{
+  int count = work.objects->size();
+  for (;;)
+  {
+    int first = work.next->fetchAndAddRelaxed(bakeBatch);
+    if (first >= count)
+      return;
+    for (int k = first; k < qMin(first + bakeBatch, count); k++)
+      bakeObject(work, work.objects->at(k), work.results[k]);
+  }
+}
+
+BakedColors bakeObjects(const SceneData &scene, const SceneBvh &bvh, const QVector<int> &objects, const BakeSettings &settings)
+{
+  TRACE_SCOPE("bakeObjects");
+  BakedColors results(objects.size());
+  QAtomicInt next(0);
+  BakeWork work = { &scene, &bvh, &objects, &settings, &next, results.data() };
+  QVector<BakeWork> workers(qMax(1, QThread::idealThreadCount()), work);
+  QtConcurrent::blockingMap(workers, bakeWorker);
+  return results;
+}
+
+qint64 bakedMemoryUsage(const BakedColors &colors)
+{
+  qint64 bytes = (qint64)colors.capacity() * sizeof(QVector<quint8>);
+  for (int i = 0; i < colors.size(); i++)
+    bytes += colors.at(i).capacity();
+  return bytes;
+}
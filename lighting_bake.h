@@ -0,0 +1,37 @@
+#pragma once
+
+#include <QtCore>
+#include "scene_data.h"
+
+class SceneBvh;
+
+// Per object, the lit color of each vertex of its default mesh as RGB
+// bytes; empty for objects that are not baked
+typedef QVector<QVector<quint8> > BakedColors;
+
+// The renderer's GL_LIGHT0, with shadows, plus ambient light that nearby
+// geometry occludes. Ambient is stronger than the renderer's, or the
+// occlusion would hardly show.
+struct BakeSettings
+{
+  int occlusionRays;        // Per vertex
+  double occlusionDistance; // Geometry further away than this doesn't darken
+  double lightPosition[3];
+  double ambient;
+  double diffuse;
+
+  BakeSettings() : occlusionRays(32), occlusionDistance(1.5), ambient(0.35), diffuse(0.75)
+  {
+    lightPosition[0] = 25.0;
+    lightPosition[1] = 50.0;
+    lightPosition[2] = 25.0;
+  }
+};
+
+// Bakes the listed objects of scene against everything in bvh; result k
+// belongs to objects[k]. Every core takes small batches of objects off a
+// shared counter until none are left, so cores that draw cheap objects
+// take on more of them.
+BakedColors bakeObjects(const SceneData &scene, const SceneBvh &bvh, const QVector<int> &objects, const BakeSettings &settings);
+
+qint64 bakedMemoryUsage(const BakedColors &colors);
@@ -0,0 +1,171 @@
+#include "lighting_baker.h"
+#include <QtConcurrentRun>
+#include "scene_bvh.h"
+#include "trace.h"
+
+static const int maxPendingRegions = 64; // Past this many edits a bake just covers everything
+static const int bakeDelay = 250;        // Milliseconds an edit waits for more edits
+
+LightingBaker::LightingBaker(Scene *scene) : QObject(scene), scene(scene), charge(LightingMemory)
+{
+  enabled = false;
+  everything = false;
+  delay = new QTimer(this);
+  delay->setSingleShot(true);
+  delay->setInterval(bakeDelay);
+  connect(delay, SIGNAL(timeout()), this, SLOT(start()));
+  connect(&watcher, SIGNAL(finished()), this, SLOT(bakeFinished()));
+}
+
+LightingBaker::~LightingBaker()
+{
+  watcher.waitForFinished();
+}
+
+void LightingBaker::setEnabled(bool enabled)
+{
+  if (enabled == this->enabled)
+    return;
+  this->enabled = enabled;
+  pending.clear();
+  everything = enabled;
+  if (enabled)
+  {
+    start();
+    return;
+  }
+  delay->stop();
+  baked.clear();
+  charge.resize(0);
+  emit colorsChanged();
+}
+
+void LightingBaker::edited(const SceneRegion &region)
+{
+  if (!enabled)
+    return;
+  if (region.everything || pending.size() >= maxPendingRegions)
+  {
+    pending.clear();
+    everything = true;
+  }
+  else if (!everything)
+    pending.append(region);
+  delay->start();
+}
+
+// The object's colors go with it, so the others keep theirs
+void LightingBaker::objectRemoved(int index)
+{
+  if (!enabled)
+    return;
+  if (index < baked.size())
+  {
+    baked.remove(index);
+    charge.resize(bakedMemoryUsage(baked));
+  }
+  if (watcher.isRunning())
+    removedWhileBaking.append(index);
+}
+
+// Within the occlusion distance of an edit, or lit through it. The way to
+// the light is taken from the object's center.
+bool LightingBaker::isNearEdit(const SceneRegion &object) const
+{
+  for (int r = 0; r < pending.size(); r++)
+  {
+    const SceneRegion &edit = pending[r];
+    bool inReach = true;
+    double center[3], low = 0.0, high = 1.0;
+    for (int a = 0; a < 3; a++)
+    {
+      double min = edit.min[a] - settings.occlusionDistance, max = edit.max[a] + settings.occlusionDistance;
+      inReach = inReach && object.max[a] >= min && object.min[a] <= max;
+
+      // Slab test of the segment from the center to the light
+      center[a] = 0.5 * (object.min[a] + object.max[a]);
+      double span = settings.lightPosition[a] - center[a];
+      if (fabs(span) < 1e-12)
+      {
+        if (center[a] < edit.min[a] || center[a] > edit.max[a])
+          high = -1.0;
+        continue;
+      }
+      double t0 = (edit.min[a] - center[a]) / span, t1 = (edit.max[a] - center[a]) / span;
+      low = qMax(low, qMin(t0, t1));
+      high = qMin(high, qMax(t0, t1));
+    }
+    if (inReach || low <= high)
+      return true;
+  }
+  return false;
+}
+
+void LightingBaker::start()
+{
+  TRACE_SCOPE("LightingBaker::start");
+  if (!enabled || watcher.isRunning())
+    return; // bakeFinished starts again if edits came in
+
+  // Objects not baked yet are always due, the rest when near an edit
+  const SceneData &pose = scene->displayed();
+  QVector<int> objects;
+  for (int i = 0; i < pose.size(); i++)
+    if (everything || i >= baked.size() || baked[i].isEmpty() || (!pending.isEmpty() && isNearEdit(scene->objectRegion(i))))
+      objects.append(i);
+  pending.clear();
+  everything = false;
+  if (objects.isEmpty())
+    return;
+
+  removedWhileBaking.clear();
+  emit started(QString("Baking lighting of %1 objects").arg(objects.size()));
+  watcher.setFuture(QtConcurrent::run(runBake, SceneData(pose), objects, settings));
+}
+
+BakeResult LightingBaker::runBake(SceneData pose, QVector<int> objects, BakeSettings settings)
+{
+  TRACE_SCOPE("LightingBaker::runBake");
+  QElapsedTimer timer;
+  timer.start();
+  SceneBvh bvh(pose);
+  MemoryCharge treeCharge(LightingMemory, bvh.memoryUsage());
+  BakeResult result;
+  result.objects = objects;
+  result.colors = bakeObjects(pose, bvh, objects, settings);
+  result.msec = timer.elapsed();
+  return result;
+}
+
+void LightingBaker::bakeFinished()
+{
+  TRACE_SCOPE("LightingBaker::bakeFinished");
+  BakeResult result = watcher.result();
+  if (!enabled)
+    return;
+
+  // Follow the removals made meanwhile; a removed object's result is dropped
+  int count = scene->data().size();
+  if (baked.size() < count)
+    baked.resize(count);
+  for (int k = 0; k < result.objects.size(); k++)
+  {
+    int index = result.objects[k];
+    for (int r = 0; r < removedWhileBaking.size() && index >= 0; r++)
+    {
+      if (index == removedWhileBaking[r])
+        index = -1;
+      else if (index > removedWhileBaking[r])
+        index--;
+    }
+    if (index >= 0 && index < count)
+      baked[index] = result.colors[k];
+  }
+  removedWhileBaking.clear();
+  charge.resize(bakedMemoryUsage(baked));
+
+  emit colorsChanged();
+  emit finished(QString("Baked lighting of %1 objects (%2 ms)").arg(result.objects.size()).arg(result.msec));
+  if (everything || !pending.isEmpty())
+    start();
+}
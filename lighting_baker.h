@@ -0,0 +1,69 @@
+#pragma once
+
+#include <QtCore>
+#include <QFutureWatcher>
+#include "lighting_bake.h"
+#include "memory_stats.h"
+#include "scene.h"
+
+struct BakeResult
+{
+  QVector<int> objects;
+  BakedColors colors;
+  qint64 msec;
+};
+
+// Keeps the scene's lighting baked while enabled (lighting_bake.h). The
+// first bake covers every object; after that, edits only re-bake the
+// objects near them: those within the occlusion distance of an edited
+// region, and those whose way to the light passes through it. Bakes run on
+// worker threads against a snapshot of the posed scene; animation playback
+// does not re-bake. Lives on the UI thread.
+class LightingBaker : public QObject
+{
+
+  Q_OBJECT
+
+public:
+  LightingBaker(Scene *scene);
+  ~LightingBaker();
+
+  bool isEnabled() const { return enabled; }
+
+  // Cheap to copy, for the render threads
+  const BakedColors &colors() const { return baked; }
+
+  // Called by the scene as it changes
+  void edited(const SceneRegion &region);
+  void objectRemoved(int index);
+
+public slots:
+  void setEnabled(bool enabled);
+
+signals:
+  void colorsChanged();
+  void started(QString text);
+  void finished(QString report);
+
+private slots:
+  void start();
+  void bakeFinished();
+
+private:
+  static BakeResult runBake(SceneData pose, QVector<int> objects, BakeSettings settings);
+  bool isNearEdit(const SceneRegion &object) const;
+
+  Scene *scene;
+  bool enabled;
+  BakeSettings settings;
+  BakedColors baked;
+  MemoryCharge charge;
+
+  // Edits since the last bake started; too many become "everything"
+  QVector<SceneRegion> pending;
+  bool everything;
+  QTimer *delay; // Collects the edits of a drag before baking
+
+  QFutureWatcher<BakeResult> watcher;
+  QVector<int> removedWhileBaking; // To move the results to the objects' new indices
+};
@@ -1,10 +1,79 @@
 #include "viewer.h"
+#include "farm_coordinator.h"
+#include "farm_worker.h"
+#include <cstdio>
 
 int main(int argc, char *argv[])
 {
+#if QT_VERSION >= 0x040800
+	// GLViewer renders from its own thread
+	QApplication::setAttribute(Qt::AA_X11InitThreads);
+#endif
 	QApplication app(argc, argv);
+	QThread::currentThread()->setObjectName("UI"); // Thread name in traces
+
+	QStringList args = app.arguments();
+
+	// --farm-worker name index is a render farm worker, started by --farm
+	int flag = args.indexOf("--farm-worker");
+	if (flag != -1)
+	{
+		FarmWorker worker;
+		if (flag + 2 >= args.size() || !worker.start(args.at(flag + 1), args.at(flag + 2).toInt()))
+			return 1;
+		return app.exec();
+	}
+
+	// --farm jobs [--workers n] renders the jobs on worker processes, without a window
+	flag = args.indexOf("--farm");
+	if (flag != -1)
+	{
+		int workers = QThread::idealThreadCount();
+		int workersFlag = args.indexOf("--workers");
+		bool ok = flag + 1 < args.size();
+		if (ok && workersFlag != -1)
+			workers = workersFlag + 1 < args.size() ? args.at(workersFlag + 1).toInt(&ok) : 0;
+		if (!ok || workers < 1)
+		{
+			fprintf(stderr, "usage: %s --farm jobs [--workers n]\n", argv[0]);
+			return 1;
+		}
+		FarmCoordinator coordinator;
+		if (!coordinator.start(args.at(flag + 1), workers))
+			return 1;
+		return app.exec();
+	}
+
+	// --generate kind:count[:seed] starts with a procedural stress scene
+	GeneratorParams params;
+	bool generate = false;
+	flag = args.indexOf("--generate");
+	if (flag != -1)
+	{
+		if (flag + 1 >= args.size() || !parseGeneratorSpec(args.at(flag + 1), params))
+		{
+			fprintf(stderr, "usage: %s [--generate grid|scatter|fractal|city:count[:seed]] [--serve [name]] [--farm jobs [--workers n]]\n", argv[0]);
+			return 1;
+		}
+		generate = true;
+	}
+
+	// --serve [name] accepts scripted edits on a local socket
+	QString serverName;
+	flag = args.indexOf("--serve");
+	if (flag != -1)
+	{
+		serverName = CommandProtocol::defaultServerName();
+		if (flag + 1 < args.size() && !args.at(flag + 1).startsWith("--"))
+			serverName = args.at(flag + 1);
+	}
+
 	Viewer *window = new Viewer;
 
 	window->show();
+	if (!serverName.isEmpty() && !window->startCommandServer(serverName))
+		fprintf(stderr, "could not listen on %s\n", serverName.toLocal8Bit().constData());
+	if (generate)
+		window->generate(params.kind, params.count, params.seed);
 	return app.exec();
 }
@@ -0,0 +1,81 @@
+#include "memory_stats.h"
+#include <atomic>
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+static std::atomic<qint64> charged[MemorySubsystems];
+static std::atomic<qint64> peakCharged[MemorySubsystems];
+
+static void charge(MemorySubsystem subsystem, qint64 bytes)
+{
+  qint64 now = charged[subsystem].fetch_add(bytes, std::memory_order_relaxed) + bytes;
+  qint64 peak = peakCharged[subsystem].load(std::memory_order_relaxed);
+  while (now > peak && !peakCharged[subsystem].compare_exchange_weak(peak, now, std::memory_order_relaxed))
+    ;
+}
+
+MemoryCharge::MemoryCharge(MemorySubsystem subsystem, qint64 bytes) : subsystem(subsystem), bytes(bytes)
+{
+  charge(subsystem, bytes);
+}
+
+MemoryCharge::~MemoryCharge()
+{
+  charge(subsystem, -bytes);
+}
+
+void MemoryCharge::resize(qint64 newBytes)
+{
+  charge(subsystem, newBytes - bytes);
+  bytes = newBytes;
+}
+
+qint64 chargedMemory(MemorySubsystem subsystem)
+{
+  return charged[subsystem].load(std::memory_order_relaxed);
+}
+
+qint64 peakChargedMemory(MemorySubsystem subsystem)
+{
+  return peakCharged[subsystem].load(std::memory_order_relaxed);
+}
+
+ProcessMemory processMemory()
+{
+  ProcessMemory memory = { 0, 0 };
+#ifdef Q_OS_LINUX
+  // Second field is the resident set in pages
+  QFile statm("/proc/self/statm");
+  if (statm.open(QIODevice::ReadOnly))
+  {
+    QList<QByteArray> fields = statm.readAll().split(' ');
+    if (fields.size() > 1)
+      memory.resident = fields[1].toLongLong() * sysconf(_SC_PAGESIZE);
+  }
+#endif
+#ifdef Q_OS_UNIX
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0)
+  {
+#ifdef Q_OS_MAC
+    memory.peakResident = usage.ru_maxrss; // Bytes on macOS
+#else
+    memory.peakResident = (qint64)usage.ru_maxrss * 1024;
+#endif
+  }
+#endif
+  return memory;
+}
+
+QString formatBytes(qint64 bytes)
+{
+  if (bytes < 1024)
+    return QString::number(bytes) + " B";
+  if (bytes < 1024 * 1024)
+    return QString::number(bytes / 1024.0, 'f', 1) + " KB";
+  if (bytes < 1024LL * 1024 * 1024)
+    return QString::number(bytes / (1024.0 * 1024.0), 'f', 1) + " MB";
+  return QString::number(bytes / (1024.0 * 1024.0 * 1024.0), 'f', 2) + " GB";
+}
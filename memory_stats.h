@@ -0,0 +1,41 @@
+#pragma once
+
+#include <QtCore>
+
+// Memory accounting for the status bar. Long-lived stores (the scene, the
+// object list) are measured on demand; other buffers charge their
+// subsystem with a MemoryCharge for as long as they are held, from any
+// thread.
+enum MemorySubsystem { SceneMemory, MeshMemory, RenderMemory, StreamMemory, ObjectListMemory, IoMemory, LightingMemory, InterferenceMemory, MemorySubsystems };
+
+class MemoryCharge
+{
+public:
+  explicit MemoryCharge(MemorySubsystem subsystem, qint64 bytes = 0);
+  ~MemoryCharge();
+
+  // Changes the charge to bytes, e.g. as a buffer grows
+  void resize(qint64 bytes);
+
+private:
+  Q_DISABLE_COPY(MemoryCharge)
+
+  MemorySubsystem subsystem;
+  qint64 bytes;
+};
+
+// Bytes currently charged, and the most ever charged at once
+qint64 chargedMemory(MemorySubsystem subsystem);
+qint64 peakChargedMemory(MemorySubsystem subsystem);
+
+// Resident set of the whole process and its high-water mark; zero where
+// the platform does not tell
+struct ProcessMemory
+{
+  qint64 resident;
+  qint64 peakResident;
+};
+ProcessMemory processMemory();
+
+// "12.3 MB" and friends
+QString formatBytes(qint64 bytes);
@@ -0,0 +1,161 @@
+#include "mesh_buffers.h"
+#include "primitive_geometry.h"
+#include "trace.h"
+
+static QMutex sharedMutex;
+static MeshBuffers *sharedBuffers = 0;
+static int sharedUsers = 0;
+
+MeshBuffers *MeshBuffers::acquire()
+{
+  QMutexLocker locker(&sharedMutex);
+  if (!sharedBuffers)
+    sharedBuffers = new MeshBuffers;
+  sharedUsers++;
+  return sharedBuffers;
+}
+
+void MeshBuffers::release()
+{
+  QMutexLocker locker(&sharedMutex);
+  if (--sharedUsers > 0)
+    return;
+  sharedBuffers->vertexBuffer.destroy();
+  sharedBuffers->indexBuffer.destroy();
+  delete sharedBuffers;
+  sharedBuffers = 0;
+}
+
+// Positions then normals of each type in one buffer, indices in another
+MeshBuffers::MeshBuffers() : vertexBuffer(QGLBuffer::VertexBuffer), indexBuffer(QGLBuffer::IndexBuffer), charge(MeshMemory)
+{
+  valid = vertexBuffer.create() && indexBuffer.create();
+  if (!valid)
+    return;
+
+  int vertexBytes = 0, indexBytes = 0;
+  for (int type = 0; type < 7; type++)
+  {
+    const MeshData &mesh = primitiveMesh(type);
+    positionOffset[type] = vertexBytes;
+    normalOffset[type] = vertexBytes + mesh.vertexCount * 3 * sizeof(float);
+    vertexBytes += 2 * mesh.vertexCount * 3 * sizeof(float);
+    indexOffset[type] = indexBytes;
+    indexBytes += mesh.indexCount * sizeof(unsigned short);
+  }
+
+  vertexBuffer.bind();
+  vertexBuffer.allocate(vertexBytes);
+  indexBuffer.bind();
+  indexBuffer.allocate(indexBytes);
+  charge.resize(vertexBytes + indexBytes);
+  for (int type = 0; type < 7; type++)
+  {
+    const MeshData &mesh = primitiveMesh(type);
+    vertexBuffer.write(positionOffset[type], mesh.positions, mesh.vertexCount * 3 * sizeof(float));
+    vertexBuffer.write(normalOffset[type], mesh.normals, mesh.vertexCount * 3 * sizeof(float));
+    indexBuffer.write(indexOffset[type], mesh.indices, mesh.indexCount * sizeof(unsigned short));
+  }
+  unbind();
+}
+
+void MeshBuffers::bind()
+{
+  vertexBuffer.bind();
+  indexBuffer.bind();
+}
+
+void MeshBuffers::unbind()
+{
+  vertexBuffer.release();
+  indexBuffer.release();
+}
+
+/**************/
+/* LOD LEVELS */
+/**************/
+
+LodBuffers::LodBuffers() : vertexBuffer(QGLBuffer::VertexBuffer), indexBuffer(QGLBuffer::IndexBuffer), charge(MeshMemory)
+{
+  valid = false;
+}
+
+// Everything is uploaded again whenever a chain arrives, which happens
+// seven times at most
+bool LodBuffers::update()
+{
+  bool arrived = false;
+  for (int type = 0; type < 7; type++)
+  {
+    if (chains[type])
+      continue;
+    chains[type] = MeshLodCache::instance().chain(primitiveMesh(type));
+    arrived = arrived || !chains[type].isNull();
+  }
+  if (!arrived)
+    return false;
+
+  TRACE_SCOPE("LodBuffers::update");
+  if (!vertexBuffer.isCreated())
+    valid = vertexBuffer.create() && indexBuffer.create();
+  if (!valid)
+    return true;
+
+  int vertexBytes = 0, indexBytes = 0;
+  for (int type = 0; type < 7; type++)
+    for (int level = 1; level < levelCount(type); level++)
+    {
+      const IndexedMesh &mesh = chains[type]->levels[level];
+      positionOffset[type][level] = vertexBytes;
+      normalOffset[type][level] = vertexBytes + mesh.positions.size() * sizeof(float);
+      vertexBytes += (mesh.positions.size() + mesh.normals.size()) * sizeof(float);
+      indexOffset[type][level] = indexBytes;
+      indexBytes += mesh.indices.size() * sizeof(unsigned short);
+    }
+
+  vertexBuffer.bind();
+  vertexBuffer.allocate(qMax(vertexBytes, 1));
+  indexBuffer.bind();
+  indexBuffer.allocate(qMax(indexBytes, 1));
+  charge.resize(vertexBytes + indexBytes);
+  for (int type = 0; type < 7; type++)
+    for (int level = 1; level < levelCount(type); level++)
+    {
+      const IndexedMesh &mesh = chains[type]->levels[level];
+      vertexBuffer.write(positionOffset[type][level], mesh.positions.data(), mesh.positions.size() * sizeof(float));
+      vertexBuffer.write(normalOffset[type][level], mesh.normals.data(), mesh.normals.size() * sizeof(float));
+      indexBuffer.write(indexOffset[type][level], mesh.indices.data(), mesh.indices.size() * sizeof(unsigned short));
+    }
+  vertexBuffer.release();
+  indexBuffer.release();
+  return true;
+}
+
+void LodBuffers::destroy()
+{
+  vertexBuffer.destroy();
+  indexBuffer.destroy();
+  valid = false;
+  charge.resize(0);
+  for (int type = 0; type < 7; type++)
+    chains[type].clear();
+}
+
+void LodBuffers::bind(int type, int level)
+{
+  const IndexedMesh &mesh = chains[type]->levels[level];
+  if (valid)
+  {
+    vertexBuffer.bind();
+    indexBuffer.bind();
+  }
+  glVertexPointer(3, GL_FLOAT, 0, valid ? (const void *)positionOffset[type][level] : mesh.positions.data());
+  glNormalPointer(GL_FLOAT, 0, valid ? (const void *)normalOffset[type][level] : mesh.normals.data());
+}
+
+void LodBuffers::draw(int type, int level)
+{
+  const IndexedMesh &mesh = chains[type]->levels[level];
+  glDrawElements(GL_TRIANGLES, (int)mesh.indices.size(), GL_UNSIGNED_SHORT,
+                 valid ? (const void *)indexOffset[type][level] : mesh.indices.data());
+}
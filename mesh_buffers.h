@@ -0,0 +1,73 @@
+#pragma once
+
+#include <QtCore>
+#include <QGLBuffer>
+#include "memory_stats.h"
+#include "mesh_lod.h"
+
+// The primitive meshes in GL buffer objects. All viewports' contexts are in
+// one share group, so the meshes are uploaded once and every render thread
+// draws from the same buffers.
+class MeshBuffers
+{
+public:
+  // Both need a context of the share group current on the calling thread;
+  // the last release deletes the buffers
+  static MeshBuffers *acquire();
+  static void release();
+
+  // False if buffer objects are not supported; draw from client memory then
+  bool isValid() const { return valid; }
+
+  void bind();
+  void unbind();
+
+  // Offsets into the bound buffers, for the gl*Pointer calls and glDrawElements
+  const void *positions(int type) const { return (const void *)positionOffset[type]; }
+  const void *normals(int type) const { return (const void *)normalOffset[type]; }
+  const void *indices(int type) const { return (const void *)indexOffset[type]; }
+
+private:
+  MeshBuffers();
+
+  QGLBuffer vertexBuffer;
+  QGLBuffer indexBuffer;
+  size_t positionOffset[7], normalOffset[7], indexOffset[7];
+  bool valid;
+  MemoryCharge charge; // The buffers' bytes, as the driver holds a copy
+};
+
+// The coarser levels of the primitives' LOD chains (mesh_lod.h), for one
+// render thread. The chains arrive while the views are drawing, so every
+// thread uploads them to buffers of its own context; they are small, and
+// that is simpler than handing uploads between contexts. Without buffer
+// objects the levels are drawn from the chains' arrays.
+class LodBuffers
+{
+public:
+  LodBuffers();
+
+  // Asks for the chains still missing and uploads any that have arrived;
+  // true if one did. Needs the render thread's context current.
+  bool update();
+  void destroy();
+
+  // 1 until the type's chain has arrived
+  int levelCount(int type) const { return chains[type] ? chains[type]->levelCount() : 1; }
+  double error(int type, int level) const { return chains[type]->errors[level]; }
+  int triangles(int type, int level) const { return chains[type]->levels[level].triangleCount(); }
+
+  // Levels 1 and up; the buffers stay bound until the mesh buffers are
+  void bind(int type, int level);
+  void draw(int type, int level);
+
+private:
+  Q_DISABLE_COPY(LodBuffers)
+
+  MeshLodChainPtr chains[7];
+  QGLBuffer vertexBuffer;
+  QGLBuffer indexBuffer;
+  size_t positionOffset[7][MeshLodChain::MaxLevels], normalOffset[7][MeshLodChain::MaxLevels], indexOffset[7][MeshLodChain::MaxLevels];
+  bool valid;
+  MemoryCharge charge;
+};
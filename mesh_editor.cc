@@ -0,0 +1,142 @@
+#include "mesh_editor.h"
+#include "trace.h"
+
+static const char *const primitiveNames[7] = { "plane", "cube", "sphere", "cone", "cylinder", "pyramid", "wedge" };
+
+MeshEditor::MeshEditor(Scene *scene) : QObject(scene), scene(scene)
+{
+  editedObject = -1;
+  subdivisionLevel = 3;
+}
+
+// Objects that are meshes already are edited as saved; others are
+// converted, and are meshes from then on
+void MeshEditor::edit(int object)
+{
+  TRACE_SCOPE("MeshEditor::edit");
+  const SceneData &data = scene->data();
+  if (object < 0 || object >= data.size())
+    object = -1;
+  if (object == editedObject)
+    return;
+  if (object < 0)
+  {
+    endSession();
+    return;
+  }
+
+  HalfEdgeMesh converted;
+  int level = subdivisionLevel;
+  const MeshObject *mesh = data.meshes.find(object);
+  if (mesh)
+  {
+    converted = mesh->cage;
+    level = mesh->level;
+  }
+  else
+  {
+    int type = qBound(0, data.objects[object], 6);
+    if (!converted.buildPrimitive(type))
+    {
+      emit updated(QString("Could not convert the %1 into a mesh").arg(primitiveNames[type]));
+      return;
+    }
+  }
+  editedObject = object;
+  subdivisionLevel = level;
+  controlMesh = converted;
+  rebuild();
+}
+
+void MeshEditor::setLevel(int level)
+{
+  level = qBound(0, level, (int)SubdivisionSurface::MaxLevels);
+  if (level == subdivisionLevel)
+    return;
+  subdivisionLevel = level;
+  if (editedObject >= 0)
+    rebuild();
+}
+
+void MeshEditor::moveVertex(int vertex, double x, double y, double z)
+{
+  TRACE_SCOPE("MeshEditor::moveVertex");
+  if (editedObject < 0 || vertex < 0 || vertex >= controlMesh.vertexCount())
+    return;
+  QElapsedTimer timer;
+  timer.start();
+  controlMesh.setPosition(vertex, x, y, z);
+  subdivision.update(controlMesh, std::vector<int>(1, vertex));
+  scene->setMesh(editedObject, controlMesh, subdivisionLevel, subdivision.mesh());
+  emit updated(QString("Moved vertex %1: %2 of %3 surface vertices updated in %4 ms").arg(vertex)
+               .arg(subdivision.evaluatedVertices()).arg(subdivision.mesh().vertexCount()).arg(timer.nsecsElapsed() / 1000000.0, 0, 'f', 1));
+}
+
+void MeshEditor::extrudeFace(int face, double distance)
+{
+  if (editedObject < 0)
+    return;
+  if (!controlMesh.extrudeFace(face, distance))
+  {
+    emit updated(QString("Could not extrude face %1").arg(face));
+    return;
+  }
+  rebuild();
+}
+
+void MeshEditor::removeFace(int face)
+{
+  if (editedObject < 0)
+    return;
+  if (!controlMesh.removeFace(face))
+  {
+    emit updated(QString("Could not remove face %1: the faces around one of its vertices would no longer meet").arg(face));
+    return;
+  }
+  rebuild();
+}
+
+void MeshEditor::revert()
+{
+  if (editedObject < 0)
+    return;
+  int object = editedObject;
+  endSession();
+  scene->removeMesh(object);
+  emit updated(QString("Object %1 is its primitive again").arg(object));
+}
+
+// The stencils depend on the cage's topology and the level
+void MeshEditor::rebuild()
+{
+  TRACE_SCOPE("MeshEditor::rebuild");
+  QElapsedTimer timer;
+  timer.start();
+  subdivision.setCage(controlMesh, subdivisionLevel);
+  scene->setMesh(editedObject, controlMesh, subdivisionLevel, subdivision.mesh());
+  emit updated(QString("Mesh of %1 vertices and %2 faces, subdivided to %3 faces in %4 ms").arg(controlMesh.vertexCount())
+               .arg(controlMesh.faceCount()).arg(surfaceFaces()).arg(timer.elapsed()));
+  emit cageChanged();
+}
+
+// The mesh stays in the scene; only the stencils go
+void MeshEditor::endSession()
+{
+  editedObject = -1;
+  controlMesh = HalfEdgeMesh();
+  subdivision.setCage(controlMesh, 0);
+  emit cageChanged();
+}
+
+// Before the scene removes the object, and its mesh with it
+void MeshEditor::objectRemoved(int index)
+{
+  if (index > editedObject)
+    return;
+  if (index < editedObject)
+  {
+    editedObject--;
+    return;
+  }
+  endSession();
+}
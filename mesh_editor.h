@@ -0,0 +1,57 @@
+#pragma once
+
+#include <QtCore>
+#include "half_edge_mesh.h"
+#include "scene.h"
+#include "subdivision_surface.h"
+
+// Edits one object of the scene as a mesh (scene_meshes.h). An object
+// edited for the first time becomes a mesh: its primitive is converted to
+// a cage (half_edge_mesh.h) of vertices and faces to move, extrude and
+// remove, and the views draw the cage's Catmull-Clark surface in its
+// place. The cage is in the object's own space, so the object's transform,
+// color and keys still apply. Every edit goes straight into the scene, to
+// be saved with it; ending the session or editing another object keeps
+// the mesh, and only revert() turns it back into its primitive.
+//
+// The editor keeps the stencils of the edited cage, so moving a vertex
+// re-evaluates only the part of the surface it shapes; topology edits and
+// level changes rebuild them. Lives on the UI thread.
+class MeshEditor : public QObject
+{
+
+  Q_OBJECT
+
+public:
+  MeshEditor(Scene *scene);
+
+  int object() const { return editedObject; } // -1 while none is edited
+  const HalfEdgeMesh &cage() const { return controlMesh; }
+  int level() const { return subdivisionLevel; }
+  int surfaceFaces() const { return subdivision.faceCount(); }
+
+  // Called by the scene before it removes an object
+  void objectRemoved(int index);
+
+public slots:
+  void edit(int object); // -1 ends the session
+  void setLevel(int level);
+  void moveVertex(int vertex, double x, double y, double z);
+  void extrudeFace(int face, double distance);
+  void removeFace(int face);
+  void revert(); // The edited object back to its primitive; ends the session
+
+signals:
+  void cageChanged(); // Another object, topology or level
+  void updated(QString report);
+
+private:
+  void rebuild();
+  void endSession();
+
+  Scene *scene;
+  int editedObject;
+  int subdivisionLevel;
+  HalfEdgeMesh controlMesh;
+  SubdivisionSurface subdivision;
+};
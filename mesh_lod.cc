@@ -0,0 +1,91 @@
+#include "mesh_lod.h"
+#include <QtConcurrentRun>
+#include <cmath>
+#include "mesh_simplifier.h"
+#include "trace.h"
+
+// Triangle share each level aims for, and the most it may stray from the
+// level before, over the diagonal of the mesh's bounds
+static const double levelRatios[MeshLodChain::MaxLevels - 1] = { 0.5, 0.25, 0.1, 0.02 };
+static const double levelErrors[MeshLodChain::MaxLevels - 1] = { 0.003, 0.006, 0.02, 0.06 };
+
+// A level that saves less than this share of the one before isn't kept
+static const double minimumSaving = 0.1;
+
+MeshLodCache &MeshLodCache::instance()
+{
+  static MeshLodCache cache;
+  return cache;
+}
+
+// FNV-1a over the arrays
+quint64 MeshLodCache::contentHash(const MeshData &mesh)
+{
+  quint64 hash = 14695981039346656037ULL;
+  const uchar *arrays[3] = { (const uchar *)mesh.positions, (const uchar *)mesh.normals, (const uchar *)mesh.indices };
+  size_t sizes[3] = { mesh.vertexCount * 3 * sizeof(float), mesh.vertexCount * 3 * sizeof(float), mesh.indexCount * sizeof(unsigned short) };
+  for (int a = 0; a < 3; a++)
+    for (size_t i = 0; i < sizes[a]; i++)
+      hash = (hash ^ arrays[a][i]) * 1099511628211ULL;
+  return hash;
+}
+
+MeshLodChainPtr MeshLodCache::chain(const MeshData &mesh)
+{
+  quint64 hash = contentHash(mesh);
+  QMutexLocker locker(&mutex);
+  QHash<quint64, MeshLodChainPtr>::const_iterator found = chains.constFind(hash);
+  if (found != chains.constEnd())
+    return found.value();
+  if (!building.contains(hash))
+  {
+    // The caller's arrays need not outlive the build
+    building.insert(hash);
+    QtConcurrent::run(build, this, hash, IndexedMesh(mesh));
+  }
+  return MeshLodChainPtr();
+}
+
+void MeshLodCache::build(MeshLodCache *cache, quint64 hash, IndexedMesh mesh)
+{
+  TRACE_SCOPE("MeshLodCache::build");
+  MeshLodChain *chain = new MeshLodChain;
+  chain->levels.push_back(mesh);
+  chain->errors.push_back(0.0);
+
+  double low[3] = { 0.0, 0.0, 0.0 }, high[3] = { 0.0, 0.0, 0.0 };
+  for (int v = 0; v < mesh.vertexCount(); v++)
+    for (int a = 0; a < 3; a++)
+    {
+      low[a] = v == 0 ? mesh.positions[a] : qMin(low[a], (double)mesh.positions[v * 3 + a]);
+      high[a] = v == 0 ? mesh.positions[a] : qMax(high[a], (double)mesh.positions[v * 3 + a]);
+    }
+  double diagonal = sqrt((high[0] - low[0]) * (high[0] - low[0]) + (high[1] - low[1]) * (high[1] - low[1]) +
+                         (high[2] - low[2]) * (high[2] - low[2]));
+
+  // Each level from the one before, so their errors add up
+  int triangles = mesh.triangleCount();
+  for (int level = 0; level < MeshLodChain::MaxLevels - 1; level++)
+  {
+    const IndexedMesh &previous = chain->levels.back();
+    double error = 0.0;
+    IndexedMesh simplified = simplifyMesh(previous, qMax(1, (int)(triangles * levelRatios[level])), levelErrors[level] * diagonal, &error);
+    if (simplified.triangleCount() == 0 || simplified.triangleCount() > (1.0 - minimumSaving) * previous.triangleCount())
+      continue;
+    optimizeMesh(simplified);
+    chain->errors.push_back(chain->errors.back() + error);
+    chain->levels.push_back(simplified);
+  }
+
+  qint64 bytes = 0;
+  for (int level = 0; level < chain->levelCount(); level++)
+  {
+    const IndexedMesh &m = chain->levels[level];
+    bytes += (m.positions.size() + m.normals.size()) * sizeof(float) + m.indices.size() * sizeof(unsigned short);
+  }
+  chain->charge.resize(bytes);
+
+  QMutexLocker locker(&cache->mutex);
+  cache->chains.insert(hash, MeshLodChainPtr(chain));
+  cache->building.remove(hash);
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <QtCore>
+#include <QSharedPointer>
+#include <vector>
+#include "mesh_optimizer.h"
+#include "memory_stats.h"
+
+// Levels of detail of a mesh. Level 0 is the mesh itself; each further
+// level is simplified from the one before it (mesh_simplifier.h) towards
+// 50, 25, 10 and 2% of the triangles, as far as that is possible within
+// an error budget, and optimized for the vertex cache. Never changed once
+// built, so render threads can share it.
+struct MeshLodChain
+{
+  enum { MaxLevels = 5 };
+
+  std::vector<IndexedMesh> levels;
+  std::vector<double> errors; // How far each level strays from level 0, in mesh units
+  MemoryCharge charge;
+
+  MeshLodChain() : charge(MeshMemory) {}
+  int levelCount() const { return (int)levels.size(); }
+};
+typedef QSharedPointer<const MeshLodChain> MeshLodChainPtr;
+
+// Process-wide store of LOD chains, keyed by mesh content so that equal
+// meshes share one chain. Chains are built on the global thread pool;
+// chain() never waits for one.
+class MeshLodCache
+{
+public:
+  static MeshLodCache &instance();
+
+  static quint64 contentHash(const MeshData &mesh);
+
+  // The chain if it is built; otherwise null, and the build is started
+  // unless it already runs. Safe from any thread.
+  MeshLodChainPtr chain(const MeshData &mesh);
+
+private:
+  MeshLodCache() {}
+  Q_DISABLE_COPY(MeshLodCache)
+
+  static void build(MeshLodCache *cache, quint64 hash, IndexedMesh mesh);
+
+  QMutex mutex;
+  QHash<quint64, MeshLodChainPtr> chains;
+  QSet<quint64> building;
+};
@@ -0,0 +1,232 @@
+#include "mesh_optimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <map>
+
+IndexedMesh::IndexedMesh(const MeshData &mesh)
+  : positions(mesh.positions, mesh.positions + mesh.vertexCount * 3),
+    normals(mesh.normals, mesh.normals + mesh.vertexCount * 3),
+    indices(mesh.indices, mesh.indices + mesh.indexCount)
+{
+}
+
+MeshData IndexedMesh::data() const
+{
+  MeshData data = { positions.data(), normals.data(), indices.data(), vertexCount(), (int)indices.size() };
+  return data;
+}
+
+/********/
+/* WELD */
+/********/
+
+void weldVertices(IndexedMesh &mesh)
+{
+  // Vertices are equal when their quantized attributes are
+  typedef std::vector<long> Key;
+  std::map<Key, int> welded;
+  std::vector<int> remap(mesh.vertexCount());
+  IndexedMesh out;
+  for (int v = 0; v < mesh.vertexCount(); v++)
+  {
+    Key key(6);
+    for (int a = 0; a < 3; a++)
+    {
+      key[a] = lround(mesh.positions[v * 3 + a] * 65536.0);
+      key[3 + a] = lround(mesh.normals[v * 3 + a] * 65536.0);
+    }
+    std::map<Key, int>::iterator found = welded.find(key);
+    if (found == welded.end())
+    {
+      found = welded.insert(std::make_pair(key, out.vertexCount())).first;
+      out.positions.insert(out.positions.end(), &mesh.positions[v * 3], &mesh.positions[v * 3] + 3);
+      out.normals.insert(out.normals.end(), &mesh.normals[v * 3], &mesh.normals[v * 3] + 3);
+    }
+    remap[v] = found->second;
+  }
+
+  // Triangles that lost an edge to the weld are dropped
+  for (int t = 0; t < mesh.triangleCount(); t++)
+  {
+    int a = remap[mesh.indices[t * 3]], b = remap[mesh.indices[t * 3 + 1]], c = remap[mesh.indices[t * 3 + 2]];
+    if (a == b || b == c || a == c)
+      continue;
+    out.indices.push_back(a);
+    out.indices.push_back(b);
+    out.indices.push_back(c);
+  }
+  std::swap(mesh, out);
+}
+
+/****************/
+/* VERTEX CACHE */
+/****************/
+
+static const int scoreCacheSize = 32;
+
+// Vertex score of Forsyth's "Linear-Speed Vertex Cache Optimisation": high
+// for vertices just used, and for vertices with few triangles left so that
+// none are left stranded
+static float vertexScore(int cachePosition, int remaining)
+{
+  if (remaining == 0)
+    return -1.0f;
+  float score = 0.0f;
+  if (cachePosition >= 0)
+  {
+    // The last triangle's vertices score a little lower so that the next
+    // triangle doesn't just reuse its edge in a thin strip
+    if (cachePosition < 3)
+      score = 0.75f;
+    else
+      score = powf(1.0f - (float)(cachePosition - 3) / (scoreCacheSize - 3), 1.5f);
+  }
+  return score + 2.0f * powf((float)remaining, -0.5f);
+}
+
+void optimizeVertexCache(std::vector<unsigned short> &indices, int vertexCount)
+{
+  int triangles = (int)indices.size() / 3;
+  if (triangles < 2)
+    return;
+
+  // Triangles of each vertex, in one array
+  std::vector<int> remaining(vertexCount, 0), firstTriangle(vertexCount + 1, 0), vertexTriangles(indices.size());
+  for (size_t i = 0; i < indices.size(); i++)
+    remaining[indices[i]]++;
+  for (int v = 0; v < vertexCount; v++)
+    firstTriangle[v + 1] = firstTriangle[v] + remaining[v];
+  std::vector<int> fill(firstTriangle.begin(), firstTriangle.end() - 1);
+  for (size_t i = 0; i < indices.size(); i++)
+    vertexTriangles[fill[indices[i]]++] = (int)i / 3;
+
+  std::vector<int> cachePosition(vertexCount, -1);
+  std::vector<float> score(vertexCount), triangleScore(triangles);
+  std::vector<bool> emitted(triangles, false);
+  for (int v = 0; v < vertexCount; v++)
+    score[v] = vertexScore(-1, remaining[v]);
+  for (int t = 0; t < triangles; t++)
+    triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+
+  std::vector<int> cache, nextCache;
+  std::vector<unsigned short> out;
+  out.reserve(indices.size());
+  int best = (int)(std::max_element(triangleScore.begin(), triangleScore.end()) - triangleScore.begin());
+  int scan = 0; // Fallback search resumes here; everything before is emitted
+  while (best >= 0)
+  {
+    emitted[best] = true;
+    for (int k = 0; k < 3; k++)
+    {
+      int v = indices[best * 3 + k];
+      out.push_back(v);
+
+      // Take the triangle out of the vertex's list
+      int *list = &vertexTriangles[firstTriangle[v]];
+      int *end = list + remaining[v];
+      *std::find(list, end, best) = *(end - 1);
+      remaining[v]--;
+    }
+
+    // The triangle's vertices move to the front, the rest shift back
+    nextCache.assign(&indices[best * 3], &indices[best * 3] + 3);
+    for (size_t i = 0; i < cache.size(); i++)
+      if (std::find(nextCache.begin(), nextCache.begin() + 3, cache[i]) == nextCache.begin() + 3)
+        nextCache.push_back(cache[i]);
+    std::swap(cache, nextCache);
+
+    // Rescore what is in the cache, and what just fell out of it
+    for (size_t i = 0; i < cache.size(); i++)
+    {
+      int v = cache[i];
+      cachePosition[v] = i < (size_t)scoreCacheSize ? (int)i : -1;
+      score[v] = vertexScore(cachePosition[v], remaining[v]);
+    }
+    best = -1;
+    float bestScore = -1.0f;
+    for (size_t i = 0; i < cache.size(); i++)
+    {
+      int v = cache[i];
+      for (int j = 0; j < remaining[v]; j++)
+      {
+        int t = vertexTriangles[firstTriangle[v] + j];
+        triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+        if (triangleScore[t] > bestScore)
+        {
+          best = t;
+          bestScore = triangleScore[t];
+        }
+      }
+    }
+    if (cache.size() > (size_t)scoreCacheSize)
+      cache.resize(scoreCacheSize);
+
+    // Nothing left next to the cache; start over from any triangle
+    if (best < 0)
+    {
+      while (scan < triangles && emitted[scan])
+        scan++;
+      if (scan < triangles)
+        best = scan;
+    }
+  }
+  indices.swap(out);
+}
+
+/****************/
+/* VERTEX FETCH */
+/****************/
+
+void optimizeVertexFetch(IndexedMesh &mesh)
+{
+  std::vector<int> remap(mesh.vertexCount(), -1);
+  IndexedMesh out;
+  out.indices.reserve(mesh.indices.size());
+  for (size_t i = 0; i < mesh.indices.size(); i++)
+  {
+    int v = mesh.indices[i];
+    if (remap[v] < 0)
+    {
+      remap[v] = out.vertexCount();
+      out.positions.insert(out.positions.end(), &mesh.positions[v * 3], &mesh.positions[v * 3] + 3);
+      out.normals.insert(out.normals.end(), &mesh.normals[v * 3], &mesh.normals[v * 3] + 3);
+    }
+    out.indices.push_back(remap[v]);
+  }
+  std::swap(mesh, out);
+}
+
+/**********/
+/* REPORT */
+/**********/
+
+double vertexCacheMissRatio(const unsigned short *indices, int indexCount, int cacheSize)
+{
+  if (indexCount < 3)
+    return 0.0;
+  std::vector<int> fifo(cacheSize, -1);
+  int head = 0, misses = 0;
+  for (int i = 0; i < indexCount; i++)
+  {
+    if (std::find(fifo.begin(), fifo.end(), (int)indices[i]) != fifo.end())
+      continue;
+    misses++;
+    fifo[head] = indices[i];
+    head = (head + 1) % cacheSize;
+  }
+  return (double)misses / (indexCount / 3);
+}
+
+MeshReport optimizeMesh(IndexedMesh &mesh)
+{
+  MeshReport report;
+  report.verticesBefore = mesh.vertexCount();
+  report.acmrBefore = vertexCacheMissRatio(mesh.indices.data(), (int)mesh.indices.size());
+  weldVertices(mesh);
+  optimizeVertexCache(mesh.indices, mesh.vertexCount());
+  optimizeVertexFetch(mesh);
+  report.triangles = mesh.triangleCount();
+  report.verticesAfter = mesh.vertexCount();
+  report.acmrAfter = vertexCacheMissRatio(mesh.indices.data(), (int)mesh.indices.size());
+  return report;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vector>
+#include "primitive_geometry.h"
+
+// Indexed triangle mesh that owns its arrays, for meshes built or changed
+// at run time. data() views it like the compile-time tables.
+struct IndexedMesh
+{
+  std::vector<float> positions; // xyz per vertex
+  std::vector<float> normals;
+  std::vector<unsigned short> indices;
+
+  IndexedMesh() {}
+  explicit IndexedMesh(const MeshData &mesh);
+
+  int vertexCount() const { return (int)positions.size() / 3; }
+  int triangleCount() const { return (int)indices.size() / 3; }
+  MeshData data() const;
+};
+
+// Effect of optimizeMesh
+struct MeshReport
+{
+  int triangles;
+  int verticesBefore, verticesAfter;
+  double acmrBefore, acmrAfter; // Average cache misses per triangle
+};
+
+// Post-transform cache modelled by the report; a FIFO of this size is
+// typical of the hardware we run on
+enum { ReportCacheSize = 16 };
+
+// Merges vertices whose position and normal agree to within 1/65536, such
+// as the seam and pole vertices of the sphere
+void weldVertices(IndexedMesh &mesh);
+
+// Reorders the triangles so that they reuse recently transformed vertices
+// (Forsyth's linear-speed algorithm, scored for a 32 entry LRU cache, which
+// also suits smaller FIFO caches)
+void optimizeVertexCache(std::vector<unsigned short> &indices, int vertexCount);
+
+// Renumbers the vertices in order of first use so fetches walk the vertex
+// arrays forward; unused vertices are dropped
+void optimizeVertexFetch(IndexedMesh &mesh);
+
+// Misses of a FIFO cache of cacheSize vertices per triangle: 3 for no reuse
+// at all, about 0.5 at best for large regular meshes
+double vertexCacheMissRatio(const unsigned short *indices, int indexCount, int cacheSize = ReportCacheSize);
+
+// All of the above in order
+MeshReport optimizeMesh(IndexedMesh &mesh);
@@ -0,0 +1,397 @@
+#include "mesh_simplifier.h"
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <queue>
+
+namespace {
+
+struct Point
+{
+  double x, y, z;
+
+  Point() : x(0.0), y(0.0), z(0.0) {}
+  Point(double x, double y, double z) : x(x), y(y), z(z) {}
+  Point operator+(const Point &p) const { return Point(x + p.x, y + p.y, z + p.z); }
+  Point operator-(const Point &p) const { return Point(x - p.x, y - p.y, z - p.z); }
+  Point operator*(double s) const { return Point(x * s, y * s, z * s); }
+  double dot(const Point &p) const { return x * p.x + y * p.y + z * p.z; }
+  Point cross(const Point &p) const { return Point(y * p.z - z * p.y, z * p.x - x * p.z, x * p.y - y * p.x); }
+  double length() const { return sqrt(dot(*this)); }
+};
+
+// Sum of squared distances to a set of planes, as the symmetric 4x4 matrix
+// of Garland and Heckbert (upper triangle), plus the planes' total weight
+struct Quadric
+{
+  double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+  double weight;
+
+  Quadric() : a2(0), ab(0), ac(0), ad(0), b2(0), bc(0), bd(0), c2(0), cd(0), d2(0), weight(0) {}
+
+  // Plane through p with unit normal n
+  void addPlane(const Point &n, const Point &p, double w)
+  {
+    double d = -n.dot(p);
+    a2 += w * n.x * n.x; ab += w * n.x * n.y; ac += w * n.x * n.z; ad += w * n.x * d;
+    b2 += w * n.y * n.y; bc += w * n.y * n.z; bd += w * n.y * d;
+    c2 += w * n.z * n.z; cd += w * n.z * d;
+    d2 += w * d * d;
+    weight += w;
+  }
+
+  void add(const Quadric &q)
+  {
+    a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad; b2 += q.b2; bc += q.bc; bd += q.bd;
+    c2 += q.c2; cd += q.cd; d2 += q.d2; weight += q.weight;
+  }
+
+  double evaluate(const Point &p) const
+  {
+    double e = a2 * p.x * p.x + 2 * ab * p.x * p.y + 2 * ac * p.x * p.z + 2 * ad * p.x
+             + b2 * p.y * p.y + 2 * bc * p.y * p.z + 2 * bd * p.y
+             + c2 * p.z * p.z + 2 * cd * p.z + d2;
+    return std::max(e, 0.0);
+  }
+
+  // Point of least error; false when the planes don't pin one down
+  bool minimum(Point &p) const
+  {
+    double det = a2 * (b2 * c2 - bc * bc) - ab * (ab * c2 - bc * ac) + ac * (ab * bc - b2 * ac);
+    if (fabs(det) < 1e-12 * weight * weight * weight)
+      return false;
+    p.x = -(ad * (b2 * c2 - bc * bc) - ab * (bd * c2 - bc * cd) + ac * (bd * bc - b2 * cd)) / det;
+    p.y = -(a2 * (bd * c2 - cd * bc) - ad * (ab * c2 - bc * ac) + ac * (ab * cd - bd * ac)) / det;
+    p.z = -(a2 * (b2 * cd - bc * bd) - ab * (ab * cd - bd * ac) + ad * (ab * bc - b2 * ac)) / det;
+    return true;
+  }
+};
+
+struct Collapse
+{
+  double cost;
+  int a, b;
+  int versionA, versionB;
+  Point target;
+
+  bool operator<(const Collapse &c) const { return cost > c.cost; } // Cheapest on top
+};
+
+struct Triangle
+{
+  int v[3];
+  bool alive;
+
+  bool has(int vertex) const { return v[0] == vertex || v[1] == vertex || v[2] == vertex; }
+};
+
+class Simplifier
+{
+public:
+  Simplifier(const IndexedMesh &mesh);
+
+  void run(int targetTriangles, double maxError);
+  IndexedMesh result(double creaseAngle) const;
+  double largestError() const { return largest; }
+
+private:
+  Point faceNormal(const Triangle &t) const;
+  void push(int a, int b);
+  bool canCollapse(const Collapse &c) const;
+  void collapse(const Collapse &c);
+
+  std::vector<Point> points;
+  std::vector<Quadric> quadrics;
+  std::vector<Triangle> triangles;
+  std::vector<std::vector<int> > vertexTriangles;
+  std::vector<int> versions;
+  std::vector<bool> removed;
+  std::priority_queue<Collapse> queue;
+  int liveTriangles;
+  double largest;
+};
+
+Simplifier::Simplifier(const IndexedMesh &mesh)
+{
+  largest = 0.0;
+
+  // Weld by position only
+  std::map<std::vector<long>, int> welded;
+  std::vector<int> remap(mesh.vertexCount());
+  for (int v = 0; v < mesh.vertexCount(); v++)
+  {
+    std::vector<long> key(3);
+    for (int a = 0; a < 3; a++)
+      key[a] = lround(mesh.positions[v * 3 + a] * 65536.0);
+    std::map<std::vector<long>, int>::iterator found = welded.find(key);
+    if (found == welded.end())
+    {
+      found = welded.insert(std::make_pair(key, (int)points.size())).first;
+      points.push_back(Point(mesh.positions[v * 3], mesh.positions[v * 3 + 1], mesh.positions[v * 3 + 2]));
+    }
+    remap[v] = found->second;
+  }
+  quadrics.resize(points.size());
+  vertexTriangles.resize(points.size());
+  versions.assign(points.size(), 0);
+  removed.assign(points.size(), false);
+
+  std::map<std::pair<int, int>, int> edgeUses;
+  for (int t = 0; t < mesh.triangleCount(); t++)
+  {
+    Triangle tri;
+    for (int k = 0; k < 3; k++)
+      tri.v[k] = remap[mesh.indices[t * 3 + k]];
+    tri.alive = true;
+    if (tri.v[0] == tri.v[1] || tri.v[1] == tri.v[2] || tri.v[0] == tri.v[2])
+      continue;
+
+    // Planes weighted by area, so small slivers count for little
+    Point n = faceNormal(tri);
+    double area = 0.5 * n.length();
+    if (area > 0.0)
+      for (int k = 0; k < 3; k++)
+        quadrics[tri.v[k]].addPlane(n * (0.5 / area), points[tri.v[k]], area);
+    for (int k = 0; k < 3; k++)
+    {
+      vertexTriangles[tri.v[k]].push_back((int)triangles.size());
+      edgeUses[std::make_pair(std::min(tri.v[k], tri.v[(k + 1) % 3]), std::max(tri.v[k], tri.v[(k + 1) % 3]))]++;
+    }
+    triangles.push_back(tri);
+  }
+  liveTriangles = (int)triangles.size();
+
+  // Open edges are held in place by a steep plane along them
+  for (size_t t = 0; t < triangles.size(); t++)
+  {
+    const Triangle &tri = triangles[t];
+    Point n = faceNormal(tri);
+    for (int k = 0; k < 3; k++)
+    {
+      int a = tri.v[k], b = tri.v[(k + 1) % 3];
+      if (edgeUses[std::make_pair(std::min(a, b), std::max(a, b))] != 1)
+        continue;
+      Point edge = points[b] - points[a];
+      Point side = edge.cross(n);
+      double length = side.length();
+      if (length <= 0.0)
+        continue;
+      side = side * (1.0 / length);
+      double w = 100.0 * edge.dot(edge);
+      quadrics[a].addPlane(side, points[a], w);
+      quadrics[b].addPlane(side, points[b], w);
+    }
+  }
+
+  for (std::map<std::pair<int, int>, int>::const_iterator e = edgeUses.begin(); e != edgeUses.end(); ++e)
+    push(e->first.first, e->first.second);
+}
+
+// Twice the area long
+Point Simplifier::faceNormal(const Triangle &t) const
+{
+  return (points[t.v[1]] - points[t.v[0]]).cross(points[t.v[2]] - points[t.v[0]]);
+}
+
+void Simplifier::push(int a, int b)
+{
+  Quadric q = quadrics[a];
+  q.add(quadrics[b]);
+
+  // The optimum where it exists, else the better of the ends and the middle
+  Collapse c;
+  c.a = a;
+  c.b = b;
+  c.versionA = versions[a];
+  c.versionB = versions[b];
+  Point candidates[3] = { points[a], points[b], (points[a] + points[b]) * 0.5 };
+  c.target = candidates[0];
+  c.cost = q.evaluate(candidates[0]);
+  for (int i = 1; i < 3; i++)
+  {
+    double cost = q.evaluate(candidates[i]);
+    if (cost < c.cost)
+    {
+      c.cost = cost;
+      c.target = candidates[i];
+    }
+  }
+  Point optimum;
+  if (q.minimum(optimum) && q.evaluate(optimum) < c.cost)
+  {
+    c.cost = q.evaluate(optimum);
+    c.target = optimum;
+  }
+  c.cost = q.weight > 0.0 ? sqrt(c.cost / q.weight) : 0.0; // As a distance
+  queue.push(c);
+}
+
+bool Simplifier::canCollapse(const Collapse &c) const
+{
+  // Neighbours shared by a and b must all be across a triangle on the edge,
+  // or the collapse would pinch the surface
+  std::vector<int> aNeighbours, shared;
+  int edgeTriangles = 0;
+  for (size_t i = 0; i < vertexTriangles[c.a].size(); i++)
+  {
+    const Triangle &t = triangles[vertexTriangles[c.a][i]];
+    edgeTriangles += t.has(c.b);
+    for (int k = 0; k < 3; k++)
+      if (t.v[k] != c.a)
+        aNeighbours.push_back(t.v[k]);
+  }
+  std::sort(aNeighbours.begin(), aNeighbours.end());
+  aNeighbours.erase(std::unique(aNeighbours.begin(), aNeighbours.end()), aNeighbours.end());
+  for (size_t i = 0; i < vertexTriangles[c.b].size(); i++)
+  {
+    const Triangle &t = triangles[vertexTriangles[c.b][i]];
+    for (int k = 0; k < 3; k++)
+      if (t.v[k] != c.b && t.v[k] != c.a && std::binary_search(aNeighbours.begin(), aNeighbours.end(), t.v[k]))
+        shared.push_back(t.v[k]);
+  }
+  std::sort(shared.begin(), shared.end());
+  shared.erase(std::unique(shared.begin(), shared.end()), shared.end());
+  if ((int)shared.size() != edgeTriangles || edgeTriangles == 0)
+    return false;
+
+  // No triangle that stays may turn over
+  const int ends[2] = { c.a, c.b };
+  for (int e = 0; e < 2; e++)
+  {
+    for (size_t i = 0; i < vertexTriangles[ends[e]].size(); i++)
+    {
+      const Triangle &t = triangles[vertexTriangles[ends[e]][i]];
+      if (t.has(c.a) && t.has(c.b))
+        continue;
+      Triangle moved = t;
+      for (int k = 0; k < 3; k++)
+        if (moved.v[k] == ends[e])
+          moved.v[k] = -1;
+      Point p[3];
+      for (int k = 0; k < 3; k++)
+        p[k] = moved.v[k] < 0 ? c.target : points[moved.v[k]];
+      Point before = faceNormal(t), after = (p[1] - p[0]).cross(p[2] - p[0]);
+      if (after.dot(before) <= 0.2 * before.length() * after.length())
+        return false;
+    }
+  }
+  return true;
+}
+
+// b goes away, a moves to the target
+void Simplifier::collapse(const Collapse &c)
+{
+  points[c.a] = c.target;
+  quadrics[c.a].add(quadrics[c.b]);
+  for (size_t i = 0; i < vertexTriangles[c.b].size(); i++)
+  {
+    int index = vertexTriangles[c.b][i];
+    Triangle &t = triangles[index];
+    if (t.has(c.a))
+    {
+      // Triangles on the edge collapse to nothing
+      t.alive = false;
+      liveTriangles--;
+      for (int k = 0; k < 3; k++)
+      {
+        if (t.v[k] == c.b)
+          continue;
+        std::vector<int> &list = vertexTriangles[t.v[k]];
+        list.erase(std::find(list.begin(), list.end(), index));
+      }
+      continue;
+    }
+    for (int k = 0; k < 3; k++)
+      if (t.v[k] == c.b)
+        t.v[k] = c.a;
+    vertexTriangles[c.a].push_back(index);
+  }
+  vertexTriangles[c.b].clear();
+  removed[c.b] = true;
+  versions[c.a]++;
+  largest = std::max(largest, c.cost);
+
+  std::vector<int> neighbours;
+  for (size_t i = 0; i < vertexTriangles[c.a].size(); i++)
+    for (int k = 0; k < 3; k++)
+      if (triangles[vertexTriangles[c.a][i]].v[k] != c.a)
+        neighbours.push_back(triangles[vertexTriangles[c.a][i]].v[k]);
+  std::sort(neighbours.begin(), neighbours.end());
+  neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+  for (size_t i = 0; i < neighbours.size(); i++)
+    push(c.a, neighbours[i]);
+}
+
+void Simplifier::run(int targetTriangles, double maxError)
+{
+  while (liveTriangles > targetTriangles && !queue.empty())
+  {
+    Collapse c = queue.top();
+    if (c.cost > maxError)
+      break;
+    queue.pop();
+    if (removed[c.a] || removed[c.b] || versions[c.a] != c.versionA || versions[c.b] != c.versionB)
+      continue; // Stale
+    if (canCollapse(c))
+      collapse(c);
+  }
+}
+
+IndexedMesh Simplifier::result(double creaseAngle) const
+{
+  double creaseCos = cos(creaseAngle * M_PI / 180.0);
+  std::vector<Point> normals(triangles.size());
+  for (size_t t = 0; t < triangles.size(); t++)
+    if (triangles[t].alive)
+      normals[t] = faceNormal(triangles[t]);
+
+  // A vertex per position and distinct corner normal
+  IndexedMesh out;
+  std::map<std::pair<int, std::vector<long> >, int> corners;
+  for (size_t t = 0; t < triangles.size(); t++)
+  {
+    if (!triangles[t].alive)
+      continue;
+    Point own = normals[t] * (1.0 / std::max(normals[t].length(), 1e-30));
+    for (int k = 0; k < 3; k++)
+    {
+      int v = triangles[t].v[k];
+      Point sum;
+      for (size_t i = 0; i < vertexTriangles[v].size(); i++)
+      {
+        const Point &other = normals[vertexTriangles[v][i]];
+        if (other.dot(own) >= creaseCos * other.length())
+          sum = sum + other;
+      }
+      Point n = sum * (1.0 / std::max(sum.length(), 1e-30));
+      std::vector<long> key(3);
+      key[0] = lround(n.x * 65536.0);
+      key[1] = lround(n.y * 65536.0);
+      key[2] = lround(n.z * 65536.0);
+      std::map<std::pair<int, std::vector<long> >, int>::iterator found = corners.find(std::make_pair(v, key));
+      if (found == corners.end())
+      {
+        found = corners.insert(std::make_pair(std::make_pair(v, key), out.vertexCount())).first;
+        out.positions.push_back(points[v].x);
+        out.positions.push_back(points[v].y);
+        out.positions.push_back(points[v].z);
+        out.normals.push_back(n.x);
+        out.normals.push_back(n.y);
+        out.normals.push_back(n.z);
+      }
+      out.indices.push_back(found->second);
+    }
+  }
+  return out;
+}
+
+} // namespace
+
+IndexedMesh simplifyMesh(const IndexedMesh &mesh, int targetTriangles, double maxError, double *error, double creaseAngle)
+{
+  Simplifier simplifier(mesh);
+  simplifier.run(targetTriangles, maxError);
+  if (error)
+    *error = simplifier.largestError();
+  return simplifier.result(creaseAngle);
+}
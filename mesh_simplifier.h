@@ -0,0 +1,17 @@
+#pragma once
+
+#include "mesh_optimizer.h"
+
+// Quadric error metric simplification (Garland and Heckbert): collapses
+// the edge whose merged vertex strays least from the planes of its
+// original triangles, again and again, until the mesh is down to
+// targetTriangles or the next collapse would move the surface by more
+// than maxError.
+//
+// Vertices are welded by position first, so hard edges don't split the
+// surface; the normals are rebuilt afterwards, smooth across edges flatter
+// than creaseAngle degrees and hard across sharper ones. Collapses that
+// would flip a triangle or pinch the surface are skipped. error, if given,
+// receives the largest distance any collapse moved the surface by.
+IndexedMesh simplifyMesh(const IndexedMesh &mesh, int targetTriangles, double maxError, double *error = 0,
+                         double creaseAngle = 60.0);
@@ -0,0 +1,78 @@
+#include "object_list_model.h"
+
+ObjectListModel::ObjectListModel(QObject *parent) : QAbstractListModel(parent)
+{
+}
+
+int ObjectListModel::rowCount(const QModelIndex &parent) const
+{
+  return parent.isValid() ? 0 : rows.size();
+}
+
+QVariant ObjectListModel::data(const QModelIndex &index, int role) const
+{
+  if (!index.isValid() || index.row() >= rows.size() || (role != Qt::DisplayRole && role != Qt::EditRole))
+    return QVariant();
+  return names.at(rows.at(index.row()));
+}
+
+bool ObjectListModel::setData(const QModelIndex &index, const QVariant &value, int role)
+{
+  if (!index.isValid() || index.row() >= rows.size() || role != Qt::EditRole)
+    return false;
+  rows[index.row()] = nameId(value.toString());
+  emit dataChanged(index, index);
+  return true;
+}
+
+Qt::ItemFlags ObjectListModel::flags(const QModelIndex &index) const
+{
+  return QAbstractListModel::flags(index) | Qt::ItemIsEditable;
+}
+
+bool ObjectListModel::removeRows(int row, int count, const QModelIndex &parent)
+{
+  if (parent.isValid() || row < 0 || count <= 0 || row + count > rows.size())
+    return false;
+  beginRemoveRows(parent, row, row + count - 1);
+  rows.remove(row, count);
+  endRemoveRows();
+  return true;
+}
+
+void ObjectListModel::appendRows(const QString &name, int count)
+{
+  if (count <= 0)
+    return;
+  int id = nameId(name);
+  beginInsertRows(QModelIndex(), rows.size(), rows.size() + count - 1);
+  rows.insert(rows.size(), count, id);
+  endInsertRows();
+}
+
+void ObjectListModel::clear()
+{
+  beginResetModel();
+  rows.clear();
+  names.clear();
+  nameIds.clear();
+  endResetModel();
+}
+
+qint64 ObjectListModel::memoryUsage() const
+{
+  qint64 bytes = (qint64)rows.capacity() * sizeof(int) + (qint64)names.capacity() * sizeof(QString);
+  for (int i = 0; i < names.size(); i++)
+    bytes += names.at(i).capacity() * sizeof(QChar);
+  return bytes + (qint64)nameIds.size() * (sizeof(QString) + sizeof(int) + 2 * sizeof(void *));
+}
+
+int ObjectListModel::nameId(const QString &name)
+{
+  QHash<QString, int>::const_iterator found = nameIds.constFind(name);
+  if (found != nameIds.constEnd())
+    return found.value();
+  names.append(name);
+  nameIds.insert(name, names.size() - 1);
+  return names.size() - 1;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <QtCore>
+#include <QAbstractListModel>
+
+// Object names for the sidebar list, one row per scene object. Rows hold
+// an index into a pool of distinct names instead of a heap item each, so
+// a million "Nameless" objects cost four bytes apiece; renaming interns
+// the new name. The pool is only released by clear().
+class ObjectListModel : public QAbstractListModel
+{
+
+  Q_OBJECT
+
+public:
+  ObjectListModel(QObject *parent = 0);
+
+  int rowCount(const QModelIndex &parent = QModelIndex()) const;
+  QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+  bool setData(const QModelIndex &index, const QVariant &value, int role = Qt::EditRole);
+  Qt::ItemFlags flags(const QModelIndex &index) const;
+  bool removeRows(int row, int count, const QModelIndex &parent = QModelIndex());
+
+  void appendRows(const QString &name, int count);
+  void clear();
+
+  // Heap bytes of the rows and the name pool, roughly
+  qint64 memoryUsage() const;
+
+private:
+  int nameId(const QString &name);
+
+  QVector<int> rows;
+  QVector<QString> names;
+  QHash<QString, int> nameIds;
+};
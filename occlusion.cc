@@ -0,0 +1,250 @@
+#include "occlusion.h"
+#include "scene_math.h"
+#include "trace.h"
+#include <algorithm>
+#include <cmath>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+OcclusionCuller::OcclusionCuller()
+{
+  identityMatrix(viewProj);
+
+  // Allocate the buffer and all pyramid levels once
+  int w = Width, h = Height;
+  while (true)
+  {
+    levelWidths.push_back(w);
+    levelHeights.push_back(h);
+    levels.push_back(std::vector<float>(w * h, 1.0f));
+    if (w == 1 && h == 1)
+      break;
+    w = std::max(1, w / 2);
+    h = std::max(1, h / 2);
+  }
+}
+
+void OcclusionCuller::setViewProjection(const double matrix[16])
+{
+  for (int i = 0; i < 16; i++)
+    viewProj[i] = matrix[i];
+}
+
+void OcclusionCuller::clearOccluders()
+{
+  occluders.clear();
+}
+
+void OcclusionCuller::addOccluder(const double model[16], const float boxMin[3], const float boxMax[3])
+{
+  ScreenVertex corners[8];
+  // Occluders crossing the near plane are simply skipped, which is always safe
+  if ((int)occluders.size() < MaxOccluders && projectBox(model, boxMin, boxMax, corners))
+    occluders.push_back(std::vector<ScreenVertex>(corners, corners + 8));
+}
+
+bool OcclusionCuller::projectBox(const double model[16], const float boxMin[3], const float boxMax[3], ScreenVertex out[8]) const
+{
+  double mvp[16];
+  multiplyMatrix(viewProj, model, mvp);
+
+  for (int i = 0; i < 8; i++)
+  {
+    double x = (i & 1) ? boxMax[0] : boxMin[0];
+    double y = (i & 2) ? boxMax[1] : boxMin[1];
+    double z = (i & 4) ? boxMax[2] : boxMin[2];
+
+    double cx = mvp[0] * x + mvp[4] * y + mvp[8] * z + mvp[12];
+    double cy = mvp[1] * x + mvp[5] * y + mvp[9] * z + mvp[13];
+    double cz = mvp[2] * x + mvp[6] * y + mvp[10] * z + mvp[14];
+    double cw = mvp[3] * x + mvp[7] * y + mvp[11] * z + mvp[15];
+    if (cw < 1e-5)
+      return false;
+
+    out[i].x = (cx / cw * 0.5 + 0.5) * Width;
+    out[i].y = (cy / cw * 0.5 + 0.5) * Height;
+    out[i].z = cz / cw * 0.5 + 0.5;
+  }
+  return true;
+}
+
+void OcclusionCuller::rasterize()
+{
+  TRACE_SCOPE("OcclusionCuller::rasterize");
+  std::fill(levels[0].begin(), levels[0].end(), 1.0f);
+
+  // Box faces as corner indices (bit 0 = x, bit 1 = y, bit 2 = z)
+  static const int faces[6][4] = {
+    {0, 2, 3, 1}, {4, 5, 7, 6}, // -z, +z
+    {0, 1, 5, 4}, {2, 6, 7, 3}, // -y, +y
+    {0, 4, 6, 2}, {1, 3, 7, 5}  // -x, +x
+  };
+
+  for (size_t i = 0; i < occluders.size(); i++)
+  {
+    const std::vector<ScreenVertex> &v = occluders[i];
+    for (int f = 0; f < 6; f++)
+    {
+      rasterizeTriangle(v[faces[f][0]], v[faces[f][1]], v[faces[f][2]]);
+      rasterizeTriangle(v[faces[f][0]], v[faces[f][2]], v[faces[f][3]]);
+    }
+  }
+
+  buildPyramid();
+}
+
+void OcclusionCuller::rasterizeTriangle(const ScreenVertex &v0, const ScreenVertex &in1, const ScreenVertex &in2)
+{
+  // Both windings are rasterized, so bring the triangle to counter-clockwise
+  float area = (in1.x - v0.x) * (in2.y - v0.y) - (in1.y - v0.y) * (in2.x - v0.x);
+  if (fabs(area) < 1e-6f)
+    return;
+  const ScreenVertex &v1 = (area > 0.0f) ? in1 : in2;
+  const ScreenVertex &v2 = (area > 0.0f) ? in2 : in1;
+  area = fabs(area);
+
+  int minX = std::max(0, (int)floor(std::min(v0.x, std::min(v1.x, v2.x))));
+  int maxX = std::min((int)Width - 1, (int)ceil(std::max(v0.x, std::max(v1.x, v2.x))));
+  int minY = std::max(0, (int)floor(std::min(v0.y, std::min(v1.y, v2.y))));
+  int maxY = std::min((int)Height - 1, (int)ceil(std::max(v0.y, std::max(v1.y, v2.y))));
+  if (minX > maxX || minY > maxY)
+    return;
+
+  // Edge functions w0 (opposite v0), w1, w2 and their steps along x and y
+  float a0 = v1.y - v2.y, b0 = v2.x - v1.x;
+  float a1 = v2.y - v0.y, b1 = v0.x - v2.x;
+  float a2 = v0.y - v1.y, b2 = v1.x - v0.x;
+
+  // Depth is affine in screen space
+  float invArea = 1.0f / area;
+  float dzdx = (a0 * v0.z + a1 * v1.z + a2 * v2.z) * invArea;
+
+  // Start rows on a multiple of 4 so the SIMD loop covers whole quads
+  int startX = minX & ~3;
+  float *depth = &levels[0][0];
+
+  for (int y = minY; y <= maxY; y++)
+  {
+    float px = startX + 0.5f, py = y + 0.5f;
+    float w0 = (px - v1.x) * a0 + (py - v1.y) * b0;
+    float w1 = (px - v2.x) * a1 + (py - v2.y) * b1;
+    float w2 = (px - v0.x) * a2 + (py - v0.y) * b2;
+    float z = (w0 * v0.z + w1 * v1.z + w2 * v2.z) * invArea;
+    float *row = depth + y * Width;
+
+#ifdef __SSE2__
+    const __m128 steps = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+    __m128 e0 = _mm_add_ps(_mm_set1_ps(w0), _mm_mul_ps(steps, _mm_set1_ps(a0)));
+    __m128 e1 = _mm_add_ps(_mm_set1_ps(w1), _mm_mul_ps(steps, _mm_set1_ps(a1)));
+    __m128 e2 = _mm_add_ps(_mm_set1_ps(w2), _mm_mul_ps(steps, _mm_set1_ps(a2)));
+    __m128 zs = _mm_add_ps(_mm_set1_ps(z), _mm_mul_ps(steps, _mm_set1_ps(dzdx)));
+    __m128 e0Step = _mm_set1_ps(4.0f * a0), e1Step = _mm_set1_ps(4.0f * a1), e2Step = _mm_set1_ps(4.0f * a2);
+    __m128 zStep = _mm_set1_ps(4.0f * dzdx);
+    __m128i xs = _mm_add_epi32(_mm_set1_epi32(startX), _mm_set_epi32(3, 2, 1, 0));
+    const __m128i xStep = _mm_set1_epi32(4);
+    const __m128i lo = _mm_set1_epi32(minX - 1), hi = _mm_set1_epi32(maxX + 1);
+    const __m128 zero = _mm_setzero_ps();
+
+    for (int x = startX; x <= maxX; x += 4)
+    {
+      __m128 inside = _mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_and_ps(_mm_cmpge_ps(e1, zero), _mm_cmpge_ps(e2, zero)));
+      __m128i inRange = _mm_and_si128(_mm_cmpgt_epi32(xs, lo), _mm_cmplt_epi32(xs, hi));
+      __m128 mask = _mm_and_ps(inside, _mm_castsi128_ps(inRange));
+
+      __m128 old = _mm_loadu_ps(row + x);
+      __m128 nearer = _mm_min_ps(old, zs);
+      _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(mask, nearer), _mm_andnot_ps(mask, old)));
+
+      e0 = _mm_add_ps(e0, e0Step);
+      e1 = _mm_add_ps(e1, e1Step);
+      e2 = _mm_add_ps(e2, e2Step);
+      zs = _mm_add_ps(zs, zStep);
+      xs = _mm_add_epi32(xs, xStep);
+    }
+#else
+    for (int x = startX; x <= maxX; x++)
+    {
+      if (x >= minX && w0 >= 0.0f && w1 >= 0.0f && w2 >= 0.0f && z < row[x])
+        row[x] = z;
+      w0 += a0;
+      w1 += a1;
+      w2 += a2;
+      z += dzdx;
+    }
+#endif
+  }
+}
+
+// Every texel keeps the farthest depth of the four below it
+void OcclusionCuller::buildPyramid()
+{
+  for (size_t level = 1; level < levels.size(); level++)
+  {
+    const std::vector<float> &src = levels[level - 1];
+    std::vector<float> &dst = levels[level];
+    int srcW = levelWidths[level - 1], srcH = levelHeights[level - 1];
+    int w = levelWidths[level], h = levelHeights[level];
+
+    for (int y = 0; y < h; y++)
+    {
+      int y0 = 2 * y, y1 = std::min(2 * y + 1, srcH - 1);
+      for (int x = 0; x < w; x++)
+      {
+        int x0 = 2 * x, x1 = std::min(2 * x + 1, srcW - 1);
+        float a = std::max(src[y0 * srcW + x0], src[y0 * srcW + x1]);
+        float b = std::max(src[y1 * srcW + x0], src[y1 * srcW + x1]);
+        dst[y * w + x] = std::max(a, b);
+      }
+    }
+  }
+}
+
+OcclusionRect OcclusionCuller::project(const double model[16], const float boxMin[3], const float boxMax[3]) const
+{
+  OcclusionRect rect;
+  rect.testable = false;
+
+  ScreenVertex corners[8];
+  if (!projectBox(model, boxMin, boxMax, corners))
+    return rect;
+
+  float minX = corners[0].x, maxX = corners[0].x, minY = corners[0].y, maxY = corners[0].y, minZ = corners[0].z;
+  for (int i = 1; i < 8; i++)
+  {
+    minX = std::min(minX, corners[i].x); maxX = std::max(maxX, corners[i].x);
+    minY = std::min(minY, corners[i].y); maxY = std::max(maxY, corners[i].y);
+    minZ = std::min(minZ, corners[i].z);
+  }
+  if (maxX < 0.0f || maxY < 0.0f || minX >= Width || minY >= Height)
+    return rect; // Off screen, not our business
+
+  rect.x0 = std::max(0, (int)floor(minX));
+  rect.y0 = std::max(0, (int)floor(minY));
+  rect.x1 = std::min((int)Width - 1, (int)floor(maxX));
+  rect.y1 = std::min((int)Height - 1, (int)floor(maxY));
+  rect.minDepth = std::max(0.0f, minZ);
+  rect.testable = true;
+  return rect;
+}
+
+bool OcclusionCuller::isVisible(const OcclusionRect &rect) const
+{
+  if (!rect.testable)
+    return true;
+
+  // Pick the level where the rect spans at most a couple of texels
+  int span = std::max(rect.x1 - rect.x0, rect.y1 - rect.y0) + 1;
+  size_t level = 0;
+  while ((span >> level) > 2 && level + 1 < levels.size())
+    level++;
+
+  const std::vector<float> &depth = levels[level];
+  int w = levelWidths[level];
+  for (int y = rect.y0 >> level; y <= (rect.y1 >> level); y++)
+    for (int x = rect.x0 >> level; x <= (rect.x1 >> level); x++)
+      if (depth[y * w + x] >= rect.minDepth)
+        return true;
+  return false;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vector>
+
+// Screen-space footprint of an object's bounding box in the occlusion buffer
+struct OcclusionRect
+{
+  int x0, y0, x1, y1; // Inclusive pixel range
+  float minDepth;     // Nearest depth, 0 (near) .. 1 (far)
+  bool testable;      // False if the box crosses the near plane or leaves the screen
+};
+
+// CPU hierarchical-Z occlusion culling.
+// A handful of large occluders are rasterized into a small depth buffer,
+// which is reduced into a max-depth pyramid. An object is hidden when its
+// nearest depth lies behind every pyramid texel its bounds touch.
+class OcclusionCuller
+{
+public:
+  enum { Width = 256, Height = 128, MaxOccluders = 32 };
+
+  OcclusionCuller();
+
+  // Column-major projection * view matrix for the coming frame
+  void setViewProjection(const double matrix[16]);
+
+  void clearOccluders();
+  void addOccluder(const double model[16], const float boxMin[3], const float boxMax[3]);
+  int occluderCount() const { return (int)occluders.size(); }
+
+  // Rasterize all occluders and build the pyramid; safe to run on a worker
+  // thread as long as the occluder list is left alone meanwhile
+  void rasterize();
+
+  OcclusionRect project(const double model[16], const float boxMin[3], const float boxMax[3]) const;
+  bool isVisible(const OcclusionRect &rect) const;
+
+private:
+  struct ScreenVertex { float x, y, z; };
+
+  bool projectBox(const double model[16], const float boxMin[3], const float boxMax[3], ScreenVertex out[8]) const;
+  void rasterizeTriangle(const ScreenVertex &v0, const ScreenVertex &v1, const ScreenVertex &v2);
+  void buildPyramid();
+
+  double viewProj[16];
+  std::vector<std::vector<ScreenVertex> > occluders; // 8 projected corners each
+  std::vector<std::vector<float> > levels;           // levels[0] is the full resolution buffer
+  std::vector<int> levelWidths, levelHeights;
+};
@@ -0,0 +1,220 @@
+#include "poster_renderer.h"
+#include <QGLPixelBuffer>
+#include <vector>
+#include "memory_stats.h"
+#include "renderer.h"
+#include "scene_math.h"
+#include "trace.h"
+
+static const int posterTileSize = 2048; // Within every driver's framebuffer limits
+static const int maxPosterThreads = 4;  // Contexts drawing tiles at once
+
+// What the tile threads share
+struct PosterJob
+{
+  QString fileName;
+  qint64 headerSize;
+  int columns;
+  int endTile;
+  FrameState frame; // Camera and scene; the tile is filled in per thread
+  const QAtomicInt *cancelled;
+
+  QAtomicInt nextTile;
+  QAtomicInt doneTiles;
+  QAtomicInt failedTiles;
+};
+
+class TileThread : public QThread
+{
+public:
+  TileThread(PosterJob *job, QGLWidget *shareWidget) : job(job), shareWidget(shareWidget)
+  {
+    setObjectName("Poster tiles"); // Thread name in traces
+  }
+
+protected:
+  void run();
+
+private:
+  PosterJob *job;
+  QGLWidget *shareWidget;
+};
+
+// Takes tiles until there are none left; a thread that can't get a
+// context leaves them to the others
+void TileThread::run()
+{
+  TRACE_SCOPE("TileThread::run");
+  QGLPixelBuffer target(posterTileSize, posterTileSize, QGLFormat::defaultFormat(), shareWidget);
+  if (!target.isValid() || !target.makeCurrent())
+    return;
+  QFile file(job->fileName);
+  if (!file.open(QIODevice::ReadWrite))
+    return;
+
+  Renderer renderer;
+  renderer.initialize();
+  glPixelStorei(GL_PACK_ALIGNMENT, 1); // PPM rows are packed RGB
+  std::vector<unsigned char> pixels(posterTileSize * posterTileSize * 3);
+  MemoryCharge charge(IoMemory, pixels.size());
+
+  FrameState frame = job->frame;
+  int width = 0, height = 0;
+  while ((int)*job->cancelled == 0)
+  {
+    int tile = job->nextTile.fetchAndAddRelaxed(1);
+    if (tile >= job->endTile)
+      break;
+    frame.tileX = (tile % job->columns) * posterTileSize;
+    frame.tileY = (tile / job->columns) * posterTileSize;
+    frame.tileWidth = qMin(posterTileSize, frame.width - frame.tileX);
+    frame.tileHeight = qMin(posterTileSize, frame.height - frame.tileY);
+    if (frame.tileWidth != width || frame.tileHeight != height)
+    {
+      width = frame.tileWidth;
+      height = frame.tileHeight;
+      renderer.resize(width, height);
+    }
+    renderer.render(frame);
+    glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, &pixels[0]);
+
+    // GL rows run bottom up
+    TRACE_SCOPE("writeTile");
+    bool ok = true;
+    for (int row = 0; row < height && ok; row++)
+    {
+      qint64 offset = job->headerSize + ((qint64)(frame.tileY + row) * frame.width + frame.tileX) * 3;
+      ok = file.seek(offset) && file.write((const char *)&pixels[(height - 1 - row) * width * 3], width * 3) == width * 3;
+    }
+    if (!ok)
+      job->failedTiles.ref();
+    job->doneTiles.ref();
+  }
+
+  renderer.shutdown();
+  target.doneCurrent();
+}
+
+/************/
+/* RENDERER */
+/************/
+
+PosterRenderer::PosterRenderer(const PosterSettings &settings, const SceneData &scene, const BakedColors &baked,
+                               QGLWidget *shareWidget, QObject *parent)
+  : QThread(parent), settings(settings), scene(scene), baked(baked), shareWidget(shareWidget), cancelled(0)
+{
+  succeeded = false;
+  setObjectName("Poster"); // Thread name in traces
+}
+
+PosterRenderer::~PosterRenderer()
+{
+  cancel();
+  wait();
+}
+
+int PosterRenderer::tileCount() const
+{
+  return tileCount(settings.width, settings.height);
+}
+
+int PosterRenderer::tileCount(int width, int height)
+{
+  return ((width + posterTileSize - 1) / posterTileSize) * ((height + posterTileSize - 1) / posterTileSize);
+}
+
+static QByteArray posterHeader(int width, int height)
+{
+  return QString("P6\n%1 %2\n255\n").arg(width).arg(height).toLatin1();
+}
+
+bool PosterRenderer::createFile(const QString &fileName, int width, int height)
+{
+  QByteArray header = posterHeader(width, height);
+  QFile file(fileName);
+  return file.open(QIODevice::WriteOnly | QIODevice::Truncate) && file.write(header) == header.size()
+         && file.resize(header.size() + (qint64)width * height * 3);
+}
+
+void PosterRenderer::cancel()
+{
+  cancelled = 1;
+}
+
+void PosterRenderer::run()
+{
+  TRACE_SCOPE("PosterRenderer::run");
+  QElapsedTimer timer;
+  timer.start();
+
+  int first = settings.endTile > 0 ? qBound(0, settings.firstTile, tileCount()) : 0;
+  int end = settings.endTile > 0 ? qBound(first, settings.endTile, tileCount()) : tileCount();
+
+  // Every pixel's place is known before any tile is drawn
+  if (settings.endTile == 0 && !createFile(settings.fileName, settings.width, settings.height))
+  {
+    emit rendered("Could not write " + settings.fileName);
+    return;
+  }
+
+  PosterJob job;
+  job.fileName = settings.fileName;
+  job.headerSize = posterHeader(settings.width, settings.height).size();
+  job.columns = (settings.width + posterTileSize - 1) / posterTileSize;
+  job.endTile = end;
+  job.cancelled = &cancelled;
+  job.nextTile = first;
+  job.doneTiles = 0;
+  job.failedTiles = 0;
+
+  FrameState &frame = job.frame;
+  frame.scene = scene;
+  frame.baked = baked;
+  for (int k = 0; k < 3; k++)
+    frame.camPosition[k] = settings.camera.position[k];
+  double right[3];
+  cameraAxes(settings.camera.rotation[0], settings.camera.rotation[1], frame.forwardVec, right, frame.upVec);
+  frame.width = settings.width;
+  frame.height = settings.height;
+  frame.orthographic = false;
+  frame.orthoSize = 1.0;
+  frame.occlusionCulling = true;
+  frame.levelOfDetail = true; // Picked for the whole image's size, so nearly all full detail
+  frame.revision = 0; // Every tile shows this one pose, and each thread's renderer starts with no queue
+
+  // Contexts outside the views' share group can't share the mesh buffers
+  int tiles = end - first, percent = -1;
+  int threadCount = shareWidget ? qBound(1, QThread::idealThreadCount(), maxPosterThreads) : 1;
+  QList<TileThread *> threads;
+  for (int t = 0; t < qMin(tiles, threadCount); t++)
+  {
+    threads.append(new TileThread(&job, shareWidget));
+    threads.last()->start();
+  }
+  for (int t = 0; t < threads.size(); t++)
+  {
+    while (!threads[t]->wait(100))
+    {
+      if ((int)job.doneTiles * 100 / tiles != percent)
+      {
+        percent = (int)job.doneTiles * 100 / tiles;
+        emit progress("Rendering tiles", percent);
+      }
+    }
+    delete threads[t];
+  }
+
+  double seconds = timer.elapsed() / 1000.0;
+  if ((int)cancelled != 0)
+    emit rendered(QString("Poster cancelled after %1 of %2 tiles").arg((int)job.doneTiles).arg(tiles));
+  else if ((int)job.doneTiles < tiles)
+    emit rendered("Could not create offscreen buffers for the poster");
+  else if ((int)job.failedTiles != 0)
+    emit rendered(QString("Could not write %1 of %2 poster tiles to %3").arg((int)job.failedTiles).arg(tiles).arg(settings.fileName));
+  else
+  {
+    succeeded = true;
+    emit rendered(QString("Rendered %1 tiles of a %2 x %3 poster to %4 (%5 s)").arg(tiles).arg(settings.width)
+                  .arg(settings.height).arg(settings.fileName).arg(seconds, 0, 'f', 1));
+  }
+}
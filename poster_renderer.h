@@ -0,0 +1,68 @@
+#pragma once
+
+#include <QtCore>
+#include "camera_path.h"
+#include "lighting_bake.h"
+#include "scene_data.h"
+
+class QGLWidget;
+
+struct PosterSettings
+{
+  QString fileName; // Binary PPM
+  int width;
+  int height;
+  CameraKey camera; // Perspective, as in the view
+
+  // Farm workers draw a range of the tiles, in rows from the top left, into
+  // a file the coordinator made; an endTile of 0 makes the file and draws all
+  int firstTile, endTile;
+
+  PosterSettings() : firstTile(0), endTile(0) {}
+};
+
+// Renders one frame far larger than any framebuffer into a binary PPM
+// file, one tile at a time. Each tile is drawn with its part of the
+// frustum (FrameState::tileX and friends), read back, and written
+// straight to its rows of the file, which is sized up front, so the whole
+// image is never in memory. A few threads, each with a context of its own
+// in the views' share group, take tiles as they come; where the driver
+// serializes drawing, their queue building and occlusion culling still
+// overlap.
+class PosterRenderer : public QThread
+{
+
+  Q_OBJECT
+
+public:
+  PosterRenderer(const PosterSettings &settings, const SceneData &scene, const BakedColors &baked, QGLWidget *shareWidget,
+                 QObject *parent = 0);
+  ~PosterRenderer();
+
+  int tileCount() const; // Of the whole poster
+  static int tileCount(int width, int height);
+
+  // Once rendered() was emitted: every tile asked for was written
+  bool isComplete() const { return succeeded; }
+
+  // Writes the header and sizes the file for every pixel
+  static bool createFile(const QString &fileName, int width, int height);
+
+public slots:
+  void cancel();
+
+signals:
+  void progress(QString phase, int percent);
+  void rendered(QString report);
+
+protected:
+  void run();
+
+private:
+  PosterSettings settings;
+  SceneData scene;
+  BakedColors baked;
+  QGLWidget *shareWidget;
+  QAtomicInt cancelled;
+  bool succeeded;
+};
@@ -0,0 +1,74 @@
+#include "primitive_geometry.h"
+#include "mesh_optimizer.h"
+
+using namespace geometry;
+
+// Everything below is evaluated by the compiler; no trig runs at startup
+static constexpr PlaneTable plane = makePlane();
+static constexpr CubeTable cube = makeCube();
+static constexpr PyramidTable pyramid = makePyramid();
+static constexpr WedgeTable wedge = makeWedge();
+
+static constexpr auto coneCoarse = makeCone<8>();
+static constexpr auto cone = makeCone<16>();
+static constexpr auto coneFine = makeCone<32>();
+static constexpr auto cylinderCoarse = makeCylinder<8>();
+static constexpr auto cylinder = makeCylinder<16>();
+static constexpr auto cylinderFine = makeCylinder<32>();
+static constexpr auto sphereCoarse = makeSphere<8, 8>();
+static constexpr auto sphere = makeSphere<16, 16>();
+static constexpr auto sphereFine = makeSphere<32, 32>();
+
+template <typename Table>
+static MeshData view(const Table &table)
+{
+  MeshData data = { table.positions, table.normals, table.indices, Table::VertexCount, Table::IndexCount };
+  return data;
+}
+
+// The tables as generated, which are laid out for reading rather than for
+// the vertex cache
+static const MeshData &generatedMesh(int type, TessellationLevel level)
+{
+  static const MeshData meshes[TessellationLevels][7] = {
+    { view(plane), view(cube), view(sphereCoarse), view(coneCoarse), view(cylinderCoarse), view(pyramid), view(wedge) },
+    { view(plane), view(cube), view(sphere), view(cone), view(cylinder), view(pyramid), view(wedge) },
+    { view(plane), view(cube), view(sphereFine), view(coneFine), view(cylinderFine), view(pyramid), view(wedge) }
+  };
+  return meshes[level][type];
+}
+
+// Optimized copies of every table, made on first use from any thread
+struct OptimizedPrimitives
+{
+  IndexedMesh meshes[TessellationLevels][7];
+  MeshData views[TessellationLevels][7];
+  MeshReport reports[TessellationLevels][7];
+
+  OptimizedPrimitives()
+  {
+    for (int level = 0; level < TessellationLevels; level++)
+      for (int type = 0; type < 7; type++)
+      {
+        meshes[level][type] = IndexedMesh(generatedMesh(type, (TessellationLevel)level));
+        reports[level][type] = optimizeMesh(meshes[level][type]);
+        views[level][type] = meshes[level][type].data();
+      }
+  }
+};
+
+static const OptimizedPrimitives &optimizedPrimitives()
+{
+  static const OptimizedPrimitives primitives;
+  return primitives;
+}
+
+const MeshData &primitiveMesh(int type, TessellationLevel level)
+{
+  return optimizedPrimitives().views[level][type];
+}
+
+const MeshReport &primitiveMeshReport(int type, TessellationLevel level)
+{
+  return optimizedPrimitives().reports[level][type];
+}
@@ -0,0 +1,274 @@
+#pragma once
+
+// Triangle meshes of the seven built-in primitives, generated at compile
+// time. Curved primitives are templates on their segment count, so another
+// tessellation level is just another instantiation. All meshes fit in the
+// unit box, wind counter-clockwise seen from outside, and keep the axes of
+// the old GLU shapes (cone, cylinder and sphere run along z).
+
+namespace geometry {
+
+constexpr double pi = 3.14159265358979323846;
+
+// Series sin/cos for constant evaluation; x is brought into [-pi, pi] first
+constexpr double wrapAngle(double x)
+{
+  while (x > pi)
+    x -= 2.0 * pi;
+  while (x < -pi)
+    x += 2.0 * pi;
+  return x;
+}
+
+constexpr double sin(double x)
+{
+  x = wrapAngle(x);
+  double term = x, sum = 0.0;
+  for (int k = 0; k < 14; k++)
+  {
+    sum += term;
+    term *= -x * x / ((2 * k + 2) * (2 * k + 3));
+  }
+  return sum;
+}
+
+constexpr double cos(double x)
+{
+  return sin(x + pi / 2.0);
+}
+
+constexpr double sqrt(double x)
+{
+  double r = x > 1.0 ? x : 1.0;
+  for (int i = 0; i < 64; i++)
+    r = 0.5 * (r + x / r);
+  return r;
+}
+
+template <int Vertices, int Indices>
+struct MeshTable
+{
+  enum { VertexCount = Vertices, IndexCount = Indices };
+
+  float positions[Vertices * 3];
+  float normals[Vertices * 3];
+  unsigned short indices[Indices];
+  int vertexFill, indexFill;
+
+  constexpr MeshTable() : positions(), normals(), indices(), vertexFill(0), indexFill(0) {}
+
+  constexpr int vertex(double x, double y, double z, double nx, double ny, double nz)
+  {
+    double len = sqrt(nx * nx + ny * ny + nz * nz);
+    positions[vertexFill * 3 + 0] = x;
+    positions[vertexFill * 3 + 1] = y;
+    positions[vertexFill * 3 + 2] = z;
+    normals[vertexFill * 3 + 0] = nx / len;
+    normals[vertexFill * 3 + 1] = ny / len;
+    normals[vertexFill * 3 + 2] = nz / len;
+    return vertexFill++;
+  }
+
+  constexpr void triangle(int a, int b, int c)
+  {
+    indices[indexFill++] = a;
+    indices[indexFill++] = b;
+    indices[indexFill++] = c;
+  }
+
+  // Corners counter-clockwise around the normal
+  constexpr void quad(const double (&p)[4][3], double nx, double ny, double nz)
+  {
+    int first = vertexFill;
+    for (int i = 0; i < 4; i++)
+      vertex(p[i][0], p[i][1], p[i][2], nx, ny, nz);
+    triangle(first, first + 1, first + 2);
+    triangle(first, first + 2, first + 3);
+  }
+
+  constexpr void tri(const double (&p)[3][3], double nx, double ny, double nz)
+  {
+    int first = vertexFill;
+    for (int i = 0; i < 3; i++)
+      vertex(p[i][0], p[i][1], p[i][2], nx, ny, nz);
+    triangle(first, first + 1, first + 2);
+  }
+
+  // Disc of radius 0.5 at height z facing +z or -z
+  constexpr void cap(int segments, double z, double facing)
+  {
+    int center = vertex(0.0, 0.0, z, 0.0, 0.0, facing);
+    for (int j = 0; j < segments; j++)
+    {
+      double angle = j * 2.0 * pi / segments;
+      vertex(0.5 * cos(angle), 0.5 * sin(angle), z, 0.0, 0.0, facing);
+    }
+    for (int j = 0; j < segments; j++)
+    {
+      int a = center + 1 + j, b = center + 1 + (j + 1) % segments;
+      if (facing > 0.0)
+        triangle(center, a, b);
+      else
+        triangle(center, b, a);
+    }
+  }
+};
+
+typedef MeshTable<4, 6> PlaneTable;
+typedef MeshTable<24, 36> CubeTable;
+typedef MeshTable<16, 18> PyramidTable;
+typedef MeshTable<18, 24> WedgeTable;
+
+constexpr PlaneTable makePlane()
+{
+  PlaneTable m;
+  const double top[4][3] = {{-0.5, 0.0, 0.5}, {0.5, 0.0, 0.5}, {0.5, 0.0, -0.5}, {-0.5, 0.0, -0.5}};
+  m.quad(top, 0.0, 1.0, 0.0);
+  return m;
+}
+
+constexpr CubeTable makeCube()
+{
+  CubeTable m;
+  const double front[4][3] = {{-0.5, -0.5, -0.5}, {-0.5, 0.5, -0.5}, {0.5, 0.5, -0.5}, {0.5, -0.5, -0.5}};
+  const double back[4][3] = {{-0.5, -0.5, 0.5}, {0.5, -0.5, 0.5}, {0.5, 0.5, 0.5}, {-0.5, 0.5, 0.5}};
+  const double right[4][3] = {{0.5, -0.5, -0.5}, {0.5, 0.5, -0.5}, {0.5, 0.5, 0.5}, {0.5, -0.5, 0.5}};
+  const double left[4][3] = {{-0.5, -0.5, 0.5}, {-0.5, 0.5, 0.5}, {-0.5, 0.5, -0.5}, {-0.5, -0.5, -0.5}};
+  const double top[4][3] = {{-0.5, 0.5, 0.5}, {0.5, 0.5, 0.5}, {0.5, 0.5, -0.5}, {-0.5, 0.5, -0.5}};
+  const double bottom[4][3] = {{-0.5, -0.5, -0.5}, {0.5, -0.5, -0.5}, {0.5, -0.5, 0.5}, {-0.5, -0.5, 0.5}};
+  m.quad(front, 0.0, 0.0, -1.0);
+  m.quad(back, 0.0, 0.0, 1.0);
+  m.quad(right, 1.0, 0.0, 0.0);
+  m.quad(left, -1.0, 0.0, 0.0);
+  m.quad(top, 0.0, 1.0, 0.0);
+  m.quad(bottom, 0.0, -1.0, 0.0);
+  return m;
+}
+
+constexpr PyramidTable makePyramid()
+{
+  PyramidTable m;
+  const double bottom[4][3] = {{-0.5, -0.5, -0.5}, {0.5, -0.5, -0.5}, {0.5, -0.5, 0.5}, {-0.5, -0.5, 0.5}};
+  const double right[3][3] = {{0.5, -0.5, 0.5}, {0.5, -0.5, -0.5}, {0.0, 0.5, 0.0}};
+  const double back[3][3] = {{-0.5, -0.5, 0.5}, {0.5, -0.5, 0.5}, {0.0, 0.5, 0.0}};
+  const double left[3][3] = {{-0.5, -0.5, -0.5}, {-0.5, -0.5, 0.5}, {0.0, 0.5, 0.0}};
+  const double front[3][3] = {{0.5, -0.5, -0.5}, {-0.5, -0.5, -0.5}, {0.0, 0.5, 0.0}};
+  m.quad(bottom, 0.0, -1.0, 0.0);
+  m.tri(right, 1.0, 0.5, 0.0);
+  m.tri(back, 0.0, 0.5, 1.0);
+  m.tri(left, -1.0, 0.5, 0.0);
+  m.tri(front, 0.0, 0.5, -1.0);
+  return m;
+}
+
+constexpr WedgeTable makeWedge()
+{
+  WedgeTable m;
+  const double bottom[4][3] = {{-0.5, -0.5, -0.5}, {0.5, -0.5, -0.5}, {0.5, -0.5, 0.5}, {-0.5, -0.5, 0.5}};
+  const double right[4][3] = {{0.5, -0.5, -0.5}, {0.5, 0.5, -0.5}, {0.5, 0.5, 0.5}, {0.5, -0.5, 0.5}};
+  const double slant[4][3] = {{-0.5, -0.5, 0.5}, {0.5, 0.5, 0.5}, {0.5, 0.5, -0.5}, {-0.5, -0.5, -0.5}};
+  const double back[3][3] = {{-0.5, -0.5, 0.5}, {0.5, -0.5, 0.5}, {0.5, 0.5, 0.5}};
+  const double front[3][3] = {{-0.5, -0.5, -0.5}, {0.5, 0.5, -0.5}, {0.5, -0.5, -0.5}};
+  m.quad(bottom, 0.0, -1.0, 0.0);
+  m.quad(right, 1.0, 0.0, 0.0);
+  m.quad(slant, -1.0, 1.0, 0.0);
+  m.tri(back, 0.0, 0.0, 1.0);
+  m.tri(front, 0.0, 0.0, -1.0);
+  return m;
+}
+
+// Side ring vertices plus one apex per segment, so every side has its own normal
+template <int Segments>
+constexpr MeshTable<3 * Segments + 1, 6 * Segments> makeCone()
+{
+  MeshTable<3 * Segments + 1, 6 * Segments> m;
+  for (int j = 0; j < Segments; j++)
+  {
+    double angle = j * 2.0 * pi / Segments;
+    m.vertex(0.5 * cos(angle), 0.5 * sin(angle), -0.5, cos(angle), sin(angle), 0.5);
+  }
+  for (int j = 0; j < Segments; j++)
+  {
+    double angle = (j + 0.5) * 2.0 * pi / Segments;
+    m.vertex(0.0, 0.0, 0.5, cos(angle), sin(angle), 0.5);
+  }
+  for (int j = 0; j < Segments; j++)
+    m.triangle(j, (j + 1) % Segments, Segments + j);
+  m.cap(Segments, -0.5, -1.0);
+  return m;
+}
+
+template <int Segments>
+constexpr MeshTable<4 * Segments + 2, 12 * Segments> makeCylinder()
+{
+  MeshTable<4 * Segments + 2, 12 * Segments> m;
+  for (int j = 0; j < Segments; j++)
+  {
+    double angle = j * 2.0 * pi / Segments;
+    m.vertex(0.5 * cos(angle), 0.5 * sin(angle), -0.5, cos(angle), sin(angle), 0.0);
+    m.vertex(0.5 * cos(angle), 0.5 * sin(angle), 0.5, cos(angle), sin(angle), 0.0);
+  }
+  for (int j = 0; j < Segments; j++)
+  {
+    int a = 2 * j, b = 2 * ((j + 1) % Segments);
+    m.triangle(a, b, b + 1);
+    m.triangle(a, b + 1, a + 1);
+  }
+  m.cap(Segments, 0.5, 1.0);
+  m.cap(Segments, -0.5, -1.0);
+  return m;
+}
+
+// Latitude/longitude sphere of radius 0.5 with the poles on z, like gluSphere
+template <int Slices, int Stacks>
+constexpr MeshTable<(Slices + 1) * (Stacks + 1), 6 * Slices * (Stacks - 1)> makeSphere()
+{
+  MeshTable<(Slices + 1) * (Stacks + 1), 6 * Slices * (Stacks - 1)> m;
+  for (int i = 0; i <= Stacks; i++)
+  {
+    double polar = i * pi / Stacks;
+    for (int j = 0; j <= Slices; j++)
+    {
+      double angle = j * 2.0 * pi / Slices;
+      double x = sin(polar) * cos(angle), y = sin(polar) * sin(angle), z = cos(polar);
+      if (i == 0 || i == Stacks)
+        x = y = 0.0;
+      m.vertex(0.5 * x, 0.5 * y, 0.5 * z, x, y, z);
+    }
+  }
+  for (int i = 0; i < Stacks; i++)
+  {
+    for (int j = 0; j < Slices; j++)
+    {
+      int a = i * (Slices + 1) + j, b = a + Slices + 1;
+      if (i != 0)
+        m.triangle(a, b, a + 1);
+      if (i != Stacks - 1)
+        m.triangle(a + 1, b, b + 1);
+    }
+  }
+  return m;
+}
+
+} // namespace geometry
+
+// Runtime view of one of the tables above
+struct MeshData
+{
+  const float *positions;
+  const float *normals;
+  const unsigned short *indices;
+  int vertexCount;
+  int indexCount;
+};
+
+enum TessellationLevel { CoarseTessellation, DefaultTessellation, FineTessellation, TessellationLevels };
+
+// Mesh of primitive type 0-6 (0 = Plane ... 6 = Wedge); the default level
+// has 16 segments, like the old GLU shapes. The tables above are welded and
+// reordered for the vertex cache (mesh_optimizer.h) on first use.
+const MeshData &primitiveMesh(int type, TessellationLevel level = DefaultTessellation);
+
+// What the optimization did to that mesh
+struct MeshReport;
+const MeshReport &primitiveMeshReport(int type, TessellationLevel level = DefaultTessellation);
@@ -0,0 +1,88 @@
+#include "render_queue.h"
+
+static const int keyBytes = (RenderQueue::MeshBits + RenderQueue::LodBits + RenderQueue::MaterialBits + RenderQueue::DepthBits + 7) / 8;
+static const quint64 stateMask = ~(quint64)0 << RenderQueue::DepthBits;
+
+RenderQueue::RenderQueue() : charge(RenderMemory)
+{
+  clear();
+}
+
+void RenderQueue::clear()
+{
+  keys.clear();
+  indices.clear();
+  lastKey = ~(quint64)0;
+  unsortedChanges = 0;
+}
+
+void RenderQueue::reserve(int count)
+{
+  keys.reserve(count);
+  indices.reserve(count);
+  updateCharge();
+}
+
+void RenderQueue::add(int type, int lod, const double color[3], double depth, int index)
+{
+  quint64 material = 0;
+  for (int c = 0; c < 3; c++)
+    material = (material << 8) | (quint64)qBound(0, (int)(color[c] * 255.0 + 0.5), 255);
+  quint64 bucket = (quint64)(qBound(0.0, depth, 1.0) * ((1 << DepthBits) - 1));
+  quint64 key = ((quint64)type << (DepthBits + MaterialBits + LodBits)) | ((quint64)lod << (DepthBits + MaterialBits)) |
+                (material << DepthBits) | bucket;
+
+  // A mesh or level change also re-sends the color, so any counts as one
+  if ((key & stateMask) != (lastKey & stateMask))
+    unsortedChanges++;
+  lastKey = key;
+
+  keys.push_back(key);
+  indices.push_back(index);
+}
+
+void RenderQueue::sort()
+{
+  int count = size();
+  if (count < 2)
+    return;
+  scratchKeys.resize(count);
+  scratchIndices.resize(count);
+  updateCharge();
+
+  // Histogram every byte in one pass
+  int histogram[keyBytes][256] = {};
+  for (int i = 0; i < count; i++)
+    for (int b = 0; b < keyBytes; b++)
+      histogram[b][(keys[i] >> (8 * b)) & 0xff]++;
+
+  for (int b = 0; b < keyBytes; b++)
+  {
+    // A byte that is the same in every key would not move anything
+    int *counts = histogram[b];
+    if (counts[(keys[0] >> (8 * b)) & 0xff] == count)
+      continue;
+
+    int offset = 0;
+    for (int v = 0; v < 256; v++)
+    {
+      int n = counts[v];
+      counts[v] = offset;
+      offset += n;
+    }
+    for (int i = 0; i < count; i++)
+    {
+      int slot = counts[(keys[i] >> (8 * b)) & 0xff]++;
+      scratchKeys[slot] = keys[i];
+      scratchIndices[slot] = indices[i];
+    }
+    keys.swap(scratchKeys);
+    indices.swap(scratchIndices);
+  }
+}
+
+void RenderQueue::updateCharge()
+{
+  charge.resize((qint64)(keys.capacity() + scratchKeys.capacity()) * sizeof(quint64) +
+                (qint64)(indices.capacity() + scratchIndices.capacity()) * sizeof(int));
+}
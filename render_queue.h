@@ -0,0 +1,53 @@
+#pragma once
+
+#include <QtCore>
+#include <vector>
+#include "memory_stats.h"
+
+// Draw order of a frame. Every object gets a 64-bit sort key, most
+// significant field first:
+//
+//   | unused (18) | mesh (3) | level of detail (3) | material (24) | depth bucket (16) |
+//
+// so after sorting, objects sharing a mesh are drawn together, within a
+// mesh those at the same level of detail, within a level those sharing a
+// color, and within a color front to back. The
+// material is the color quantized to 8 bits per channel, which is exactly
+// what the color picker produces.
+class RenderQueue
+{
+public:
+  enum { DepthBits = 16, MaterialBits = 24, LodBits = 3, MeshBits = 3 };
+
+  RenderQueue();
+
+  void clear();
+  void reserve(int count);
+
+  // Depth is the view distance over the far plane, clamped to [0, 1]
+  void add(int type, int lod, const double color[3], double depth, int index);
+
+  // LSD radix sort on the used bytes of the keys
+  void sort();
+
+  int size() const { return (int)keys.size(); }
+  int index(int i) const { return indices[i]; }
+  int mesh(int i) const { return (int)(keys[i] >> (DepthBits + MaterialBits + LodBits)); }
+  int lod(int i) const { return (int)(keys[i] >> (DepthBits + MaterialBits)) & ((1 << LodBits) - 1); }
+  quint32 material(int i) const { return (quint32)(keys[i] >> DepthBits) & 0xffffff; }
+
+  // Mesh, level and color changes the queued objects would cost in the
+  // order they were added, to compare with what the sorted submission costs
+  int unsortedStateChanges() const { return unsortedChanges; }
+
+private:
+  void updateCharge();
+
+  std::vector<quint64> keys;
+  std::vector<int> indices;
+  std::vector<quint64> scratchKeys;
+  std::vector<int> scratchIndices;
+  quint64 lastKey;
+  int unsortedChanges;
+  MemoryCharge charge;
+};
@@ -0,0 +1,70 @@
+#include "render_thread.h"
+#include <QGLWidget>
+
+RenderThread::RenderThread(QGLWidget *widget) : QThread(widget), widget(widget)
+{
+  hasPending = false;
+  running = true;
+  setObjectName("Render"); // Thread name in traces
+}
+
+// Only an O(1) copy happens under the lock
+void RenderThread::publish(const FrameState &frame)
+{
+  QMutexLocker locker(&mutex);
+  pending = frame;
+  hasPending = true;
+  frameReady.wakeOne();
+}
+
+void RenderThread::stop()
+{
+  {
+    QMutexLocker locker(&mutex);
+    running = false;
+    frameReady.wakeOne();
+  }
+  wait();
+}
+
+void RenderThread::run()
+{
+  widget->makeCurrent();
+  renderer.initialize();
+
+  int width = 0, height = 0;
+  FrameState frame; // Back buffer, only touched by this thread
+  QElapsedTimer frameTimer;
+
+  while (true)
+  {
+    {
+      QMutexLocker locker(&mutex);
+      while (!hasPending && running)
+        frameReady.wait(&mutex);
+      if (!running)
+        break;
+      frame = pending;
+      pending.scene = SceneData(); // Drop our share so UI edits stop detaching
+      hasPending = false;
+    }
+
+    frameTimer.start();
+    if (frame.width != width || frame.height != height)
+    {
+      width = frame.width;
+      height = frame.height;
+      renderer.resize(width, height);
+    }
+    FrameStats stats = renderer.render(frame);
+    widget->swapBuffers();
+    frame.scene = SceneData();
+
+    emit stateChanges(stats.stateChanges, stats.unsortedStateChanges);
+    emit trianglesDrawn(stats.triangles);
+    emit frameRendered(stats.drawn, stats.culled, frameTimer.nsecsElapsed() / 1000000.0, frame.revision);
+  }
+
+  renderer.shutdown();
+  widget->doneCurrent();
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <QtCore>
+#include "renderer.h"
+
+class QGLWidget;
+
+// Renders a QGLWidget's frames on its own thread.
+// The UI thread publishes FrameStates; the thread always draws the newest
+// one and drops any it did not get to, so a slow frame never holds up edits
+// and a burst of edits never queues up frames.
+class RenderThread : public QThread
+{
+
+  Q_OBJECT
+
+public:
+  RenderThread(QGLWidget *widget);
+
+  void publish(const FrameState &frame);
+  void stop();
+
+signals:
+  void frameRendered(int drawn, int culled, double msec, int revision);
+  void stateChanges(int sorted, int unsorted);
+  void trianglesDrawn(int triangles);
+
+protected:
+  void run();
+
+private:
+  QGLWidget *widget;
+  Renderer renderer;
+
+  // Front buffer, written by the UI thread under the mutex
+  QMutex mutex;
+  QWaitCondition frameReady;
+  FrameState pending;
+  bool hasPending;
+  bool running;
+};
@@ -0,0 +1,526 @@
+#include "renderer.h"
+#include <QtConcurrentRun>
+#include <algorithm>
+#include "scene_math.h"
+#include "primitive_geometry.h"
+#include "trace.h"
+
+// Object space bounds of each primitive type, used to test for occlusion
+static const float primitiveBounds[7][2][3] = {
+  {{-0.5f, 0.0f, -0.5f}, {0.5f, 0.0f, 0.5f}},   // Plane
+  {{-0.5f, -0.5f, -0.5f}, {0.5f, 0.5f, 0.5f}},  // Cube
+  {{-0.5f, -0.5f, -0.5f}, {0.5f, 0.5f, 0.5f}},  // Sphere
+  {{-0.5f, -0.5f, -0.5f}, {0.5f, 0.5f, 0.5f}},  // Cone
+  {{-0.5f, -0.5f, -0.5f}, {0.5f, 0.5f, 0.5f}},  // Cylinder
+  {{-0.5f, -0.5f, -0.5f}, {0.5f, 0.5f, 0.5f}},  // Pyramid
+  {{-0.5f, -0.5f, -0.5f}, {0.5f, 0.5f, 0.5f}}   // Wedge
+};
+
+// Largest box fully inside each primitive as drawn; only these may hide
+// other objects. The sphere's facets sag inside its radius, so its box is
+// the cube inside 0.5 * cos^2(pi / 16), not 0.5
+static const float primitiveOccluders[7][2][3] = {
+  {{-0.5f, 0.0f, -0.5f}, {0.5f, 0.0f, 0.5f}},             // Plane
+  {{-0.5f, -0.5f, -0.5f}, {0.5f, 0.5f, 0.5f}},            // Cube
+  {{-0.2776f, -0.2776f, -0.2776f}, {0.2776f, 0.2776f, 0.2776f}}, // Sphere (16 slices and stacks)
+  {{-0.1767f, -0.1767f, -0.5f}, {0.1767f, 0.1767f, 0.0f}}, // Cone (lower half)
+  {{-0.3535f, -0.3535f, -0.5f}, {0.3535f, 0.3535f, 0.5f}}, // Cylinder
+  {{-0.25f, -0.5f, -0.25f}, {0.25f, 0.0f, 0.25f}},        // Pyramid (lower half)
+  {{0.0f, -0.5f, -0.5f}, {0.5f, 0.0f, 0.5f}}              // Wedge (below the slant)
+};
+
+// Projected error, in pixels, a coarser level of detail may show
+static const double maxLodError = 1.0;
+
+// The object's baked colors if they were baked for its mesh, else null
+static const quint8 *bakedColors(const FrameState &frame, int index, int type)
+{
+  if (index >= frame.baked.size())
+    return 0;
+  const QVector<quint8> &colors = frame.baked.at(index);
+  return colors.size() == primitiveMesh(type).vertexCount * 3 ? colors.constData() : 0;
+}
+
+// Baked colors already hold the light, and vary across faces
+static void setBakedLighting(bool baked)
+{
+  if (baked)
+  {
+    glDisable(GL_LIGHTING);
+    glShadeModel(GL_SMOOTH);
+    glEnableClientState(GL_COLOR_ARRAY);
+  }
+  else
+  {
+    glDisableClientState(GL_COLOR_ARRAY);
+    glShadeModel(GL_FLAT);
+    glEnable(GL_LIGHTING);
+  }
+}
+
+Renderer::Renderer()
+{
+  meshes = 0;
+  buffered = false;
+  queued.revision = -1;
+}
+
+static double farPlane(const FrameState &frame)
+{
+  return frame.orthographic ? 1000.0 : 100.0;
+}
+
+// A tile's frustum is the tile's part of the whole frame's near plane (or
+// box), so the tiles of a poster line up exactly
+static void tileMatrix(const FrameState &frame, double projection[16])
+{
+  double zNear = 0.01;
+  double top = frame.orthographic ? frame.orthoSize : zNear * tan(22.5 * M_PI / 180.0);
+  double right = top * frame.width / frame.height;
+  double x0 = -right + 2.0 * right * frame.tileX / frame.width;
+  double x1 = -right + 2.0 * right * (frame.tileX + frame.tileWidth) / frame.width;
+  double y0 = top - 2.0 * top * (frame.tileY + frame.tileHeight) / frame.height;
+  double y1 = top - 2.0 * top * frame.tileY / frame.height;
+  if (frame.orthographic)
+    orthoMatrix(x0, x1, y0, y1, zNear, farPlane(frame), projection);
+  else
+    frustumMatrix(x0, x1, y0, y1, zNear, farPlane(frame), projection);
+}
+
+void frameMatrices(const FrameState &frame, double projection[16], double view[16])
+{
+  double aspect = (double)frame.width / (double)frame.height;
+  if (frame.tileWidth > 0)
+    tileMatrix(frame, projection);
+  else if (frame.orthographic)
+    orthoMatrix(-frame.orthoSize * aspect, frame.orthoSize * aspect, -frame.orthoSize, frame.orthoSize, 0.01, farPlane(frame), projection);
+  else
+    perspectiveMatrix(45, aspect, 0.01, farPlane(frame), projection);
+  lookAtMatrix(frame.camPosition, frame.forwardVec, frame.upVec, view);
+}
+
+void Renderer::initialize()
+{
+  meshes = MeshBuffers::acquire();
+
+  glClearColor(0.8, 0.8, 0.8, 0.0);
+  glShadeModel(GL_FLAT);
+
+  glEnable(GL_DEPTH_TEST);
+  glDepthFunc(GL_LEQUAL);
+  glClearDepth(1.0);
+
+  glEnable(GL_LIGHTING);
+  glEnable(GL_LIGHT0);
+  //glEnable(GL_LIGHT1);
+  glEnable(GL_NORMALIZE);
+
+  // Ambient light
+  float ambientColor[] = {0.2, 0.2, 0.2, 1.0};
+  glLightModelfv(GL_LIGHT_MODEL_AMBIENT, ambientColor);
+
+  // Add positioned light
+  float posLightColor[] = {0.8, 0.8, 0.8, 1.0}; // Diffuse color
+  float posLightSpecular[] = {1.0, 1.0, 1.0, 1.0}; // Specular color
+  float posLightPosition[] = {25, 50.0, 25, 1.0}; // Fourth float dictates that this is a positioned light
+  glLightfv(GL_LIGHT0, GL_DIFFUSE, posLightColor);
+  //glLightfv(GL_LIGHT0, GL_SPECULAR, posLightSpecular);
+  glLightfv(GL_LIGHT0, GL_POSITION,  posLightPosition);
+
+  /*
+  // Add directed light
+  float dirLightColor[] = {0.5, 0.2, 0.2, 1.0};
+  float dirLightPosition[] = {25.0, 50.0, -25.0, 0.0}; // Fourth float dictates that this light is a directed light
+  glLightfv(GL_LIGHT1, GL_DIFFUSE, dirLightColor);
+  glLightfv(GL_LIGHT1, GL_POSITION, dirLightPosition);
+  */
+
+  glEnable(GL_COLOR_MATERIAL);
+  glColorMaterial(GL_FRONT, GL_AMBIENT_AND_DIFFUSE);
+  glMaterialfv(GL_FRONT, GL_SPECULAR, posLightSpecular);
+  glMateriali(GL_FRONT, GL_SHININESS, 128);
+}
+
+// Needs the context current, like initialize
+void Renderer::shutdown()
+{
+  lods.destroy();
+  if (meshes)
+    MeshBuffers::release();
+  meshes = 0;
+}
+
+FrameStats Renderer::render(const FrameState &frame)
+{
+  TRACE_SCOPE("Renderer::render");
+  const SceneData &data = frame.scene;
+
+  // Rasterize the occluders on a worker while this thread sets up the frame
+  QFuture<void> occlusionFuture;
+  bool culling = frame.occlusionCulling && data.size() > 0;
+  if (culling)
+  {
+    prepareOcclusion(frame);
+    occlusionFuture = QtConcurrent::run(&occluder, &OcclusionCuller::rasterize);
+  }
+
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); // Get depth buffer higher??
+
+  // Each view has its own projection, which can change from frame to frame
+  double projection[16], view[16];
+  frameMatrices(frame, projection, view);
+  glMatrixMode(GL_PROJECTION);
+  glLoadMatrixd(projection);
+  glMatrixMode(GL_MODELVIEW);
+  glLoadMatrixd(view);
+
+  // Render floor grid
+  glColor3f(0.4, 0.4, 0.4);
+  for (double i = -5.0; i <= 5.0; i++)
+  {
+    glNormal3f(0.0, 1.0, 0.0);
+    glBegin(GL_LINES);
+    glVertex3f(i, 0.0, 5.0);
+    glVertex3f(i, 0.0, -5.0);
+    glEnd();
+    glBegin(GL_LINES);
+    glVertex3f(5.0, 0.0, i);
+    glVertex3f(-5.0, 0.0, i);
+    glEnd();
+  }
+
+  // Project every object's bounds, then wait for the depth pyramid
+  if (culling)
+  {
+    occlusionRects.resize(data.size());
+    for (int i = 0; i < data.size(); i++)
+    {
+      double model[16];
+      int type = qBound(0, data.objects[i], 6);
+      objectMatrix(data.translates[i].v, data.rotations[i].v, data.scales[i].v, model);
+      occlusionRects[i] = occluder.project(model, primitiveBounds[type][0], primitiveBounds[type][1]);
+    }
+    occlusionFuture.waitForFinished();
+  }
+
+  // Levels of detail are picked when the queue is built, so a chain that
+  // just arrived needs a new queue
+  if (lods.update())
+    queued.revision = -1;
+
+  // Sorted by mesh, then level, then color, then front to back
+  if (queueDirty(frame))
+    buildQueue(frame, view);
+
+  // Render objects (read-only access, the UI thread may share these chunks)
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glEnableClientState(GL_NORMAL_ARRAY);
+  buffered = meshes && meshes->isValid();
+  if (buffered)
+    meshes->bind();
+  int culled = 0, changes = 0, triangles = 0, boundType = -1, boundLod = 0;
+  quint32 boundMaterial = 0;
+  bool bakedMode = false;
+  for (int k = 0; k < queue.size(); k++)
+  {
+    int i = queue.index(k);
+    if (culling && !occluder.isVisible(occlusionRects[i]))
+    {
+      culled++;
+      continue;
+    }
+
+    int type = queue.mesh(k), lod = queue.lod(k);
+    quint32 material = queue.material(k);
+    const quint8 *baked = bakedColors(frame, i, type);
+    if (baked)
+      lod = 0; // Baked per vertex of the full mesh
+    bool meshChanged = type != boundType || lod != boundLod;
+    if (meshChanged)
+      bindMesh(type, lod);
+    if ((baked != 0) != bakedMode)
+    {
+      bakedMode = baked != 0;
+      setBakedLighting(bakedMode);
+      changes++;
+    }
+    if (baked)
+    {
+      // From client memory; the positions keep their buffer
+      QGLBuffer::release(QGLBuffer::VertexBuffer);
+      glColorPointer(3, GL_UNSIGNED_BYTE, 0, baked);
+    }
+    if (meshChanged || material != boundMaterial)
+    {
+      glColor3ub(material >> 16, (material >> 8) & 0xff, material & 0xff);
+      changes++;
+    }
+    boundType = type;
+    boundLod = lod;
+    boundMaterial = material;
+
+    // One matrix load instead of a push, five transforms and a pop
+    double model[16], modelView[16];
+    objectMatrix(data.translates[i].v, data.rotations[i].v, data.scales[i].v, model);
+    multiplyMatrix(view, model, modelView);
+    glLoadMatrixd(modelView);
+    triangles += drawMesh(type, lod);
+  }
+  if (bakedMode)
+    setBakedLighting(false);
+
+  FrameStats stats;
+  stats.drawn = queue.size() - culled;
+  stats.culled = culled;
+  stats.stateChanges = changes;
+  stats.unsortedStateChanges = queue.unsortedStateChanges();
+  stats.triangles = triangles;
+  if (!frame.streamed.isEmpty())
+    drawStreamed(frame, projection, view, stats);
+
+  if (buffered)
+    meshes->unbind();
+  drawMeshSurfaces(frame, view, stats);
+  glLoadMatrixd(view);
+  glDisableClientState(GL_NORMAL_ARRAY);
+  glDisableClientState(GL_VERTEX_ARRAY);
+  return stats;
+}
+
+// Geometry comes from the shared buffers, or straight from the
+// optimized primitive tables without buffer object support; coarser
+// levels come from this thread's LOD buffers
+void Renderer::bindMesh(int type, int lod)
+{
+  if (lod > 0)
+  {
+    lods.bind(type, lod);
+    return;
+  }
+  const MeshData &mesh = primitiveMesh(type);
+  if (buffered)
+    meshes->bind();
+  glVertexPointer(3, GL_FLOAT, 0, buffered ? meshes->positions(type) : mesh.positions);
+  glNormalPointer(GL_FLOAT, 0, buffered ? meshes->normals(type) : mesh.normals);
+}
+
+// Returns the triangles drawn
+int Renderer::drawMesh(int type, int lod)
+{
+  if (lod > 0)
+  {
+    lods.draw(type, lod);
+    return lods.triangles(type, lod);
+  }
+  const MeshData &mesh = primitiveMesh(type);
+  glDrawElements(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_SHORT, buffered ? meshes->indices(type) : mesh.indices);
+  return mesh.indexCount / 3;
+}
+
+// The coarsest level whose error, scaled with the object and projected at
+// its depth, stays under a pixel
+int Renderer::selectLod(const FrameState &frame, int type, const Vec3 &scale, double depth) const
+{
+  int levels = lods.levelCount(type);
+  if (!frame.levelOfDetail || levels < 2)
+    return 0;
+  double pixelsPerUnit = frame.orthographic ? frame.height / (2.0 * frame.orthoSize)
+                                            : frame.height / (2.0 * tan(22.5 * M_PI / 180.0) * qMax(depth, 0.01));
+  double size = qMax(fabs(scale[0]), qMax(fabs(scale[1]), fabs(scale[2]))) * pixelsPerUnit;
+  for (int lod = levels - 1; lod > 0; lod--)
+    if (lods.error(type, lod) * size <= maxLodError)
+      return lod;
+  return 0;
+}
+
+// view * model with a single precision model matrix
+static void streamedModelView(const double view[16], const float model[16], float out[16])
+{
+  for (int col = 0; col < 4; col++)
+    for (int row = 0; row < 4; row++)
+      out[col * 4 + row] = view[row] * model[col * 4] + view[4 + row] * model[col * 4 + 1] +
+                           view[8 + row] * model[col * 4 + 2] + view[12 + row] * model[col * 4 + 3];
+}
+
+// Chunks of a streamed scene. Resident chunks near the focus are drawn
+// object by object in the order they were sorted in when loaded; the rest
+// are drawn as proxy boxes. Both skip chunks outside the frustum.
+void Renderer::drawStreamed(const FrameState &frame, const double projection[16], const double view[16], FrameStats &stats)
+{
+  TRACE_SCOPE("Renderer::drawStreamed");
+  const StreamedView &streamed = frame.streamed;
+  double viewProj[16];
+  multiplyMatrix(projection, view, viewProj);
+
+  int boundType = -1;
+  quint32 boundMaterial = 0;
+  for (int c = 0; c < streamed.resident.size(); c++)
+  {
+    const StreamedChunkInfo &info = streamed.residentInfo[c];
+    if (boxOutsideFrustum(viewProj, info.min, info.max))
+      continue;
+    if (chunkDistance(info, streamed.focus) > streamed.detailDistance)
+    {
+      drawProxy(info, view);
+      boundType = -1;
+      continue;
+    }
+
+    const StreamedChunk &chunk = *streamed.resident[c];
+    for (int k = 0; k < chunk.size(); k++)
+    {
+      int type = chunk.keys[k] >> 24;
+      quint32 material = chunk.keys[k] & 0xffffff;
+      if (type != boundType)
+        bindMesh(type);
+      if (type != boundType || material != boundMaterial)
+      {
+        glColor3ub(material >> 16, (material >> 8) & 0xff, material & 0xff);
+        stats.stateChanges++;
+      }
+      boundType = type;
+      boundMaterial = material;
+
+      float modelView[16];
+      streamedModelView(view, &chunk.matrices[16 * k], modelView);
+      glLoadMatrixf(modelView);
+      stats.triangles += drawMesh(type);
+    }
+    stats.drawn += chunk.size();
+  }
+
+  for (int c = 0; c < streamed.proxies.size(); c++)
+    if (!boxOutsideFrustum(viewProj, streamed.proxies[c].min, streamed.proxies[c].max))
+      drawProxy(streamed.proxies[c], view);
+}
+
+// The cube mesh stretched over the chunk's bounds
+void Renderer::drawProxy(const StreamedChunkInfo &info, const double view[16])
+{
+  double model[16], modelView[16];
+  identityMatrix(model);
+  for (int a = 0; a < 3; a++)
+  {
+    model[a * 5] = qMax(info.max[a] - info.min[a], 1e-3);
+    model[12 + a] = 0.5 * (info.min[a] + info.max[a]);
+  }
+  multiplyMatrix(view, model, modelView);
+  bindMesh(1);
+  glColor3ub(info.color[0], info.color[1], info.color[2]);
+  glLoadMatrixd(modelView);
+  drawMesh(1);
+}
+
+// Objects that are meshes, from client memory, as their surfaces change
+// with every edit; few enough to go without culling or the queue
+void Renderer::drawMeshSurfaces(const FrameState &frame, const double view[16], FrameStats &stats)
+{
+  const SceneData &data = frame.scene;
+  if (data.meshes.isEmpty())
+    return;
+  TRACE_SCOPE("Renderer::drawMeshSurfaces");
+  QList<int> objects = data.meshes.objects();
+  for (int k = 0; k < objects.size(); k++)
+  {
+    int i = objects[k];
+    const SubdividedMesh &surface = data.meshes.find(i)->surface;
+    if (i >= data.size() || surface.indices.isEmpty())
+      continue;
+    double model[16], modelView[16];
+    objectMatrix(data.translates[i].v, data.rotations[i].v, data.scales[i].v, model);
+    multiplyMatrix(view, model, modelView);
+    glLoadMatrixd(modelView);
+    glColor3dv(data.colors[i].v);
+    glVertexPointer(3, GL_FLOAT, 0, surface.positions.constData());
+    glNormalPointer(GL_FLOAT, 0, surface.normals.constData());
+    glDrawElements(GL_TRIANGLES, surface.indices.size(), GL_UNSIGNED_INT, surface.indices.constData());
+    stats.drawn++;
+    stats.triangles += surface.triangleCount();
+  }
+}
+
+bool Renderer::queueDirty(const FrameState &frame) const
+{
+  if (frame.revision != queued.revision || frame.orthographic != queued.orthographic)
+    return true;
+  if (frame.height != queued.height || frame.orthoSize != queued.orthoSize || frame.levelOfDetail != queued.levelOfDetail)
+    return true;
+  for (int i = 0; i < 3; i++)
+    if (frame.camPosition[i] != queued.camPosition[i] || frame.forwardVec[i] != queued.forwardVec[i])
+      return true;
+  return false;
+}
+
+// Depth is the distance along the view direction, which is also what
+// orthographic views need
+void Renderer::buildQueue(const FrameState &frame, const double view[16])
+{
+  TRACE_SCOPE("Renderer::buildQueue");
+  const SceneData &data = frame.scene;
+  double farDistance = farPlane(frame);
+  queue.clear();
+  queue.reserve(data.size());
+  for (int i = 0; i < data.size(); i++)
+  {
+    int type = data.objects[i];
+    if (type < 0 || type > 6 || data.meshes.contains(i))
+      continue;
+    const Vec3 &t = data.translates[i];
+    double depth = -(view[2] * t[0] + view[6] * t[1] + view[10] * t[2] + view[14]);
+    queue.add(type, selectLod(frame, type, data.scales[i], depth), data.colors[i].v, depth / farDistance, i);
+  }
+  queue.sort();
+
+  queued = frame;
+  queued.scene = SceneData(); // Don't hold on to the snapshots
+  queued.streamed = StreamedView();
+}
+
+// Set up the culler's camera and pick the occluders that cover the most screen
+void Renderer::prepareOcclusion(const FrameState &frame)
+{
+  TRACE_SCOPE("Renderer::prepareOcclusion");
+  const SceneData &data = frame.scene;
+  const double *camPosition = frame.camPosition;
+  double projection[16], view[16], viewProj[16];
+  frameMatrices(frame, projection, view);
+  multiplyMatrix(projection, view, viewProj);
+  occluder.setViewProjection(viewProj);
+
+  // Rank by the area of the occluder's largest face over squared distance
+  std::vector<std::pair<double, int> > ranked;
+  ranked.reserve(data.size());
+  for (int i = 0; i < data.size(); i++)
+  {
+    if (data.meshes.contains(i))
+      continue; // Its primitive's box may not be inside the surface
+    const Vec3 &t = data.translates[i];
+    const Vec3 &sc = data.scales[i];
+    const float (*box)[3] = primitiveOccluders[qBound(0, data.objects[i], 6)];
+    double ex = (box[1][0] - box[0][0]) * sc[0], ey = (box[1][1] - box[0][1]) * sc[1], ez = (box[1][2] - box[0][2]) * sc[2];
+    double area = std::max(ex * ey, std::max(ey * ez, ex * ez));
+    double dx = t[0] - camPosition[0], dy = t[1] - camPosition[1], dz = t[2] - camPosition[2];
+    ranked.push_back(std::make_pair(-area / (dx * dx + dy * dy + dz * dz + 1e-6), i));
+  }
+  occluder.clearOccluders();
+  int count = std::min((int)ranked.size(), (int)OcclusionCuller::MaxOccluders);
+  if (count == 0)
+    return; // Every object is a mesh
+  std::nth_element(ranked.begin(), ranked.begin() + count - 1, ranked.end());
+
+  for (int k = 0; k < count; k++)
+  {
+    int i = ranked[k].second;
+    int type = qBound(0, data.objects[i], 6);
+    double model[16];
+    objectMatrix(data.translates[i].v, data.rotations[i].v, data.scales[i].v, model);
+    occluder.addOccluder(model, primitiveOccluders[type][0], primitiveOccluders[type][1]);
+  }
+}
+
+void Renderer::resize(int width, int height)
+{
+  TRACE_SCOPE("Renderer::resize");
+  glClear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  glViewport(0, 0, width, height); // The projection is loaded every frame
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <QtCore>
+#include <QGLWidget>
+#include <vector>
+#include "scene_data.h"
+#include "lighting_bake.h"
+#include "occlusion.h"
+#include "mesh_buffers.h"
+#include "render_queue.h"
+#include "streamed_scene.h"
+
+// Need some more includes for OSX
+#ifdef __APPLE__
+#include <OpenGL/gl.h>
+#include <OpenGL/glu.h>
+#endif
+
+// Everything the renderer needs for one frame. The scene is a cheap
+// copy-on-write snapshot, so the UI can keep editing while it is drawn.
+struct FrameState
+{
+  SceneData scene;
+  double camPosition[3];
+  double forwardVec[3];
+  double upVec[3];
+  int width;
+  int height;
+  bool orthographic;
+  double orthoSize; // Half the visible height when orthographic
+  int tileX, tileY; // Posters draw the frame in tiles of the width x height image,
+  int tileWidth, tileHeight; // from the top left; a tileWidth of 0 draws all of it
+  bool occlusionCulling;
+  bool levelOfDetail; // Draw distant objects with coarser meshes
+  int revision; // Scene revision this frame shows
+  StreamedView streamed; // Chunks of a streamed scene file, if one is open
+  BakedColors baked; // Objects with baked lighting are drawn unlit with these
+};
+
+struct FrameStats
+{
+  int drawn;
+  int culled;
+  int stateChanges;         // Mesh and color changes actually submitted
+  int unsortedStateChanges; // What drawing in scene order would have cost
+  int triangles;
+};
+
+// Projection and view matrices of a frame's camera
+void frameMatrices(const FrameState &frame, double projection[16], double view[16]);
+
+// Issues all GL calls for a frame; lives on the render thread
+class Renderer
+{
+public:
+  Renderer();
+
+  void initialize();
+  void shutdown();
+  void resize(int width, int height);
+  FrameStats render(const FrameState &frame);
+
+private:
+  void prepareOcclusion(const FrameState &frame);
+  void buildQueue(const FrameState &frame, const double view[16]);
+  void bindMesh(int type, int lod = 0);
+  int drawMesh(int type, int lod = 0);
+  int selectLod(const FrameState &frame, int type, const Vec3 &scale, double depth) const;
+  void drawStreamed(const FrameState &frame, const double projection[16], const double view[16], FrameStats &stats);
+  void drawProxy(const StreamedChunkInfo &info, const double view[16]);
+  void drawMeshSurfaces(const FrameState &frame, const double view[16], FrameStats &stats);
+
+  // The queue is only rebuilt when the scene or the camera moved
+  bool queueDirty(const FrameState &frame) const;
+
+  MeshBuffers *meshes;
+  bool buffered; // Meshes come from buffer objects this frame
+  LodBuffers lods;
+  OcclusionCuller occluder;
+  std::vector<OcclusionRect> occlusionRects;
+  RenderQueue queue;
+  FrameState queued; // Camera and revision of the queue; no scene
+};
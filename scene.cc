@@ -0,0 +1,906 @@
+#include "scene.h"
+#include <cmath>
+#include <QTextStream>
+#include <QFile>
+#include <QtConcurrentRun>
+#include "interference_checker.h"
+#include "lighting_baker.h"
+#include "mesh_editor.h"
+#include "scene_io.h"
+#include "scene_math.h"
+#include "trace.h"
+
+static const qint64 journalCompactSize = 4 << 20; // Fold the journal into the base file past this size
+static const int batchRegionEdits = 256; // Past this many edits a batch just redraws every view
+static const int playbackRate = 30; // Frames per second of animation playback
+
+/***********/
+/* REGIONS */
+/***********/
+
+SceneRegion SceneRegion::all()
+{
+  SceneRegion region;
+  region.everything = true;
+  return region;
+}
+
+SceneRegion SceneRegion::united(const SceneRegion &other) const
+{
+  SceneRegion region = *this;
+  region.everything = everything || other.everything;
+  for (int i = 0; i < 3; i++)
+  {
+    region.min[i] = qMin(min[i], other.min[i]);
+    region.max[i] = qMax(max[i], other.max[i]);
+  }
+  return region;
+}
+
+/*********/
+/* SCENE */
+/*********/
+
+Scene::Scene(QObject *parent) : QObject(parent)
+{
+  // Periodic autosave, written on a worker thread
+  sceneRevision = 0;
+  autosavedRevision = 0;
+  autoSaver = new AutoSaver(this);
+  connect(autoSaver, SIGNAL(saved(bool, qint64)), this, SIGNAL(autosaveFinished(bool, qint64)));
+  autosaveTimer = new QTimer(this);
+  connect(autosaveTimer, SIGNAL(timeout()), this, SLOT(autosave()));
+  autosaveTimer->start(30000);
+
+  journaledSaves = false;
+  batchDepth = 0;
+  batchEdits = 0;
+  batchCreated = 0;
+  connect(&compactWatcher, SIGNAL(finished()), this, SLOT(compactionFinished()));
+
+  // Loads and saves run on workers; the UI polls their progress
+  ioJob = NoJob;
+  loadedJournalEnd = 0;
+  savedRevision = 0;
+  progressTimer = new QTimer(this);
+  progressTimer->setInterval(100);
+  connect(progressTimer, SIGNAL(timeout()), this, SLOT(pollIo()));
+  connect(&ioWatcher, SIGNAL(finished()), this, SLOT(ioJobFinished()));
+
+  streamer = new SceneStreamer(this);
+  connect(streamer, SIGNAL(chunkChanged(int)), this, SLOT(streamedChunkChanged(int)));
+  baker = new LightingBaker(this);
+  checker = new InterferenceChecker(this);
+  editor = new MeshEditor(this);
+
+  currentTime = 0.0;
+  loopLength = 5.0;
+  poseRevision = 0;
+  keyInterpolation = BezierKey;
+  playStart = 0.0;
+  posedRevision = -1;
+  posedTime = 0.0;
+  playTimer = new QTimer(this);
+  playTimer->setInterval(1000 / playbackRate);
+  connect(playTimer, SIGNAL(timeout()), this, SLOT(playbackTick()));
+}
+
+Scene::~Scene()
+{
+  // A save in flight is still worth finishing, a load is not
+  if (ioJob == LoadJob)
+    progress.cancel();
+  ioWatcher.waitForFinished();
+  compactWatcher.waitForFinished();
+}
+
+// World space box around an object; every primitive fits the unit box
+SceneRegion Scene::objectRegion(int index) const
+{
+  const SceneData &data = displayed();
+  double model[16];
+  objectMatrix(data.translates[index].v, data.rotations[index].v, data.scales[index].v, model);
+
+  // The primitives fill the unit box; a mesh's surface lies within its cage's box
+  double low[3] = { -0.5, -0.5, -0.5 }, high[3] = { 0.5, 0.5, 0.5 };
+  const MeshObject *mesh = data.meshes.find(index);
+  if (mesh && mesh->cage.vertexCount() > 0)
+  {
+    for (int v = 0; v < mesh->cage.vertexCount(); v++)
+    {
+      const float *p = mesh->cage.position(v);
+      for (int j = 0; j < 3; j++)
+      {
+        low[j] = v == 0 ? p[j] : qMin(low[j], (double)p[j]);
+        high[j] = v == 0 ? p[j] : qMax(high[j], (double)p[j]);
+      }
+    }
+  }
+
+  SceneRegion region;
+  region.everything = false;
+  for (int i = 0; i < 3; i++)
+  {
+    double center = model[12 + i], extent = 0.0;
+    for (int j = 0; j < 3; j++)
+    {
+      center += model[4 * j + i] * 0.5 * (low[j] + high[j]);
+      extent += fabs(model[4 * j + i]) * 0.5 * (high[j] - low[j]);
+    }
+    region.min[i] = center - extent;
+    region.max[i] = center + extent;
+  }
+  return region;
+}
+
+/*******************/
+/* OBJECT CREATION */
+/*******************/
+
+void Scene::createPlane()
+{
+  TRACE_SCOPE("Scene::createPlane");
+  createObject(0);
+}
+
+void Scene::createCube()
+{
+  TRACE_SCOPE("Scene::createCube");
+  createObject(1);
+}
+
+void Scene::createSphere()
+{
+  TRACE_SCOPE("Scene::createSphere");
+  createObject(2);
+}
+
+void Scene::createCone()
+{
+  TRACE_SCOPE("Scene::createCone");
+  createObject(3);
+}
+
+void Scene::createCylinder()
+{
+  TRACE_SCOPE("Scene::createCylinder");
+  createObject(4);
+}
+
+void Scene::createPyramid()
+{
+  TRACE_SCOPE("Scene::createPyramid");
+  createObject(5);
+}
+
+void Scene::createWedge()
+{
+  TRACE_SCOPE("Scene::createWedge");
+  createObject(6);
+}
+
+// New object of type 0-6 at the origin, unit sized and light grey
+void Scene::createObject(int type)
+{
+  TRACE_SCOPE("Scene::createObject");
+  static const char *names[7] = { "Plane", "Cube", "Sphere", "Cone", "Cylinder", "Pyramid", "Wedge" };
+  if (type < 0 || type > 6)
+    return;
+
+  // Push object properties to respective vectors
+  scene.objects.push_back(type);
+  journal.recordCreate(type);
+  Vec3 zeroVector = makeVec3(0.0, 0.0, 0.0);
+  scene.translates.push_back(zeroVector);
+  scene.rotations.push_back(zeroVector);
+  Vec3 oneVector = makeVec3(1.0, 1.0, 1.0);
+  scene.scales.push_back(oneVector);
+  Vec3 colorVector = makeVec3(0.8, 0.8, 0.8);
+  scene.colors.push_back(colorVector);
+  sceneRevision++;
+
+  // Add to object list; a batch adds all of its objects at the end
+  if (batchDepth > 0)
+    batchCreated++;
+  else
+    emit addToList(names[type]);
+
+  notifyChanged(touchedRegion(scene.size() - 1));
+}
+
+/***********/
+/* BATCHES */
+/***********/
+
+void Scene::beginBatch()
+{
+  if (batchDepth++ > 0)
+    return;
+  batchEdits = 0;
+  batchCreated = 0;
+}
+
+void Scene::endBatch()
+{
+  if (batchDepth == 0 || --batchDepth > 0)
+    return;
+  emit addToList(batchCreated);
+  if (batchEdits > 0)
+  {
+    baker->edited(batchRegion);
+    checker->edited(batchRegion);
+    emit changed(batchRegion);
+  }
+}
+
+// Region of an object for change tracking; not worth computing once a
+// batch touched so much that every view redraws anyway
+SceneRegion Scene::touchedRegion(int index) const
+{
+  if (batchDepth > 0 && batchEdits > 0 && batchRegion.everything)
+    return SceneRegion::all();
+  return objectRegion(index);
+}
+
+void Scene::notifyChanged(const SceneRegion &region)
+{
+  if (batchDepth == 0)
+  {
+    baker->edited(region);
+    checker->edited(region);
+    emit changed(region);
+    return;
+  }
+
+  batchRegion = batchEdits == 0 ? region : batchRegion.united(region);
+  if (++batchEdits > batchRegionEdits)
+    batchRegion = SceneRegion::all();
+}
+
+// Fill the scene with a procedural stress scene in one batch
+void Scene::generate(int kind, int count, int seed)
+{
+  TRACE_SCOPE("Scene::generate");
+  GeneratorParams params;
+  params.kind = (GeneratorKind)qBound(0, kind, GeneratorKinds - 1);
+  params.count = count;
+  params.seed = seed;
+
+  QElapsedTimer timer;
+  timer.start();
+  int firstIndex = scene.size();
+  generateScene(params, scene);
+  qint64 generateMsec = timer.elapsed();
+
+  // A batch this size is cheaper as one full save than as journal records
+  if (compactWatcher.isRunning())
+    compactWatcher.waitForFinished();
+  journal.close();
+
+  sceneRevision++;
+  emit addToList(scene.size() - firstIndex);
+  baker->edited(SceneRegion::all());
+  checker->edited(SceneRegion::all());
+  emit changed(SceneRegion::all());
+  emit generated(QString("%1 x %2: generated in %3 ms").arg(generatorName(params.kind)).arg(scene.size() - firstIndex).arg(generateMsec));
+}
+
+/*****************/
+/* SIGNALS/SLOTS */
+/*****************/
+
+void Scene::removeObject(int index)
+{
+  TRACE_SCOPE("Scene::removeObject");
+  //qDebug() << "\nIndex: " << index;
+  if (index > -1)
+  {
+    SceneRegion region = touchedRegion(index);
+    editor->objectRemoved(index);
+    scene.objects.erase(index);
+    scene.translates.erase(index);
+    scene.rotations.erase(index);
+    scene.scales.erase(index);
+    scene.colors.erase(index);
+    scene.animation.removeObject(index);
+    scene.meshes.removeObject(index);
+    journal.recordRemove(index);
+    baker->objectRemoved(index);
+    checker->objectRemoved(index);
+    sceneRevision++;
+
+    emit removeFromList(index);
+    if (!scene.animation.isEmpty())
+      emit keysChanged(); // Renumbered
+    notifyChanged(region);
+  }
+}
+
+//Translate Function
+void Scene::receiveTranslation(int index, double x, double y, double z)
+{
+  TRACE_SCOPE("Scene::receiveTranslation");
+  if (index > -1)
+  {
+    SceneRegion region = touchedRegion(index);
+    if (!keyAttribute(index, AnimateTranslate, makeVec3(x, y, z)))
+    {
+      scene.translates[index] = makeVec3(x, y, z);
+      journal.recordVector(SceneJournal::Translate, index, scene.translates[index]);
+      sceneRevision++;
+    }
+    //qDebug() << "Update Translation: " << index << x << y << z;
+
+    notifyChanged(region.united(touchedRegion(index)));
+  }
+}
+
+//Rotation Function
+void Scene::receiveRotation(int index, double x, double y, double z)
+{
+  TRACE_SCOPE("Scene::receiveRotation");
+  if (index > -1)
+  {
+    SceneRegion region = touchedRegion(index);
+    if (!keyAttribute(index, AnimateRotate, makeVec3(x, y, z)))
+    {
+      scene.rotations[index] = makeVec3(x, y, z);
+      journal.recordVector(SceneJournal::Rotate, index, scene.rotations[index]);
+      sceneRevision++;
+    }
+    //qDebug() << "Update Rotation: " << index << x << y << z;
+
+    notifyChanged(region.united(touchedRegion(index)));
+  }
+}
+
+//Scale Function
+void Scene::receiveScale(int index, double x, double y, double z)
+{
+  TRACE_SCOPE("Scene::receiveScale");
+  if (index > -1)
+  {
+    SceneRegion region = touchedRegion(index);
+    if (!keyAttribute(index, AnimateScale, makeVec3(x, y, z)))
+    {
+      scene.scales[index] = makeVec3(x, y, z);
+      journal.recordVector(SceneJournal::Scale, index, scene.scales[index]);
+      sceneRevision++;
+    }
+    //qDebug() << "Update Scale: " << index << x << y << z;
+
+    notifyChanged(region.united(touchedRegion(index)));
+  }
+}
+
+void Scene::receiveColor(int index, double r, double g, double b)
+{
+  TRACE_SCOPE("Scene::receiveColor");
+  if (index > -1)
+  {
+    if (!keyAttribute(index, AnimateColor, makeVec3(r, g, b)))
+    {
+      scene.colors[index] = makeVec3(r, g, b);
+      journal.recordVector(SceneJournal::Color, index, scene.colors[index]);
+      sceneRevision++;
+    }
+    //qDebug() << "Update Color: " << index << r << g << b;
+
+    notifyChanged(touchedRegion(index));
+  }
+}
+
+void Scene::answerInfo(int index)
+{
+  TRACE_SCOPE("Scene::answerInfo");
+  if (index > -1)
+  {
+    const SceneData &data = displayed();
+    std::vector<double> info;
+    info.push_back(data.translates[index][0]);
+    info.push_back(data.translates[index][1]);
+    info.push_back(data.translates[index][2]);
+    info.push_back(data.rotations[index][0]);
+    info.push_back(data.rotations[index][1]);
+    info.push_back(data.rotations[index][2]);
+    info.push_back(data.scales[index][0]);
+    info.push_back(data.scales[index][1]);
+    info.push_back(data.scales[index][2]);
+    info.push_back(data.colors[index][0]);
+    info.push_back(data.colors[index][1]);
+    info.push_back(data.colors[index][2]);
+    emit sendInfo(info);
+    //qDebug() << "Info: " << info[0] << info[1] << info[2] << info[3] << info[4] << info[5] << info[6] << info[7] << info[8];
+  }
+  //qDebug() << "\nIndex: " << index;
+  //qDebug() << "Translations: " << translates.size();
+  //qDebug() << "Rotations: " << rotations.size();
+  //qDebug() << "Scales: " << scales.size();
+  //qDebug() << "Color: " << colors.size();
+}
+
+// Save scene to .vox file. With journaled saves, saving again to the same
+// file only appends the edits made since the last save; anything else is
+// written from a snapshot on a worker while editing goes on.
+void Scene::saveFile(QString fileName)
+{
+  TRACE_SCOPE("Scene::saveFile");
+  if (isBusy())
+    return;
+
+  if (journaledSaves && journal.isOpen() && journal.baseFile() == fileName)
+  {
+    QElapsedTimer clock;
+    clock.start();
+    if (journal.commit())
+    {
+      if (journal.size() > journalCompactSize)
+        compactJournal();
+      emit ioFinished(QString("Saved %1 (journal, %2 ms)").arg(QFileInfo(fileName).fileName()).arg(clock.elapsed()));
+      return;
+    }
+  }
+
+  // A full write makes any journal of the old base stale
+  if (compactWatcher.isRunning())
+    compactWatcher.waitForFinished();
+  journal.close();
+
+  savedRevision = sceneRevision;
+  startIo(SaveJob, fileName, "Saving " + QFileInfo(fileName).fileName());
+  ioWatcher.setFuture(QtConcurrent::run(writeSceneFile, fileName, SceneData(scene), encoding, &progress));
+}
+
+// Export the tessellated scene as a Wavefront .obj file
+void Scene::exportFile(QString fileName)
+{
+  TRACE_SCOPE("Scene::exportFile");
+  exportObj(fileName, scene);
+}
+
+// Write the scene as a spatially chunked file, for opening with openStreamed
+void Scene::exportStreamed(QString fileName)
+{
+  TRACE_SCOPE("Scene::exportStreamed");
+  if (isBusy())
+    return;
+  startIo(StreamExportJob, fileName, "Writing " + QFileInfo(fileName).fileName());
+  ioWatcher.setFuture(QtConcurrent::run(writeStreamedScene, fileName, SceneData(scene), &progress));
+}
+
+// Show a streamed scene file; its chunks load around the perspective camera
+void Scene::openStreamed(QString fileName)
+{
+  TRACE_SCOPE("Scene::openStreamed");
+  if (!streamer->open(fileName))
+  {
+    emit ioFinished("Could not open " + fileName);
+    return;
+  }
+  emit ioFinished(QString("Streaming %1 objects in %2 chunks from %3").arg(streamer->objectCount())
+                  .arg(streamer->chunkCount()).arg(QFileInfo(fileName).fileName()));
+}
+
+void Scene::closeStreamed()
+{
+  streamer->close();
+}
+
+// Views that can see the chunk draw it in detail now, or as a box again
+void Scene::streamedChunkChanged(int chunk)
+{
+  if (chunk < 0)
+  {
+    emit changed(SceneRegion::all());
+    return;
+  }
+  const StreamedChunkInfo &info = streamer->chunkInfo(chunk);
+  SceneRegion region;
+  region.everything = false;
+  for (int i = 0; i < 3; i++)
+  {
+    region.min[i] = info.min[i];
+    region.max[i] = info.max[i];
+  }
+  emit changed(region);
+}
+
+// Read scene from vox file, followed by the saved edits in its journal
+void Scene::loadFile(QString fileName)
+{
+  TRACE_SCOPE("Scene::loadFile");
+  readFile(fileName, false);
+}
+
+// Same, but also replay edits that were flushed to the journal and never saved
+void Scene::recoverFile(QString fileName)
+{
+  TRACE_SCOPE("Scene::recoverFile");
+  readFile(fileName, true);
+}
+
+// Runs on a worker: the file and its journal go into a scene of their own,
+// so the UI thread only has to append it once everything is in
+static bool loadInBackground(QString fileName, bool recovering, SceneData *out, qint64 *journalEnd, IoProgress *progress)
+{
+  TRACE_SCOPE("loadInBackground");
+  if (!readSceneFile(fileName, *out, progress))
+    return false;
+  SceneJournal::replay(fileName, *out, 0, recovering, journalEnd);
+  return !progress->isCancelled();
+}
+
+void Scene::readFile(QString fileName, bool recovering)
+{
+  if (isBusy())
+    return;
+
+  loaded = SceneData();
+  loadedJournalEnd = 0;
+  startIo(LoadJob, fileName, "Loading " + QFileInfo(fileName).fileName());
+  ioWatcher.setFuture(QtConcurrent::run(loadInBackground, fileName, recovering, &loaded, &loadedJournalEnd, &progress));
+}
+
+/******************/
+/* BACKGROUND I/O */
+/******************/
+
+void Scene::startIo(IoJob job, QString fileName, QString text)
+{
+  ioJob = job;
+  ioFile = fileName;
+  progress.reset();
+  ioClock.start();
+  progressTimer->start();
+  emit ioStarted(text);
+}
+
+void Scene::cancelIo()
+{
+  if (isBusy())
+    progress.cancel();
+}
+
+void Scene::pollIo()
+{
+  static const char *phases[] = { "Reading", "Decoding", "Encoding", "Writing" };
+  emit ioProgress(phases[progress.phase()], progress.percent());
+}
+
+void Scene::ioJobFinished()
+{
+  progressTimer->stop();
+  IoJob job = ioJob;
+  ioJob = NoJob;
+  if (job == LoadJob)
+    finishLoad();
+  else if (job == SaveJob)
+    finishSave();
+  else if (job == StreamExportJob)
+    finishStreamExport();
+}
+
+void Scene::finishLoad()
+{
+  TRACE_SCOPE("Scene::finishLoad");
+  SceneData data = loaded;
+  loaded = SceneData();
+  if (progress.isCancelled())
+  {
+    emit ioFinished("Load cancelled");
+    return;
+  }
+  if (!ioWatcher.result())
+  {
+    emit ioFinished("Could not load " + ioFile);
+    return;
+  }
+
+  // All loaded objects go in behind the existing ones at once
+  int firstIndex = scene.size();
+  appendScene(scene, data);
+  emit addToList(data.size());
+
+  // Keep appending to the journal, unless its indices no longer line up
+  if (compactWatcher.isRunning())
+    compactWatcher.waitForFinished();
+  journal.close();
+  if (journaledSaves && firstIndex == 0)
+  {
+    if (loadedJournalEnd > 0)
+      journal.resume(ioFile, loadedJournalEnd);
+    else if (QFile::exists(ioFile))
+      journal.start(ioFile);
+  }
+
+  sceneRevision++;
+  if (!data.animation.isEmpty())
+    emit keysChanged();
+  baker->edited(SceneRegion::all());
+  checker->edited(SceneRegion::all());
+  emit changed(SceneRegion::all());
+  emit ioFinished(QString("Loaded %1 objects from %2 (%3 ms)").arg(data.size()).arg(QFileInfo(ioFile).fileName()).arg(ioClock.elapsed()));
+}
+
+void Scene::finishSave()
+{
+  TRACE_SCOPE("Scene::finishSave");
+  if (!ioWatcher.result())
+  {
+    emit ioFinished(progress.isCancelled() ? QString("Save cancelled") : "Could not save " + ioFile);
+    return;
+  }
+
+  // Edits made during the write are not in the file, so only journal
+  // against it when there were none
+  if (journaledSaves && sceneRevision == savedRevision)
+    journal.start(ioFile);
+  emit ioFinished(QString("Saved %1 (%2 ms)").arg(QFileInfo(ioFile).fileName()).arg(ioClock.elapsed()));
+}
+
+void Scene::finishStreamExport()
+{
+  if (!ioWatcher.result())
+  {
+    emit ioFinished(progress.isCancelled() ? QString("Export cancelled") : "Could not write " + ioFile);
+    return;
+  }
+  emit ioFinished(QString("Wrote %1 (%2 ms)").arg(QFileInfo(ioFile).fileName()).arg(ioClock.elapsed()));
+}
+
+// Hand a snapshot of the scene to the autosaver; copying SceneData only
+// shares its chunks, so this never stalls the UI
+void Scene::autosave()
+{
+  TRACE_SCOPE("Scene::autosave");
+  if (sceneRevision == autosavedRevision)
+    return;
+
+  autoSaver->save(scene, encoding);
+  autosavedRevision = sceneRevision;
+
+  // Unsaved edits also go to the journal, where recovery can find them
+  journal.flush();
+}
+
+void Scene::discardAutosave()
+{
+  autosaveTimer->stop();
+  autoSaver->discard();
+}
+
+void Scene::setCompactEncoding(bool enabled)
+{
+  encoding.format = enabled ? SceneEncoding::Compact : SceneEncoding::Text;
+}
+
+void Scene::setHalfFloatTransforms(bool enabled)
+{
+  encoding.transforms = enabled ? SceneEncoding::HalfFloat : SceneEncoding::FixedPoint;
+}
+
+void Scene::setJournaledSaves(bool enabled)
+{
+  journaledSaves = enabled;
+  if (!enabled)
+  {
+    if (compactWatcher.isRunning())
+      compactWatcher.waitForFinished();
+    journal.close();
+  }
+}
+
+// Rewrite the base file from a snapshot taken right after a save, on a
+// worker thread; edits made meanwhile are carried over into the new journal
+void Scene::compactJournal()
+{
+  TRACE_SCOPE("Scene::compactJournal");
+  if (!journal.isOpen() || compactWatcher.isRunning())
+    return;
+
+  journal.flush();
+  journal.beginCompaction();
+  compactWatcher.setFuture(QtConcurrent::run(writeSceneFile, journal.baseFile(), SceneData(scene), encoding, (IoProgress *)0));
+}
+
+void Scene::compactionFinished()
+{
+  journal.finishCompaction(compactWatcher.result());
+}
+
+/*************/
+/* ANIMATION */
+/*************/
+
+const SceneData &Scene::displayed() const
+{
+  if (scene.animation.isEmpty())
+    return scene;
+  if (posedRevision != sceneRevision || posedTime != currentTime)
+  {
+    // Between edits only the animated chunks change, and those are already ours
+    if (posedRevision != sceneRevision)
+      posed = scene;
+    scene.animation.evaluate(currentTime, posed);
+    posedRevision = sceneRevision;
+    posedTime = currentTime;
+  }
+  return posed;
+}
+
+// Edits of an animated attribute key it at the current time, rather than
+// move the rest pose that the keys override anyway
+bool Scene::keyAttribute(int index, int attribute, const Vec3 &value)
+{
+  if (!scene.animation.isAnimated(index, attribute))
+    return false;
+  AnimationKey key;
+  key.time = currentTime;
+  for (int i = 0; i < 3; i++)
+    key.value[i] = value[i];
+  key.interpolation = keyInterpolation;
+  scene.animation.setKey(index, attribute, key);
+  keysEdited();
+  return true;
+}
+
+// The journal has no records for keys, so the next save is a full one
+void Scene::keysEdited()
+{
+  if (compactWatcher.isRunning())
+    compactWatcher.waitForFinished();
+  journal.close();
+  sceneRevision++;
+  emit keysChanged();
+}
+
+void Scene::setAnimationTime(double time)
+{
+  time = qMax(0.0, time);
+  if (time == currentTime)
+    return;
+  currentTime = time;
+  poseRevision++;
+  if (!scene.animation.isEmpty())
+    emit changed(SceneRegion::all());
+  emit animationTimeChanged(time);
+}
+
+void Scene::setAnimationLength(double length)
+{
+  loopLength = qMax(0.0, length);
+}
+
+void Scene::setKeyInterpolation(int interpolation)
+{
+  keyInterpolation = interpolation == LinearKey ? LinearKey : BezierKey;
+}
+
+// Key every attribute of the object at the current time, at its posed values
+void Scene::setKey(int index)
+{
+  TRACE_SCOPE("Scene::setKey");
+  if (index < 0 || index >= scene.size())
+    return;
+  const SceneData &pose = displayed();
+  const Vec3 values[AnimatedAttributes] = { pose.translates[index], pose.rotations[index], pose.scales[index], pose.colors[index] };
+  for (int attribute = 0; attribute < AnimatedAttributes; attribute++)
+  {
+    AnimationKey key;
+    key.time = currentTime;
+    for (int i = 0; i < 3; i++)
+      key.value[i] = values[attribute][i];
+    key.interpolation = keyInterpolation;
+    scene.animation.setKey(index, attribute, key);
+  }
+  keysEdited();
+  notifyChanged(touchedRegion(index));
+}
+
+void Scene::removeKeys(int index)
+{
+  TRACE_SCOPE("Scene::removeKeys");
+  if (index < 0 || index >= scene.size())
+    return;
+  SceneRegion region = touchedRegion(index);
+  if (!scene.animation.removeKeys(index, currentTime))
+    return;
+  keysEdited();
+  notifyChanged(region.united(touchedRegion(index)));
+}
+
+// Playback steps at a fixed rate, read off a wall clock so that slow
+// frames drop steps instead of slowing the animation down
+void Scene::playAnimation(bool play)
+{
+  if (play == playTimer->isActive())
+    return;
+  if (play)
+  {
+    playStart = currentTime;
+    playClock.start();
+    playTimer->start();
+  }
+  else
+    playTimer->stop();
+}
+
+void Scene::playbackTick()
+{
+  double length = qMax(loopLength, scene.animation.duration());
+  double time = playStart + floor(playClock.elapsed() * playbackRate / 1000.0) / playbackRate;
+  if (length > 0.0)
+    time = fmod(time, length);
+  setAnimationTime(time);
+}
+
+/**********/
+/* MESHES */
+/**********/
+
+void Scene::setMesh(int index, const HalfEdgeMesh &cage, int level, const SubdividedMesh &surface)
+{
+  if (index < 0 || index >= scene.size())
+    return;
+  SceneRegion before = touchedRegion(index);
+  scene.meshes.setMesh(index, cage, level, surface);
+  meshEdited(index, before);
+}
+
+void Scene::removeMesh(int index)
+{
+  if (!scene.meshes.contains(index))
+    return;
+  SceneRegion before = touchedRegion(index);
+  scene.meshes.removeMesh(index);
+  meshEdited(index, before);
+}
+
+// The journal has no records for meshes either, so the next save is a full one
+void Scene::meshEdited(int index, const SceneRegion &before)
+{
+  if (compactWatcher.isRunning())
+    compactWatcher.waitForFinished();
+  journal.close();
+  sceneRevision++;
+  notifyChanged(before.united(touchedRegion(index)));
+}
+
+void Scene::printInfo()
+{
+  qDebug() << "\nObjects: ";
+  for (int i = 0; i < scene.objects.size(); i++)
+    qDebug() << scene.objects[i] << ",";
+
+  qDebug() << "\nTranslation: ";
+  for (int i = 0; i < scene.translates.size(); i++)
+  {
+    for (int j = 0; j < 3; j++)
+      qDebug() << scene.translates[i][j] << ",";
+    qDebug() << ";";
+  }
+
+  qDebug() << "\nRotation: ";
+  for (int i = 0; i < scene.rotations.size(); i++)
+  {
+    for (int j = 0; j < 3; j++)
+      qDebug() << scene.rotations[i][j] << ",";
+    qDebug() << ";";
+  }
+
+  qDebug() << "\nScale: ";
+  for (int i = 0; i < scene.scales.size(); i++)
+  {
+    for (int j = 0; j < 3; j++)
+      qDebug() << scene.scales[i][j] << ",";
+    qDebug() << ";";
+  }
+
+  qDebug() << "\nColor: ";
+  for (int i = 0; i < scene.colors.size(); i++)
+  {
+    for (int j = 0; j < 3; j++)
+      qDebug() << scene.colors[i][j] << ",";
+    qDebug() << ";";
+  }
+}
\ No newline at end of file
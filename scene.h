@@ -0,0 +1,203 @@
+#pragma once
+
+#include <QtCore>
+#include <vector>
+#include "scene_data.h"
+#include "autosave.h"
+#include "scene_codec.h"
+#include "scene_journal.h"
+#include "scene_generators.h"
+#include "scene_streamer.h"
+
+class LightingBaker;
+class InterferenceChecker;
+class MeshEditor;
+
+// World space box touched by an edit. Viewports that cannot see it don't
+// need to render again.
+struct SceneRegion
+{
+  double min[3], max[3];
+  bool everything; // Bulk changes: loads, generators
+
+  static SceneRegion all();
+  SceneRegion united(const SceneRegion &other) const;
+};
+
+// The modelling data shared by every viewport, with its editing, saving and
+// loading. Views only read it and listen to changed().
+class Scene : public QObject
+{
+
+    Q_OBJECT
+
+public:
+    Scene(QObject *parent = 0);
+    ~Scene();
+
+    const SceneData &data() const { return scene; }
+    int revision() const { return sceneRevision + poseRevision; }
+    SceneRegion objectRegion(int index) const;
+
+    // The scene as posed at the animation time; data() holds the rest pose
+    // and the keys. Evaluated when first asked for after a change.
+    const SceneData &displayed() const;
+    double animationTime() const { return currentTime; }
+    double animationLength() const { return loopLength; }
+    bool isPlaying() const { return playTimer->isActive(); }
+
+    // True while a load or save runs in the background
+    bool isBusy() const { return ioJob != NoJob; }
+
+    // A streamed scene file shown along with the scene; read-only
+    SceneStreamer *streaming() const { return streamer; }
+
+    // Baked per-vertex lighting; disabled until turned on
+    LightingBaker *lighting() const { return baker; }
+
+    // Objects that overlap; not checked until turned on
+    InterferenceChecker *interference() const { return checker; }
+
+    // Edits objects as meshes (scene_meshes.h)
+    MeshEditor *meshEditor() const { return editor; }
+
+    // Makes the object a mesh, or replaces its cage; the surface is the
+    // cage subdivided level times, as the mesh editor keeps it
+    void setMesh(int index, const HalfEdgeMesh &cage, int level, const SubdividedMesh &surface);
+    void removeMesh(int index); // Back to its primitive
+
+    // Edits between these reach the views and the object list as a single
+    // change, e.g. a batch from the command server. Batches nest.
+    void beginBatch();
+    void endBatch();
+
+public slots:
+    void createPlane();
+    void createCube();
+    void createSphere();
+    void createCone();
+    void createCylinder();
+    void createPyramid();
+    void createWedge();
+    void createObject(int type);
+    void generate(int kind, int count, int seed);
+    void removeObject(int index);
+    void receiveTranslation(int index, double x, double y, double z);
+    void receiveRotation(int index, double x, double y, double z);
+    void receiveScale(int index, double x, double y, double z);
+    void receiveColor(int index, double r, double g, double b);
+    void answerInfo(int index);
+
+    void saveFile(QString fileName);
+    void loadFile(QString fileName);
+    void recoverFile(QString fileName);
+    void exportFile(QString fileName);
+    void exportStreamed(QString fileName);
+    void openStreamed(QString fileName);
+    void closeStreamed();
+    void autosave();
+    void discardAutosave();
+    void setJournaledSaves(bool enabled);
+    void setCompactEncoding(bool enabled);
+    void setHalfFloatTransforms(bool enabled);
+    void printInfo();
+    void cancelIo();
+
+    // Animation
+    void setAnimationTime(double time);
+    void setAnimationLength(double length);
+    void playAnimation(bool play);
+    void setKeyInterpolation(int interpolation);
+    void setKey(int index);
+    void removeKeys(int index);
+
+signals:
+    void changed(SceneRegion region);
+    void addToList(QString str);
+    void addToList();
+    void addToList(int count);
+    void removeFromList(int index);
+    void sendInfo(std::vector<double> info);
+    void autosaveFinished(bool ok, qint64 msec);
+    void generated(QString report);
+    void ioStarted(QString text);
+    void ioProgress(QString phase, int percent);
+    void ioFinished(QString message);
+    void animationTimeChanged(double time);
+    void keysChanged();
+
+private slots:
+    void compactionFinished();
+    void pollIo();
+    void ioJobFinished();
+    void streamedChunkChanged(int chunk);
+    void playbackTick();
+
+private:
+    enum IoJob { NoJob, LoadJob, SaveJob, StreamExportJob };
+
+    void readFile(QString fileName, bool recovering);
+    void startIo(IoJob job, QString fileName, QString text);
+    void finishLoad();
+    void finishSave();
+    void finishStreamExport();
+    void compactJournal();
+    SceneRegion touchedRegion(int index) const;
+    void notifyChanged(const SceneRegion &region);
+    bool keyAttribute(int index, int attribute, const Vec3 &value);
+    void keysEdited();
+    void meshEdited(int index, const SceneRegion &before);
+
+    // Modelling variables
+    SceneData scene;
+    int sceneRevision; // Bumped on every edit
+
+    // Batched edits
+    int batchDepth;
+    int batchEdits;
+    int batchCreated;
+    SceneRegion batchRegion;
+
+    // Autosave
+    AutoSaver *autoSaver;
+    QTimer *autosaveTimer;
+    int autosavedRevision;
+
+    // Saving
+    SceneEncoding encoding;
+
+    // Journaled saves
+    SceneJournal journal;
+    bool journaledSaves;
+    QFutureWatcher<bool> compactWatcher;
+
+    // Background load or save, one at a time
+    IoJob ioJob;
+    QString ioFile;
+    QFutureWatcher<bool> ioWatcher;
+    IoProgress progress;
+    QTimer *progressTimer;
+    QElapsedTimer ioClock;
+    SceneData loaded;      // Filled by the loader, appended when it is done
+    qint64 loadedJournalEnd;
+    int savedRevision;     // Revision the running save is writing
+
+    // Streamed scene file
+    SceneStreamer *streamer;
+
+    LightingBaker *baker;
+    InterferenceChecker *checker;
+    MeshEditor *editor;
+
+    // Animation
+    double currentTime;
+    double loopLength;    // Playback wraps around at this or the last key, whichever is later
+    int poseRevision;     // Bumped when the time changes
+    int keyInterpolation; // Of keys set from now on
+    QTimer *playTimer;
+    QElapsedTimer playClock;
+    double playStart;     // Animation time when playback started
+    mutable SceneData posed;
+    mutable int posedRevision;
+    mutable double posedTime;
+};
@@ -0,0 +1,450 @@
+#include "scene_animation.h"
+#include <QtConcurrentMap>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "scene_data.h"
+#include "trace.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+static const double timeEpsilon = 1e-6; // Keys closer than this are at the same time
+static const int evaluateBlock = 256;   // Tracks gathered and blended at a time
+static const int evaluateJob = 8192;    // Tracks per thread pool task
+
+struct AnimationTrack
+{
+  int object;
+  int attribute;
+  int firstKey;
+  int keyCount;
+};
+
+struct AnimationData : public QSharedData
+{
+  std::vector<AnimationTrack> tracks;
+  std::vector<double> times;
+  std::vector<Vec3> values;
+  std::vector<quint8> interpolations;
+  std::vector<Vec3> outControls; // Bezier controls of the segment to the next key;
+  std::vector<Vec3> inControls;  // the last key of a track has its value in both
+
+  int lowerBound(int object, int attribute) const;
+  int findTrack(int object, int attribute) const;
+  void insertKey(int at, const AnimationKey &key);
+  void eraseKeys(int at, int count);
+  void shiftKeys(int fromTrack, int delta);
+  void updateControls(int track);
+};
+
+// First track not sorting before (object, attribute)
+int AnimationData::lowerBound(int object, int attribute) const
+{
+  int low = 0, high = (int)tracks.size();
+  while (low < high)
+  {
+    int mid = (low + high) / 2;
+    const AnimationTrack &t = tracks[mid];
+    if (t.object < object || (t.object == object && t.attribute < attribute))
+      low = mid + 1;
+    else
+      high = mid;
+  }
+  return low;
+}
+
+int AnimationData::findTrack(int object, int attribute) const
+{
+  int t = lowerBound(object, attribute);
+  if (t < (int)tracks.size() && tracks[t].object == object && tracks[t].attribute == attribute)
+    return t;
+  return -1;
+}
+
+void AnimationData::insertKey(int at, const AnimationKey &key)
+{
+  times.insert(times.begin() + at, key.time);
+  values.insert(values.begin() + at, makeVec3(key.value[0], key.value[1], key.value[2]));
+  interpolations.insert(interpolations.begin() + at, (quint8)key.interpolation);
+  outControls.insert(outControls.begin() + at, Vec3());
+  inControls.insert(inControls.begin() + at, Vec3());
+}
+
+void AnimationData::eraseKeys(int at, int count)
+{
+  times.erase(times.begin() + at, times.begin() + at + count);
+  values.erase(values.begin() + at, values.begin() + at + count);
+  interpolations.erase(interpolations.begin() + at, interpolations.begin() + at + count);
+  outControls.erase(outControls.begin() + at, outControls.begin() + at + count);
+  inControls.erase(inControls.begin() + at, inControls.begin() + at + count);
+}
+
+void AnimationData::shiftKeys(int fromTrack, int delta)
+{
+  for (size_t t = fromTrack; t < tracks.size(); t++)
+    tracks[t].firstKey += delta;
+}
+
+// Bezier segments of a track after its keys changed. Curved segments take
+// the slope between the neighbouring keys at each end, and none at the
+// track's first and last key.
+void AnimationData::updateControls(int track)
+{
+  const AnimationTrack &t = tracks[track];
+  const double *time = &times[t.firstKey];
+  const Vec3 *value = &values[t.firstKey];
+  for (int k = 0; k < t.keyCount; k++)
+  {
+    int key = t.firstKey + k;
+    if (k == t.keyCount - 1)
+    {
+      outControls[key] = inControls[key] = value[k];
+      continue;
+    }
+    double span = time[k + 1] - time[k];
+    for (int c = 0; c < 3; c++)
+    {
+      double step = (value[k + 1][c] - value[k][c]) / 3.0;
+      if (interpolations[key] == BezierKey)
+      {
+        double startSlope = k > 0 ? (value[k + 1][c] - value[k - 1][c]) / (time[k + 1] - time[k - 1]) : 0.0;
+        double endSlope = k + 2 < t.keyCount ? (value[k + 2][c] - value[k][c]) / (time[k + 2] - time[k]) : 0.0;
+        outControls[key][c] = value[k][c] + startSlope * span / 3.0;
+        inControls[key][c] = value[k + 1][c] - endSlope * span / 3.0;
+      }
+      else
+      {
+        outControls[key][c] = value[k][c] + step;
+        inControls[key][c] = value[k + 1][c] - step;
+      }
+    }
+  }
+}
+
+/*************/
+/* INTERFACE */
+/*************/
+
+// Shared by every empty animation, so that the many short-lived SceneData
+// copies don't each allocate one
+static const QSharedDataPointer<AnimationData> &emptyData()
+{
+  static const QSharedDataPointer<AnimationData> empty(new AnimationData);
+  return empty;
+}
+
+SceneAnimation::SceneAnimation() : d(emptyData()) {}
+SceneAnimation::SceneAnimation(const SceneAnimation &other) : d(other.d) {}
+SceneAnimation::~SceneAnimation() {}
+
+SceneAnimation &SceneAnimation::operator=(const SceneAnimation &other)
+{
+  d = other.d;
+  return *this;
+}
+
+bool SceneAnimation::isEmpty() const { return d->tracks.empty(); }
+int SceneAnimation::trackCount() const { return (int)d->tracks.size(); }
+int SceneAnimation::keyCount() const { return (int)d->times.size(); }
+int SceneAnimation::trackObject(int track) const { return d->tracks[track].object; }
+int SceneAnimation::trackAttribute(int track) const { return d->tracks[track].attribute; }
+
+double SceneAnimation::duration() const
+{
+  double last = 0.0;
+  for (size_t t = 0; t < d->tracks.size(); t++)
+    last = qMax(last, d->times[d->tracks[t].firstKey + d->tracks[t].keyCount - 1]);
+  return last;
+}
+
+void SceneAnimation::setKey(int object, int attribute, const AnimationKey &key)
+{
+  AnimationData &data = *d;
+  int t = data.findTrack(object, attribute);
+  if (t < 0)
+  {
+    t = data.lowerBound(object, attribute);
+    AnimationTrack track = { object, attribute, t < (int)data.tracks.size() ? data.tracks[t].firstKey : (int)data.times.size(), 0 };
+    data.tracks.insert(data.tracks.begin() + t, track);
+  }
+
+  AnimationTrack &track = data.tracks[t];
+  std::vector<double>::iterator begin = data.times.begin() + track.firstKey, end = begin + track.keyCount;
+  int at = (int)(std::lower_bound(begin, end, key.time - timeEpsilon) - data.times.begin());
+  if (at < track.firstKey + track.keyCount && fabs(data.times[at] - key.time) < timeEpsilon)
+  {
+    data.values[at] = makeVec3(key.value[0], key.value[1], key.value[2]);
+    data.interpolations[at] = (quint8)key.interpolation;
+  }
+  else
+  {
+    data.insertKey(at, key);
+    track.keyCount++;
+    data.shiftKeys(t + 1, 1);
+  }
+  data.updateControls(t);
+}
+
+bool SceneAnimation::removeKeys(int object, double time)
+{
+  bool removed = false;
+  for (int attribute = 0; attribute < AnimatedAttributes; attribute++)
+  {
+    int t = d->findTrack(object, attribute);
+    if (t < 0)
+      continue;
+    AnimationData &data = *d;
+    AnimationTrack &track = data.tracks[t];
+    for (int k = track.firstKey; k < track.firstKey + track.keyCount; k++)
+    {
+      if (fabs(data.times[k] - time) >= timeEpsilon)
+        continue;
+      data.eraseKeys(k, 1);
+      data.shiftKeys(t + 1, -1);
+      if (--track.keyCount == 0)
+        data.tracks.erase(data.tracks.begin() + t);
+      else
+        data.updateControls(t);
+      removed = true;
+      break;
+    }
+  }
+  return removed;
+}
+
+bool SceneAnimation::isAnimated(int object, int attribute) const
+{
+  return d->findTrack(object, attribute) >= 0;
+}
+
+QVector<double> SceneAnimation::keyTimes(int object) const
+{
+  QVector<double> result;
+  const AnimationData &data = *d;
+  int first = data.lowerBound(object, 0), last = data.lowerBound(object + 1, 0);
+  for (int t = first; t < last; t++)
+    for (int k = 0; k < data.tracks[t].keyCount; k++)
+      result.append(data.times[data.tracks[t].firstKey + k]);
+  std::sort(result.begin(), result.end());
+  QVector<double> unique;
+  for (int i = 0; i < result.size(); i++)
+    if (unique.isEmpty() || result[i] - unique.last() >= timeEpsilon)
+      unique.append(result[i]);
+  return unique;
+}
+
+void SceneAnimation::appendTrack(int object, int attribute, const QVector<AnimationKey> &keys)
+{
+  if (keys.isEmpty())
+    return;
+  const AnimationData &current = *d;
+  bool inOrder = current.tracks.empty() || current.tracks.back().object < object ||
+                 (current.tracks.back().object == object && current.tracks.back().attribute < attribute);
+  for (int k = 1; k < keys.size() && inOrder; k++)
+    inOrder = keys[k].time - keys[k - 1].time >= timeEpsilon;
+  if (!inOrder)
+  {
+    for (int k = 0; k < keys.size(); k++)
+      setKey(object, attribute, keys[k]);
+    return;
+  }
+
+  AnimationData &data = *d;
+  AnimationTrack track = { object, attribute, (int)data.times.size(), keys.size() };
+  for (int k = 0; k < keys.size(); k++)
+    data.insertKey((int)data.times.size(), keys[k]);
+  data.tracks.push_back(track);
+  data.updateControls((int)data.tracks.size() - 1);
+}
+
+void SceneAnimation::removeObject(int object)
+{
+  int first = d->lowerBound(object, 0), last = d->lowerBound(object + 1, 0);
+  if (first == last && (first == (int)d->tracks.size() || d->tracks.back().object < object))
+    return; // Nothing to remove, nothing to renumber
+
+  AnimationData &data = *d;
+  if (first < last)
+  {
+    int firstKey = data.tracks[first].firstKey;
+    int keys = data.tracks[last - 1].firstKey + data.tracks[last - 1].keyCount - firstKey;
+    data.eraseKeys(firstKey, keys);
+    data.tracks.erase(data.tracks.begin() + first, data.tracks.begin() + last);
+    data.shiftKeys(first, -keys);
+  }
+  for (size_t t = first; t < data.tracks.size(); t++)
+    data.tracks[t].object--;
+}
+
+void SceneAnimation::append(const SceneAnimation &other, int objectOffset)
+{
+  if (other.isEmpty())
+    return;
+  if (isEmpty() && objectOffset == 0)
+  {
+    d = other.d;
+    return;
+  }
+  AnimationData &data = *d;
+  const AnimationData &from = *other.d;
+  int keyOffset = (int)data.times.size();
+  for (size_t t = 0; t < from.tracks.size(); t++)
+  {
+    AnimationTrack track = from.tracks[t];
+    track.object += objectOffset;
+    track.firstKey += keyOffset;
+    data.tracks.push_back(track);
+  }
+  data.times.insert(data.times.end(), from.times.begin(), from.times.end());
+  data.values.insert(data.values.end(), from.values.begin(), from.values.end());
+  data.interpolations.insert(data.interpolations.end(), from.interpolations.begin(), from.interpolations.end());
+  data.outControls.insert(data.outControls.end(), from.outControls.begin(), from.outControls.end());
+  data.inControls.insert(data.inControls.end(), from.inControls.begin(), from.inControls.end());
+}
+
+QVector<AnimationKey> SceneAnimation::trackKeys(int track) const
+{
+  const AnimationData &data = *d;
+  const AnimationTrack &t = data.tracks[track];
+  QVector<AnimationKey> keys(t.keyCount);
+  for (int k = 0; k < t.keyCount; k++)
+  {
+    keys[k].time = data.times[t.firstKey + k];
+    for (int c = 0; c < 3; c++)
+      keys[k].value[c] = data.values[t.firstKey + k][c];
+    keys[k].interpolation = data.interpolations[t.firstKey + k];
+  }
+  return keys;
+}
+
+qint64 SceneAnimation::memoryUsage() const
+{
+  const AnimationData &data = *d;
+  return (qint64)data.tracks.capacity() * sizeof(AnimationTrack) + (qint64)data.times.capacity() * sizeof(double) +
+         (qint64)(data.values.capacity() + data.outControls.capacity() + data.inControls.capacity()) * sizeof(Vec3) +
+         (qint64)data.interpolations.capacity();
+}
+
+/**************/
+/* EVALUATION */
+/**************/
+
+struct EvaluateJob
+{
+  const AnimationData *data;
+  int first, count;
+  double time;
+  int objectCount;
+  Vec3 *const *chunks[AnimatedAttributes]; // Detached chunk of each attribute array, null where not animated
+};
+
+// Gather each track's segment, blend its four points, scatter the results
+static void evaluateTracks(EvaluateJob &job)
+{
+  const AnimationData &data = *job.data;
+  double points[4][3][evaluateBlock]; // Start, two controls, end; component-major
+  double weights[4][evaluateBlock];
+  double result[3][evaluateBlock];
+
+  for (int start = job.first; start < job.first + job.count; start += evaluateBlock)
+  {
+    int n = qMin(evaluateBlock, job.first + job.count - start);
+    for (int i = 0; i < n; i++)
+    {
+      const AnimationTrack &track = data.tracks[start + i];
+      const double *times = &data.times[track.firstKey];
+      int k = (int)(std::upper_bound(times, times + track.keyCount, job.time) - times) - 1;
+      double u = 0.0;
+      if (k < 0)
+        k = 0;
+      else if (k < track.keyCount - 1)
+        u = (job.time - times[k]) / (times[k + 1] - times[k]);
+      else
+        k = track.keyCount - 1;
+      int key = track.firstKey + k, next = track.firstKey + qMin(k + 1, track.keyCount - 1);
+
+      const Vec3 *segment[4] = { &data.values[key], &data.outControls[key], &data.inControls[key], &data.values[next] };
+      for (int p = 0; p < 4; p++)
+        for (int c = 0; c < 3; c++)
+          points[p][c][i] = (*segment[p])[c];
+      double v = 1.0 - u;
+      weights[0][i] = v * v * v;
+      weights[1][i] = 3.0 * u * v * v;
+      weights[2][i] = 3.0 * u * u * v;
+      weights[3][i] = u * u * u;
+    }
+
+    for (int c = 0; c < 3; c++)
+    {
+      int i = 0;
+#ifdef __SSE2__
+      for (; i + 2 <= n; i += 2)
+      {
+        __m128d sum = _mm_mul_pd(_mm_loadu_pd(&weights[0][i]), _mm_loadu_pd(&points[0][c][i]));
+        sum = _mm_add_pd(sum, _mm_mul_pd(_mm_loadu_pd(&weights[1][i]), _mm_loadu_pd(&points[1][c][i])));
+        sum = _mm_add_pd(sum, _mm_mul_pd(_mm_loadu_pd(&weights[2][i]), _mm_loadu_pd(&points[2][c][i])));
+        sum = _mm_add_pd(sum, _mm_mul_pd(_mm_loadu_pd(&weights[3][i]), _mm_loadu_pd(&points[3][c][i])));
+        _mm_storeu_pd(&result[c][i], sum);
+      }
+#endif
+      for (; i < n; i++)
+        result[c][i] = weights[0][i] * points[0][c][i] + weights[1][i] * points[1][c][i] +
+                       weights[2][i] * points[2][c][i] + weights[3][i] * points[3][c][i];
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+      const AnimationTrack &track = data.tracks[start + i];
+      if (track.object >= job.objectCount)
+        continue;
+      Vec3 &out = job.chunks[track.attribute][track.object / CowArray<Vec3>::ChunkSize][track.object & CowArray<Vec3>::ChunkMask];
+      for (int c = 0; c < 3; c++)
+        out[c] = result[c][i];
+    }
+  }
+}
+
+void SceneAnimation::evaluate(double time, SceneData &scene) const
+{
+  TRACE_SCOPE("SceneAnimation::evaluate");
+  const AnimationData &data = *d;
+  if (data.tracks.empty())
+    return;
+
+  // Detach what the tasks write to up front; they then write through raw
+  // pointers, each to its own objects
+  CowArray<Vec3> *arrays[AnimatedAttributes] = { &scene.translates, &scene.rotations, &scene.scales, &scene.colors };
+  std::vector<Vec3 *> chunks[AnimatedAttributes];
+  for (int a = 0; a < AnimatedAttributes; a++)
+    chunks[a].assign(arrays[a]->chunkCount(), (Vec3 *)0);
+  int objectCount = scene.size();
+  for (size_t t = 0; t < data.tracks.size(); t++)
+  {
+    const AnimationTrack &track = data.tracks[t];
+    if (track.object >= objectCount)
+      break; // Sorted by object
+    Vec3 *&chunk = chunks[track.attribute][track.object / CowArray<Vec3>::ChunkSize];
+    if (!chunk)
+      chunk = arrays[track.attribute]->chunkData(track.object / CowArray<Vec3>::ChunkSize);
+  }
+
+  QVector<EvaluateJob> jobs;
+  for (int first = 0; first < (int)data.tracks.size(); first += evaluateJob)
+  {
+    EvaluateJob job;
+    job.data = &data;
+    job.first = first;
+    job.count = qMin(evaluateJob, (int)data.tracks.size() - first);
+    job.time = time;
+    job.objectCount = objectCount;
+    for (int a = 0; a < AnimatedAttributes; a++)
+      job.chunks[a] = chunks[a].data();
+    jobs.append(job);
+  }
+  if (jobs.size() == 1)
+    evaluateTracks(jobs[0]);
+  else
+    QtConcurrent::blockingMap(jobs, evaluateTracks);
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <QtCore>
+#include <QSharedDataPointer>
+
+struct Vec3;
+struct SceneData;
+struct AnimationData;
+
+enum AnimatedAttribute { AnimateTranslate, AnimateRotate, AnimateScale, AnimateColor, AnimatedAttributes };
+
+// How the value moves from a key to the next one: in a straight line, or
+// along a curve whose tangents run from the key before to the key after,
+// which eases into and out of the first and last keys
+enum KeyInterpolation { LinearKey, BezierKey };
+
+struct AnimationKey
+{
+  double time; // Seconds
+  double value[3];
+  int interpolation;
+};
+
+// Keyframe tracks of a scene, one per animated attribute of an object.
+//
+// All tracks share one set of arrays: the tracks are sorted by object and
+// attribute, and the keys of a track lie next to each other, sorted by
+// time. With every key its segment to the next one is stored as a cubic
+// Bezier, linear segments included, so evaluation is the same few
+// multiplies for every track, done a block of tracks at a time.
+//
+// Copies share the arrays until one of them changes, like SceneData.
+class SceneAnimation
+{
+public:
+  SceneAnimation();
+  SceneAnimation(const SceneAnimation &other);
+  ~SceneAnimation();
+  SceneAnimation &operator=(const SceneAnimation &other);
+
+  bool isEmpty() const;
+  int trackCount() const;
+  int keyCount() const;
+  double duration() const; // Time of the last key
+
+  // Adds the key, or replaces the one at the same time
+  void setKey(int object, int attribute, const AnimationKey &key);
+
+  // Removes the object's keys at time, of every attribute; false if none
+  bool removeKeys(int object, double time);
+
+  bool isAnimated(int object, int attribute) const;
+
+  // Times of the object's keys of any attribute, sorted, each once
+  QVector<double> keyTimes(int object) const;
+
+  // Adds a whole track; faster than setKey key by key when the track sorts
+  // after every existing one and its keys by time, as when reading a file
+  void appendTrack(int object, int attribute, const QVector<AnimationKey> &keys);
+
+  // Keeps track indices in step with the scene's objects
+  void removeObject(int object);
+  void append(const SceneAnimation &other, int objectOffset);
+
+  // Tracks in storage order, for writing
+  int trackObject(int track) const;
+  int trackAttribute(int track) const;
+  QVector<AnimationKey> trackKeys(int track) const;
+
+  // Overwrites the animated attributes of scene's objects with their values
+  // at time. Blocks of tracks are evaluated on the global thread pool; only
+  // the scene chunks that hold animated objects are detached, and nothing
+  // is allocated per object.
+  void evaluate(double time, SceneData &scene) const;
+
+  qint64 memoryUsage() const;
+
+private:
+  QSharedDataPointer<AnimationData> d;
+};
@@ -0,0 +1,307 @@
+#include "scene_bvh.h"
+#include <algorithm>
+#include <cfloat>
+#include "primitive_geometry.h"
+#include "scene_math.h"
+#include "trace.h"
+
+static const int leafSize = 4;     // Items per leaf at most
+static const int maxDepth = 64;    // Traversal stack; median splits stay far below this
+static const double hitEpsilon = 1e-6; // Nearer hits are the ray's own surface
+
+/************/
+/* BUILDING */
+/************/
+
+// Orders items by the center of their box along one axis
+struct CenterLess
+{
+  const std::vector<float> &boxes;
+  int axis;
+
+  bool operator()(int a, int b) const
+  {
+    return boxes[a * 6 + axis] + boxes[a * 6 + 3 + axis] < boxes[b * 6 + axis] + boxes[b * 6 + 3 + axis];
+  }
+};
+
+// Median split along the widest axis of the item centers; quick to build,
+// which matters as the scene's tree is built for every bake
+static void buildNode(std::vector<BvhNode> &nodes, int node, std::vector<int> &items, int begin, int end,
+                      const std::vector<float> &boxes)
+{
+  float low[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, high[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+  float centerLow[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, centerHigh[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+  for (int i = begin; i < end; i++)
+  {
+    const float *box = &boxes[items[i] * 6];
+    for (int a = 0; a < 3; a++)
+    {
+      low[a] = qMin(low[a], box[a]);
+      high[a] = qMax(high[a], box[3 + a]);
+      float center = 0.5f * (box[a] + box[3 + a]);
+      centerLow[a] = qMin(centerLow[a], center);
+      centerHigh[a] = qMax(centerHigh[a], center);
+    }
+  }
+  for (int a = 0; a < 3; a++)
+  {
+    nodes[node].min[a] = low[a];
+    nodes[node].max[a] = high[a];
+  }
+
+  int axis = 0;
+  for (int a = 1; a < 3; a++)
+    if (centerHigh[a] - centerLow[a] > centerHigh[axis] - centerLow[axis])
+      axis = a;
+  if (end - begin <= leafSize || centerHigh[axis] == centerLow[axis])
+  {
+    nodes[node].first = begin;
+    nodes[node].count = end - begin;
+    return;
+  }
+
+  int mid = (begin + end) / 2;
+  CenterLess less = { boxes, axis };
+  std::nth_element(items.begin() + begin, items.begin() + mid, items.begin() + end, less);
+  int children = (int)nodes.size();
+  nodes.resize(children + 2);
+  nodes[node].first = children;
+  nodes[node].count = 0;
+  buildNode(nodes, children, items, begin, mid, boxes);
+  buildNode(nodes, children + 1, items, mid, end, boxes);
+}
+
+// Tree over count boxes (min xyz, max xyz each); returns the items in leaf order
+static std::vector<int> buildTree(std::vector<BvhNode> &nodes, const std::vector<float> &boxes, int count)
+{
+  std::vector<int> items(count);
+  for (int i = 0; i < count; i++)
+    items[i] = i;
+  nodes.assign(1, BvhNode());
+  if (count == 0)
+  {
+    for (int a = 0; a < 3; a++)
+      nodes[0].min[a] = nodes[0].max[a] = 0.0f;
+    nodes[0].first = 0;
+    nodes[0].count = -1; // Empty: neither inner nor leaf
+    return items;
+  }
+  buildNode(nodes, 0, items, 0, count, boxes);
+  return items;
+}
+
+// Triangles of the default primitive meshes in leaf order, nine floats each
+struct MeshTree
+{
+  std::vector<BvhNode> nodes;
+  std::vector<float> triangles;
+};
+
+struct MeshTrees
+{
+  MeshTree trees[7];
+
+  MeshTrees()
+  {
+    for (int type = 0; type < 7; type++)
+    {
+      const MeshData &mesh = primitiveMesh(type);
+      int count = mesh.indexCount / 3;
+      std::vector<float> boxes(count * 6);
+      for (int t = 0; t < count; t++)
+        for (int a = 0; a < 3; a++)
+        {
+          boxes[t * 6 + a] = FLT_MAX;
+          boxes[t * 6 + 3 + a] = -FLT_MAX;
+          for (int c = 0; c < 3; c++)
+          {
+            float p = mesh.positions[mesh.indices[t * 3 + c] * 3 + a];
+            boxes[t * 6 + a] = qMin(boxes[t * 6 + a], p);
+            boxes[t * 6 + 3 + a] = qMax(boxes[t * 6 + 3 + a], p);
+          }
+        }
+
+      MeshTree &tree = trees[type];
+      std::vector<int> order = buildTree(tree.nodes, boxes, count);
+      tree.triangles.resize(count * 9);
+      for (int t = 0; t < count; t++)
+        for (int c = 0; c < 3; c++)
+          for (int a = 0; a < 3; a++)
+            tree.triangles[t * 9 + c * 3 + a] = mesh.positions[mesh.indices[order[t] * 3 + c] * 3 + a];
+    }
+  }
+};
+
+static const MeshTrees &meshTrees()
+{
+  static const MeshTrees trees;
+  return trees;
+}
+
+SceneBvh::SceneBvh(const SceneData &scene)
+{
+  TRACE_SCOPE("SceneBvh::SceneBvh");
+  const MeshTrees &trees = meshTrees();
+  std::vector<Instance> objects;
+  std::vector<float> boxes;
+  objects.reserve(scene.size());
+  boxes.reserve(scene.size() * 6);
+  for (int i = 0; i < scene.size(); i++)
+  {
+    Instance instance;
+    instance.object = i;
+    instance.type = scene.objects[i];
+    if (instance.type < 0 || instance.type > 6)
+      continue;
+    double model[16];
+    objectMatrix(scene.translates[i].v, scene.rotations[i].v, scene.scales[i].v, model);
+    if (!invertAffine(model, instance.inverse))
+      continue;
+
+    // World box of the mesh's box
+    const BvhNode &root = trees.trees[instance.type].nodes[0];
+    double center[3], extent[3];
+    for (int a = 0; a < 3; a++)
+    {
+      center[a] = model[12 + a];
+      extent[a] = 0.0;
+      for (int c = 0; c < 3; c++)
+      {
+        center[a] += model[c * 4 + a] * 0.5 * (root.min[c] + root.max[c]);
+        extent[a] += fabs(model[c * 4 + a]) * 0.5 * (root.max[c] - root.min[c]);
+      }
+    }
+    for (int a = 0; a < 3; a++)
+      boxes.push_back(center[a] - extent[a]);
+    for (int a = 0; a < 3; a++)
+      boxes.push_back(center[a] + extent[a]);
+    objects.push_back(instance);
+  }
+
+  std::vector<int> order = buildTree(nodes, boxes, (int)objects.size());
+  instances.resize(objects.size());
+  for (size_t i = 0; i < order.size(); i++)
+    instances[i] = objects[order[i]];
+}
+
+qint64 SceneBvh::memoryUsage() const
+{
+  return (qint64)nodes.capacity() * sizeof(BvhNode) + (qint64)instances.capacity() * sizeof(Instance);
+}
+
+/********/
+/* RAYS */
+/********/
+
+static bool hitsBox(const BvhNode &node, const double origin[3], const double inverseDirection[3], double maxT)
+{
+  double enter = 0.0, leave = maxT;
+  for (int a = 0; a < 3; a++)
+  {
+    double t0 = (node.min[a] - origin[a]) * inverseDirection[a];
+    double t1 = (node.max[a] - origin[a]) * inverseDirection[a];
+    if (t0 > t1)
+      std::swap(t0, t1);
+    enter = qMax(enter, t0);
+    leave = qMin(leave, t1);
+    if (enter > leave)
+      return false;
+  }
+  return true;
+}
+
+// Moller-Trumbore, both sides
+static bool hitsTriangle(const float *triangle, const double origin[3], const double direction[3], double maxT)
+{
+  double e1[3], e2[3], s[3];
+  for (int a = 0; a < 3; a++)
+  {
+    e1[a] = triangle[3 + a] - triangle[a];
+    e2[a] = triangle[6 + a] - triangle[a];
+    s[a] = origin[a] - triangle[a];
+  }
+  double p[3] = { direction[1] * e2[2] - direction[2] * e2[1], direction[2] * e2[0] - direction[0] * e2[2],
+                  direction[0] * e2[1] - direction[1] * e2[0] };
+  double det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+  if (fabs(det) < 1e-14)
+    return false;
+  double inv = 1.0 / det;
+  double u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * inv;
+  if (u < 0.0 || u > 1.0)
+    return false;
+  double q[3] = { s[1] * e1[2] - s[2] * e1[1], s[2] * e1[0] - s[0] * e1[2], s[0] * e1[1] - s[1] * e1[0] };
+  double v = (direction[0] * q[0] + direction[1] * q[1] + direction[2] * q[2]) * inv;
+  if (v < 0.0 || u + v > 1.0)
+    return false;
+  double t = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * inv;
+  return t > hitEpsilon && t < maxT;
+}
+
+static void inverseOf(const double direction[3], double inverse[3])
+{
+  for (int a = 0; a < 3; a++)
+    inverse[a] = direction[a] != 0.0 ? 1.0 / direction[a] : (direction[a] < 0.0 ? -DBL_MAX : DBL_MAX);
+}
+
+// The ray keeps its t along the way: the direction is moved into object
+// space as it is, without normalizing it
+bool SceneBvh::instanceOccluded(const Instance &instance, const double origin[3], const double direction[3], double maxT) const
+{
+  const double *m = instance.inverse;
+  double o[3], d[3], inverseDirection[3];
+  for (int a = 0; a < 3; a++)
+  {
+    o[a] = m[a] * origin[0] + m[4 + a] * origin[1] + m[8 + a] * origin[2] + m[12 + a];
+    d[a] = m[a] * direction[0] + m[4 + a] * direction[1] + m[8 + a] * direction[2];
+  }
+  inverseOf(d, inverseDirection);
+
+  const MeshTree &tree = meshTrees().trees[instance.type];
+  int stack[maxDepth], depth = 0;
+  stack[depth++] = 0;
+  while (depth > 0)
+  {
+    const BvhNode &node = tree.nodes[stack[--depth]];
+    if (node.count < 0 || !hitsBox(node, o, inverseDirection, maxT))
+      continue;
+    if (node.count > 0)
+    {
+      for (int t = node.first; t < node.first + node.count; t++)
+        if (hitsTriangle(&tree.triangles[t * 9], o, d, maxT))
+          return true;
+    }
+    else if (depth + 2 <= maxDepth)
+    {
+      stack[depth++] = node.first + 1;
+      stack[depth++] = node.first;
+    }
+  }
+  return false;
+}
+
+bool SceneBvh::occluded(const double origin[3], const double direction[3], double maxT, int skip) const
+{
+  double inverseDirection[3];
+  inverseOf(direction, inverseDirection);
+  int stack[maxDepth], depth = 0;
+  stack[depth++] = 0;
+  while (depth > 0)
+  {
+    const BvhNode &node = nodes[stack[--depth]];
+    if (node.count < 0 || !hitsBox(node, origin, inverseDirection, maxT))
+      continue;
+    if (node.count > 0)
+    {
+      for (int i = node.first; i < node.first + node.count; i++)
+        if (instances[i].object != skip && instanceOccluded(instances[i], origin, direction, maxT))
+          return true;
+    }
+    else if (depth + 2 <= maxDepth)
+    {
+      stack[depth++] = node.first + 1;
+      stack[depth++] = node.first;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <QtCore>
+#include <vector>
+#include "scene_data.h"
+
+// Bounding volume hierarchy node: a box, and either two children (count 0,
+// the children at first and first + 1) or count items from first
+struct BvhNode
+{
+  float min[3], max[3];
+  int first, count;
+};
+
+// Ray queries against the objects of a scene, for baking.
+//
+// Two levels: every primitive type has a tree over its triangles in object
+// space, built once, and the scene has a tree over its objects' world
+// space bounds. A ray that reaches an object goes on into the tree of its
+// type, moved into object space, so thousands of copies of the same mesh
+// cost one small tree. Never changed once built; safe from any thread.
+class SceneBvh
+{
+public:
+  explicit SceneBvh(const SceneData &scene);
+
+  // Whether anything but the object skip lies on origin + t * direction
+  // for 0 < t < maxT; both sides of every triangle count
+  bool occluded(const double origin[3], const double direction[3], double maxT, int skip) const;
+
+  int objectCount() const { return (int)instances.size(); }
+  qint64 memoryUsage() const;
+
+private:
+  struct Instance
+  {
+    int object;
+    int type;
+    double inverse[16]; // World to object space
+  };
+
+  bool instanceOccluded(const Instance &instance, const double origin[3], const double direction[3], double maxT) const;
+
+  std::vector<BvhNode> nodes;
+  std::vector<Instance> instances; // In tree order; objects with a singular matrix are left out
+};
@@ -0,0 +1,581 @@
+#include "scene_codec.h"
+#include <QtConcurrentMap>
+#include <cmath>
+#include <cstring>
+#include "memory_stats.h"
+#include "trace.h"
+
+static const char sceneMagic[4] = { 'V', 'O', 'X', 'C' };
+static const int sceneVersion = 4; // 2 adds the preview section after the header, 3 the animation after the blocks, 4 the meshes after that
+static const int headerSize = 16;
+static const quint32 maxPreviewSize = 4 << 20;
+static const int blockSize = CowArray<Vec3>::ChunkSize; // One block per CowArray chunk
+
+/***************/
+/* HALF FLOATS */
+/***************/
+
+// IEEE binary16 with round to nearest even
+static quint16 toHalf(double value)
+{
+  float f = (float)value;
+  quint32 bits;
+  memcpy(&bits, &f, 4);
+
+  quint32 sign = (bits >> 16) & 0x8000;
+  int exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+  quint32 mantissa = bits & 0x7fffff;
+
+  if (((bits >> 23) & 0xff) == 0xff) // Inf and NaN
+    return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+  if (exponent >= 31) // Overflow
+    return sign | 0x7c00;
+  if (exponent <= 0) // Denormal or zero
+  {
+    if (exponent < -10)
+      return sign;
+    mantissa |= 0x800000;
+    int shift = 14 - exponent;
+    quint32 half = mantissa >> shift;
+    quint32 rest = mantissa & ((1u << shift) - 1), midpoint = 1u << (shift - 1);
+    if (rest > midpoint || (rest == midpoint && (half & 1)))
+      half++;
+    return sign | half;
+  }
+
+  quint32 half = (exponent << 10) | (mantissa >> 13);
+  quint32 rest = mantissa & 0x1fff;
+  if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+    half++; // May carry into the exponent, which rounds up to the next power of two (or Inf)
+  return sign | half;
+}
+
+static double fromHalf(quint16 half)
+{
+  quint32 sign = (half & 0x8000) << 16;
+  quint32 exponent = (half >> 10) & 0x1f;
+  quint32 mantissa = half & 0x3ff;
+  quint32 bits;
+
+  if (exponent == 0)
+  {
+    if (mantissa == 0)
+      bits = sign;
+    else
+    {
+      // Renormalize the denormal
+      exponent = 127 - 15 + 1;
+      while (!(mantissa & 0x400))
+      {
+        mantissa <<= 1;
+        exponent--;
+      }
+      bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+    }
+  }
+  else if (exponent == 31)
+    bits = sign | 0x7f800000 | (mantissa << 13);
+  else
+    bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+
+  float f;
+  memcpy(&f, &bits, 4);
+  return f;
+}
+
+/**********************/
+/* VARINTS AND DELTAS */
+/**********************/
+
+static void putVarint(QByteArray &out, quint64 value)
+{
+  while (value >= 0x80)
+  {
+    out.append((char)((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  out.append((char)value);
+}
+
+static bool getVarint(const uchar *&data, const uchar *end, quint64 &value)
+{
+  value = 0;
+  for (int shift = 0; shift < 64 && data < end; shift += 7)
+  {
+    uchar byte = *data++;
+    value |= (quint64)(byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+      return true;
+  }
+  return false;
+}
+
+static quint64 zigzag(qint64 value) { return ((quint64)value << 1) ^ (quint64)(value >> 63); }
+static qint64 unzigzag(quint64 value) { return (qint64)(value >> 1) ^ -(qint64)(value & 1); }
+
+/**********/
+/* BLOCKS */
+/**********/
+
+struct CodecBlock
+{
+  // Encoding input
+  const SceneData *scene;
+  int first;
+  SceneEncoding encoding;
+  IoProgress *progress; // May be null
+
+  // Encoded block, and the decoded objects
+  int count;
+  QByteArray packed;
+  QVector<int> objects;
+  QVector<Vec3> translates, rotations, scales, colors;
+  bool ok;
+};
+
+static double fixedScale(int decimals)
+{
+  return pow(10.0, qBound(0, decimals, 9));
+}
+
+// Each component is coded as its own run of deltas, which keeps the
+// repeated values of typical scenes (unit scales, zero rotations) tiny
+static void encodeVectors(QByteArray &out, const CowArray<Vec3> &vectors, int first, int count, const SceneEncoding &encoding)
+{
+  double scale = fixedScale(encoding.fixedPointDecimals);
+  for (int c = 0; c < 3; c++)
+  {
+    qint64 previous = 0;
+    for (int i = first; i < first + count; i++)
+    {
+      double value = vectors[i][c];
+      qint64 quantized = (encoding.transforms == SceneEncoding::HalfFloat) ? (qint64)toHalf(value) : (qint64)floor(qBound(-1e15, value * scale, 1e15) + 0.5);
+      putVarint(out, zigzag(quantized - previous));
+      previous = quantized;
+    }
+  }
+}
+
+static bool decodeVectors(const uchar *&data, const uchar *end, QVector<Vec3> &vectors, int count, int transforms, int decimals)
+{
+  double scale = 1.0 / fixedScale(decimals);
+  vectors.resize(count);
+  for (int c = 0; c < 3; c++)
+  {
+    qint64 previous = 0;
+    for (int i = 0; i < count; i++)
+    {
+      quint64 delta;
+      if (!getVarint(data, end, delta))
+        return false;
+      previous += unzigzag(delta);
+      vectors[i][c] = (transforms == SceneEncoding::HalfFloat) ? fromHalf((quint16)previous) : previous * scale;
+    }
+  }
+  return true;
+}
+
+static void encodeBlock(CodecBlock &block)
+{
+  if (block.progress && block.progress->isCancelled())
+    return;
+
+  const SceneData &scene = *block.scene;
+  QByteArray raw;
+  raw.reserve(block.count * 24);
+
+  for (int i = block.first; i < block.first + block.count; i++)
+    raw.append((char)scene.objects[i]);
+
+  encodeVectors(raw, scene.translates, block.first, block.count, block.encoding);
+  encodeVectors(raw, scene.rotations, block.first, block.count, block.encoding);
+  encodeVectors(raw, scene.scales, block.first, block.count, block.encoding);
+
+  // Colors always come from 8 bit QColor values
+  for (int c = 0; c < 3; c++)
+  {
+    uchar previous = 0;
+    for (int i = block.first; i < block.first + block.count; i++)
+    {
+      uchar quantized = (uchar)qBound(0, (int)floor(scene.colors[i][c] * 255.0 + 0.5), 255);
+      raw.append((char)(uchar)(quantized - previous));
+      previous = quantized;
+    }
+  }
+
+  block.packed = qCompress(raw, block.encoding.compressionLevel);
+  if (block.progress)
+    block.progress->advance(block.count);
+}
+
+static void decodeBlock(CodecBlock &block)
+{
+  block.ok = false;
+  if (block.progress && block.progress->isCancelled())
+    return;
+  QByteArray raw = qUncompress(block.packed);
+  const uchar *data = (const uchar *)raw.constData();
+  const uchar *end = data + raw.size();
+  int count = block.count;
+
+  if (raw.size() < count * 13) // Type, nine varints and three color bytes per object at least
+    return;
+
+  block.objects.resize(count);
+  for (int i = 0; i < count; i++)
+    block.objects[i] = *data++;
+
+  int transforms = block.encoding.transforms, decimals = block.encoding.fixedPointDecimals;
+  if (!decodeVectors(data, end, block.translates, count, transforms, decimals) ||
+      !decodeVectors(data, end, block.rotations, count, transforms, decimals) ||
+      !decodeVectors(data, end, block.scales, count, transforms, decimals))
+    return;
+
+  if (end - data != count * 3)
+    return;
+  block.colors.resize(count);
+  for (int c = 0; c < 3; c++)
+  {
+    uchar previous = 0;
+    for (int i = 0; i < count; i++)
+    {
+      previous += *data++;
+      block.colors[i][c] = previous / 255.0;
+    }
+  }
+  block.packed.clear();
+  block.ok = true;
+  if (block.progress)
+    block.progress->advance(count);
+}
+
+/*************/
+/* ANIMATION */
+/*************/
+
+// Keys are few next to objects and must not drift when saved again, so
+// they are stored at full precision and compressed as one section
+static QByteArray encodeAnimation(const SceneAnimation &animation)
+{
+  QByteArray raw;
+  QDataStream stream(&raw, QIODevice::WriteOnly);
+  stream.setByteOrder(QDataStream::LittleEndian);
+  stream << (quint32)animation.trackCount();
+  for (int t = 0; t < animation.trackCount(); t++)
+  {
+    QVector<AnimationKey> keys = animation.trackKeys(t);
+    stream << (quint32)animation.trackObject(t) << (quint8)animation.trackAttribute(t) << (quint32)keys.size();
+    for (int k = 0; k < keys.size(); k++)
+      stream << keys[k].time << (quint8)keys[k].interpolation << keys[k].value[0] << keys[k].value[1] << keys[k].value[2];
+  }
+  return qCompress(raw, 1);
+}
+
+static bool decodeAnimation(const QByteArray &packed, SceneAnimation &animation, quint32 objectCount)
+{
+  QByteArray raw = qUncompress(packed);
+  QDataStream stream(raw);
+  stream.setByteOrder(QDataStream::LittleEndian);
+  quint32 trackCount;
+  stream >> trackCount;
+  for (quint32 t = 0; t < trackCount && stream.status() == QDataStream::Ok; t++)
+  {
+    quint32 object, keyCount;
+    quint8 attribute;
+    stream >> object >> attribute >> keyCount;
+    if (object >= objectCount || attribute >= AnimatedAttributes || keyCount > (quint32)raw.size())
+      return false;
+    QVector<AnimationKey> keys(keyCount);
+    for (quint32 k = 0; k < keyCount; k++)
+    {
+      quint8 interpolation;
+      stream >> keys[k].time >> interpolation >> keys[k].value[0] >> keys[k].value[1] >> keys[k].value[2];
+      keys[k].interpolation = interpolation == BezierKey ? BezierKey : LinearKey;
+    }
+    animation.appendTrack(object, attribute, keys);
+  }
+  return stream.status() == QDataStream::Ok;
+}
+
+/**********/
+/* MESHES */
+/**********/
+
+// Cages as their vertices and polygons, at full precision like the keys;
+// the surfaces are subdivided again when read
+static QByteArray encodeMeshes(const SceneMeshes &meshes)
+{
+  QByteArray raw;
+  QDataStream stream(&raw, QIODevice::WriteOnly);
+  stream.setByteOrder(QDataStream::LittleEndian);
+  stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
+  QList<int> objects = meshes.objects();
+  stream << (quint32)objects.size();
+  for (int m = 0; m < objects.size(); m++)
+  {
+    const MeshObject &mesh = *meshes.find(objects[m]);
+    std::vector<int> faceStarts, corners;
+    mesh.cage.polygons(faceStarts, corners);
+    const std::vector<float> &positions = mesh.cage.vertexPositions();
+    stream << (quint32)objects[m] << (quint8)mesh.level << (quint32)mesh.cage.vertexCount() << (quint32)mesh.cage.faceCount()
+           << (quint32)corners.size();
+    for (size_t k = 0; k < positions.size(); k++)
+      stream << positions[k];
+    for (int f = 0; f < mesh.cage.faceCount(); f++)
+      stream << (quint32)(faceStarts[f + 1] - faceStarts[f]);
+    for (size_t c = 0; c < corners.size(); c++)
+      stream << (quint32)corners[c];
+  }
+  return qCompress(raw, 1);
+}
+
+static bool decodeMeshes(const QByteArray &packed, SceneMeshes &meshes, quint32 objectCount)
+{
+  QByteArray raw = qUncompress(packed);
+  QDataStream stream(raw);
+  stream.setByteOrder(QDataStream::LittleEndian);
+  stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
+  quint32 meshCount;
+  stream >> meshCount;
+  for (quint32 m = 0; m < meshCount && stream.status() == QDataStream::Ok; m++)
+  {
+    quint32 object, vertexCount, faceCount, cornerCount;
+    quint8 level;
+    stream >> object >> level >> vertexCount >> faceCount >> cornerCount;
+    if (object >= objectCount || vertexCount > (quint32)raw.size() || faceCount > (quint32)raw.size() || cornerCount > (quint32)raw.size())
+      return false;
+    std::vector<float> positions(vertexCount * 3);
+    for (size_t k = 0; k < positions.size(); k++)
+      stream >> positions[k];
+    std::vector<int> faceStarts(faceCount + 1, 0), corners(cornerCount);
+    for (quint32 f = 0; f < faceCount; f++)
+    {
+      quint32 size;
+      stream >> size;
+      if (size > cornerCount - faceStarts[f])
+        return false;
+      faceStarts[f + 1] = faceStarts[f] + size;
+    }
+    for (quint32 c = 0; c < cornerCount; c++)
+    {
+      quint32 corner;
+      stream >> corner;
+      if (corner >= vertexCount)
+        return false;
+      corners[c] = corner;
+    }
+    HalfEdgeMesh cage;
+    if (stream.status() != QDataStream::Ok || faceStarts[faceCount] != (int)cornerCount || !cage.build(positions, faceStarts, corners))
+      return false;
+    meshes.setMesh(object, cage, level);
+  }
+  return stream.status() == QDataStream::Ok;
+}
+
+/*************/
+/* INTERFACE */
+/*************/
+
+QByteArray encodeScene(const SceneData &scene, const SceneEncoding &encoding, IoProgress *progress, const QByteArray &preview)
+{
+  TRACE_SCOPE("encodeScene");
+  int count = scene.size();
+  if (progress)
+    progress->begin(IoProgress::Encoding, count);
+  QVector<CodecBlock> blocks((count + blockSize - 1) / blockSize);
+  for (int b = 0; b < blocks.size(); b++)
+  {
+    blocks[b].scene = &scene;
+    blocks[b].first = b * blockSize;
+    blocks[b].count = qMin(blockSize, count - b * blockSize);
+    blocks[b].encoding = encoding;
+    blocks[b].progress = progress;
+  }
+  QtConcurrent::blockingMap(blocks, encodeBlock);
+  if (progress && progress->isCancelled())
+    return QByteArray();
+
+  QByteArray out;
+  QDataStream stream(&out, QIODevice::WriteOnly);
+  stream.setByteOrder(QDataStream::LittleEndian);
+  stream.writeRawData(sceneMagic, 4);
+  stream << (quint8)sceneVersion << (quint8)encoding.transforms << (quint8)qBound(0, encoding.fixedPointDecimals, 9) << (quint8)0;
+  stream << (quint32)count << (quint32)blocks.size();
+  stream << (quint32)preview.size();
+  stream.writeRawData(preview.constData(), preview.size());
+  for (int b = 0; b < blocks.size(); b++)
+  {
+    stream << (quint32)blocks[b].packed.size();
+    stream.writeRawData(blocks[b].packed.constData(), blocks[b].packed.size());
+  }
+  QByteArray animation = encodeAnimation(scene.animation);
+  stream << (quint32)animation.size();
+  stream.writeRawData(animation.constData(), animation.size());
+  QByteArray meshes = encodeMeshes(scene.meshes);
+  stream << (quint32)meshes.size();
+  stream.writeRawData(meshes.constData(), meshes.size());
+  return out;
+}
+
+bool decodeScene(const QByteArray &data, SceneData &scene, IoProgress *progress)
+{
+  TRACE_SCOPE("decodeScene");
+  if (data.size() < headerSize || memcmp(data.constData(), sceneMagic, 4) != 0)
+    return false;
+
+  QDataStream stream(data);
+  stream.setByteOrder(QDataStream::LittleEndian);
+  stream.skipRawData(4);
+  quint8 version, transforms, decimals, reserved;
+  quint32 count, blockCount;
+  stream >> version >> transforms >> decimals >> reserved >> count >> blockCount;
+  if (version < 1 || version > sceneVersion || transforms > SceneEncoding::HalfFloat || blockCount != (count + blockSize - 1) / blockSize)
+    return false;
+  if (version >= 2)
+  {
+    quint32 previewSize;
+    stream >> previewSize;
+    if (stream.status() != QDataStream::Ok || previewSize > maxPreviewSize || stream.skipRawData(previewSize) != (int)previewSize)
+      return false;
+  }
+
+  QVector<CodecBlock> blocks(blockCount);
+  for (int b = 0; b < blocks.size(); b++)
+  {
+    quint32 size;
+    stream >> size;
+    if (stream.status() != QDataStream::Ok || size > (quint32)data.size())
+      return false;
+    // Blocks point into data instead of copying it; it outlives them
+    int offset = stream.device()->pos();
+    if (stream.skipRawData(size) != (int)size)
+      return false;
+    blocks[b].packed = QByteArray::fromRawData(data.constData() + offset, size);
+    blocks[b].count = qMin(blockSize, (int)count - b * blockSize);
+    blocks[b].encoding.transforms = (SceneEncoding::TransformFormat)transforms;
+    blocks[b].encoding.fixedPointDecimals = decimals;
+    blocks[b].progress = progress;
+  }
+  if (progress)
+    progress->begin(IoProgress::Decoding, count);
+  QtConcurrent::blockingMap(blocks, decodeBlock);
+
+  for (int b = 0; b < blocks.size(); b++)
+    if (!blocks[b].ok)
+      return false;
+
+  SceneAnimation animation;
+  if (version >= 3)
+  {
+    quint32 size;
+    stream >> size;
+    if (stream.status() != QDataStream::Ok || size > (quint32)data.size())
+      return false;
+    QByteArray packed = QByteArray::fromRawData(data.constData() + stream.device()->pos(), size);
+    if (stream.skipRawData(size) != (int)size || !decodeAnimation(packed, animation, count))
+      return false;
+  }
+  SceneMeshes meshes;
+  if (version >= 4)
+  {
+    quint32 size;
+    stream >> size;
+    if (stream.status() != QDataStream::Ok || size > (quint32)data.size())
+      return false;
+    QByteArray packed = QByteArray::fromRawData(data.constData() + stream.device()->pos(), size);
+    if (stream.skipRawData(size) != (int)size || !decodeMeshes(packed, meshes, count))
+      return false;
+  }
+  scene.animation.append(animation, scene.size());
+  scene.meshes.append(meshes, scene.size());
+
+  for (int b = 0; b < blocks.size(); b++)
+  {
+    const CodecBlock &block = blocks[b];
+    if ((scene.size() & (blockSize - 1)) == 0)
+    {
+      // Blocks line up with chunks, hand them over without copying
+      scene.objects.appendChunk(block.objects);
+      scene.translates.appendChunk(block.translates);
+      scene.rotations.appendChunk(block.rotations);
+      scene.scales.appendChunk(block.scales);
+      scene.colors.appendChunk(block.colors);
+    }
+    else
+    {
+      for (int i = 0; i < block.count; i++)
+      {
+        scene.objects.push_back(block.objects[i]);
+        scene.translates.push_back(block.translates[i]);
+        scene.rotations.push_back(block.rotations[i]);
+        scene.scales.push_back(block.scales[i]);
+        scene.colors.push_back(block.colors[i]);
+      }
+    }
+  }
+  return true;
+}
+
+bool isEncodedSceneFile(const QString &fileName)
+{
+  QFile inFile(fileName);
+  if (!inFile.open(QIODevice::ReadOnly))
+    return false;
+  return inFile.read(4) == QByteArray(sceneMagic, 4);
+}
+
+// Reads the header and the preview behind it, nothing else
+bool readEncodedScenePreview(const QString &fileName, QByteArray &preview)
+{
+  QFile inFile(fileName);
+  if (!inFile.open(QIODevice::ReadOnly))
+    return false;
+  QByteArray header = inFile.read(headerSize + 4);
+  if (header.size() < headerSize + 4 || memcmp(header.constData(), sceneMagic, 4) != 0 || (quint8)header[4] < 2)
+    return false;
+  quint32 previewSize = qFromLittleEndian<quint32>((const uchar *)header.constData() + headerSize);
+  if (previewSize == 0 || previewSize > maxPreviewSize)
+    return false;
+  preview = inFile.read(previewSize);
+  return preview.size() == (int)previewSize;
+}
+
+bool readEncodedSceneFile(const QString &fileName, SceneData &scene, IoProgress *progress)
+{
+  QByteArray data;
+  MemoryCharge charge(IoMemory);
+  if (!readWholeFile(fileName, data, progress))
+    return false;
+  charge.resize(data.size());
+  return decodeScene(data, scene, progress);
+}
+
+// Read in 1 MB pieces, so progress moves and a cancel is noticed
+bool readWholeFile(const QString &fileName, QByteArray &data, IoProgress *progress)
+{
+  QFile inFile(fileName);
+  if (!inFile.open(QIODevice::ReadOnly))
+    return false;
+  if (!progress)
+  {
+    data = inFile.readAll();
+    return true;
+  }
+
+  const qint64 pieceSize = 1 << 20;
+  qint64 size = inFile.size();
+  progress->begin(IoProgress::Reading, size / pieceSize + 1);
+  data.resize(size);
+  qint64 offset = 0;
+  while (offset < size)
+  {
+    if (progress->isCancelled())
+      return false;
+    qint64 read = inFile.read(data.data() + offset, qMin(pieceSize, size - offset));
+    if (read <= 0)
+      return false;
+    offset += read;
+    progress->advance(1);
+  }
+  return true;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <QtCore>
+#include "scene_data.h"
+#include "io_progress.h"
+
+// How a scene is written to disk. The compact format quantizes colors to
+// 8 bits and transforms to fixed point or half floats, delta codes each
+// component, and compresses every block of ChunkSize objects on its own,
+// so blocks can be encoded and decoded in parallel.
+struct SceneEncoding
+{
+  enum Format { Text, Compact };
+  enum TransformFormat { FixedPoint, HalfFloat };
+
+  Format format;
+  TransformFormat transforms;
+  int fixedPointDecimals; // Fixed point step is 10^-decimals; 3 matches the edit spinboxes
+  int compressionLevel;   // zlib level per block, low is fast
+  bool preview;           // Store counts, bounds and a thumbnail up front for the open dialog
+
+  SceneEncoding() : format(Text), transforms(FixedPoint), fixedPointDecimals(3), compressionLevel(1), preview(true) {}
+};
+
+// Progress is reported in objects; a cancelled encode returns no data.
+// The preview (see scene_preview.h) is stored right after the header, the
+// animation keys after the blocks, and the mesh cages after those.
+QByteArray encodeScene(const SceneData &scene, const SceneEncoding &encoding, IoProgress *progress = 0,
+                       const QByteArray &preview = QByteArray());
+
+// Append the objects of an encoded scene; false if the data is not a valid
+// compact scene or decoding was cancelled, in which case nothing is appended
+bool decodeScene(const QByteArray &data, SceneData &scene, IoProgress *progress = 0);
+
+// True if the file starts with the compact format's magic
+bool isEncodedSceneFile(const QString &fileName);
+bool readEncodedSceneFile(const QString &fileName, SceneData &scene, IoProgress *progress = 0);
+
+// The encoded preview of a compact file; false if it has none
+bool readEncodedScenePreview(const QString &fileName, QByteArray &preview);
+
+// All of a file; false if it cannot be read or reading was cancelled
+bool readWholeFile(const QString &fileName, QByteArray &data, IoProgress *progress = 0);
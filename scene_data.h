@@ -0,0 +1,57 @@
+#pragma once
+
+#include <QtCore>
+#include "cow_array.h"
+#include "scene_animation.h"
+#include "scene_meshes.h"
+
+// Three doubles stored inline, so per-object attributes need no heap blocks
+struct Vec3
+{
+  double v[3];
+
+  double &operator[](int i) { return v[i]; }
+  double operator[](int i) const { return v[i]; }
+};
+Q_DECLARE_TYPEINFO(Vec3, Q_PRIMITIVE_TYPE);
+
+inline Vec3 makeVec3(double x, double y, double z)
+{
+  Vec3 vec;
+  vec.v[0] = x; vec.v[1] = y; vec.v[2] = z;
+  return vec;
+}
+
+// All modelling data of a scene. Copying is cheap (see CowArray), which is
+// what background writers use to take a consistent snapshot.
+struct SceneData
+{
+  CowArray<int> objects; // Holds the object types; 0 = Plane, 1 = Cube, 2 = Sphere, 3 = Cone, 4 = Cylinder, 5 = Pyramid, 6 = Wedge
+  CowArray<Vec3> translates;
+  CowArray<Vec3> rotations;
+  CowArray<Vec3> scales;
+  CowArray<Vec3> colors;
+  SceneAnimation animation; // Keys of the above; these arrays hold the rest pose
+  SceneMeshes meshes;       // Objects drawn as subdivided cages instead of their primitives
+
+  int size() const { return objects.size(); }
+};
+
+// Append the objects of another scene, sharing its chunks where possible
+inline void appendScene(SceneData &scene, const SceneData &other)
+{
+  scene.animation.append(other.animation, scene.size());
+  scene.meshes.append(other.meshes, scene.size());
+  scene.objects.append(other.objects);
+  scene.translates.append(other.translates);
+  scene.rotations.append(other.rotations);
+  scene.scales.append(other.scales);
+  scene.colors.append(other.colors);
+}
+
+inline qint64 sceneMemoryUsage(const SceneData &scene)
+{
+  return scene.objects.memoryUsage() + scene.translates.memoryUsage() + scene.rotations.memoryUsage() +
+         scene.scales.memoryUsage() + scene.colors.memoryUsage() + scene.animation.memoryUsage() +
+         scene.meshes.memoryUsage();
+}
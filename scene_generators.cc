@@ -0,0 +1,200 @@
+#include "scene_generators.h"
+#include <cmath>
+
+namespace {
+
+// Small deterministic generator, so a seed means the same scene everywhere
+class Random
+{
+public:
+  Random(quint32 seed) : state(seed * 2654435761u + 1) {}
+
+  quint32 next()
+  {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+  }
+
+  double uniform(double low, double high) { return low + (high - low) * (next() / 4294967296.0); }
+  int below(int n) { return (int)(next() % (quint32)n); }
+
+  // Colors are stored as 8 bit values, like the ones QColorDialog hands out
+  Vec3 color() { return makeVec3(below(256) / 255.0, below(256) / 255.0, below(256) / 255.0); }
+
+private:
+  quint32 state;
+};
+
+// Appends objects until the requested count is reached
+class Emitter
+{
+public:
+  Emitter(SceneData &scene, int count) : scene(scene), remaining(count) {}
+
+  bool full() const { return remaining <= 0; }
+
+  void add(int type, const Vec3 &translate, const Vec3 &rotate, const Vec3 &scale, const Vec3 &color)
+  {
+    if (remaining <= 0)
+      return;
+    scene.objects.push_back(type);
+    scene.translates.push_back(translate);
+    scene.rotations.push_back(rotate);
+    scene.scales.push_back(scale);
+    scene.colors.push_back(color);
+    remaining--;
+  }
+
+private:
+  SceneData &scene;
+  int remaining;
+};
+
+const Vec3 noRotation = { { 0.0, 0.0, 0.0 } };
+const Vec3 upright = { { -90.0, 0.0, 0.0 } }; // Turns the z axis of cones and cylinders to y
+
+/**************/
+/* GENERATORS */
+/**************/
+
+// Cubes on a square grid, colored by position
+void generateGrid(Emitter &out, int count)
+{
+  int side = (int)ceil(sqrt((double)count));
+  for (int i = 0; !out.full(); i++)
+  {
+    int x = i % side, z = i / side;
+    Vec3 color = makeVec3(qRound(255.0 * x / side) / 255.0, 0.5, qRound(255.0 * z / side) / 255.0);
+    out.add(1, makeVec3((x - side / 2) * 1.5, 0.5, (z - side / 2) * 1.5), noRotation, makeVec3(1.0, 1.0, 1.0), color);
+  }
+}
+
+// Random types, placement, orientation and size inside a cube whose volume grows with the count
+void generateScatter(Emitter &out, int count, Random &random)
+{
+  double extent = 2.0 * cbrt((double)count);
+  while (!out.full())
+  {
+    Vec3 translate = makeVec3(random.uniform(-extent, extent), random.uniform(0.0, extent), random.uniform(-extent, extent));
+    Vec3 rotate = makeVec3(random.uniform(0.0, 360.0), random.uniform(0.0, 360.0), random.uniform(0.0, 360.0));
+    double size = random.uniform(0.5, 1.5);
+    out.add(1 + random.below(6), translate, rotate, makeVec3(size, size, size), random.color());
+  }
+}
+
+// Stacks of cubes, each carrying four half-sized stacks on its corners,
+// grown breadth first so every level is complete before the next starts
+void generateFractal(Emitter &out, int count, Random &random)
+{
+  struct Node { double x, y, z, size; int depth; };
+  QVector<Node> queue;
+  Node root = { 0.0, 4.0, 0.0, 8.0, 0 };
+  queue.append(root);
+
+  QVector<Vec3> palette;
+  for (int i = 0; i < 16; i++)
+    palette.append(random.color());
+
+  for (int head = 0; head < queue.size() && !out.full(); head++)
+  {
+    Node node = queue.at(head);
+    out.add(1, makeVec3(node.x, node.y, node.z), noRotation, makeVec3(node.size, node.size, node.size), palette.at(node.depth % palette.size()));
+
+    double offset = node.size / 4.0, child = node.size / 2.0;
+    for (int c = 0; c < 4 && queue.size() < count; c++)
+    {
+      Node next = { node.x + ((c & 1) ? offset : -offset), node.y + node.size / 2.0 + child / 2.0,
+                    node.z + ((c & 2) ? offset : -offset), child, node.depth + 1 };
+      queue.append(next);
+    }
+  }
+}
+
+// City blocks: a paved plane per block with buildings on a 3x3 lot grid.
+// Buildings are boxes or towers with a roof, which mixes in all seven types.
+void generateCity(Emitter &out, int count, Random &random)
+{
+  const double lot = 4.0, street = 3.0, block = 3 * lot + street;
+  int blocks = qMax(1, count / 22); // Roughly the objects per block
+  int side = (int)ceil(sqrt((double)blocks));
+  Vec3 pavement = makeVec3(0.4, 0.4, 0.4);
+
+  for (int b = 0; !out.full(); b++)
+  {
+    double blockX = (b % side - side / 2) * block, blockZ = (b / side - side / 2) * block;
+    out.add(0, makeVec3(blockX, 0.0, blockZ), noRotation, makeVec3(3 * lot, 1.0, 3 * lot), pavement);
+
+    for (int l = 0; l < 9 && !out.full(); l++)
+    {
+      double x = blockX + (l % 3 - 1) * lot, z = blockZ + (l / 3 - 1) * lot;
+      double height = random.uniform(2.0, 20.0), width = random.uniform(2.0, 3.5);
+      Vec3 color = random.color();
+
+      if (random.below(3) == 0)
+      {
+        // Round tower with a cone or a dome
+        out.add(4, makeVec3(x, height / 2.0, z), upright, makeVec3(width, width, height), color);
+        if (random.below(2) == 0)
+          out.add(3, makeVec3(x, height + 1.0, z), upright, makeVec3(width, width, 2.0), color);
+        else
+          out.add(2, makeVec3(x, height, z), noRotation, makeVec3(width, width, width), color);
+      }
+      else
+      {
+        // Box with a pyramid or wedge roof
+        out.add(1, makeVec3(x, height / 2.0, z), noRotation, makeVec3(width, height, width), color);
+        if (random.below(2) == 0)
+          out.add(5, makeVec3(x, height + 0.75, z), noRotation, makeVec3(width, 1.5, width), color);
+        else
+          out.add(6, makeVec3(x, height + 0.75, z), makeVec3(0.0, 90.0 * random.below(4), 0.0), makeVec3(width, 1.5, width), color);
+      }
+    }
+  }
+}
+
+} // namespace
+
+QString generatorName(GeneratorKind kind)
+{
+  static const char *names[GeneratorKinds] = { "grid", "scatter", "fractal", "city" };
+  return (kind >= 0 && kind < GeneratorKinds) ? names[kind] : "";
+}
+
+bool parseGeneratorSpec(const QString &spec, GeneratorParams &params)
+{
+  QStringList parts = spec.split(':');
+  if (parts.size() < 2 || parts.size() > 3)
+    return false;
+
+  int kind = 0;
+  while (kind < GeneratorKinds && generatorName((GeneratorKind)kind) != parts.at(0).toLower())
+    kind++;
+  if (kind == GeneratorKinds)
+    return false;
+
+  bool ok = true;
+  params.kind = (GeneratorKind)kind;
+  params.count = parts.at(1).toInt(&ok);
+  if (!ok || params.count <= 0)
+    return false;
+  if (parts.size() == 3)
+    params.seed = parts.at(2).toUInt(&ok);
+  return ok;
+}
+
+void generateScene(const GeneratorParams &params, SceneData &scene)
+{
+  Random random(params.seed);
+  Emitter out(scene, params.count);
+
+  switch (params.kind)
+  {
+  case GridGenerator: generateGrid(out, params.count); break;
+  case ScatterGenerator: generateScatter(out, params.count, random); break;
+  case FractalGenerator: generateFractal(out, params.count, random); break;
+  case CityGenerator: generateCity(out, params.count, random); break;
+  default: break;
+  }
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <QtCore>
+#include "scene_data.h"
+
+// Procedural stress scenes for reproducing performance problems
+enum GeneratorKind { GridGenerator, ScatterGenerator, FractalGenerator, CityGenerator, GeneratorKinds };
+
+struct GeneratorParams
+{
+  GeneratorKind kind;
+  int count;    // Objects to generate
+  quint32 seed; // Same seed, same scene
+
+  GeneratorParams() : kind(GridGenerator), count(10000), seed(1) {}
+};
+
+QString generatorName(GeneratorKind kind);
+
+// "kind:count[:seed]", e.g. "city:200000" or "scatter:50000:7"
+bool parseGeneratorSpec(const QString &spec, GeneratorParams &params);
+
+// Append params.count objects straight to the scene store
+void generateScene(const GeneratorParams &params, SceneData &scene);
@@ -0,0 +1,550 @@
+#include "scene_io.h"
+#include "scene_math.h"
+#include "primitive_geometry.h"
+#include "scene_preview.h"
+#include "streamed_scene.h"
+#include "memory_stats.h"
+#include "trace.h"
+#include <cstdio>
+#include <cstring>
+#include <QTextStream>
+#include <QFile>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+static const int progressStep = CowArray<Vec3>::ChunkSize; // Objects between progress reports
+
+static bool writeVectors(QTextStream &outStream, const CowArray<Vec3> &vectors, IoProgress *progress)
+{
+  for (int j = 0; j < vectors.size(); j++)
+  {
+    const Vec3 &vec = vectors[j];
+    for (int i = 0; i < 3; i++)
+      outStream << vec[i] << ',';
+    outStream << ';';
+
+    if (progress && (j + 1) % progressStep == 0)
+    {
+      progress->advance(progressStep);
+      if (progress->isCancelled())
+        return false;
+    }
+  }
+  if (progress)
+    progress->advance(vectors.size() % progressStep);
+  return true;
+}
+
+// Optional first line of a text file: the tag, then the encoded preview in base64
+static const char textPreviewTag[] = "#preview ";
+
+// Optional lines after the colors, one per animation track:
+// "#track object,attribute,;time,interpolation,x,y,z,;..."
+static const char textTrackTag[] = "#track ";
+
+static void writeTracks(QTextStream &outStream, const SceneAnimation &animation)
+{
+  for (int t = 0; t < animation.trackCount(); t++)
+  {
+    outStream << endl << textTrackTag << animation.trackObject(t) << ',' << animation.trackAttribute(t) << ",;";
+    QVector<AnimationKey> keys = animation.trackKeys(t);
+    for (int k = 0; k < keys.size(); k++)
+    {
+      outStream << keys[k].time << ',' << keys[k].interpolation << ',';
+      for (int i = 0; i < 3; i++)
+        outStream << keys[k].value[i] << ',';
+      outStream << ';';
+    }
+  }
+}
+
+// Optional lines after the tracks, one per object that is a mesh:
+// "#mesh object,level,vertices,;x,y,z,;...;corner,corner,...,;..." with
+// the vertices first, then a face per element. Older readers skip them.
+static const char textMeshTag[] = "#mesh ";
+
+static void writeMeshes(QTextStream &outStream, const SceneMeshes &meshes)
+{
+  QList<int> objects = meshes.objects();
+  for (int m = 0; m < objects.size(); m++)
+  {
+    const MeshObject &mesh = *meshes.find(objects[m]);
+    const HalfEdgeMesh &cage = mesh.cage;
+    outStream << endl << textMeshTag << objects[m] << ',' << mesh.level << ',' << cage.vertexCount() << ",;";
+    for (int v = 0; v < cage.vertexCount(); v++)
+    {
+      const float *p = cage.position(v);
+      outStream << p[0] << ',' << p[1] << ',' << p[2] << ",;";
+    }
+    std::vector<int> faceStarts, corners;
+    cage.polygons(faceStarts, corners);
+    for (int f = 0; f + 1 < (int)faceStarts.size(); f++)
+    {
+      for (int c = faceStarts[f]; c < faceStarts[f + 1]; c++)
+        outStream << corners[c] << ',';
+      outStream << ';';
+    }
+  }
+}
+
+bool writeScene(QIODevice *device, const SceneData &scene, const SceneEncoding &encoding, IoProgress *progress)
+{
+  QByteArray preview;
+  if (encoding.preview)
+    preview = encodePreview(makeScenePreview(scene));
+
+  if (encoding.format == SceneEncoding::Compact)
+  {
+    QByteArray data = encodeScene(scene, encoding, progress, preview);
+    MemoryCharge charge(IoMemory, data.size());
+    if (progress && progress->isCancelled())
+      return false;
+
+    // Written in 1 MB pieces for the same reason
+    const int pieceSize = 1 << 20;
+    if (progress)
+      progress->begin(IoProgress::Writing, data.size() / pieceSize + 1);
+    for (int offset = 0; offset < data.size(); offset += pieceSize)
+    {
+      if (progress && progress->isCancelled())
+        return false;
+      device->write(data.constData() + offset, qMin(pieceSize, data.size() - offset));
+      if (progress)
+        progress->advance(1);
+    }
+    return true;
+  }
+
+  // One unit per object per line
+  if (progress)
+    progress->begin(IoProgress::Writing, 5 * (qint64)scene.size());
+  QTextStream outStream(device);
+  if (!preview.isEmpty())
+    outStream << textPreviewTag << preview.toBase64() << endl;
+
+  for (int i = 0; i < scene.objects.size(); i++)
+    outStream << scene.objects[i] << ',';
+  outStream << endl;
+  if (progress)
+    progress->advance(scene.size());
+
+  bool ok = writeVectors(outStream, scene.translates, progress);
+  outStream << endl;
+  ok = ok && writeVectors(outStream, scene.rotations, progress);
+  outStream << endl;
+  ok = ok && writeVectors(outStream, scene.scales, progress);
+  outStream << endl;
+  ok = ok && writeVectors(outStream, scene.colors, progress);
+  if (ok)
+  {
+    writeTracks(outStream, scene.animation);
+    writeMeshes(outStream, scene.meshes);
+  }
+  outStream.flush();
+  return ok;
+}
+
+bool writeSceneFile(const QString &fileName, const SceneData &scene, const SceneEncoding &encoding, IoProgress *progress)
+{
+  TRACE_SCOPE("writeSceneFile");
+  QString tempName = fileName + ".tmp";
+  QFile outFile(tempName);
+  if (!outFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    return false;
+
+  bool ok = writeScene(&outFile, scene, encoding, progress);
+  ok = ok && outFile.flush() && outFile.error() == QFile::NoError;
+#ifndef Q_OS_WIN
+  // Make sure the data hits the disk before the rename does
+  if (ok)
+    ok = fsync(outFile.handle()) == 0;
+#endif
+  outFile.close();
+
+  if (!ok)
+  {
+    QFile::remove(tempName);
+    return false;
+  }
+  return replaceFile(tempName, fileName);
+}
+
+// Reports parse progress in 64 KB steps of the input
+struct ParseProgress
+{
+  IoProgress *progress;
+  const char *start;
+  qint64 reported;
+
+  bool update(const char *position)
+  {
+    if (!progress)
+      return true;
+    qint64 steps = (position - start) >> 16;
+    if (steps > reported)
+    {
+      progress->advance(steps - reported);
+      reported = steps;
+    }
+    return !progress->isCancelled();
+  }
+};
+
+static const char *findChar(const char *from, const char *to, char c)
+{
+  const char *found = (const char *)memchr(from, c, to - from);
+  return found ? found : to;
+}
+
+// Plain decimals are parsed in place: up to 19 digits into an integer, then
+// one multiply or divide by an exact power of ten, which is correctly
+// rounded while the digits fit in 53 bits and the power is at most 1e22.
+// Anything else (exponents, long digit strings, junk) goes to Qt.
+static double parseNumber(const char *from, const char *to)
+{
+  static const double powers[23] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                     1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+  const char *p = from;
+  bool negative = p < to && *p == '-';
+  if (p < to && (*p == '-' || *p == '+'))
+    p++;
+
+  quint64 mantissa = 0;
+  int digits = 0, fraction = 0;
+  bool point = false;
+  for (; p < to; p++)
+  {
+    if (*p >= '0' && *p <= '9')
+    {
+      if (mantissa == 0 && *p == '0')
+      {
+        if (point)
+          fraction++;
+        continue;
+      }
+      if (++digits > 19)
+        break;
+      mantissa = mantissa * 10 + (*p - '0');
+      if (point)
+        fraction++;
+    }
+    else if (*p == '.' && !point)
+      point = true;
+    else
+      break;
+  }
+
+  if (p == to && p != from && fraction <= 22 && mantissa <= ((quint64)1 << 53))
+  {
+    double value = (double)mantissa / powers[fraction];
+    return negative ? -value : value;
+  }
+  return QByteArray::fromRawData(from, to - from).toDouble();
+}
+
+// One line of "x,y,z,;x,y,z,;..." with at most limit entries; like the old
+// parser, a trailing piece without its separator is ignored
+static bool parseVectors(const char *&p, const char *end, CowArray<Vec3> &vectors, int limit, ParseProgress &parse)
+{
+  const char *lineEnd = findChar(p, end, '\n');
+  while (p < lineEnd && vectors.size() < limit)
+  {
+    const char *elementEnd = findChar(p, lineEnd, ';');
+    if (elementEnd == lineEnd)
+      break;
+    Vec3 vec = makeVec3(0.0, 0.0, 0.0);
+    for (int j = 0; j < 3; j++)
+    {
+      const char *comma = findChar(p, elementEnd, ',');
+      if (comma == elementEnd)
+        break;
+      vec[j] = parseNumber(p, comma);
+      p = comma + 1;
+    }
+    vectors.push_back(vec);
+    p = elementEnd + 1;
+    if (!parse.update(p))
+      return false;
+  }
+  p = lineEnd < end ? lineEnd + 1 : end;
+  return true;
+}
+
+// Comma terminated numbers up to the end of an element; false if fewer than count
+static bool parseFields(const char *&p, const char *elementEnd, double *fields, int count)
+{
+  for (int i = 0; i < count; i++)
+  {
+    const char *comma = findChar(p, elementEnd, ',');
+    if (comma == elementEnd)
+      return false;
+    fields[i] = parseNumber(p, comma);
+    p = comma + 1;
+  }
+  return true;
+}
+
+// Track lines; ones for objects or attributes the scene lacks are skipped
+static void parseTracks(const char *p, const char *end, SceneAnimation &animation, int count)
+{
+  const int tagLength = sizeof(textTrackTag) - 1;
+  while (p < end)
+  {
+    const char *lineEnd = findChar(p, end, '\n');
+    if (lineEnd - p > tagLength && memcmp(p, textTrackTag, tagLength) == 0)
+    {
+      p += tagLength;
+      const char *elementEnd = findChar(p, lineEnd, ';');
+      double header[2];
+      if (elementEnd < lineEnd && parseFields(p, elementEnd, header, 2) && header[0] >= 0 && header[0] < count &&
+          header[1] >= 0 && header[1] < AnimatedAttributes)
+      {
+        QVector<AnimationKey> keys;
+        for (p = elementEnd + 1; (elementEnd = findChar(p, lineEnd, ';')) < lineEnd; p = elementEnd + 1)
+        {
+          double fields[5];
+          if (!parseFields(p, elementEnd, fields, 5))
+            continue;
+          AnimationKey key;
+          key.time = fields[0];
+          key.interpolation = fields[1] == BezierKey ? BezierKey : LinearKey;
+          for (int i = 0; i < 3; i++)
+            key.value[i] = fields[2 + i];
+          keys.append(key);
+        }
+        animation.appendTrack((int)header[0], (int)header[1], keys);
+      }
+    }
+    p = lineEnd < end ? lineEnd + 1 : end;
+  }
+}
+
+// Mesh lines; ones for objects the scene lacks, or whose cage isn't a
+// manifold mesh, are skipped and leave the primitive
+static void parseMeshes(const char *p, const char *end, SceneMeshes &meshes, int count)
+{
+  const int tagLength = sizeof(textMeshTag) - 1;
+  while (p < end)
+  {
+    const char *lineEnd = findChar(p, end, '\n');
+    if (lineEnd - p > tagLength && memcmp(p, textMeshTag, tagLength) == 0)
+    {
+      p += tagLength;
+      const char *elementEnd = findChar(p, lineEnd, ';');
+      double header[3];
+      if (elementEnd < lineEnd && parseFields(p, elementEnd, header, 3) && header[0] >= 0 && header[0] < count &&
+          header[2] >= 0 && header[2] <= lineEnd - p)
+      {
+        int vertexCount = (int)header[2];
+        std::vector<float> positions;
+        std::vector<int> faceStarts(1, 0), corners;
+        positions.reserve(vertexCount * 3);
+        bool ok = true;
+        for (p = elementEnd + 1; ok && (elementEnd = findChar(p, lineEnd, ';')) < lineEnd; p = elementEnd + 1)
+        {
+          if ((int)positions.size() < vertexCount * 3)
+          {
+            double fields[3] = { 0.0, 0.0, 0.0 };
+            ok = parseFields(p, elementEnd, fields, 3);
+            for (int i = 0; i < 3; i++)
+              positions.push_back((float)fields[i]);
+            continue;
+          }
+          for (const char *comma; (comma = findChar(p, elementEnd, ',')) < elementEnd; p = comma + 1)
+          {
+            double corner = parseNumber(p, comma);
+            ok = ok && corner >= 0 && corner < vertexCount;
+            corners.push_back((int)corner);
+          }
+          faceStarts.push_back((int)corners.size());
+        }
+        HalfEdgeMesh cage;
+        if (ok && (int)positions.size() == vertexCount * 3 && cage.build(positions, faceStarts, corners))
+          meshes.setMesh((int)header[0], cage, (int)header[1]);
+      }
+    }
+    p = lineEnd < end ? lineEnd + 1 : end;
+  }
+}
+
+static void padVectors(CowArray<Vec3> &vectors, int count, const Vec3 &value)
+{
+  while (vectors.size() < count)
+    vectors.push_back(value);
+}
+
+// The text format has the object types on the first line, then one line
+// each of translates, rotations, scales and colors, then the tracks and
+// meshes
+static bool parseTextScene(const QByteArray &data, SceneData &scene, IoProgress *progress)
+{
+  const char *p = data.constData(), *end = p + data.size();
+  ParseProgress parse = { progress, p, 0 };
+  if (progress)
+    progress->begin(IoProgress::Decoding, (data.size() >> 16) + 1);
+
+  // Skip the preview line and any other comment lines in front
+  while (p < end && *p == '#')
+  {
+    const char *commentEnd = findChar(p, end, '\n');
+    p = commentEnd < end ? commentEnd + 1 : end;
+  }
+
+  const char *lineEnd = findChar(p, end, '\n');
+  while (p < lineEnd)
+  {
+    const char *comma = findChar(p, lineEnd, ',');
+    if (comma == lineEnd)
+      break;
+    scene.objects.push_back((int)parseNumber(p, comma));
+    p = comma + 1;
+    if (!parse.update(p))
+      return false;
+  }
+  p = lineEnd < end ? lineEnd + 1 : end;
+
+  int count = scene.objects.size();
+  if (!parseVectors(p, end, scene.translates, count, parse) || !parseVectors(p, end, scene.rotations, count, parse) ||
+      !parseVectors(p, end, scene.scales, count, parse) || !parseVectors(p, end, scene.colors, count, parse))
+    return false;
+
+  // Short or truncated files still give every object all of its attributes
+  padVectors(scene.translates, count, makeVec3(0.0, 0.0, 0.0));
+  padVectors(scene.rotations, count, makeVec3(0.0, 0.0, 0.0));
+  padVectors(scene.scales, count, makeVec3(1.0, 1.0, 1.0));
+  padVectors(scene.colors, count, makeVec3(0.8, 0.8, 0.8));
+  parseTracks(p, end, scene.animation, count);
+  parseMeshes(p, end, scene.meshes, count);
+  return true;
+}
+
+bool readSceneFile(const QString &fileName, SceneData &scene, IoProgress *progress)
+{
+  TRACE_SCOPE("readSceneFile");
+  if (isEncodedSceneFile(fileName))
+    return readEncodedSceneFile(fileName, scene, progress);
+
+  QByteArray data;
+  MemoryCharge charge(IoMemory);
+  if (!readWholeFile(fileName, data, progress))
+    return false;
+  charge.resize(data.size());
+
+  // Parse into a scene of its own, so a cancel leaves the target untouched
+  SceneData loaded;
+  if (!parseTextScene(data, loaded, progress))
+    return false;
+  appendScene(scene, loaded);
+  return true;
+}
+
+bool readScenePreview(const QString &fileName, ScenePreview &preview)
+{
+  TRACE_SCOPE("readScenePreview");
+  QByteArray encoded;
+  if (isEncodedSceneFile(fileName))
+  {
+    if (!readEncodedScenePreview(fileName, encoded))
+      return false;
+  }
+  else if (isStreamedSceneFile(fileName))
+  {
+    if (!readStreamedPreview(fileName, encoded))
+      return false;
+  }
+  else
+  {
+    QFile inFile(fileName);
+    if (!inFile.open(QIODevice::ReadOnly))
+      return false;
+    // Files without the line start with the long list of object types
+    if (inFile.peek(sizeof(textPreviewTag) - 1) != textPreviewTag)
+      return false;
+    QByteArray line = inFile.readLine(8 << 20).trimmed();
+    encoded = QByteArray::fromBase64(line.mid(sizeof(textPreviewTag) - 1));
+  }
+  return decodePreview(encoded, preview);
+}
+
+bool exportObj(const QString &fileName, const SceneData &scene)
+{
+  TRACE_SCOPE("exportObj");
+  QFile outFile(fileName);
+  if (!outFile.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+    return false;
+
+  static const char *names[7] = { "Plane", "Cube", "Sphere", "Cone", "Cylinder", "Pyramid", "Wedge" };
+  QTextStream outStream(&outFile);
+  int vertexBase = 1; // .obj indices start at one
+
+  for (int i = 0; i < scene.size(); i++)
+  {
+    int type = scene.objects[i];
+    if (type < 0 || type > 6)
+      continue;
+
+    // Meshes are written as their surfaces
+    const MeshObject *meshObject = scene.meshes.find(i);
+    const MeshData &primitive = primitiveMesh(type);
+    const float *positions = meshObject ? meshObject->surface.positions.constData() : primitive.positions;
+    const float *normals = meshObject ? meshObject->surface.normals.constData() : primitive.normals;
+    int vertexCount = meshObject ? meshObject->surface.vertexCount() : primitive.vertexCount;
+    int indexCount = meshObject ? meshObject->surface.indices.size() : primitive.indexCount;
+    const Vec3 &scale = scene.scales[i];
+    double model[16];
+    objectMatrix(scene.translates[i].v, scene.rotations[i].v, scale.v, model);
+
+    outStream << "o " << (meshObject ? "Mesh" : names[type]) << '_' << i << '\n';
+    for (int v = 0; v < vertexCount; v++)
+    {
+      const float *p = positions + v * 3;
+      outStream << "v " << model[0] * p[0] + model[4] * p[1] + model[8] * p[2] + model[12]
+                << ' ' << model[1] * p[0] + model[5] * p[1] + model[9] * p[2] + model[13]
+                << ' ' << model[2] * p[0] + model[6] * p[1] + model[10] * p[2] + model[14] << '\n';
+    }
+
+    // Normals go through the inverse transpose: rotate after dividing by the scale squared
+    for (int v = 0; v < vertexCount; v++)
+    {
+      const float *n = normals + v * 3;
+      double m[3] = { n[0] / (scale[0] * scale[0]), n[1] / (scale[1] * scale[1]), n[2] / (scale[2] * scale[2]) };
+      double x = model[0] * m[0] + model[4] * m[1] + model[8] * m[2];
+      double y = model[1] * m[0] + model[5] * m[1] + model[9] * m[2];
+      double z = model[2] * m[0] + model[6] * m[1] + model[10] * m[2];
+      double len = sqrt(x * x + y * y + z * z);
+      if (len > 0.0)
+        len = 1.0 / len;
+      outStream << "vn " << x * len << ' ' << y * len << ' ' << z * len << '\n';
+    }
+
+    for (int t = 0; t < indexCount; t += 3)
+    {
+      outStream << 'f';
+      for (int k = 0; k < 3; k++)
+      {
+        int index = vertexBase + (meshObject ? (int)meshObject->surface.indices[t + k] : primitive.indices[t + k]);
+        outStream << ' ' << index << "//" << index;
+      }
+      outStream << '\n';
+    }
+    vertexBase += vertexCount;
+  }
+
+  outStream.flush();
+  return outFile.error() == QFile::NoError;
+}
+
+bool replaceFile(const QString &from, const QString &to)
+{
+#ifdef Q_OS_WIN
+  return MoveFileExW((const wchar_t *)QDir::toNativeSeparators(from).utf16(),
+                     (const wchar_t *)QDir::toNativeSeparators(to).utf16(),
+                     MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+  return ::rename(QFile::encodeName(from).constData(), QFile::encodeName(to).constData()) == 0;
+#endif
+}
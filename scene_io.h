@@ -0,0 +1,31 @@
+#pragma once
+
+#include <QtCore>
+#include "scene_data.h"
+#include "scene_codec.h"
+#include "scene_preview.h"
+
+// Write the scene in the .vox text format, or the compact one if asked to;
+// false if the write was cancelled through progress. Unless the encoding
+// turns it off, a preview goes first; in text files it is a "#preview"
+// line, which the reader skips.
+bool writeScene(QIODevice *device, const SceneData &scene, const SceneEncoding &encoding = SceneEncoding(), IoProgress *progress = 0);
+
+// Write the scene to fileName + ".tmp" and atomically rename it into place,
+// so a crash mid-write never leaves a truncated file behind. A cancelled
+// write leaves the old file alone. Progress may be null.
+bool writeSceneFile(const QString &fileName, const SceneData &scene, const SceneEncoding &encoding, IoProgress *progress);
+
+// Append the objects of a .vox file in either format; false if it cannot
+// be read or the read was cancelled, in which case nothing is appended
+bool readSceneFile(const QString &fileName, SceneData &scene, IoProgress *progress = 0);
+
+// Only the preview a save stored at the front of the file; false if the
+// file cannot be read or was saved without one
+bool readScenePreview(const QString &fileName, ScenePreview &preview);
+
+// Atomically replace "to" with "from"
+bool replaceFile(const QString &from, const QString &to);
+
+// Write every object's tessellated mesh, in world space, as a Wavefront .obj
+bool exportObj(const QString &fileName, const SceneData &scene);
@@ -0,0 +1,312 @@
+#include "scene_journal.h"
+#include <cstring>
+
+static const quint32 journalMagic = 0x4a584f56; // "VOXJ"
+static const quint32 journalVersion = 1;
+static const int headerSize = 24;
+
+/***********/
+/* HELPERS */
+/***********/
+
+static void appendU32(QByteArray &out, quint32 value)
+{
+  uchar bytes[4];
+  qToLittleEndian(value, bytes);
+  out.append((const char *)bytes, 4);
+}
+
+static void appendU64(QByteArray &out, quint64 value)
+{
+  uchar bytes[8];
+  qToLittleEndian(value, bytes);
+  out.append((const char *)bytes, 8);
+}
+
+static void appendDouble(QByteArray &out, double value)
+{
+  quint64 bits;
+  memcpy(&bits, &value, 8);
+  appendU64(out, bits);
+}
+
+static double readDouble(const uchar *data)
+{
+  quint64 bits = qFromLittleEndian<quint64>(data);
+  double value;
+  memcpy(&value, &bits, 8);
+  return value;
+}
+
+static QByteArray makeHeader(const QString &baseFile)
+{
+  QFileInfo info(baseFile);
+  QByteArray header;
+  appendU32(header, journalMagic);
+  appendU32(header, journalVersion);
+  appendU64(header, info.size());
+  appendU64(header, info.lastModified().toMSecsSinceEpoch());
+  return header;
+}
+
+// Size of the record starting at data, or 0 if it is unknown or cut off
+static int recordSize(const uchar *data, qint64 available)
+{
+  if (available < 1)
+    return 0;
+  int size = 0;
+  switch (data[0])
+  {
+  case SceneJournal::Create: size = 2; break;
+  case SceneJournal::Remove: size = 5; break;
+  case SceneJournal::Translate:
+  case SceneJournal::Rotate:
+  case SceneJournal::Scale:
+  case SceneJournal::Color: size = 29; break;
+  case SceneJournal::Commit: size = 1; break;
+  default: return 0;
+  }
+  return available >= size ? size : 0;
+}
+
+/**********/
+/* REPLAY */
+/**********/
+
+QString SceneJournal::journalPath(const QString &baseFile)
+{
+  return baseFile + ".journal";
+}
+
+int SceneJournal::replay(const QString &baseFile, SceneData &scene, int firstIndex, bool includeUncommitted, qint64 *endOffset)
+{
+  QFile inFile(journalPath(baseFile));
+  if (!inFile.open(QIODevice::ReadOnly))
+    return -1;
+  QByteArray bytes = inFile.readAll();
+  if (bytes.size() < headerSize || bytes.left(headerSize) != makeHeader(baseFile))
+    return -1; // Belongs to another version of the base file
+
+  const uchar *data = (const uchar *)bytes.constData();
+  qint64 total = bytes.size();
+
+  // Find where replay has to stop: the last commit, or the last whole record
+  qint64 stop = headerSize;
+  for (qint64 offset = headerSize; offset < total; )
+  {
+    int size = recordSize(data + offset, total - offset);
+    if (size == 0)
+      break;
+    offset += size;
+    if (includeUncommitted || data[offset - size] == Commit)
+      stop = offset;
+  }
+
+  int applied = 0;
+  qint64 offset = headerSize;
+  while (offset < stop)
+  {
+    const uchar *record = data + offset;
+    int size = recordSize(record, stop - offset);
+    bool indexed = record[0] != Create && record[0] != Commit;
+    int index = indexed ? firstIndex + (int)qFromLittleEndian<quint32>(record + 1) : 0;
+    if (indexed && (index < firstIndex || index >= scene.size()))
+      break; // Corrupt, keep what we have
+
+    switch (record[0])
+    {
+    case Create:
+      scene.objects.push_back(record[1]);
+      scene.translates.push_back(makeVec3(0.0, 0.0, 0.0));
+      scene.rotations.push_back(makeVec3(0.0, 0.0, 0.0));
+      scene.scales.push_back(makeVec3(1.0, 1.0, 1.0));
+      scene.colors.push_back(makeVec3(0.8, 0.8, 0.8));
+      break;
+    case Remove:
+      scene.objects.erase(index);
+      scene.translates.erase(index);
+      scene.rotations.erase(index);
+      scene.scales.erase(index);
+      scene.colors.erase(index);
+      scene.animation.removeObject(index);
+      scene.meshes.removeObject(index);
+      break;
+    case Commit:
+      break;
+    default: {
+      Vec3 value = makeVec3(readDouble(record + 5), readDouble(record + 13), readDouble(record + 21));
+      if (record[0] == Translate)
+        scene.translates[index] = value;
+      else if (record[0] == Rotate)
+        scene.rotations[index] = value;
+      else if (record[0] == Scale)
+        scene.scales[index] = value;
+      else
+        scene.colors[index] = value;
+      break;
+    }
+    }
+
+    if (record[0] != Commit)
+      applied++;
+    offset += size;
+  }
+
+  if (endOffset)
+    *endOffset = offset;
+  return applied;
+}
+
+int SceneJournal::uncommittedRecords(const QString &baseFile)
+{
+  QFile inFile(journalPath(baseFile));
+  if (!inFile.open(QIODevice::ReadOnly))
+    return 0;
+  QByteArray bytes = inFile.readAll();
+  if (bytes.size() < headerSize || bytes.left(headerSize) != makeHeader(baseFile))
+    return 0;
+
+  const uchar *data = (const uchar *)bytes.constData();
+  int uncommitted = 0;
+  for (qint64 offset = headerSize; offset < bytes.size(); )
+  {
+    int size = recordSize(data + offset, bytes.size() - offset);
+    if (size == 0)
+      break;
+    uncommitted = (data[offset] == Commit) ? 0 : uncommitted + 1;
+    offset += size;
+  }
+  return uncommitted;
+}
+
+/***********/
+/* WRITING */
+/***********/
+
+SceneJournal::SceneJournal()
+{
+  pending = 0;
+  compacting = false;
+}
+
+bool SceneJournal::start(const QString &baseFile)
+{
+  close();
+  file.setFileName(journalPath(baseFile));
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    return false;
+  base = baseFile;
+  file.write(makeHeader(baseFile));
+  file.flush();
+  return true;
+}
+
+bool SceneJournal::resume(const QString &baseFile, qint64 offset)
+{
+  close();
+  file.setFileName(journalPath(baseFile));
+  if (!file.open(QIODevice::ReadWrite))
+    return false;
+  base = baseFile;
+  file.resize(offset); // Drop uncommitted or torn records
+  file.seek(offset);
+  return true;
+}
+
+void SceneJournal::close()
+{
+  if (file.isOpen())
+    file.close();
+  buffer.clear();
+  pending = 0;
+  compacting = false;
+  compactionTail.clear();
+}
+
+qint64 SceneJournal::size() const
+{
+  return file.isOpen() ? file.size() : 0;
+}
+
+void SceneJournal::recordCreate(int type)
+{
+  if (!file.isOpen())
+    return;
+  buffer.append((char)Create);
+  buffer.append((char)type);
+  pending++;
+}
+
+void SceneJournal::recordRemove(int index)
+{
+  if (!file.isOpen())
+    return;
+  buffer.append((char)Remove);
+  appendU32(buffer, index);
+  pending++;
+}
+
+void SceneJournal::recordVector(Op op, int index, const Vec3 &value)
+{
+  if (!file.isOpen())
+    return;
+  buffer.append((char)op);
+  appendU32(buffer, index);
+  appendDouble(buffer, value[0]);
+  appendDouble(buffer, value[1]);
+  appendDouble(buffer, value[2]);
+  pending++;
+}
+
+bool SceneJournal::writeBuffer()
+{
+  if (!file.isOpen())
+    return false;
+  if (buffer.isEmpty())
+    return true;
+
+  bool ok = file.write(buffer) == buffer.size() && file.flush();
+  if (compacting)
+    compactionTail.append(buffer);
+  buffer.clear();
+  pending = 0;
+  return ok;
+}
+
+bool SceneJournal::flush()
+{
+  return writeBuffer();
+}
+
+bool SceneJournal::commit()
+{
+  buffer.append((char)Commit);
+  return writeBuffer();
+}
+
+void SceneJournal::beginCompaction()
+{
+  compacting = true;
+  compactionTail.clear();
+}
+
+// The base now holds everything up to beginCompaction; restart the journal
+// with only what was written since
+bool SceneJournal::finishCompaction(bool baseWritten)
+{
+  QByteArray tail = compactionTail;
+  compacting = false;
+  compactionTail.clear();
+  if (!baseWritten)
+    return false;
+
+  QByteArray unwritten = buffer;
+  int unwrittenCount = pending;
+  if (!start(base))
+    return false;
+  buffer = tail;
+  bool ok = writeBuffer();
+  buffer = unwritten;
+  pending = unwrittenCount;
+  return ok;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <QtCore>
+#include "scene_data.h"
+
+// Append-only log of scene edits, kept next to a base .vox file as
+// "<file>.journal". Saving only appends the records made since the last
+// save, so its cost depends on the number of changes, not the scene size.
+//
+// The header ties the journal to the size and modification time of its
+// base file; a journal left behind by an older base is ignored. Records
+// written by the periodic flush stay "uncommitted" until a save appends a
+// commit marker, so a normal load only replays saved edits and crash
+// recovery can replay the rest.
+class SceneJournal
+{
+public:
+  enum Op { Create = 1, Remove, Translate, Rotate, Scale, Color, Commit };
+
+  SceneJournal();
+
+  static QString journalPath(const QString &baseFile);
+
+  // Apply the journal of baseFile to a scene whose objects from firstIndex
+  // on came from that file. Returns the number of records applied, or -1 if
+  // there is no valid journal; endOffset receives where replay stopped.
+  static int replay(const QString &baseFile, SceneData &scene, int firstIndex, bool includeUncommitted, qint64 *endOffset = 0);
+  static int uncommittedRecords(const QString &baseFile);
+
+  bool start(const QString &baseFile);                 // Fresh journal for a just written base file
+  bool resume(const QString &baseFile, qint64 offset); // Keep the first offset bytes, append after them
+  void close();
+
+  bool isOpen() const { return file.isOpen(); }
+  QString baseFile() const { return base; }
+  qint64 size() const;
+  int pendingRecords() const { return pending; }
+
+  void recordCreate(int type);
+  void recordRemove(int index);
+  void recordVector(Op op, int index, const Vec3 &value);
+
+  bool flush();  // Write buffered records without committing them
+  bool commit(); // Write buffered records followed by a commit marker
+
+  // While the base file is being rewritten, written records are also kept
+  // aside so they can be carried over into the journal of the new base
+  void beginCompaction();
+  bool finishCompaction(bool baseWritten);
+
+private:
+  bool writeBuffer();
+
+  QFile file;
+  QString base;
+  QByteArray buffer;
+  int pending;
+  bool compacting;
+  QByteArray compactionTail;
+};
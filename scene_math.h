@@ -0,0 +1,179 @@
+#pragma once
+
+#include <cmath>
+
+// Small column-major 4x4 matrix helpers that mirror the fixed-function
+// calls used by GLViewer, for work done on the CPU.
+
+inline void identityMatrix(double m[16])
+{
+  for (int i = 0; i < 16; i++)
+    m[i] = (i % 5 == 0) ? 1.0 : 0.0;
+}
+
+// out = a * b
+inline void multiplyMatrix(const double a[16], const double b[16], double out[16])
+{
+  double r[16];
+  for (int col = 0; col < 4; col++)
+    for (int row = 0; row < 4; row++)
+      r[col * 4 + row] = a[row] * b[col * 4] + a[4 + row] * b[col * 4 + 1] + a[8 + row] * b[col * 4 + 2] + a[12 + row] * b[col * 4 + 3];
+  for (int i = 0; i < 16; i++)
+    out[i] = r[i];
+}
+
+// Same as glTranslated, glRotated (x, then y, then z; degrees) and glScaled
+inline void objectMatrix(const double translate[3], const double rotate[3], const double scale[3], double m[16])
+{
+  double rx = rotate[0] * M_PI / 180.0, ry = rotate[1] * M_PI / 180.0, rz = rotate[2] * M_PI / 180.0;
+  double cx = cos(rx), sx = sin(rx), cy = cos(ry), sy = sin(ry), cz = cos(rz), sz = sin(rz);
+
+  // R = Rx * Ry * Rz
+  double r[9] = {
+    cy * cz,                cx * sz + sx * sy * cz, sx * sz - cx * sy * cz, // Column 0
+    -cy * sz,               cx * cz - sx * sy * sz, sx * cz + cx * sy * sz, // Column 1
+    sy,                     -sx * cy,               cx * cy                 // Column 2
+  };
+
+  for (int col = 0; col < 3; col++)
+  {
+    m[col * 4 + 0] = r[col * 3 + 0] * scale[col];
+    m[col * 4 + 1] = r[col * 3 + 1] * scale[col];
+    m[col * 4 + 2] = r[col * 3 + 2] * scale[col];
+    m[col * 4 + 3] = 0.0;
+  }
+  m[12] = translate[0]; m[13] = translate[1]; m[14] = translate[2]; m[15] = 1.0;
+}
+
+// Inverse of a matrix with no projective part, like objectMatrix makes;
+// false if it is singular (e.g. a zero scale)
+inline bool invertAffine(const double m[16], double out[16])
+{
+  double c00 = m[5] * m[10] - m[6] * m[9], c01 = m[6] * m[8] - m[4] * m[10], c02 = m[4] * m[9] - m[5] * m[8];
+  double det = m[0] * c00 + m[1] * c01 + m[2] * c02;
+  if (fabs(det) < 1e-12)
+    return false;
+  double inv = 1.0 / det;
+  double r[16];
+  r[0] = c00 * inv;
+  r[1] = (m[2] * m[9] - m[1] * m[10]) * inv;
+  r[2] = (m[1] * m[6] - m[2] * m[5]) * inv;
+  r[4] = c01 * inv;
+  r[5] = (m[0] * m[10] - m[2] * m[8]) * inv;
+  r[6] = (m[2] * m[4] - m[0] * m[6]) * inv;
+  r[8] = c02 * inv;
+  r[9] = (m[1] * m[8] - m[0] * m[9]) * inv;
+  r[10] = (m[0] * m[5] - m[1] * m[4]) * inv;
+  r[3] = r[7] = r[11] = 0.0;
+  for (int row = 0; row < 3; row++)
+    r[12 + row] = -(r[row] * m[12] + r[4 + row] * m[13] + r[8 + row] * m[14]);
+  r[15] = 1.0;
+  for (int i = 0; i < 16; i++)
+    out[i] = r[i];
+  return true;
+}
+
+// Same as gluPerspective
+inline void perspectiveMatrix(double fovy, double aspect, double zNear, double zFar, double m[16])
+{
+  double f = 1.0 / tan(fovy * M_PI / 360.0);
+  for (int i = 0; i < 16; i++)
+    m[i] = 0.0;
+  m[0] = f / aspect;
+  m[5] = f;
+  m[10] = (zFar + zNear) / (zNear - zFar);
+  m[11] = -1.0;
+  m[14] = 2.0 * zFar * zNear / (zNear - zFar);
+}
+
+// Same as glFrustum
+inline void frustumMatrix(double left, double right, double bottom, double top, double zNear, double zFar, double m[16])
+{
+  for (int i = 0; i < 16; i++)
+    m[i] = 0.0;
+  m[0] = 2.0 * zNear / (right - left);
+  m[5] = 2.0 * zNear / (top - bottom);
+  m[8] = (right + left) / (right - left);
+  m[9] = (top + bottom) / (top - bottom);
+  m[10] = (zFar + zNear) / (zNear - zFar);
+  m[11] = -1.0;
+  m[14] = 2.0 * zFar * zNear / (zNear - zFar);
+}
+
+// Same as glOrtho
+inline void orthoMatrix(double left, double right, double bottom, double top, double zNear, double zFar, double m[16])
+{
+  for (int i = 0; i < 16; i++)
+    m[i] = 0.0;
+  m[0] = 2.0 / (right - left);
+  m[5] = 2.0 / (top - bottom);
+  m[10] = -2.0 / (zFar - zNear);
+  m[12] = -(right + left) / (right - left);
+  m[13] = -(top + bottom) / (top - bottom);
+  m[14] = -(zFar + zNear) / (zFar - zNear);
+  m[15] = 1.0;
+}
+
+// Same as gluLookAt with a view direction instead of a center point
+inline void lookAtMatrix(const double eye[3], const double forward[3], const double up[3], double m[16])
+{
+  double f[3] = { forward[0], forward[1], forward[2] };
+  double len = sqrt(f[0] * f[0] + f[1] * f[1] + f[2] * f[2]);
+  f[0] /= len; f[1] /= len; f[2] /= len;
+
+  // s = f x up, u = s x f
+  double s[3] = { f[1] * up[2] - f[2] * up[1], f[2] * up[0] - f[0] * up[2], f[0] * up[1] - f[1] * up[0] };
+  len = sqrt(s[0] * s[0] + s[1] * s[1] + s[2] * s[2]);
+  s[0] /= len; s[1] /= len; s[2] /= len;
+  double u[3] = { s[1] * f[2] - s[2] * f[1], s[2] * f[0] - s[0] * f[2], s[0] * f[1] - s[1] * f[0] };
+
+  m[0] = s[0]; m[4] = s[1]; m[8] = s[2];
+  m[1] = u[0]; m[5] = u[1]; m[9] = u[2];
+  m[2] = -f[0]; m[6] = -f[1]; m[10] = -f[2];
+  m[3] = 0.0; m[7] = 0.0; m[11] = 0.0;
+  m[12] = -(s[0] * eye[0] + s[1] * eye[1] + s[2] * eye[2]);
+  m[13] = -(u[0] * eye[0] + u[1] * eye[1] + u[2] * eye[2]);
+  m[14] = f[0] * eye[0] + f[1] * eye[1] + f[2] * eye[2];
+  m[15] = 1.0;
+}
+
+// View vectors of the perspective camera from its horizontal and vertical
+// angles (radians), as GLViewer keeps them
+inline void cameraAxes(double horizontal, double vertical, double forward[3], double right[3], double up[3])
+{
+  forward[0] = cos(vertical) * sin(horizontal);
+  forward[1] = sin(vertical);
+  forward[2] = cos(vertical) * cos(horizontal);
+
+  right[0] = sin(horizontal - M_PI / 2.0);
+  right[1] = 0.0;
+  right[2] = cos(horizontal - M_PI / 2.0);
+
+  // up = right x forward
+  up[0] = right[1] * forward[2] - right[2] * forward[1];
+  up[1] = right[2] * forward[0] - right[0] * forward[2];
+  up[2] = right[0] * forward[1] - right[1] * forward[0];
+}
+
+// Conservative frustum test: the box is out of sight only if all its
+// corners lie outside the same clip plane of viewProj
+inline bool boxOutsideFrustum(const double viewProj[16], const double min[3], const double max[3])
+{
+  int outside[6] = {0, 0, 0, 0, 0, 0};
+  for (int c = 0; c < 8; c++)
+  {
+    double p[3] = { (c & 1) ? max[0] : min[0], (c & 2) ? max[1] : min[1], (c & 4) ? max[2] : min[2] };
+    double clip[4];
+    for (int r = 0; r < 4; r++)
+      clip[r] = viewProj[r] * p[0] + viewProj[4 + r] * p[1] + viewProj[8 + r] * p[2] + viewProj[12 + r];
+    for (int axis = 0; axis < 3; axis++)
+    {
+      outside[axis * 2] += clip[axis] < -clip[3];
+      outside[axis * 2 + 1] += clip[axis] > clip[3];
+    }
+  }
+  for (int plane = 0; plane < 6; plane++)
+    if (outside[plane] == 8)
+      return true;
+  return false;
+}
@@ -0,0 +1,62 @@
+#include "scene_meshes.h"
+#include "trace.h"
+
+const MeshObject *SceneMeshes::find(int object) const
+{
+  QMap<int, MeshObject>::const_iterator mesh = meshes.constFind(object);
+  return mesh == meshes.constEnd() ? 0 : &mesh.value();
+}
+
+void SceneMeshes::setMesh(int object, const HalfEdgeMesh &cage, int level)
+{
+  TRACE_SCOPE("SceneMeshes::setMesh");
+  SubdivisionSurface subdivision;
+  subdivision.setCage(cage, level);
+  setMesh(object, cage, level, subdivision.mesh());
+}
+
+void SceneMeshes::setMesh(int object, const HalfEdgeMesh &cage, int level, const SubdividedMesh &surface)
+{
+  MeshObject &mesh = meshes[object];
+  mesh.cage = cage;
+  mesh.level = qBound(0, level, (int)SubdivisionSurface::MaxLevels);
+  mesh.surface = surface;
+}
+
+void SceneMeshes::removeMesh(int object)
+{
+  meshes.remove(object);
+}
+
+void SceneMeshes::removeObject(int object)
+{
+  if (meshes.isEmpty() || object > meshes.lastKey())
+    return;
+  QMap<int, MeshObject> shifted;
+  for (QMap<int, MeshObject>::const_iterator mesh = meshes.constBegin(); mesh != meshes.constEnd(); ++mesh)
+  {
+    if (mesh.key() != object)
+      shifted.insert(mesh.key() < object ? mesh.key() : mesh.key() - 1, mesh.value());
+  }
+  meshes = shifted;
+}
+
+void SceneMeshes::append(const SceneMeshes &other, int objectOffset)
+{
+  for (QMap<int, MeshObject>::const_iterator mesh = other.meshes.constBegin(); mesh != other.meshes.constEnd(); ++mesh)
+    meshes.insert(mesh.key() + objectOffset, mesh.value());
+}
+
+// Shared surfaces count in full, as CowArray does
+qint64 SceneMeshes::memoryUsage() const
+{
+  qint64 bytes = 0;
+  for (QMap<int, MeshObject>::const_iterator mesh = meshes.constBegin(); mesh != meshes.constEnd(); ++mesh)
+  {
+    const SubdividedMesh &surface = mesh.value().surface;
+    bytes += sizeof(MeshObject) + mesh.value().cage.memoryUsage();
+    bytes += (qint64)(surface.positions.capacity() + surface.normals.capacity()) * sizeof(float);
+    bytes += (qint64)surface.indices.capacity() * sizeof(quint32);
+  }
+  return bytes;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <QtCore>
+#include "half_edge_mesh.h"
+#include "subdivision_surface.h"
+
+// An object that is a mesh: the cage edited in the object's own space
+// (mesh_editor.h), and the cage's subdivision surface, which is drawn in
+// place of the object's primitive
+struct MeshObject
+{
+  HalfEdgeMesh cage;
+  int level; // Subdivision levels
+  SubdividedMesh surface;
+};
+
+// The objects of a scene that are meshes, by object index. Files store
+// the cages and levels; the surfaces are subdivided again when read.
+// Copies share the map until one of them changes, like SceneAnimation.
+class SceneMeshes
+{
+public:
+  bool isEmpty() const { return meshes.isEmpty(); }
+  int count() const { return meshes.size(); }
+  bool contains(int object) const { return meshes.contains(object); }
+  const MeshObject *find(int object) const; // 0 unless the object is a mesh
+  QList<int> objects() const { return meshes.keys(); } // Sorted
+
+  // Subdivides the cage, or takes its surface from an editor that already did
+  void setMesh(int object, const HalfEdgeMesh &cage, int level);
+  void setMesh(int object, const HalfEdgeMesh &cage, int level, const SubdividedMesh &surface);
+  void removeMesh(int object);
+
+  // Keeps object indices in step with the scene's objects
+  void removeObject(int object);
+  void append(const SceneMeshes &other, int objectOffset);
+
+  qint64 memoryUsage() const;
+
+private:
+  QMap<int, MeshObject> meshes;
+};
@@ -0,0 +1,80 @@
+#include "scene_open_dialog.h"
+#include "scene_io.h"
+#include "scene_journal.h"
+
+SceneOpenDialog::SceneOpenDialog(QWidget *parent, const QString &directory)
+  : QFileDialog(parent, tr("Open Project"), directory, tr("VOX Files (*.vox *.voxs)"))
+{
+  // Only the Qt dialog can take an extra pane
+  setOption(QFileDialog::DontUseNativeDialog, true);
+  setFileMode(QFileDialog::ExistingFile);
+  setAcceptMode(QFileDialog::AcceptOpen);
+
+  QWidget *previewPane = new QWidget;
+  QVBoxLayout *paneLayout = new QVBoxLayout(previewPane);
+  thumbnailLabel = new QLabel;
+  thumbnailLabel->setFixedSize(ScenePreview::ThumbnailSize + 2, ScenePreview::ThumbnailSize + 2);
+  thumbnailLabel->setAlignment(Qt::AlignCenter);
+  thumbnailLabel->setFrameShape(QFrame::StyledPanel);
+  infoLabel = new QLabel;
+  infoLabel->setWordWrap(true);
+  infoLabel->setAlignment(Qt::AlignTop | Qt::AlignLeft);
+  infoLabel->setFixedWidth(ScenePreview::ThumbnailSize + 40);
+  paneLayout->addWidget(thumbnailLabel);
+  paneLayout->addWidget(infoLabel, 1);
+
+  // The Qt dialog lays itself out in a grid; the pane goes in a column of its own
+  QGridLayout *grid = qobject_cast<QGridLayout *>(layout());
+  if (grid)
+    grid->addWidget(previewPane, 0, grid->columnCount(), grid->rowCount(), 1);
+
+  connect(this, SIGNAL(currentChanged(QString)), this, SLOT(showPreview(QString)));
+  showPreview(QString());
+}
+
+QString SceneOpenDialog::getOpenFileName(QWidget *parent, const QString &directory)
+{
+  SceneOpenDialog dialog(parent, directory);
+  if (dialog.exec() != QDialog::Accepted || dialog.selectedFiles().isEmpty())
+    return QString();
+  return dialog.selectedFiles().first();
+}
+
+void SceneOpenDialog::showPreview(const QString &fileName)
+{
+  static const char *names[7] = { "Plane", "Cube", "Sphere", "Cone", "Cylinder", "Pyramid", "Wedge" };
+  thumbnailLabel->clear();
+  QFileInfo info(fileName);
+  if (fileName.isEmpty() || !info.isFile())
+  {
+    infoLabel->setText(tr("Select a scene to preview it."));
+    return;
+  }
+
+  QString text = info.fileName() + "\n" + QString::number(info.size() / 1024.0, 'f', 1) + " KB\n\n";
+  ScenePreview preview;
+  if (!readScenePreview(fileName, preview))
+  {
+    infoLabel->setText(text + tr("No preview; the file was saved without one."));
+    return;
+  }
+
+  if (!preview.thumbnail.isNull())
+    thumbnailLabel->setPixmap(QPixmap::fromImage(preview.thumbnail));
+  text += tr("%1 objects").arg(preview.objectCount) + "\n";
+  for (int t = 0; t < 7; t++)
+    if (preview.typeCounts[t] > 0)
+      text += QString("  %1: %2\n").arg(names[t]).arg(preview.typeCounts[t]);
+  if (preview.objectCount > 0)
+  {
+    text += "\n" + tr("Size: %1 x %2 x %3")
+                     .arg(preview.boundsMax[0] - preview.boundsMin[0], 0, 'g', 4)
+                     .arg(preview.boundsMax[1] - preview.boundsMin[1], 0, 'g', 4)
+                     .arg(preview.boundsMax[2] - preview.boundsMin[2], 0, 'g', 4) + "\n";
+  }
+
+  // Journaled saves append edits that the preview of the base file predates
+  if (QFile::exists(SceneJournal::journalPath(fileName)))
+    text += "\n" + tr("Later edits are in its journal.");
+  infoLabel->setText(text);
+}
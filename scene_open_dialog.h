@@ -0,0 +1,26 @@
+#pragma once
+
+#include <QtCore>
+#include <QtGui>
+
+// Open dialog for .vox files with a preview pane. Selecting a file reads
+// only the preview a save stored in its header, never the objects, so
+// browsing a directory of big scenes stays instant.
+class SceneOpenDialog : public QFileDialog
+{
+
+  Q_OBJECT
+
+public:
+  SceneOpenDialog(QWidget *parent = 0, const QString &directory = QString());
+
+  // Like QFileDialog::getOpenFileName; empty if cancelled
+  static QString getOpenFileName(QWidget *parent, const QString &directory);
+
+private slots:
+  void showPreview(const QString &fileName);
+
+private:
+  QLabel *thumbnailLabel;
+  QLabel *infoLabel;
+};
@@ -0,0 +1,222 @@
+#include "scene_preview.h"
+#include <QBuffer>
+#include <cmath>
+#include <vector>
+#include "scene_math.h"
+#include "primitive_geometry.h"
+#include "trace.h"
+
+static const int previewVersion = 1;
+static const int thumbnailObjects = 8192; // Most objects drawn into a thumbnail
+
+ScenePreview::ScenePreview() : objectCount(0)
+{
+  for (int t = 0; t < 7; t++)
+    typeCounts[t] = 0;
+  boundsMin = boundsMax = makeVec3(0.0, 0.0, 0.0);
+}
+
+/*************/
+/* THUMBNAIL */
+/*************/
+
+struct ThumbnailVertex { float x, y, z; };
+
+// Flat-shaded triangle into color and depth buffers of size x size
+static void rasterizeTriangle(const ThumbnailVertex &a, const ThumbnailVertex &b, const ThumbnailVertex &c, QRgb color,
+                              int size, QRgb *pixels, float *depth)
+{
+  float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+  if (area == 0.0f)
+    return;
+  int x0 = qMax(0, (int)floor(qMin(a.x, qMin(b.x, c.x))));
+  int x1 = qMin(size - 1, (int)ceil(qMax(a.x, qMax(b.x, c.x))));
+  int y0 = qMax(0, (int)floor(qMin(a.y, qMin(b.y, c.y))));
+  int y1 = qMin(size - 1, (int)ceil(qMax(a.y, qMax(b.y, c.y))));
+
+  for (int y = y0; y <= y1; y++)
+  {
+    float py = y + 0.5f;
+    for (int x = x0; x <= x1; x++)
+    {
+      float px = x + 0.5f;
+      float w0 = ((b.x - px) * (c.y - py) - (b.y - py) * (c.x - px)) / area;
+      float w1 = ((c.x - px) * (a.y - py) - (c.y - py) * (a.x - px)) / area;
+      float w2 = 1.0f - w0 - w1;
+      if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+        continue;
+      float z = w0 * a.z + w1 * b.z + w2 * c.z;
+      if (z < depth[y * size + x])
+      {
+        depth[y * size + x] = z;
+        pixels[y * size + x] = color;
+      }
+    }
+  }
+}
+
+// Orthographic view from above and to the front right, fitted to the bounds
+static QImage renderThumbnail(const SceneData &scene, const Vec3 &boundsMin, const Vec3 &boundsMax)
+{
+  const int size = ScenePreview::ThumbnailSize;
+  QImage image(size, size, QImage::Format_ARGB32);
+  image.fill(qRgb(40, 40, 48));
+  if (scene.size() == 0)
+    return image;
+
+  double center[3], radius = 0.0;
+  for (int k = 0; k < 3; k++)
+  {
+    center[k] = 0.5 * (boundsMin[k] + boundsMax[k]);
+    radius += 0.25 * (boundsMax[k] - boundsMin[k]) * (boundsMax[k] - boundsMin[k]);
+  }
+  radius = qMax(sqrt(radius), 1e-6);
+  const double forward[3] = { -0.6, -0.5, -0.62 }, up[3] = { 0.0, 1.0, 0.0 };
+  double eye[3], view[16];
+  for (int k = 0; k < 3; k++)
+    eye[k] = center[k] - 2.0 * radius * forward[k];
+  lookAtMatrix(eye, forward, up, view);
+
+  QRgb *pixels = (QRgb *)image.bits();
+  std::vector<float> depth(size * size, 1e30f);
+  std::vector<ThumbnailVertex> screen;
+  std::vector<float> viewPositions;
+  double pixelsPerUnit = size / (2.0 * radius);
+  int stride = (scene.size() + thumbnailObjects - 1) / thumbnailObjects;
+
+  for (int i = 0; i < scene.size(); i += stride)
+  {
+    int type = scene.objects[i];
+    if (type < 0 || type > 6)
+      continue;
+    const MeshData &mesh = primitiveMesh(type, CoarseTessellation);
+    double model[16], viewModel[16];
+    objectMatrix(scene.translates[i].v, scene.rotations[i].v, scene.scales[i].v, model);
+    multiplyMatrix(view, model, viewModel);
+
+    screen.resize(mesh.vertexCount);
+    viewPositions.resize(mesh.vertexCount * 3);
+    for (int v = 0; v < mesh.vertexCount; v++)
+    {
+      const float *p = mesh.positions + v * 3;
+      float *out = &viewPositions[v * 3];
+      for (int k = 0; k < 3; k++)
+        out[k] = viewModel[k] * p[0] + viewModel[4 + k] * p[1] + viewModel[8 + k] * p[2] + viewModel[12 + k];
+      screen[v].x = size * 0.5f + out[0] * pixelsPerUnit;
+      screen[v].y = size * 0.5f - out[1] * pixelsPerUnit;
+      screen[v].z = -out[2];
+    }
+
+    // Lit from the eye; the face normal in view space gives the shade
+    const Vec3 &color = scene.colors[i];
+    for (int t = 0; t < mesh.indexCount; t += 3)
+    {
+      const float *a = &viewPositions[mesh.indices[t] * 3];
+      const float *b = &viewPositions[mesh.indices[t + 1] * 3];
+      const float *c = &viewPositions[mesh.indices[t + 2] * 3];
+      float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+      float e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+      float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+      float length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+      if (length == 0.0f)
+        continue;
+      double shade = 0.25 + 0.75 * fabs(n[2] / length);
+      QRgb rgb = qRgb(qBound(0, (int)(color[0] * shade * 255.0), 255), qBound(0, (int)(color[1] * shade * 255.0), 255),
+                      qBound(0, (int)(color[2] * shade * 255.0), 255));
+      rasterizeTriangle(screen[mesh.indices[t]], screen[mesh.indices[t + 1]], screen[mesh.indices[t + 2]], rgb, size,
+                        pixels, &depth[0]);
+    }
+  }
+  return image;
+}
+
+/*************/
+/* INTERFACE */
+/*************/
+
+ScenePreview makeScenePreview(const SceneData &scene)
+{
+  TRACE_SCOPE("makeScenePreview");
+  ScenePreview preview;
+  preview.objectCount = scene.size();
+
+  bool first = true;
+  for (int i = 0; i < scene.size(); i++)
+  {
+    int type = scene.objects[i];
+    if (type >= 0 && type <= 6)
+      preview.typeCounts[type]++;
+
+    // Every primitive fits the unit box, so its world box is the model
+    // matrix applied to that
+    double model[16];
+    objectMatrix(scene.translates[i].v, scene.rotations[i].v, scene.scales[i].v, model);
+    for (int k = 0; k < 3; k++)
+    {
+      double extent = 0.5 * (fabs(model[k]) + fabs(model[4 + k]) + fabs(model[8 + k]));
+      double low = model[12 + k] - extent, high = model[12 + k] + extent;
+      if (first || low < preview.boundsMin[k])
+        preview.boundsMin[k] = low;
+      if (first || high > preview.boundsMax[k])
+        preview.boundsMax[k] = high;
+    }
+    first = false;
+  }
+
+  preview.thumbnail = renderThumbnail(scene, preview.boundsMin, preview.boundsMax);
+  return preview;
+}
+
+// Version, counts, bounds, then the thumbnail as PNG
+QByteArray encodePreview(const ScenePreview &preview)
+{
+  QByteArray png;
+  if (!preview.thumbnail.isNull())
+  {
+    QBuffer buffer(&png);
+    buffer.open(QIODevice::WriteOnly);
+    preview.thumbnail.save(&buffer, "PNG");
+  }
+
+  QByteArray out;
+  QDataStream stream(&out, QIODevice::WriteOnly);
+  stream.setByteOrder(QDataStream::LittleEndian);
+  stream << (quint8)previewVersion << (quint32)preview.objectCount;
+  for (int t = 0; t < 7; t++)
+    stream << (quint32)preview.typeCounts[t];
+  for (int k = 0; k < 3; k++)
+    stream << preview.boundsMin[k] << preview.boundsMax[k];
+  stream << (quint32)png.size();
+  stream.writeRawData(png.constData(), png.size());
+  return out;
+}
+
+bool decodePreview(const QByteArray &data, ScenePreview &preview)
+{
+  QDataStream stream(data);
+  stream.setByteOrder(QDataStream::LittleEndian);
+  quint8 version;
+  quint32 count, pngSize;
+  stream >> version >> count;
+  if (stream.status() != QDataStream::Ok || version != previewVersion)
+    return false;
+  preview.objectCount = count;
+  for (int t = 0; t < 7; t++)
+  {
+    stream >> count;
+    preview.typeCounts[t] = count;
+  }
+  for (int k = 0; k < 3; k++)
+    stream >> preview.boundsMin[k] >> preview.boundsMax[k];
+  stream >> pngSize;
+  if (stream.status() != QDataStream::Ok || pngSize > (quint32)data.size())
+    return false;
+
+  QByteArray png = stream.device()->read(pngSize);
+  preview.thumbnail = QImage();
+  if (png.size() != (int)pngSize)
+    return false;
+  if (pngSize > 0)
+    preview.thumbnail.loadFromData(png, "PNG");
+  return true;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <QtCore>
+#include <QImage>
+#include "scene_data.h"
+
+// What the open dialog shows of a scene without loading it: object counts,
+// bounds and a small rendering. Saves store it at the front of the file,
+// so readScenePreview (scene_io.h) only has to read that far.
+struct ScenePreview
+{
+  enum { ThumbnailSize = 128 };
+
+  int objectCount;
+  int typeCounts[7];
+  Vec3 boundsMin, boundsMax; // World-space box around every object; zero when empty
+  QImage thumbnail;          // Null if none was stored
+
+  ScenePreview();
+};
+
+// Counts and bounds cover every object; the thumbnail draws a sample of
+// at most a few thousand, so this stays cheap for huge scenes. Safe on
+// worker threads.
+ScenePreview makeScenePreview(const SceneData &scene);
+
+QByteArray encodePreview(const ScenePreview &preview);
+bool decodePreview(const QByteArray &data, ScenePreview &preview);
@@ -0,0 +1,205 @@
+#include "scene_streamer.h"
+#include <QtConcurrentRun>
+#include <algorithm>
+#include "trace.h"
+
+static const int updateInterval = 100; // Milliseconds between residency checks
+
+SceneStreamer::SceneStreamer(QObject *parent) : QObject(parent)
+{
+  budget = (qint64)DefaultBudgetMB << 20;
+  residentBytes = 0;
+  focus[0] = focus[1] = focus[2] = 0.0;
+  detailDistance = 60.0;
+  focusMoved = false;
+  viewDirty = true;
+  timer = new QTimer(this);
+  timer->setInterval(updateInterval);
+  connect(timer, SIGNAL(timeout()), this, SLOT(update()));
+}
+
+bool SceneStreamer::open(const QString &fileName)
+{
+  TRACE_SCOPE("SceneStreamer::open");
+  close();
+  QVector<StreamedChunkInfo> index;
+  if (!readStreamedIndex(fileName, index) || index.isEmpty())
+    return false;
+
+  file = fileName;
+  chunks = index;
+  resident.fill(StreamedChunkPtr(), chunks.size());
+  failed.fill(false, chunks.size());
+  focusMoved = true;
+  viewDirty = true;
+  timer->start();
+  update();
+  emit chunkChanged(-1);
+  return true;
+}
+
+// Loads still running finish on their own and are dropped
+void SceneStreamer::close()
+{
+  if (!isOpen())
+    return;
+  timer->stop();
+  loads.clear();
+  chunks.clear();
+  resident.clear();
+  failed.clear();
+  residentBytes = 0;
+  file.clear();
+  viewDirty = true;
+  emit chunkChanged(-1);
+}
+
+qint64 SceneStreamer::objectCount() const
+{
+  qint64 count = 0;
+  for (int c = 0; c < chunks.size(); c++)
+    count += chunks[c].count;
+  return count;
+}
+
+int SceneStreamer::residentCount() const
+{
+  int count = 0;
+  for (int c = 0; c < resident.size(); c++)
+    count += !resident[c].isNull();
+  return count;
+}
+
+void SceneStreamer::setBudget(qint64 bytes)
+{
+  budget = bytes;
+  focusMoved = true;
+}
+
+void SceneStreamer::setDetailDistance(double distance)
+{
+  detailDistance = distance;
+}
+
+void SceneStreamer::setFocus(const double position[3])
+{
+  for (int i = 0; i < 3; i++)
+  {
+    if (focus[i] != position[i])
+      focusMoved = true;
+    focus[i] = position[i];
+  }
+}
+
+StreamedView SceneStreamer::view()
+{
+  if (viewDirty)
+  {
+    cachedView = StreamedView();
+    for (int c = 0; c < chunks.size(); c++)
+    {
+      if (resident[c])
+      {
+        cachedView.resident.append(resident[c]);
+        cachedView.residentInfo.append(chunks[c]);
+      }
+      else
+        cachedView.proxies.append(chunks[c]);
+    }
+    viewDirty = false;
+  }
+  for (int i = 0; i < 3; i++)
+    cachedView.focus[i] = focus[i];
+  cachedView.detailDistance = detailDistance;
+  return cachedView;
+}
+
+qint64 SceneStreamer::estimatedBytes(int chunk) const
+{
+  return (qint64)chunks[chunk].count * StreamedChunk::BytesPerObject + sizeof(StreamedChunk);
+}
+
+void SceneStreamer::evict(int chunk)
+{
+  resident[chunk].clear();
+  residentBytes -= estimatedBytes(chunk);
+  viewDirty = true;
+  emit chunkChanged(chunk);
+}
+
+void SceneStreamer::update()
+{
+  TRACE_SCOPE("SceneStreamer::update");
+  bool loaded = false;
+  for (QList<Load>::iterator load = loads.begin(); load != loads.end(); )
+  {
+    if (!load->future.isFinished())
+    {
+      ++load;
+      continue;
+    }
+    StreamedChunkPtr chunk = load->future.result();
+    if (chunk)
+    {
+      resident[load->chunk] = chunk;
+      residentBytes += estimatedBytes(load->chunk);
+      viewDirty = true;
+      emit chunkChanged(load->chunk);
+    }
+    else
+      failed[load->chunk] = true; // It stays a proxy box
+    load = loads.erase(load);
+    loaded = true;
+  }
+  if (!focusMoved && !loaded)
+    return;
+  focusMoved = false;
+
+  // The nearest chunks, as many as the budget holds
+  QVector<QPair<double, int> > order(chunks.size());
+  for (int c = 0; c < chunks.size(); c++)
+    order[c] = qMakePair(chunkDistance(chunks[c], focus), c);
+  std::sort(order.begin(), order.end());
+  QVector<bool> wanted(chunks.size(), false);
+  qint64 wantedBytes = 0;
+  for (int k = 0; k < order.size(); k++)
+  {
+    if (failed[order[k].second])
+      continue;
+    qint64 bytes = estimatedBytes(order[k].second);
+    if (wantedBytes + bytes > budget)
+      break;
+    wantedBytes += bytes;
+    wanted[order[k].second] = true;
+  }
+
+  // Make room for the wanted chunks still missing, farthest unwanted first;
+  // unwanted chunks stay as long as there is room, so moving back is free
+  qint64 missing = 0;
+  for (int c = 0; c < chunks.size(); c++)
+    if (wanted[c] && !resident[c])
+      missing += estimatedBytes(c);
+  for (int k = order.size() - 1; k >= 0 && residentBytes + missing > budget; k--)
+  {
+    int c = order[k].second;
+    if (resident[c] && !wanted[c])
+      evict(c);
+  }
+
+  // Nearest missing chunks first
+  for (int k = 0; k < order.size() && loads.size() < MaxLoadsInFlight; k++)
+  {
+    int c = order[k].second;
+    if (!wanted[c] || resident[c])
+      continue;
+    bool loading = false;
+    for (int l = 0; l < loads.size(); l++)
+      loading = loading || loads[l].chunk == c;
+    if (loading)
+      continue;
+    Load load;
+    load.chunk = c;
+    load.future = QtConcurrent::run(loadStreamedChunk, file, chunks[c]);
+    loads.append(load);
+  }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <QtCore>
+#include <QFuture>
+#include "streamed_scene.h"
+
+// Keeps the chunks of a streamed scene file (streamed_scene.h) around a
+// focus point resident. Chunks load on worker threads, nearest first; once
+// the resident chunks would exceed the memory budget, the farthest ones
+// that are no longer wanted are evicted. Views draw what is resident
+// through view(). Lives on the UI thread.
+class SceneStreamer : public QObject
+{
+
+  Q_OBJECT
+
+public:
+  enum { DefaultBudgetMB = 512, MaxLoadsInFlight = 2 };
+
+  SceneStreamer(QObject *parent = 0);
+
+  bool open(const QString &fileName);
+  void close();
+  bool isOpen() const { return !chunks.isEmpty(); }
+  QString fileName() const { return file; }
+  qint64 objectCount() const;
+  int chunkCount() const { return chunks.size(); }
+  int residentCount() const;
+
+  void setBudget(qint64 bytes);
+
+  // Chunks within this distance of the focus are drawn in detail
+  void setDetailDistance(double distance);
+
+  // Usually the perspective camera; checked on the next update
+  void setFocus(const double position[3]);
+
+  // Cheap to copy; rebuilt only when residency changes
+  StreamedView view();
+
+  const StreamedChunkInfo &chunkInfo(int chunk) const { return chunks.at(chunk); }
+
+signals:
+  void chunkChanged(int chunk); // Loaded or evicted
+
+private slots:
+  void update();
+
+private:
+  struct Load
+  {
+    int chunk;
+    QFuture<StreamedChunkPtr> future;
+  };
+
+  qint64 estimatedBytes(int chunk) const;
+  void evict(int chunk);
+
+  QString file;
+  QVector<StreamedChunkInfo> chunks;
+  QVector<StreamedChunkPtr> resident; // Null where not loaded, by chunk
+  QVector<bool> failed; // Chunks that could not be read; not retried until reopened
+  QList<Load> loads;
+  qint64 budget;
+  qint64 residentBytes;
+  double focus[3];
+  double detailDistance;
+  bool focusMoved;
+  bool viewDirty;
+  StreamedView cachedView;
+  QTimer *timer;
+};
@@ -0,0 +1,316 @@
+#include "streamed_scene.h"
+#include <QtConcurrentMap>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "scene_codec.h"
+#include "scene_io.h"
+#include "scene_math.h"
+#include "scene_preview.h"
+#include "trace.h"
+
+static const char streamedMagic[4] = { 'V', 'O', 'X', 'S' };
+static const int streamedVersion = 1;
+static const int indexEntrySize = 6 * 8 + 4 + 4 + 8 + 4; // Bounds, count, color and padding, offset, size
+static const int targetChunkObjects = 4096;               // About one codec block per chunk
+static const int encodeGroup = 64;                        // Chunks encoded in parallel at a time
+static const quint32 maxPreviewSize = 4 << 20;
+
+/**********/
+/* WRITER */
+/**********/
+
+struct ChunkJob
+{
+  const SceneData *scene;
+  std::vector<int> objects; // Indices into scene
+  StreamedChunkInfo info;
+  QByteArray payload;
+};
+
+// Copies the chunk's objects out and encodes them; also fills bounds and color
+static void encodeChunk(ChunkJob &job)
+{
+  const SceneData &scene = *job.scene;
+  SceneData cell;
+  double color[3] = { 0.0, 0.0, 0.0 };
+  for (size_t k = 0; k < job.objects.size(); k++)
+  {
+    int i = job.objects[k];
+    cell.objects.push_back(scene.objects[i]);
+    cell.translates.push_back(scene.translates[i]);
+    cell.rotations.push_back(scene.rotations[i]);
+    cell.scales.push_back(scene.scales[i]);
+    cell.colors.push_back(scene.colors[i]);
+
+    double model[16];
+    objectMatrix(scene.translates[i].v, scene.rotations[i].v, scene.scales[i].v, model);
+    for (int a = 0; a < 3; a++)
+    {
+      double extent = 0.5 * (fabs(model[a]) + fabs(model[4 + a]) + fabs(model[8 + a]));
+      if (k == 0 || model[12 + a] - extent < job.info.min[a])
+        job.info.min[a] = model[12 + a] - extent;
+      if (k == 0 || model[12 + a] + extent > job.info.max[a])
+        job.info.max[a] = model[12 + a] + extent;
+      color[a] += scene.colors[i][a];
+    }
+  }
+  job.info.count = job.objects.size();
+  for (int a = 0; a < 3; a++)
+    job.info.color[a] = (quint8)qBound(0, (int)(color[a] / job.objects.size() * 255.0 + 0.5), 255);
+
+  SceneEncoding encoding;
+  encoding.format = SceneEncoding::Compact;
+  encoding.preview = false;
+  job.payload = encodeScene(cell, encoding);
+  job.info.size = job.payload.size();
+}
+
+// Cell edge such that non-empty cells hold about targetChunkObjects each.
+// Starts from an even split of the bounding cube and halves while cells
+// are too full, which also copes with flat or clustered scenes.
+static double chooseCellSize(const SceneData &scene)
+{
+  double low[3], high[3];
+  for (int a = 0; a < 3; a++)
+    low[a] = high[a] = scene.translates[0][a];
+  for (int i = 1; i < scene.size(); i++)
+    for (int a = 0; a < 3; a++)
+    {
+      low[a] = qMin(low[a], scene.translates[i][a]);
+      high[a] = qMax(high[a], scene.translates[i][a]);
+    }
+  double extent = qMax(high[0] - low[0], qMax(high[1] - low[1], high[2] - low[2]));
+  double cells = qMax(1.0, (double)scene.size() / targetChunkObjects);
+  double size = qMax(extent / std::cbrt(cells), 1e-3);
+
+  // Sample the occupancy instead of counting every object each round
+  int stride = qMax(1, scene.size() / 65536);
+  for (int round = 0; round < 12; round++)
+  {
+    QSet<quint64> occupied;
+    int sampled = 0;
+    for (int i = 0; i < scene.size(); i += stride, sampled++)
+    {
+      quint64 key = 0;
+      for (int a = 0; a < 3; a++)
+        key = (key << 21) | ((quint64)(qint64)floor(scene.translates[i][a] / size) & 0x1fffff);
+      occupied.insert(key);
+    }
+    if ((double)sampled * stride / occupied.size() <= 2 * targetChunkObjects)
+      break;
+    size *= 0.5;
+  }
+  return size;
+}
+
+static void writeIndexEntry(QDataStream &stream, const StreamedChunkInfo &info)
+{
+  for (int a = 0; a < 3; a++)
+    stream << info.min[a];
+  for (int a = 0; a < 3; a++)
+    stream << info.max[a];
+  stream << info.count << info.color[0] << info.color[1] << info.color[2] << (quint8)0;
+  stream << (quint64)info.offset << info.size;
+}
+
+bool writeStreamedScene(const QString &fileName, const SceneData &scene, IoProgress *progress)
+{
+  TRACE_SCOPE("writeStreamedScene");
+  if (progress)
+    progress->begin(IoProgress::Encoding, scene.size());
+
+  // Bucket the objects by the cell of their position
+  QVector<ChunkJob> jobs;
+  if (scene.size() > 0)
+  {
+    double size = chooseCellSize(scene);
+    QHash<quint64, int> cellJobs;
+    for (int i = 0; i < scene.size(); i++)
+    {
+      quint64 key = 0;
+      for (int a = 0; a < 3; a++)
+        key = (key << 21) | ((quint64)(qint64)floor(scene.translates[i][a] / size) & 0x1fffff);
+      QHash<quint64, int>::iterator found = cellJobs.find(key);
+      if (found == cellJobs.end())
+      {
+        found = cellJobs.insert(key, jobs.size());
+        jobs.append(ChunkJob());
+        jobs.last().scene = &scene;
+      }
+      jobs[found.value()].objects.push_back(i);
+    }
+  }
+
+  QString tempName = fileName + ".tmp";
+  QFile outFile(tempName);
+  if (!outFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    return false;
+  QDataStream stream(&outFile);
+  stream.setByteOrder(QDataStream::LittleEndian);
+  QByteArray preview = encodePreview(makeScenePreview(scene));
+  stream.writeRawData(streamedMagic, 4);
+  stream << (quint8)streamedVersion << (quint8)0 << (quint8)0 << (quint8)0;
+  stream << (quint32)preview.size();
+  stream.writeRawData(preview.constData(), preview.size());
+  stream << (quint32)jobs.size();
+
+  // Room for the index, filled in once the payload offsets are known
+  qint64 indexOffset = outFile.pos();
+  qint64 offset = indexOffset + (qint64)jobs.size() * indexEntrySize;
+  outFile.seek(offset);
+
+  bool ok = true;
+  for (int first = 0; ok && first < jobs.size(); first += encodeGroup)
+  {
+    if (progress && progress->isCancelled())
+    {
+      ok = false;
+      break;
+    }
+    int last = qMin(jobs.size(), first + encodeGroup);
+    QtConcurrent::blockingMap(jobs.begin() + first, jobs.begin() + last, encodeChunk);
+    for (int j = first; j < last; j++)
+    {
+      jobs[j].info.offset = offset;
+      ok = ok && outFile.write(jobs[j].payload) == jobs[j].payload.size();
+      offset += jobs[j].payload.size();
+      jobs[j].payload = QByteArray();
+      if (progress)
+        progress->advance(jobs[j].objects.size());
+    }
+  }
+
+  if (ok)
+  {
+    outFile.seek(indexOffset);
+    for (int j = 0; j < jobs.size(); j++)
+      writeIndexEntry(stream, jobs[j].info);
+    ok = stream.status() == QDataStream::Ok && outFile.flush() && outFile.error() == QFile::NoError;
+  }
+  outFile.close();
+  if (!ok)
+  {
+    QFile::remove(tempName);
+    return false;
+  }
+  return replaceFile(tempName, fileName);
+}
+
+/**********/
+/* READER */
+/**********/
+
+bool isStreamedSceneFile(const QString &fileName)
+{
+  QFile inFile(fileName);
+  if (!inFile.open(QIODevice::ReadOnly))
+    return false;
+  return inFile.read(4) == QByteArray(streamedMagic, 4);
+}
+
+// Leaves the stream at the start of the preview
+static bool readHeader(QDataStream &stream, quint32 &previewSize)
+{
+  char magic[4];
+  quint8 version, reserved[3];
+  if (stream.readRawData(magic, 4) != 4 || memcmp(magic, streamedMagic, 4) != 0)
+    return false;
+  stream >> version >> reserved[0] >> reserved[1] >> reserved[2] >> previewSize;
+  return stream.status() == QDataStream::Ok && version == streamedVersion && previewSize <= maxPreviewSize;
+}
+
+bool readStreamedPreview(const QString &fileName, QByteArray &preview)
+{
+  QFile inFile(fileName);
+  if (!inFile.open(QIODevice::ReadOnly))
+    return false;
+  QDataStream stream(&inFile);
+  stream.setByteOrder(QDataStream::LittleEndian);
+  quint32 previewSize;
+  if (!readHeader(stream, previewSize) || previewSize == 0)
+    return false;
+  preview = inFile.read(previewSize);
+  return preview.size() == (int)previewSize;
+}
+
+bool readStreamedIndex(const QString &fileName, QVector<StreamedChunkInfo> &chunks)
+{
+  TRACE_SCOPE("readStreamedIndex");
+  QFile inFile(fileName);
+  if (!inFile.open(QIODevice::ReadOnly))
+    return false;
+  QDataStream stream(&inFile);
+  stream.setByteOrder(QDataStream::LittleEndian);
+  quint32 previewSize, count;
+  if (!readHeader(stream, previewSize) || stream.skipRawData(previewSize) != (int)previewSize)
+    return false;
+  stream >> count;
+  if (stream.status() != QDataStream::Ok || (qint64)count * indexEntrySize > inFile.size())
+    return false;
+
+  chunks.resize(count);
+  for (quint32 c = 0; c < count; c++)
+  {
+    StreamedChunkInfo &info = chunks[c];
+    quint8 padding;
+    quint64 offset;
+    for (int a = 0; a < 3; a++)
+      stream >> info.min[a];
+    for (int a = 0; a < 3; a++)
+      stream >> info.max[a];
+    stream >> info.count >> info.color[0] >> info.color[1] >> info.color[2] >> padding >> offset >> info.size;
+    info.offset = offset;
+    if (info.offset + info.size > inFile.size())
+      return false;
+  }
+  return stream.status() == QDataStream::Ok;
+}
+
+StreamedChunkPtr loadStreamedChunk(const QString &fileName, const StreamedChunkInfo &info)
+{
+  TRACE_SCOPE("loadStreamedChunk");
+  QFile inFile(fileName);
+  if (!inFile.open(QIODevice::ReadOnly) || !inFile.seek(info.offset))
+    return StreamedChunkPtr();
+  SceneData scene;
+  if (!decodeScene(inFile.read(info.size), scene) || scene.size() != (int)info.count)
+    return StreamedChunkPtr();
+
+  // Sorted by mesh and color once here, so drawing needs no queue
+  std::vector<std::pair<quint32, int> > order(scene.size());
+  for (int i = 0; i < scene.size(); i++)
+  {
+    quint32 key = (quint32)qBound(0, scene.objects[i], 6) << 24;
+    for (int a = 0; a < 3; a++)
+      key |= (quint32)qBound(0, (int)(scene.colors[i][a] * 255.0 + 0.5), 255) << (16 - 8 * a);
+    order[i] = std::make_pair(key, i);
+  }
+  std::sort(order.begin(), order.end());
+
+  StreamedChunk *chunk = new StreamedChunk;
+  chunk->keys.resize(scene.size());
+  chunk->matrices.resize(16 * scene.size());
+  for (int k = 0; k < scene.size(); k++)
+  {
+    int i = order[k].second;
+    double model[16];
+    objectMatrix(scene.translates[i].v, scene.rotations[i].v, scene.scales[i].v, model);
+    for (int e = 0; e < 16; e++)
+      chunk->matrices[16 * k + e] = (float)model[e];
+    chunk->keys[k] = order[k].first;
+  }
+  chunk->charge.resize((qint64)scene.size() * StreamedChunk::BytesPerObject);
+  return StreamedChunkPtr(chunk);
+}
+
+double chunkDistance(const StreamedChunkInfo &info, const double point[3])
+{
+  double squared = 0.0;
+  for (int a = 0; a < 3; a++)
+  {
+    double d = qMax(info.min[a] - point[a], qMax(0.0, point[a] - info.max[a]));
+    squared += d * d;
+  }
+  return sqrt(squared);
+}
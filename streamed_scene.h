@@ -0,0 +1,71 @@
+#pragma once
+
+#include <QtCore>
+#include <QSharedPointer>
+#include <vector>
+#include "scene_data.h"
+#include "io_progress.h"
+#include "memory_stats.h"
+
+// Spatially chunked scene files (.voxs) for scenes too big to load whole.
+// Objects are bucketed by position into a uniform grid; every non-empty
+// cell is a chunk, stored in the compact encoding (scene_codec.h) and found
+// through an index at the front of the file:
+//
+//   "VOXS", u8 version, 3 reserved, u32 preview size, preview,
+//   u32 chunk count, an index entry per chunk, then the chunk payloads
+//
+// Opening a file reads the index only; each chunk then loads on its own.
+struct StreamedChunkInfo
+{
+  double min[3], max[3]; // World-space bounds of the chunk's objects
+  quint32 count;
+  quint8 color[3];       // Average object color, for the proxy box
+  qint64 offset;         // Of the payload from the start of the file
+  quint32 size;
+};
+Q_DECLARE_TYPEINFO(StreamedChunkInfo, Q_PRIMITIVE_TYPE);
+
+// A loaded chunk, ready to draw and never changed afterwards, so render
+// threads can share it. Objects are sorted by mesh, then color.
+struct StreamedChunk
+{
+  enum { BytesPerObject = 16 * sizeof(float) + sizeof(quint32) };
+
+  std::vector<float> matrices; // Column-major model matrix per object
+  std::vector<quint32> keys;   // Mesh type << 24 | RGB8 color
+  MemoryCharge charge;
+
+  StreamedChunk() : charge(StreamMemory) {}
+  int size() const { return (int)keys.size(); }
+};
+typedef QSharedPointer<const StreamedChunk> StreamedChunkPtr;
+
+// What the views draw of a streamed scene: resident chunks in detail while
+// their bounds are within detailDistance of the focus, and a box in the
+// chunk's average color for every other chunk
+struct StreamedView
+{
+  QVector<StreamedChunkPtr> resident;
+  QVector<StreamedChunkInfo> residentInfo; // Parallel to resident
+  QVector<StreamedChunkInfo> proxies;
+  double focus[3];
+  double detailDistance;
+
+  StreamedView() : detailDistance(0.0) { focus[0] = focus[1] = focus[2] = 0.0; }
+  bool isEmpty() const { return resident.isEmpty() && proxies.isEmpty(); }
+};
+
+bool isStreamedSceneFile(const QString &fileName);
+
+// Written to fileName + ".tmp" and renamed into place, like writeSceneFile
+bool writeStreamedScene(const QString &fileName, const SceneData &scene, IoProgress *progress);
+
+bool readStreamedIndex(const QString &fileName, QVector<StreamedChunkInfo> &chunks);
+bool readStreamedPreview(const QString &fileName, QByteArray &preview);
+
+// Reads and prepares one chunk; null on failure. Safe on worker threads.
+StreamedChunkPtr loadStreamedChunk(const QString &fileName, const StreamedChunkInfo &info);
+
+// Distance from a point to the chunk's bounds, zero inside
+double chunkDistance(const StreamedChunkInfo &info, const double point[3]);
@@ -0,0 +1,484 @@
+#include "subdivision_surface.h"
+#include <QtConcurrentMap>
+#include <algorithm>
+#include <cmath>
+#include "trace.h"
+
+static const int rowsPerJob = 4096;
+
+/************/
+/* STENCILS */
+/************/
+
+// One row being summed; rows are short, so a scan finds repeated sources
+struct StencilRow
+{
+  std::vector<int> sources;
+  std::vector<float> weights;
+
+  void add(int source, float weight)
+  {
+    for (size_t k = 0; k < sources.size(); k++)
+    {
+      if (sources[k] == source)
+      {
+        weights[k] += weight;
+        return;
+      }
+    }
+    sources.push_back(source);
+    weights.push_back(weight);
+  }
+
+  // The face point, spread over the face's corners
+  void addFace(const HalfEdgeMesh &mesh, int face, float weight)
+  {
+    int first = mesh.faceEdge(face), h = first;
+    float corner = weight / mesh.faceSize(face);
+    do
+    {
+      add(mesh.origin(h), corner);
+      h = mesh.next(h);
+    } while (h != first);
+  }
+};
+
+// The next level's vertices are the face points, then the edge points,
+// then the vertex points
+static void stencilRow(const HalfEdgeMesh &mesh, int row, StencilRow &out)
+{
+  out.sources.clear();
+  out.weights.clear();
+  int faces = mesh.faceCount(), edges = mesh.edgeCount();
+  if (row < faces)
+  {
+    out.addFace(mesh, row, 1.0f);
+    return;
+  }
+
+  if (row < faces + edges)
+  {
+    int h = 2 * (row - faces);
+    bool rim = mesh.isBoundaryEdge(h);
+    out.add(mesh.origin(h), rim ? 0.5f : 0.25f);
+    out.add(mesh.target(h), rim ? 0.5f : 0.25f);
+    if (!rim)
+    {
+      out.addFace(mesh, mesh.face(h), 0.25f);
+      out.addFace(mesh, mesh.face(h ^ 1), 0.25f);
+    }
+    return;
+  }
+
+  int v = row - faces - edges, first = mesh.vertexEdge(v), h = first, valence = 0, rimEdges = 0;
+  do
+  {
+    valence++;
+    rimEdges += mesh.isBoundaryEdge(h) ? 1 : 0;
+    h = mesh.rotate(h);
+  } while (h != first);
+
+  if (rimEdges == 0)
+  {
+    // (Q + 2R + (n - 3)S) / n, with Q the average face point and R the
+    // average edge midpoint
+    float n = valence, ring = 1.0f / (n * n);
+    out.add(v, (n - 2.0f) / n);
+    do
+    {
+      out.add(mesh.target(h), ring);
+      out.addFace(mesh, mesh.face(h), ring);
+      h = mesh.rotate(h);
+    } while (h != first);
+  }
+  else if (rimEdges == 2 && valence > 2)
+  {
+    out.add(v, 0.75f);
+    do
+    {
+      if (mesh.isBoundaryEdge(h))
+        out.add(mesh.target(h), 0.125f);
+      h = mesh.rotate(h);
+    } while (h != first);
+  }
+  else
+    out.add(v, 1.0f); // A corner
+}
+
+struct StencilBuildJob
+{
+  const HalfEdgeMesh *mesh;
+  int begin, end;
+  StencilTable table; // Of these rows alone
+};
+
+static void buildStencils(StencilBuildJob &job)
+{
+  StencilRow row;
+  StencilTable &table = job.table;
+  table.offsets.assign(1, 0);
+  for (int i = job.begin; i < job.end; i++)
+  {
+    stencilRow(*job.mesh, i, row);
+    table.sources.insert(table.sources.end(), row.sources.begin(), row.sources.end());
+    table.weights.insert(table.weights.end(), row.weights.begin(), row.weights.end());
+    table.offsets.push_back((int)table.sources.size());
+  }
+}
+
+static void makeStencils(const HalfEdgeMesh &mesh, StencilTable &table)
+{
+  TRACE_SCOPE("makeStencils");
+  int rows = mesh.faceCount() + mesh.edgeCount() + mesh.vertexCount();
+  QVector<StencilBuildJob> jobs;
+  for (int begin = 0; begin < rows; begin += rowsPerJob)
+  {
+    StencilBuildJob job = { &mesh, begin, qMin(begin + rowsPerJob, rows), StencilTable() };
+    jobs.append(job);
+  }
+  QtConcurrent::blockingMap(jobs, buildStencils);
+
+  table.offsets.assign(1, 0);
+  table.sources.clear();
+  table.weights.clear();
+  for (int j = 0; j < jobs.size(); j++)
+  {
+    const StencilTable &part = jobs[j].table;
+    int base = (int)table.sources.size();
+    for (int i = 1; i < (int)part.offsets.size(); i++)
+      table.offsets.push_back(base + part.offsets[i]);
+    table.sources.insert(table.sources.end(), part.sources.begin(), part.sources.end());
+    table.weights.insert(table.weights.end(), part.weights.begin(), part.weights.end());
+  }
+}
+
+// Rows of the next level that read each vertex of this one
+static void invertStencils(const StencilTable &table, int sourceCount, std::vector<int> &offsets, std::vector<int> &dependents)
+{
+  offsets.assign(sourceCount + 1, 0);
+  for (size_t k = 0; k < table.sources.size(); k++)
+    offsets[table.sources[k] + 1]++;
+  for (int v = 0; v < sourceCount; v++)
+    offsets[v + 1] += offsets[v];
+  std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+  dependents.resize(table.sources.size());
+  for (int row = 0; row < table.size(); row++)
+    for (int k = table.offsets[row]; k < table.offsets[row + 1]; k++)
+      dependents[fill[table.sources[k]]++] = row;
+}
+
+// A quad at every corner of every face: the corner's vertex point, the
+// point of the edge leaving it, the face point and the point of the edge
+// coming in
+static void refineFaces(const HalfEdgeMesh &mesh, std::vector<int> &starts, std::vector<int> &corners)
+{
+  int faces = mesh.faceCount(), edgePoints = faces, vertexPoints = faces + mesh.edgeCount();
+  starts.assign(1, 0);
+  corners.clear();
+  corners.reserve(2 * mesh.halfEdgeCount());
+  for (int f = 0; f < faces; f++)
+  {
+    int first = mesh.faceEdge(f), h = first, previous = first;
+    while (mesh.next(previous) != first)
+      previous = mesh.next(previous);
+    do
+    {
+      corners.push_back(vertexPoints + mesh.origin(h));
+      corners.push_back(edgePoints + h / 2);
+      corners.push_back(f);
+      corners.push_back(edgePoints + previous / 2);
+      starts.push_back((int)corners.size());
+      previous = h;
+      h = mesh.next(h);
+    } while (h != first);
+  }
+}
+
+/**************/
+/* EVALUATION */
+/**************/
+
+// Rows begin to end of the listed rows, or of all rows without a list
+struct StencilJob
+{
+  const StencilTable *table;
+  const float *source;
+  float *target;
+  const int *rows;
+  int begin, end;
+};
+
+static void applyStencils(StencilJob &job)
+{
+  const int *offsets = job.table->offsets.data(), *sources = job.table->sources.data();
+  const float *weights = job.table->weights.data();
+  for (int i = job.begin; i < job.end; i++)
+  {
+    int row = job.rows ? job.rows[i] : i;
+    float x = 0.0f, y = 0.0f, z = 0.0f;
+    for (int k = offsets[row]; k < offsets[row + 1]; k++)
+    {
+      const float *p = job.source + sources[k] * 3;
+      x += weights[k] * p[0];
+      y += weights[k] * p[1];
+      z += weights[k] * p[2];
+    }
+    float *out = job.target + row * 3;
+    out[0] = x;
+    out[1] = y;
+    out[2] = z;
+  }
+}
+
+struct NormalJob
+{
+  const int *faceStarts, *corners;
+  const int *vertexFaceOffsets, *vertexFaces;
+  const float *positions;
+  float *normals;
+  const int *rows;
+  int begin, end;
+};
+
+// Sum of the area-weighted (Newell) normals of the faces around the vertex
+static void computeNormals(NormalJob &job)
+{
+  for (int i = job.begin; i < job.end; i++)
+  {
+    int v = job.rows ? job.rows[i] : i;
+    float n[3] = { 0.0f, 0.0f, 0.0f };
+    for (int k = job.vertexFaceOffsets[v]; k < job.vertexFaceOffsets[v + 1]; k++)
+    {
+      int f = job.vertexFaces[k], first = job.faceStarts[f], size = job.faceStarts[f + 1] - first;
+      for (int c = 0; c < size; c++)
+      {
+        const float *p = job.positions + job.corners[first + c] * 3;
+        const float *q = job.positions + job.corners[first + (c + 1) % size] * 3;
+        n[0] += (p[1] - q[1]) * (p[2] + q[2]);
+        n[1] += (p[2] - q[2]) * (p[0] + q[0]);
+        n[2] += (p[0] - q[0]) * (p[1] + q[1]);
+      }
+    }
+    float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    float scale = length > 0.0f ? 1.0f / length : 0.0f;
+    float *out = job.normals + v * 3;
+    out[0] = n[0] * scale;
+    out[1] = n[1] * scale;
+    out[2] = n[2] * scale;
+  }
+}
+
+// Splits count rows into jobs for the global pool; a single job runs here
+template <typename Job>
+static void runJobs(const Job &prototype, int count, void (*work)(Job &))
+{
+  QVector<Job> jobs;
+  for (int begin = 0; begin < count; begin += rowsPerJob)
+  {
+    Job job = prototype;
+    job.begin = begin;
+    job.end = qMin(begin + rowsPerJob, count);
+    jobs.append(job);
+  }
+  if (jobs.size() == 1)
+    work(jobs[0]);
+  else if (jobs.size() > 1)
+    QtConcurrent::blockingMap(jobs, work);
+}
+
+/***********/
+/* SURFACE */
+/***********/
+
+SubdivisionSurface::SubdivisionSurface() : charge(MeshMemory)
+{
+  markStamp = 0;
+  evaluated = 0;
+  faceStarts.assign(1, 0);
+}
+
+void SubdivisionSurface::setCage(const HalfEdgeMesh &cage, int levels)
+{
+  TRACE_SCOPE("SubdivisionSurface::setCage");
+  levels = qBound(0, levels, (int)MaxLevels);
+  refinements.assign(levels, Refinement());
+  levelPositions.assign(levels, std::vector<float>());
+
+  // Each level's topology is only needed to make the next level's stencils
+  HalfEdgeMesh mesh = cage;
+  std::vector<int> starts, quads;
+  for (int k = 0; k < levels; k++)
+  {
+    Refinement &refinement = refinements[k];
+    levelPositions[k] = mesh.vertexPositions();
+    makeStencils(mesh, refinement.stencils);
+    invertStencils(refinement.stencils, mesh.vertexCount(), refinement.dependentOffsets, refinement.dependents);
+    refineFaces(mesh, starts, quads);
+    if (k + 1 == levels)
+      break;
+
+    std::vector<float> finer(refinement.stencils.size() * 3);
+    StencilJob job = { &refinement.stencils, levelPositions[k].data(), finer.data(), 0, 0, 0 };
+    runJobs(job, refinement.stencils.size(), applyStencils);
+    HalfEdgeMesh next;
+    next.build(finer, starts, quads); // Subdividing keeps a mesh manifold
+    mesh = next;
+  }
+  if (levels == 0)
+    cage.polygons(faceStarts, corners);
+  else
+  {
+    faceStarts.swap(starts);
+    corners.swap(quads);
+  }
+
+  // Which faces each vertex needs for its normal
+  int vertices = levels > 0 ? refinements.back().stencils.size() : cage.vertexCount();
+  vertexFaceOffsets.assign(vertices + 1, 0);
+  for (size_t c = 0; c < corners.size(); c++)
+    vertexFaceOffsets[corners[c] + 1]++;
+  for (int v = 0; v < vertices; v++)
+    vertexFaceOffsets[v + 1] += vertexFaceOffsets[v];
+  std::vector<int> fill(vertexFaceOffsets.begin(), vertexFaceOffsets.end() - 1);
+  vertexFaces.resize(corners.size());
+  for (int f = 0; f < faceCount(); f++)
+    for (int c = faceStarts[f]; c < faceStarts[f + 1]; c++)
+      vertexFaces[fill[corners[c]]++] = f;
+
+  // Faces are fanned into triangles
+  surface.indices.clear();
+  surface.indices.reserve(3 * ((int)corners.size() - 2 * faceCount()));
+  for (int f = 0; f < faceCount(); f++)
+  {
+    for (int c = faceStarts[f] + 1; c + 1 < faceStarts[f + 1]; c++)
+    {
+      surface.indices.append(corners[faceStarts[f]]);
+      surface.indices.append(corners[c]);
+      surface.indices.append(corners[c + 1]);
+    }
+  }
+
+  surface.positions.resize(vertices * 3);
+  surface.normals.resize(vertices * 3);
+  if (levels == 0)
+    std::copy(cage.vertexPositions().begin(), cage.vertexPositions().end(), surface.positions.begin());
+  else
+    evaluate(levels - 1, 0);
+  updateNormals(0);
+  evaluated = vertices;
+  updateCharge();
+}
+
+void SubdivisionSurface::update(const HalfEdgeMesh &cage, const std::vector<int> &moved)
+{
+  TRACE_SCOPE("SubdivisionSurface::update");
+  int levels = levelCount();
+  if (levels == 0)
+  {
+    std::copy(cage.vertexPositions().begin(), cage.vertexPositions().end(), surface.positions.begin());
+    updateNormals(0);
+    evaluated = cage.vertexCount();
+    return;
+  }
+
+  // Each level's dirty rows are those that read the dirty rows below
+  levelPositions[0] = cage.vertexPositions();
+  std::vector<int> dirty, next;
+  for (size_t k = 0; k < moved.size(); k++)
+    if (moved[k] >= 0 && moved[k] < cage.vertexCount())
+      dirty.push_back(moved[k]);
+  bool all = false;
+  for (int k = 0; k < levels; k++)
+  {
+    const Refinement &refinement = refinements[k];
+    int rows = refinement.stencils.size();
+    if (!all)
+    {
+      if ((int)marks.size() < rows)
+        marks.resize(rows, 0);
+      markStamp++;
+      next.clear();
+      for (size_t d = 0; d < dirty.size(); d++)
+      {
+        for (int j = refinement.dependentOffsets[dirty[d]]; j < refinement.dependentOffsets[dirty[d] + 1]; j++)
+        {
+          int row = refinement.dependents[j];
+          if (marks[row] != markStamp)
+          {
+            marks[row] = markStamp;
+            next.push_back(row);
+          }
+        }
+      }
+
+      // Past a quarter of the rows, gathering them costs more than it saves
+      all = next.size() * 4 > (size_t)rows;
+    }
+    evaluate(k, all ? 0 : &next);
+    dirty.swap(next);
+  }
+
+  if (all)
+  {
+    updateNormals(0);
+    evaluated = surface.vertexCount();
+    return;
+  }
+
+  // Normals change on every face around a moved vertex
+  markStamp++;
+  next.clear();
+  for (size_t d = 0; d < dirty.size(); d++)
+  {
+    for (int k = vertexFaceOffsets[dirty[d]]; k < vertexFaceOffsets[dirty[d] + 1]; k++)
+    {
+      int f = vertexFaces[k];
+      for (int c = faceStarts[f]; c < faceStarts[f + 1]; c++)
+      {
+        if (marks[corners[c]] != markStamp)
+        {
+          marks[corners[c]] = markStamp;
+          next.push_back(corners[c]);
+        }
+      }
+    }
+  }
+  updateNormals(&next);
+  evaluated = (int)dirty.size();
+}
+
+// Level's rows of the next level, from level's positions
+void SubdivisionSurface::evaluate(int level, const std::vector<int> *rows)
+{
+  const StencilTable &stencils = refinements[level].stencils;
+  float *target = level + 1 < levelCount() ? levelPositions[level + 1].data() : surface.positions.data();
+  StencilJob job = { &stencils, levelPositions[level].data(), target, rows ? rows->data() : 0, 0, 0 };
+  runJobs(job, rows ? (int)rows->size() : stencils.size(), applyStencils);
+}
+
+void SubdivisionSurface::updateNormals(const std::vector<int> *vertices)
+{
+  const float *positions = surface.positions.constData();
+  NormalJob job = { faceStarts.data(), corners.data(), vertexFaceOffsets.data(), vertexFaces.data(),
+                    positions, surface.normals.data(), vertices ? vertices->data() : 0, 0, 0 };
+  runJobs(job, vertices ? (int)vertices->size() : surface.vertexCount(), computeNormals);
+}
+
+void SubdivisionSurface::updateCharge()
+{
+  qint64 bytes = 0;
+  for (size_t k = 0; k < refinements.size(); k++)
+  {
+    const Refinement &refinement = refinements[k];
+    bytes += (qint64)(refinement.stencils.offsets.capacity() + refinement.stencils.sources.capacity() +
+                      refinement.dependentOffsets.capacity() + refinement.dependents.capacity()) * sizeof(int);
+    bytes += (qint64)refinement.stencils.weights.capacity() * sizeof(float);
+  }
+  for (size_t k = 0; k < levelPositions.size(); k++)
+    bytes += (qint64)levelPositions[k].capacity() * sizeof(float);
+  bytes += (qint64)(faceStarts.capacity() + corners.capacity() + vertexFaceOffsets.capacity() + vertexFaces.capacity() +
+                    marks.capacity()) * sizeof(int);
+  bytes += (qint64)(surface.positions.capacity() + surface.normals.capacity()) * sizeof(float);
+  bytes += (qint64)surface.indices.capacity() * sizeof(quint32);
+  charge.resize(bytes);
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <QtCore>
+#include <vector>
+#include "half_edge_mesh.h"
+#include "memory_stats.h"
+
+// Row i of a level's vertices is the weighted sum of the previous level's
+// vertices sources[k] by weights[k], for k from offsets[i] up to
+// offsets[i + 1]
+struct StencilTable
+{
+  std::vector<int> offsets;
+  std::vector<int> sources;
+  std::vector<float> weights;
+
+  int size() const { return offsets.empty() ? 0 : (int)offsets.size() - 1; }
+};
+
+// The finest level, ready to draw. The arrays are implicitly shared, so a
+// view's snapshot costs nothing until the surface changes again; indices
+// are 32 bits, as a few levels pass 65536 vertices.
+struct SubdividedMesh
+{
+  QVector<float> positions; // xyz per vertex
+  QVector<float> normals;
+  QVector<quint32> indices; // Triangles
+
+  int vertexCount() const { return positions.size() / 3; }
+  int triangleCount() const { return indices.size() / 3; }
+};
+
+// Catmull-Clark subdivision of a cage (a HalfEdgeMesh) to a fixed number
+// of levels. Only the cage's topology decides how each level's vertices
+// follow from the level before, so that is worked out once per topology
+// as stencil tables; moving cage vertices then re-evaluates only the rows
+// that depend on them, level by level, and the normals around those.
+// Large updates run in parallel on the global thread pool. Rims of open
+// surfaces and holes follow the usual boundary rules, with vertices where
+// only two edges meet kept as corners.
+class SubdivisionSurface
+{
+public:
+  enum { MaxLevels = 8 };
+
+  SubdivisionSurface();
+
+  // Stencils for the cage's topology, and the whole surface evaluated
+  void setCage(const HalfEdgeMesh &cage, int levels);
+
+  // After the listed cage vertices moved; the topology is unchanged
+  void update(const HalfEdgeMesh &cage, const std::vector<int> &moved);
+
+  int levelCount() const { return (int)refinements.size(); }
+  int faceCount() const { return (int)faceStarts.size() - 1; } // Of the finest level
+  const SubdividedMesh &mesh() const { return surface; }
+
+  // Finest vertices the last setCage() or update() evaluated
+  int evaluatedVertices() const { return evaluated; }
+
+private:
+  Q_DISABLE_COPY(SubdivisionSurface)
+
+  // From one level to the next; dependents invert the stencils
+  struct Refinement
+  {
+    StencilTable stencils;
+    std::vector<int> dependentOffsets;
+    std::vector<int> dependents;
+  };
+
+  void evaluate(int level, const std::vector<int> *rows);
+  void updateNormals(const std::vector<int> *vertices);
+  void updateCharge();
+
+  std::vector<Refinement> refinements;
+  std::vector<std::vector<float> > levelPositions; // Below the finest; level 0 is the cage's
+  std::vector<int> faceStarts, corners;            // Finest faces
+  std::vector<int> vertexFaceOffsets, vertexFaces; // The finest faces around each finest vertex
+  SubdividedMesh surface;
+  std::vector<int> marks; // Per vertex of a level, to list each dirty row once
+  int markStamp;
+  int evaluated;
+  MemoryCharge charge;
+};
@@ -0,0 +1,152 @@
+#include "timeline_widget.h"
+
+static const int sliderRate = 30; // Slider steps per second, the playback rate
+
+// Ticks at the key times of one object, lined up with the slider above
+class KeyStrip : public QWidget
+{
+public:
+  KeyStrip(QWidget *parent = 0) : QWidget(parent), length(1.0)
+  {
+    setFixedHeight(8);
+  }
+
+  void setKeys(const QVector<double> &times, double length)
+  {
+    this->times = times;
+    this->length = qMax(length, 1e-6);
+    update();
+  }
+
+protected:
+  void paintEvent(QPaintEvent *)
+  {
+    QPainter painter(this);
+    painter.setPen(palette().color(QPalette::Highlight));
+    QStyleOptionSlider option;
+    option.initFrom(this);
+    int handle = style()->pixelMetric(QStyle::PM_SliderLength, &option, this);
+    int span = width() - handle;
+    for (int i = 0; i < times.size(); i++)
+    {
+      int x = handle / 2 + qRound(span * qMin(times[i] / length, 1.0));
+      painter.drawLine(x, 0, x, height());
+    }
+  }
+
+private:
+  QVector<double> times;
+  double length;
+};
+
+TimelineWidget::TimelineWidget(Scene *scene, QWidget *parent) : QWidget(parent), scene(scene), object(-1)
+{
+  playButton = new QPushButton(tr("Play"));
+  playButton->setCheckable(true);
+  timeSlider = new QSlider(Qt::Horizontal);
+  keyStrip = new KeyStrip;
+  timeLabel = new QLabel;
+  timeLabel->setMinimumWidth(60);
+  lengthSpinbox = new QDoubleSpinBox;
+  lengthSpinbox->setRange(0.5, 600.0);
+  lengthSpinbox->setSingleStep(0.5);
+  lengthSpinbox->setSuffix(tr(" s"));
+  lengthSpinbox->setToolTip(tr("Loop length; playback also runs to the last key"));
+  interpolationCombo = new QComboBox;
+  interpolationCombo->addItem(tr("Linear"), (int)LinearKey);
+  interpolationCombo->addItem(tr("Bezier"), (int)BezierKey);
+  interpolationCombo->setToolTip(tr("How new keys lead to the next key"));
+  setKeyButton = new QPushButton(tr("Set Key"));
+  setKeyButton->setToolTip(tr("Key the selected object's transform and color at this time"));
+  deleteKeyButton = new QPushButton(tr("Delete Key"));
+
+  QVBoxLayout *sliderLayout = new QVBoxLayout;
+  sliderLayout->setSpacing(0);
+  sliderLayout->addWidget(timeSlider);
+  sliderLayout->addWidget(keyStrip);
+  QHBoxLayout *layout = new QHBoxLayout(this);
+  layout->setMargin(2);
+  layout->addWidget(playButton);
+  layout->addLayout(sliderLayout, 1);
+  layout->addWidget(timeLabel);
+  layout->addWidget(lengthSpinbox);
+  layout->addWidget(interpolationCombo);
+  layout->addWidget(setKeyButton);
+  layout->addWidget(deleteKeyButton);
+
+  connect(playButton, SIGNAL(toggled(bool)), scene, SLOT(playAnimation(bool)));
+  connect(timeSlider, SIGNAL(valueChanged(int)), this, SLOT(sliderMoved(int)));
+  connect(lengthSpinbox, SIGNAL(valueChanged(double)), this, SLOT(setLength(double)));
+  connect(interpolationCombo, SIGNAL(currentIndexChanged(int)), this, SLOT(interpolationChanged(int)));
+  connect(setKeyButton, SIGNAL(clicked()), this, SLOT(setKeyClicked()));
+  connect(deleteKeyButton, SIGNAL(clicked()), this, SLOT(deleteKeyClicked()));
+  connect(scene, SIGNAL(animationTimeChanged(double)), this, SLOT(showTime(double)));
+  connect(scene, SIGNAL(keysChanged()), this, SLOT(updateKeys()));
+
+  lengthSpinbox->setValue(scene->animationLength());
+  interpolationCombo->setCurrentIndex(interpolationCombo->findData((int)BezierKey));
+  setLength(scene->animationLength());
+  showTime(scene->animationTime());
+  setObject(-1);
+}
+
+void TimelineWidget::setObject(int index)
+{
+  object = index;
+  setKeyButton->setEnabled(index >= 0);
+  deleteKeyButton->setEnabled(index >= 0);
+  updateKeys();
+}
+
+void TimelineWidget::sliderMoved(int frame)
+{
+  scene->setAnimationTime((double)frame / sliderRate);
+}
+
+void TimelineWidget::showTime(double time)
+{
+  timeSlider->blockSignals(true);
+  timeSlider->setValue(qRound(time * sliderRate));
+  timeSlider->blockSignals(false);
+  timeLabel->setText(QString::number(time, 'f', 2) + " s");
+}
+
+// The slider covers the loop, or up to the last key if that is later
+void TimelineWidget::setLength(double length)
+{
+  scene->setAnimationLength(length);
+  double shown = qMax(length, scene->data().animation.duration());
+  timeSlider->blockSignals(true);
+  timeSlider->setRange(0, qRound(shown * sliderRate));
+  timeSlider->blockSignals(false);
+  showTime(scene->animationTime());
+  updateKeys();
+}
+
+void TimelineWidget::setKeyClicked()
+{
+  scene->setKey(object);
+}
+
+void TimelineWidget::deleteKeyClicked()
+{
+  scene->removeKeys(object);
+}
+
+void TimelineWidget::interpolationChanged(int index)
+{
+  scene->setKeyInterpolation(interpolationCombo->itemData(index).toInt());
+}
+
+void TimelineWidget::updateKeys()
+{
+  const SceneAnimation &animation = scene->data().animation;
+  double shown = qMax(lengthSpinbox->value(), animation.duration());
+  if (timeSlider->maximum() < qRound(shown * sliderRate))
+  {
+    timeSlider->blockSignals(true);
+    timeSlider->setMaximum(qRound(shown * sliderRate));
+    timeSlider->blockSignals(false);
+  }
+  keyStrip->setKeys(object >= 0 ? animation.keyTimes(object) : QVector<double>(), (double)timeSlider->maximum() / sliderRate);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <QtCore>
+#include <QtGui>
+#include "scene.h"
+
+class KeyStrip;
+
+// Animation controls under the views: play/pause, a time slider with the
+// keys of the selected object marked under it, the loop length, and keying
+// of the selected object at the current time.
+class TimelineWidget : public QWidget
+{
+
+  Q_OBJECT
+
+public:
+  TimelineWidget(Scene *scene, QWidget *parent = 0);
+
+public slots:
+  void setObject(int index);
+
+private slots:
+  void sliderMoved(int frame);
+  void showTime(double time);
+  void setLength(double length);
+  void setKeyClicked();
+  void deleteKeyClicked();
+  void interpolationChanged(int index);
+  void updateKeys();
+
+private:
+  Scene *scene;
+  int object;
+  QPushButton *playButton;
+  QSlider *timeSlider;
+  KeyStrip *keyStrip;
+  QLabel *timeLabel;
+  QDoubleSpinBox *lengthSpinbox;
+  QComboBox *interpolationCombo;
+  QPushButton *setKeyButton;
+  QPushButton *deleteKeyButton;
+};
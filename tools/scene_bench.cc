@@ -0,0 +1,77 @@
+#include "scene_client.h"
+#include <cmath>
+#include <cstdio>
+
+// Throughput of the scene command server: creates a set of objects, moves
+// them around in batches for a number of edits, then removes them again.
+//
+//   scene_bench [--server name] [--edits count] [--batch size]
+int main(int argc, char *argv[])
+{
+  QCoreApplication app(argc, argv);
+
+  QString serverName = CommandProtocol::defaultServerName();
+  int edits = 1000000, batchSize = 10000;
+  QStringList args = app.arguments();
+  for (int i = 1; i + 1 < args.size(); i += 2)
+  {
+    if (args.at(i) == "--server")
+      serverName = args.at(i + 1);
+    else if (args.at(i) == "--edits")
+      edits = args.at(i + 1).toInt();
+    else if (args.at(i) == "--batch")
+      batchSize = args.at(i + 1).toInt();
+    else
+    {
+      fprintf(stderr, "usage: %s [--server name] [--edits count] [--batch size]\n", argv[0]);
+      return 1;
+    }
+  }
+  edits = qMax(1, edits);
+  batchSize = qBound(1, batchSize, 1000000);
+
+  SceneClient client;
+  if (!client.connectToServer(serverName))
+  {
+    fprintf(stderr, "could not connect to %s: %s\n", qPrintable(serverName), qPrintable(client.errorString()));
+    return 1;
+  }
+
+  // One cube per edit slot of a batch
+  QByteArray results;
+  for (int i = 0; i < batchSize; i++)
+    client.create(1);
+  if (!client.send(&results))
+  {
+    fprintf(stderr, "create failed: %s\n", qPrintable(client.errorString()));
+    return 1;
+  }
+  quint32 first = SceneClient::readU32(results, 0);
+
+  QElapsedTimer timer;
+  timer.start();
+  int done = 0, batches = 0;
+  while (done < edits)
+  {
+    int count = qMin(batchSize, edits - done);
+    double phase = batches * 0.1;
+    for (int i = 0; i < count; i++)
+      client.translate(first + i, (i % 100) - 50.0, sin(phase + i * 0.01), (i / 100) * 1.0 - 50.0);
+    if (!client.send())
+    {
+      fprintf(stderr, "batch %d failed: %s\n", batches, qPrintable(client.errorString()));
+      return 1;
+    }
+    done += count;
+    batches++;
+  }
+  double seconds = timer.nsecsElapsed() / 1e9;
+
+  for (int i = 0; i < batchSize; i++)
+    client.remove(first + i);
+  client.send();
+
+  printf("%d edits in %d batches of %d: %.3f s, %.0f edits/s, %.2f ms per batch\n",
+         edits, batches, batchSize, seconds, edits / seconds, seconds * 1000.0 / batches);
+  return 0;
+}
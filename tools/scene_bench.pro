@@ -0,0 +1,16 @@
+######################################################################
+# Throughput benchmark for the scene command server
+######################################################################
+
+TEMPLATE = app
+TARGET = scene_bench
+CONFIG += console
+DEPENDPATH += . ..
+INCLUDEPATH += . ..
+
+# Input
+HEADERS += scene_client.h ../command_protocol.h
+SOURCES += scene_client.cc scene_bench.cc
+QT -= gui
+QT += network
+QMAKE_CXXFLAGS += -std=c++14
@@ -0,0 +1,135 @@
+#include "scene_client.h"
+#include <QtEndian>
+#include <cstring>
+
+using namespace CommandProtocol;
+
+bool SceneClient::connectToServer(const QString &name, int msecs)
+{
+  socket.connectToServer(name);
+  if (!socket.waitForConnected(msecs))
+  {
+    error = socket.errorString();
+    return false;
+  }
+  return true;
+}
+
+void SceneClient::appendU32(quint32 value)
+{
+  uchar bytes[4];
+  qToLittleEndian(value, bytes);
+  batch.append((const char *)bytes, 4);
+}
+
+void SceneClient::appendVector(int op, quint32 index, double x, double y, double z)
+{
+  batch.append((char)op);
+  appendU32(index);
+  double values[3] = { x, y, z };
+  for (int i = 0; i < 3; i++)
+  {
+    quint64 bits;
+    memcpy(&bits, &values[i], sizeof(bits));
+    uchar bytes[8];
+    qToLittleEndian(bits, bytes);
+    batch.append((const char *)bytes, 8);
+  }
+}
+
+void SceneClient::create(int type)
+{
+  batch.append((char)Create);
+  batch.append((char)type);
+}
+
+void SceneClient::translate(quint32 index, double x, double y, double z)
+{
+  appendVector(Translate, index, x, y, z);
+}
+
+void SceneClient::rotate(quint32 index, double x, double y, double z)
+{
+  appendVector(Rotate, index, x, y, z);
+}
+
+void SceneClient::scale(quint32 index, double x, double y, double z)
+{
+  appendVector(Scale, index, x, y, z);
+}
+
+void SceneClient::color(quint32 index, double r, double g, double b)
+{
+  appendVector(Color, index, r, g, b);
+}
+
+void SceneClient::remove(quint32 index)
+{
+  batch.append((char)Remove);
+  appendU32(index);
+}
+
+void SceneClient::query(quint32 index)
+{
+  batch.append((char)Query);
+  appendU32(index);
+}
+
+void SceneClient::count()
+{
+  batch.append((char)Count);
+}
+
+void SceneClient::save(const QString &fileName)
+{
+  QByteArray name = fileName.toUtf8().left(0xffff);
+  uchar length[2];
+  qToLittleEndian((quint16)name.size(), length);
+  batch.append((char)Save);
+  batch.append((const char *)length, 2);
+  batch.append(name);
+}
+
+bool SceneClient::send(QByteArray *results, int msecs)
+{
+  QByteArray header;
+  header.resize(HeaderSize);
+  qToLittleEndian((quint32)batch.size(), (uchar *)header.data());
+  socket.write(header);
+  socket.write(batch);
+  batch.clear();
+
+  // Wait for the whole reply
+  while (socket.bytesAvailable() < HeaderSize || socket.bytesAvailable() < HeaderSize + readU32(socket.peek(HeaderSize), 0))
+  {
+    bool ok = socket.bytesToWrite() > 0 ? socket.waitForBytesWritten(msecs) : socket.waitForReadyRead(msecs);
+    if (!ok)
+    {
+      error = socket.errorString();
+      return false;
+    }
+  }
+
+  QByteArray reply = socket.read(HeaderSize + readU32(socket.peek(HeaderSize), 0));
+  if (reply.at(HeaderSize) != Ok)
+  {
+    error = QString("batch rejected at byte %1").arg(readU32(reply, HeaderSize + 1));
+    return false;
+  }
+  if (results)
+    *results = reply.mid(ReplyHeaderSize);
+  return true;
+}
+
+quint32 SceneClient::readU32(const QByteArray &data, int offset)
+{
+  return qFromLittleEndian<quint32>((const uchar *)data.constData() + offset);
+}
+
+double SceneClient::readDouble(const QByteArray &data, int offset)
+{
+  quint64 bits = qFromLittleEndian<quint64>((const uchar *)data.constData() + offset);
+  double value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
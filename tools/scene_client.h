@@ -0,0 +1,43 @@
+#pragma once
+
+#include <QtCore>
+#include <QLocalSocket>
+#include "command_protocol.h"
+
+// Client side of the scene command server. Commands are queued into a
+// batch; send() ships it and waits for the reply.
+class SceneClient
+{
+public:
+  bool connectToServer(const QString &name = CommandProtocol::defaultServerName(), int msecs = 3000);
+  QString errorString() const { return error; }
+
+  void create(int type);
+  void translate(quint32 index, double x, double y, double z);
+  void rotate(quint32 index, double x, double y, double z);
+  void scale(quint32 index, double x, double y, double z);
+  void color(quint32 index, double r, double g, double b);
+  void remove(quint32 index);
+  void query(quint32 index);
+  void count();
+  void save(const QString &fileName);
+
+  // Bytes queued for the next send()
+  int batchSize() const { return batch.size(); }
+
+  // Send the queued batch and wait for the server to apply it. The results
+  // of the batch's commands are left in results, in order; false if the
+  // connection failed or the server rejected the batch.
+  bool send(QByteArray *results = 0, int msecs = 30000);
+
+  static quint32 readU32(const QByteArray &data, int offset);
+  static double readDouble(const QByteArray &data, int offset);
+
+private:
+  void appendU32(quint32 value);
+  void appendVector(int op, quint32 index, double x, double y, double z);
+
+  QLocalSocket socket;
+  QByteArray batch;
+  QString error;
+};
@@ -0,0 +1,166 @@
+#include "trace.h"
+
+#ifdef VOXEL_TRACE
+
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <QFile>
+#include <QTextStream>
+
+struct TraceEvent
+{
+  const char *name;
+  qint64 start;    // Microseconds since startup
+  qint64 duration;
+};
+
+// Single producer (its thread), any number of readers
+class TraceBuffer
+{
+public:
+  enum { Capacity = 1 << 16 };
+
+  TraceBuffer(int id, const QString &threadName) : id(id), threadName(threadName), head(0), events(Capacity) {}
+
+  void record(const char *name, qint64 start, qint64 duration)
+  {
+    quint64 h = head.load(std::memory_order_relaxed);
+    // Keeps the overwrite behind the head that tells readers about it
+    std::atomic_thread_fence(std::memory_order_release);
+    TraceEvent &event = events[h & (Capacity - 1)];
+    event.name = name;
+    event.start = start;
+    event.duration = duration;
+    head.store(h + 1, std::memory_order_release);
+  }
+
+  // Copy out the events, dropping any the thread overwrote meanwhile
+  std::vector<TraceEvent> snapshot() const
+  {
+    quint64 end = head.load(std::memory_order_acquire);
+    quint64 first = end > Capacity ? end - Capacity : 0;
+    std::vector<TraceEvent> copy;
+    copy.reserve(end - first);
+    for (quint64 i = first; i < end; i++)
+      copy.push_back(events[i & (Capacity - 1)]);
+
+    // The copy has to be done before the recheck, or a torn event could
+    // pass it; the acquire load alone only orders what comes after it
+    std::atomic_thread_fence(std::memory_order_acquire);
+    quint64 now = head.load(std::memory_order_relaxed);
+    quint64 overwritten = now >= Capacity ? now - Capacity + 1 : 0;
+    if (overwritten > first)
+      copy.erase(copy.begin(), copy.begin() + (int)qMin(overwritten - first, (quint64)copy.size()));
+    return copy;
+  }
+
+  const int id;
+  const QString threadName;
+
+private:
+  std::atomic<quint64> head;
+  std::vector<TraceEvent> events;
+};
+
+static qint64 traceNow()
+{
+  static const std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - origin).count();
+}
+
+// Buffers outlive their threads, so a dump still shows finished workers
+static QMutex registryMutex;
+static std::vector<TraceBuffer *> registry;
+static thread_local TraceBuffer *localBuffer = 0;
+
+static TraceBuffer *threadBuffer()
+{
+  if (localBuffer)
+    return localBuffer;
+
+  QMutexLocker locker(&registryMutex);
+  int id = (int)registry.size() + 1;
+  QString name = QThread::currentThread() ? QThread::currentThread()->objectName() : QString();
+  if (name.isEmpty())
+    name = QString("Worker %1").arg(id);
+  localBuffer = new TraceBuffer(id, name);
+  registry.push_back(localBuffer);
+  return localBuffer;
+}
+
+TraceScope::TraceScope(const char *name) : name(name), start(traceNow())
+{
+}
+
+TraceScope::~TraceScope()
+{
+  qint64 end = traceNow();
+  threadBuffer()->record(name, start, end - start);
+}
+
+bool traceCompiledIn()
+{
+  return true;
+}
+
+static QString jsonString(const QString &text)
+{
+  QString escaped = text;
+  escaped.replace('\\', "\\\\").replace('"', "\\\"");
+  return '"' + escaped + '"';
+}
+
+bool dumpTrace(const QString &fileName)
+{
+  std::vector<TraceBuffer *> buffers;
+  {
+    QMutexLocker locker(&registryMutex);
+    buffers = registry;
+  }
+
+  QFile outFile(fileName);
+  if (!outFile.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+    return false;
+  QTextStream out(&outFile);
+  out << "{\"traceEvents\":[\n";
+
+  bool first = true;
+  for (size_t b = 0; b < buffers.size(); b++)
+  {
+    const TraceBuffer *buffer = buffers[b];
+    out << (first ? "" : ",\n") << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << buffer->id
+        << ",\"args\":{\"name\":" << jsonString(buffer->threadName) << "}}";
+    first = false;
+
+    std::vector<TraceEvent> events = buffer->snapshot();
+    for (size_t i = 0; i < events.size(); i++)
+      out << ",\n{\"ph\":\"X\",\"name\":" << jsonString(events[i].name) << ",\"pid\":1,\"tid\":" << buffer->id
+          << ",\"ts\":" << events[i].start << ",\"dur\":" << events[i].duration << '}';
+  }
+  out << "\n]}\n";
+  out.flush();
+  return outFile.error() == QFile::NoError;
+}
+
+#else
+
+TraceScope::TraceScope(const char *name) : name(name), start(0)
+{
+}
+
+TraceScope::~TraceScope()
+{
+}
+
+bool traceCompiledIn()
+{
+  return false;
+}
+
+bool dumpTrace(const QString &)
+{
+  return false;
+}
+
+#endif
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <QtCore>
+
+// Scoped trace markers for a Chrome trace-event timeline (chrome://tracing
+// or Perfetto). Only compiled in with "qmake CONFIG+=tracing"; otherwise
+// TRACE_SCOPE expands to nothing and costs nothing.
+//
+// Every thread records into its own ring buffer of the most recent events,
+// without locks; dumpTrace() copies all buffers out while they keep going.
+// Names must be string literals, only the pointer is stored.
+#ifdef VOXEL_TRACE
+#define TRACE_SCOPE(name) TraceScope traceScope(name)
+#else
+#define TRACE_SCOPE(name) do {} while (0)
+#endif
+
+class TraceScope
+{
+public:
+  explicit TraceScope(const char *name);
+  ~TraceScope();
+
+private:
+  const char *name;
+  qint64 start;
+};
+
+// False in builds without tracing, where there is nothing to dump
+bool traceCompiledIn();
+
+// Write everything recorded so far as trace-event JSON
+bool dumpTrace(const QString &fileName);
@@ -0,0 +1,279 @@
+#include "video_exporter.h"
+#include <QGLBuffer>
+#include <QGLPixelBuffer>
+#include <QImage>
+#include <cmath>
+#include <cstring>
+#include "memory_stats.h"
+#include "renderer.h"
+#include "scene_math.h"
+#include "trace.h"
+
+// Not in GL 1.1 headers
+#ifndef GL_BGRA
+#define GL_BGRA 0x80E1
+#endif
+#ifndef GL_UNSIGNED_INT_8_8_8_8_REV
+#define GL_UNSIGNED_INT_8_8_8_8_REV 0x8367
+#endif
+
+static const int readbackBuffers = 3; // Frames between glReadPixels and mapping
+static const int queuedPerWriter = 2; // Frames that may wait for each writer thread
+
+/***********/
+/* WRITERS */
+/***********/
+
+// Saves a frame read back bottom-up
+struct FrameWriter : public QRunnable
+{
+  QImage image;
+  QString fileName;
+  QSemaphore *room;
+  QAtomicInt *failures;
+  MemoryCharge charge;
+
+  FrameWriter(const QImage &image, const QString &fileName, QSemaphore *room, QAtomicInt *failures)
+    : image(image), fileName(fileName), room(room), failures(failures), charge(IoMemory, image.byteCount())
+  {
+  }
+
+  void run()
+  {
+    TRACE_SCOPE("FrameWriter::run");
+    if (!image.mirrored().save(fileName, "PNG"))
+      failures->ref();
+    image = QImage();
+    charge.resize(0);
+    room->release();
+  }
+};
+
+struct FrameWriters
+{
+  QThreadPool pool;
+  QSemaphore room; // Frames that may still be queued
+  QAtomicInt failures;
+
+  FrameWriters() : failures(0)
+  {
+    pool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() - 1));
+    room.release(queuedPerWriter * pool.maxThreadCount());
+  }
+
+  // Waits while the writers are behind
+  void write(const QImage &image, const QString &fileName)
+  {
+    if (image.isNull())
+    {
+      failures.ref();
+      return;
+    }
+    room.acquire();
+    pool.start(new FrameWriter(image, fileName, &room, &failures));
+  }
+};
+
+/************/
+/* READBACK */
+/************/
+
+// A frame on its way from the render target to a writer
+struct Readback
+{
+  QGLBuffer buffer;
+  QImage image; // Read into directly without buffer objects
+
+  Readback() : buffer(QGLBuffer::PixelPackBuffer) {}
+};
+
+// Returns at once with a buffer object bound; the copy happens later
+static void startReadback(Readback &readback, bool buffered, int width, int height)
+{
+  TRACE_SCOPE("startReadback");
+  if (buffered)
+  {
+    readback.buffer.bind();
+    glReadPixels(0, 0, width, height, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, 0);
+    QGLBuffer::release(QGLBuffer::PixelPackBuffer);
+    return;
+  }
+  readback.image = QImage(width, height, QImage::Format_RGB32);
+  glReadPixels(0, 0, width, height, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, readback.image.bits());
+}
+
+// The frame, bottom row first; null if the buffer could not be mapped
+static QImage finishReadback(Readback &readback, bool buffered, int width, int height)
+{
+  TRACE_SCOPE("finishReadback");
+  if (!buffered)
+  {
+    QImage image = readback.image;
+    readback.image = QImage();
+    return image;
+  }
+  QImage image;
+  readback.buffer.bind();
+  const void *pixels = readback.buffer.map(QGLBuffer::ReadOnly);
+  if (pixels)
+  {
+    image = QImage(width, height, QImage::Format_RGB32);
+    memcpy(image.bits(), pixels, image.byteCount());
+    readback.buffer.unmap();
+  }
+  QGLBuffer::release(QGLBuffer::PixelPackBuffer);
+  return image;
+}
+
+/************/
+/* EXPORTER */
+/************/
+
+VideoExporter::VideoExporter(const VideoSettings &settings, const SceneData &scene, double animationLength,
+                             const BakedColors &baked, QGLWidget *shareWidget, QObject *parent)
+  : QThread(parent), settings(settings), scene(scene), animationLength(animationLength), baked(baked),
+    shareWidget(shareWidget), cancelled(0)
+{
+  succeeded = false;
+  setObjectName("Video export"); // Thread name in traces
+}
+
+VideoExporter::~VideoExporter()
+{
+  cancel();
+  wait();
+}
+
+int VideoExporter::frameCount() const
+{
+  return frameCount(settings.seconds, settings.frameRate);
+}
+
+int VideoExporter::frameCount(double seconds, double frameRate)
+{
+  return qMax(1, (int)floor(seconds * frameRate + 0.5));
+}
+
+QString VideoExporter::frameFileName(int frame) const
+{
+  QFileInfo info(settings.fileName);
+  return info.dir().filePath(QString("%1_%2.png").arg(info.completeBaseName()).arg(frame, 4, 10, QChar('0')));
+}
+
+void VideoExporter::cancel()
+{
+  cancelled = 1;
+}
+
+void VideoExporter::run()
+{
+  TRACE_SCOPE("VideoExporter::run");
+  QElapsedTimer timer;
+  timer.start();
+  int width = settings.width, height = settings.height;
+
+  QGLPixelBuffer target(width, height, QGLFormat::defaultFormat(), shareWidget);
+  if (!target.isValid() || !target.makeCurrent())
+  {
+    emit exported("Could not create an offscreen buffer for the video");
+    return;
+  }
+  Renderer renderer;
+  renderer.initialize();
+  renderer.resize(width, height);
+
+  Readback readbacks[readbackBuffers];
+  bool buffered = true;
+  for (int r = 0; r < readbackBuffers && buffered; r++)
+  {
+    buffered = readbacks[r].buffer.create();
+    if (!buffered)
+      break;
+    readbacks[r].buffer.setUsagePattern(QGLBuffer::StreamRead);
+    readbacks[r].buffer.bind();
+    readbacks[r].buffer.allocate(width * height * 4);
+  }
+  QGLBuffer::release(QGLBuffer::PixelPackBuffer);
+  FrameWriters writers;
+
+  FrameState frame;
+  frame.width = width;
+  frame.height = height;
+  frame.orthographic = false;
+  frame.orthoSize = 1.0;
+  frame.tileX = frame.tileY = 0;
+  frame.tileWidth = frame.tileHeight = 0;
+  frame.occlusionCulling = true;
+  frame.levelOfDetail = true;
+  frame.baked = baked;
+
+  SceneData posed = scene;
+  bool animated = !scene.animation.isEmpty();
+  Vec3 boundsMin, boundsMax;
+  if (settings.turntable)
+  {
+    if (animated)
+      scene.animation.evaluate(0.0, posed);
+    sceneBounds(posed, boundsMin, boundsMax);
+  }
+
+  // Frame f is drawn while frame f - readbackBuffers + 1 is handed over
+  int count = frameCount(), percent = -1;
+  int first = settings.endFrame > 0 ? qBound(0, settings.firstFrame, count) : 0;
+  int end = settings.endFrame > 0 ? qBound(first, settings.endFrame, count) : count;
+  int drawn = first, written = first;
+  for (; drawn < end && (int)cancelled == 0; drawn++)
+  {
+    if (animated)
+    {
+      double time = drawn / settings.frameRate;
+      if (animationLength > 0.0)
+        time = fmod(time, animationLength);
+      scene.animation.evaluate(time, posed);
+    }
+    CameraKey camera = settings.turntable ? turntableCamera(boundsMin, boundsMax, (double)drawn / count)
+                                          : flythroughCamera(settings.keys, count > 1 ? (double)drawn / (count - 1) : 0.0);
+    double right[3];
+    for (int k = 0; k < 3; k++)
+      frame.camPosition[k] = camera.position[k];
+    cameraAxes(camera.rotation[0], camera.rotation[1], frame.forwardVec, right, frame.upVec);
+
+    frame.scene = posed;
+    frame.revision = animated ? drawn + 1 : 0; // Poses change colors and scales, which the queue holds
+    renderer.render(frame);
+    frame.scene = SceneData(); // Drop our share so posing the next frame doesn't copy
+    startReadback(readbacks[drawn % readbackBuffers], buffered, width, height);
+
+    if (drawn - written == readbackBuffers - 1)
+    {
+      writers.write(finishReadback(readbacks[written % readbackBuffers], buffered, width, height), frameFileName(written));
+      written++;
+    }
+    if ((drawn + 1 - first) * 100 / (end - first) != percent)
+    {
+      percent = (drawn + 1 - first) * 100 / (end - first);
+      emit progress("Rendering", percent);
+    }
+  }
+  for (; written < drawn; written++)
+    writers.write(finishReadback(readbacks[written % readbackBuffers], buffered, width, height), frameFileName(written));
+
+  writers.pool.waitForDone();
+  for (int r = 0; r < readbackBuffers; r++)
+    readbacks[r].buffer.destroy();
+  renderer.shutdown();
+  target.doneCurrent();
+
+  double seconds = timer.elapsed() / 1000.0;
+  int frames = end - first;
+  if ((int)cancelled != 0)
+    emit exported(QString("Video export cancelled after %1 frames").arg(written - first));
+  else if ((int)writers.failures != 0)
+    emit exported(QString("Could not write %1 of %2 video frames").arg((int)writers.failures).arg(frames));
+  else
+  {
+    succeeded = true;
+    emit exported(QString("Exported %1 frames from %2 in %3 s (%4 frames/s)").arg(frames).arg(frameFileName(first))
+                  .arg(seconds, 0, 'f', 1).arg(frames / qMax(seconds, 0.001), 0, 'f', 1));
+  }
+}
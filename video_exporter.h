@@ -0,0 +1,70 @@
+#pragma once
+
+#include <QtCore>
+#include "camera_path.h"
+#include "lighting_bake.h"
+#include "scene_data.h"
+
+class QGLWidget;
+
+struct VideoSettings
+{
+  QString fileName; // Frames are numbered after it: name_0000.png, name_0001.png, ...
+  int width;
+  int height;
+  double seconds;
+  double frameRate;
+  bool turntable; // Else a flythrough of keys
+  QVector<CameraKey> keys;
+  int firstFrame, endFrame; // Farm workers draw part of the video; endFrame 0 draws all of it
+
+  VideoSettings() : firstFrame(0), endFrame(0) {}
+};
+
+// Renders a camera path offscreen into a numbered PNG sequence, for
+// ffmpeg -i name_%04d.png and the like. Animated scenes play their keys
+// from time 0 along with the video.
+//
+// The stages overlap: while frame N is drawn, the frames before it are
+// still being read back into a ring of pixel buffer objects, and older
+// ones are compressed on a pool of writer threads, so the export runs at
+// the speed of rendering. Writers are a pool of their own, as the
+// renderer waits on the global one, and only a few frames may queue for
+// them. Without buffer objects frames are read back directly.
+class VideoExporter : public QThread
+{
+
+  Q_OBJECT
+
+public:
+  // The render context shares GL resources with shareWidget's, if any
+  VideoExporter(const VideoSettings &settings, const SceneData &scene, double animationLength, const BakedColors &baked,
+                QGLWidget *shareWidget, QObject *parent = 0);
+  ~VideoExporter();
+
+  int frameCount() const; // Of the whole video
+  static int frameCount(double seconds, double frameRate);
+  QString frameFileName(int frame) const;
+
+  // Once exported() was emitted: every frame asked for was written
+  bool isComplete() const { return succeeded; }
+
+public slots:
+  void cancel();
+
+signals:
+  void progress(QString phase, int percent);
+  void exported(QString report);
+
+protected:
+  void run();
+
+private:
+  VideoSettings settings;
+  SceneData scene; // Rest pose, with its keys
+  double animationLength;
+  BakedColors baked;
+  QGLWidget *shareWidget;
+  QAtomicInt cancelled;
+  bool succeeded;
+};
@@ -1,80 +1,225 @@
 #include "viewer.h"
+#include "interference_checker.h"
+#include "lighting_baker.h"
+#include "memory_stats.h"
+#include "mesh_editor.h"
+#include "mesh_lod.h"
+#include "poster_renderer.h"
+#include "scene_open_dialog.h"
+#include "streamed_scene.h"
+#include "timeline_widget.h"
+#include "trace.h"
+#include "video_exporter.h"
+
+static const int maxListedPairs = 500; // Interfering pairs shown on the check tab
+static const int videoWidth = 1280;
+static const int videoHeight = 720;
+static const double videoFrameRate = 30.0;
+static const int maxPosterSize = 32768; // Pixels along either side
 
 Viewer::Viewer(QWidget *parent) : QMainWindow(parent)
 {
 	// Setup UI
 	ui.setupUi(this);
 
-	// Add OpenGL widget
-	glViewer = new GLViewer;
-	ui.viewLayout->addWidget(glViewer);
+	// The scene, and the viewports onto it. The perspective view is created
+	// first and shares its GL resources with the others.
+	scene = new Scene(this);
+	commandServer = new CommandServer(scene, this);
+	glViewer = new GLViewer(scene, GLViewer::PerspectiveView);
+	topViewer = new GLViewer(scene, GLViewer::TopView, 0, glViewer);
+	frontViewer = new GLViewer(scene, GLViewer::FrontView, 0, glViewer);
+	sideViewer = new GLViewer(scene, GLViewer::SideView, 0, glViewer);
+
+	QWidget *viewGrid = new QWidget;
+	QGridLayout *gridLayout = new QGridLayout(viewGrid);
+	gridLayout->setSpacing(1);
+	gridLayout->setMargin(0);
+	gridLayout->addWidget(topViewer, 0, 0);
+	gridLayout->addWidget(glViewer, 0, 1);
+	gridLayout->addWidget(frontViewer, 1, 0);
+	gridLayout->addWidget(sideViewer, 1, 1);
+	setFourViews(false);
+
+	// Animation timeline under the views
+	timeline = new TimelineWidget(scene);
+	QWidget *viewArea = new QWidget;
+	QVBoxLayout *viewAreaLayout = new QVBoxLayout(viewArea);
+	viewAreaLayout->setSpacing(2);
+	viewAreaLayout->setMargin(0);
+	viewAreaLayout->addWidget(viewGrid, 1);
+	viewAreaLayout->addWidget(timeline);
+	ui.viewLayout->addWidget(viewArea);
+	videoExporter = 0;
+	posterRenderer = 0;
 
 	// Initial color value
 	color = QColor(0.8 * 255.0, 0.8 * 255.0, 0.8 * 255.0);
 	ui.colorPreviewLabel->setPalette(QPalette(color));
 	ui.colorPreviewLabel->setAutoFillBackground(true);
 
+	// Object names, one pooled row per scene object
+	objectList = new ObjectListModel(this);
+	ui.objectListView->setModel(objectList);
+	quietListChange = false;
+
+	// Frame statistics
+	statsLabel = new QLabel;
+	ui.statusBar->addPermanentWidget(statsLabel);
+
+	// Memory use, refreshed once a second; the breakdown is in the tooltip
+	memoryLabel = new QLabel;
+	ui.statusBar->addPermanentWidget(memoryLabel);
+	QTimer *memoryTimer = new QTimer(this);
+	connect(memoryTimer, SIGNAL(timeout()), this, SLOT(updateMemoryStats()));
+	memoryTimer->start(1000);
+
+	// Background load/save progress, only shown while one runs
+	ioProgressBar = new QProgressBar;
+	ioProgressBar->setMaximumWidth(200);
+	ioProgressBar->hide();
+	ui.statusBar->addPermanentWidget(ioProgressBar);
+	cancelIoButton = new QPushButton(tr("Cancel"));
+	cancelIoButton->hide();
+	ui.statusBar->addPermanentWidget(cancelIoButton);
+
 	// Connections
-	connect(glViewer, SIGNAL(changeCoords(double, double)), this, SLOT(setCoords(double, double)));
+	foreach (GLViewer *view, views())
+		connect(view, SIGNAL(changeCoords(double, double)), this, SLOT(setCoords(double, double)));
+	connect(glViewer, SIGNAL(cullStats(int, int)), this, SLOT(setCullStats(int, int)));
+	connect(glViewer, SIGNAL(stateChanges(int, int)), this, SLOT(setStateChanges(int, int)));
+	connect(glViewer, SIGNAL(trianglesDrawn(int)), this, SLOT(setTriangleCount(int)));
+	connect(glViewer, SIGNAL(frameTime(double)), this, SLOT(setFrameTime(double)));
 
 	// Connect Objects
-	connect(ui.createPlaneButton, SIGNAL(clicked()), glViewer, SLOT(createPlane()));
-	connect(ui.createCubeButton, SIGNAL(clicked()), glViewer, SLOT(createCube()));
-	connect(ui.createSphereButton, SIGNAL(clicked()), glViewer, SLOT(createSphere()));
-	connect(ui.createCylinderButton, SIGNAL(clicked()), glViewer, SLOT(createCylinder()));
-	connect(ui.createConeButton, SIGNAL(clicked()), glViewer, SLOT(createCone()));
-	connect(ui.createPyramidButton, SIGNAL(clicked()), glViewer, SLOT(createPyramid()));
-	connect(ui.createWedgeButton, SIGNAL(clicked()), glViewer, SLOT(createWedge()));
+	connect(ui.createPlaneButton, SIGNAL(clicked()), scene, SLOT(createPlane()));
+	connect(ui.createCubeButton, SIGNAL(clicked()), scene, SLOT(createCube()));
+	connect(ui.createSphereButton, SIGNAL(clicked()), scene, SLOT(createSphere()));
+	connect(ui.createCylinderButton, SIGNAL(clicked()), scene, SLOT(createCylinder()));
+	connect(ui.createConeButton, SIGNAL(clicked()), scene, SLOT(createCone()));
+	connect(ui.createPyramidButton, SIGNAL(clicked()), scene, SLOT(createPyramid()));
+	connect(ui.createWedgeButton, SIGNAL(clicked()), scene, SLOT(createWedge()));
+
+	// Connect generators
+	connect(ui.generateButton, SIGNAL(clicked()), this, SLOT(generateClicked()));
+	connect(this, SIGNAL(callGenerate(int, int, int)), scene, SLOT(generate(int, int, int)));
+	connect(scene, SIGNAL(generated(QString)), glViewer, SLOT(startBenchmark(QString)));
+	connect(glViewer, SIGNAL(benchmarkReport(QString)), ui.statusBar, SLOT(showMessage(QString)));
+
+	// Connect interference checks
+	connect(ui.interferenceCheckBox, SIGNAL(toggled(bool)), scene->interference(), SLOT(setEnabled(bool)));
+	connect(scene->interference(), SIGNAL(pairsChanged()), this, SLOT(interferenceChanged()));
+	connect(scene->interference(), SIGNAL(finished(QString)), ui.statusBar, SLOT(showMessage(QString)));
+	connect(ui.interferenceList, SIGNAL(currentRowChanged(int)), this, SLOT(interferenceRowChanged(int)));
+
+	// Connect mesh editing
+	MeshEditor *meshEditor = scene->meshEditor();
+	connect(ui.meshEditCheckBox, SIGNAL(toggled(bool)), this, SLOT(meshEditToggled(bool)));
+	connect(ui.subdivisionSpinbox, SIGNAL(valueChanged(int)), meshEditor, SLOT(setLevel(int)));
+	connect(ui.vertexSpinbox, SIGNAL(valueChanged(int)), this, SLOT(meshVertexChanged()));
+	connect(ui.vertexXSpinbox, SIGNAL(valueChanged(double)), this, SLOT(moveMeshVertex()));
+	connect(ui.vertexYSpinbox, SIGNAL(valueChanged(double)), this, SLOT(moveMeshVertex()));
+	connect(ui.vertexZSpinbox, SIGNAL(valueChanged(double)), this, SLOT(moveMeshVertex()));
+	connect(ui.extrudeButton, SIGNAL(clicked()), this, SLOT(extrudeMeshFace()));
+	connect(ui.removeFaceButton, SIGNAL(clicked()), this, SLOT(removeMeshFace()));
+	connect(ui.revertMeshButton, SIGNAL(clicked()), this, SLOT(revertMesh()));
+	connect(meshEditor, SIGNAL(cageChanged()), this, SLOT(meshChanged()));
+	connect(meshEditor, SIGNAL(updated(QString)), ui.statusBar, SLOT(showMessage(QString)));
+	meshChanged();
 
 	// Connect infoList
-	connect(glViewer, SIGNAL(addToList(QString)), this, SLOT(addToList(QString)));
+	connect(scene, SIGNAL(addToList(QString)), this, SLOT(addToList(QString)));
 
 	// Connect translations
 	connect(ui.translateXSpinbox, SIGNAL(valueChanged(double)), this, SLOT(updateTranslation()));
 	connect(ui.translateYSpinbox, SIGNAL(valueChanged(double)), this, SLOT(updateTranslation()));
 	connect(ui.translateZSpinbox, SIGNAL(valueChanged(double)), this, SLOT(updateTranslation()));
-	connect(this, SIGNAL(sendTranslation(int, double, double, double)), glViewer, SLOT(receiveTranslation(int, double, double, double)));
+	connect(this, SIGNAL(sendTranslation(int, double, double, double)), scene, SLOT(receiveTranslation(int, double, double, double)));
 
 	// Connect rotations
 	connect(ui.rotateXSpinbox, SIGNAL(valueChanged(double)), this, SLOT(updateRotation()));
 	connect(ui.rotateYSpinbox, SIGNAL(valueChanged(double)), this, SLOT(updateRotation()));
 	connect(ui.rotateZSpinbox, SIGNAL(valueChanged(double)), this, SLOT(updateRotation()));
-	connect(this, SIGNAL(sendRotation(int, double, double, double)), glViewer, SLOT(receiveRotation(int, double, double, double)));
+	connect(this, SIGNAL(sendRotation(int, double, double, double)), scene, SLOT(receiveRotation(int, double, double, double)));
 
 	// Connect scale
 	connect(ui.scaleXSpinbox, SIGNAL(valueChanged(double)), this, SLOT(updateScale()));
 	connect(ui.scaleYSpinbox, SIGNAL(valueChanged(double)), this, SLOT(updateScale()));
 	connect(ui.scaleZSpinbox, SIGNAL(valueChanged(double)), this, SLOT(updateScale()));
-	connect(this, SIGNAL(sendScale(int, double, double, double)), glViewer, SLOT(receiveScale(int, double, double, double)));
+	connect(this, SIGNAL(sendScale(int, double, double, double)), scene, SLOT(receiveScale(int, double, double, double)));
 
 	// Color signals
 	connect(ui.editColorButton, SIGNAL(clicked()), this, SLOT(colorWheel()));
-	connect(this, SIGNAL(sendColor(int, double, double, double)), glViewer, SLOT(receiveColor(int, double, double, double)));
+	connect(this, SIGNAL(sendColor(int, double, double, double)), scene, SLOT(receiveColor(int, double, double, double)));
 
 	// Connect updates
-	connect(ui.infoListWidget, SIGNAL(currentRowChanged(int)), glViewer, SLOT(answerInfo(int)));
-	connect(this, SIGNAL(manualListUpdate(int)), glViewer, SLOT(answerInfo(int)));
-	connect(this, SIGNAL(requestInfo(int)), glViewer, SLOT(answerInfo(int)));
-	connect(glViewer, SIGNAL(sendInfo(std::vector<double>)), this, SLOT(receiveInfo(std::vector<double>)));
+	connect(ui.objectListView->selectionModel(), SIGNAL(currentRowChanged(QModelIndex, QModelIndex)), this, SLOT(listRowChanged(QModelIndex)));
+	connect(this, SIGNAL(manualListUpdate(int)), scene, SLOT(answerInfo(int)));
+	connect(this, SIGNAL(requestInfo(int)), scene, SLOT(answerInfo(int)));
+	connect(scene, SIGNAL(sendInfo(std::vector<double>)), this, SLOT(receiveInfo(std::vector<double>)));
+	connect(scene, SIGNAL(animationTimeChanged(double)), this, SLOT(animationTimeChanged()));
 
 	// Connect menuBar
 	//connect(ui.actionNew, SIGNAL(triggered()), this, SLOT(newProject()));
 	connect(ui.actionSave, SIGNAL(triggered()), this, SLOT(saveProject()));
 	connect(ui.actionLoad, SIGNAL(triggered()), this, SLOT(loadProject()));
+	connect(ui.actionExportObj, SIGNAL(triggered()), this, SLOT(exportProject()));
+	connect(ui.actionExportStreamed, SIGNAL(triggered()), this, SLOT(exportStreamed()));
+	connect(ui.actionCloseStreamed, SIGNAL(triggered()), scene, SLOT(closeStreamed()));
+	connect(ui.actionCloseStreamed, SIGNAL(triggered()), this, SLOT(streamedClosed()));
+	connect(ui.actionExportTurntable, SIGNAL(triggered()), this, SLOT(exportTurntable()));
+	connect(ui.actionAddFlythroughKey, SIGNAL(triggered()), this, SLOT(addFlythroughKey()));
+	connect(ui.actionClearFlythroughKeys, SIGNAL(triggered()), this, SLOT(clearFlythroughKeys()));
+	connect(ui.actionExportFlythrough, SIGNAL(triggered()), this, SLOT(exportFlythrough()));
+	connect(ui.actionRenderPoster, SIGNAL(triggered()), this, SLOT(renderPoster()));
 	connect(ui.actionQuit, SIGNAL(triggered()), this, SLOT(close()));
+	connect(ui.actionFourViews, SIGNAL(toggled(bool)), this, SLOT(setFourViews(bool)));
+	foreach (GLViewer *view, views())
+	{
+		connect(ui.actionOcclusionCulling, SIGNAL(toggled(bool)), view, SLOT(setOcclusionCulling(bool)));
+		connect(ui.actionLevelOfDetail, SIGNAL(toggled(bool)), view, SLOT(setLevelOfDetail(bool)));
+	}
+	connect(ui.actionBakedLighting, SIGNAL(toggled(bool)), scene->lighting(), SLOT(setEnabled(bool)));
+	connect(scene->lighting(), SIGNAL(started(QString)), ui.statusBar, SLOT(showMessage(QString)));
+	connect(scene->lighting(), SIGNAL(finished(QString)), ui.statusBar, SLOT(showMessage(QString)));
+	connect(ui.actionJournaledSaves, SIGNAL(toggled(bool)), scene, SLOT(setJournaledSaves(bool)));
+	connect(ui.actionCompactEncoding, SIGNAL(toggled(bool)), scene, SLOT(setCompactEncoding(bool)));
+	connect(ui.actionCompactEncoding, SIGNAL(toggled(bool)), ui.actionHalfFloatTransforms, SLOT(setEnabled(bool)));
+	connect(ui.actionHalfFloatTransforms, SIGNAL(toggled(bool)), scene, SLOT(setHalfFloatTransforms(bool)));
+	connect(ui.actionCommandServer, SIGNAL(toggled(bool)), this, SLOT(setCommandServer(bool)));
 	connect(ui.actionAbout_3, SIGNAL(triggered()), this, SLOT(aboutInfo()));
 	connect(ui.actionHelp, SIGNAL(triggered()), this, SLOT(helpInfo()));
+	connect(ui.actionMeshStatistics, SIGNAL(triggered()), this, SLOT(meshInfo()));
+	connect(ui.actionSaveTrace, SIGNAL(triggered()), this, SLOT(saveTrace()));
+	ui.actionSaveTrace->setVisible(traceCompiledIn());
 
 	// Connect remove signals
 	connect(ui.removeButton, SIGNAL(clicked()), this, SLOT(removeObjectClicked()));
-	connect(this, SIGNAL(removeObject(int)), glViewer, SLOT(removeObject(int)));
+	connect(this, SIGNAL(removeObject(int)), scene, SLOT(removeObject(int)));
 
 	// Connect save and load functionality
-	connect(this, SIGNAL(callSave(QString)), glViewer, SLOT(saveFile(QString)));
-	connect(this, SIGNAL(callLoad(QString)), glViewer, SLOT(loadFile(QString)));
+	connect(this, SIGNAL(callSave(QString)), scene, SLOT(saveFile(QString)));
+	connect(this, SIGNAL(callLoad(QString)), scene, SLOT(loadFile(QString)));
+	connect(this, SIGNAL(callRecover(QString)), scene, SLOT(recoverFile(QString)));
+	connect(this, SIGNAL(callExport(QString)), scene, SLOT(exportFile(QString)));
+	connect(this, SIGNAL(callExportStreamed(QString)), scene, SLOT(exportStreamed(QString)));
+	connect(this, SIGNAL(callOpenStreamed(QString)), scene, SLOT(openStreamed(QString)));
+	connect(scene, SIGNAL(ioStarted(QString)), this, SLOT(ioStarted(QString)));
+	connect(scene, SIGNAL(ioProgress(QString, int)), this, SLOT(ioProgress(QString, int)));
+	connect(scene, SIGNAL(ioFinished(QString)), this, SLOT(ioFinished(QString)));
+	connect(cancelIoButton, SIGNAL(clicked()), scene, SLOT(cancelIo()));
 
 	// Connect for populate list function
-	connect(glViewer, SIGNAL(addToList()), this, SLOT(addToList()));
+	connect(scene, SIGNAL(addToList()), this, SLOT(addToList()));
+	connect(scene, SIGNAL(addToList(int)), this, SLOT(addToList(int)));
+	connect(scene, SIGNAL(removeFromList(int)), this, SLOT(removeFromList(int)));
+
+	// Autosave; the file only survives if we don't exit cleanly
+	connect(scene, SIGNAL(autosaveFinished(bool, qint64)), this, SLOT(autosaveFinished(bool, qint64)));
+	connect(qApp, SIGNAL(aboutToQuit()), scene, SLOT(discardAutosave()));
+	foreach (GLViewer *view, views())
+		connect(qApp, SIGNAL(aboutToQuit()), view, SLOT(stopRendering()));
+	QTimer::singleShot(0, this, SLOT(checkRecovery()));
 }
 
 void Viewer::setCoords(double x, double y)
@@ -86,39 +231,210 @@ void Viewer::setCoords(double x, double y)
 
 void Viewer::addToList(QString str)
 {
-	ui.infoListWidget->addItem(str);
-	QListWidgetItem * item = ui.infoListWidget->item(ui.infoListWidget->count() - 1); // Get last item
-	item->setFlags (item->flags () | Qt::ItemIsEditable); // Make item editable
-	ui.infoListWidget->setCurrentItem(item); // Set selection to last item
+	TRACE_SCOPE("Viewer::addToList");
+	objectList->appendRows(str, 1);
+	setCurrentRow(objectList->rowCount() - 1, true); // Set selection to last item
 }
 
 void Viewer::addToList()
 {
-	ui.infoListWidget->blockSignals(true);
-	ui.infoListWidget->addItem("Nameless");
-	QListWidgetItem * item = ui.infoListWidget->item(ui.infoListWidget->count() - 1);
-	item->setFlags(item->flags() | Qt::ItemIsEditable);
-	ui.infoListWidget->setCurrentItem(item);
-	ui.infoListWidget->blockSignals(false);
+	TRACE_SCOPE("Viewer::addToList");
+	objectList->appendRows("Nameless", 1);
+	setCurrentRow(objectList->rowCount() - 1, false);
+}
+
+// Many objects at once; the list repaints and selects only once
+void Viewer::addToList(int count)
+{
+	TRACE_SCOPE("Viewer::addToList");
+	if (count <= 0)
+		return;
+
+	objectList->appendRows("Nameless", count);
+	setCurrentRow(objectList->rowCount() - 1, false);
+}
+
+void Viewer::removeFromList(int index)
+{
+	TRACE_SCOPE("Viewer::removeFromList");
+	quietListChange = true;
+	objectList->removeRow(index);
+	quietListChange = false;
+}
+
+int Viewer::currentRow() const
+{
+	return ui.objectListView->currentIndex().row();
+}
+
+// Select a row; the scene is only asked for its info if notify is set
+void Viewer::setCurrentRow(int row, bool notify)
+{
+	quietListChange = !notify;
+	ui.objectListView->selectionModel()->setCurrentIndex(objectList->index(row), QItemSelectionModel::ClearAndSelect);
+	quietListChange = false;
+}
+
+void Viewer::listRowChanged(const QModelIndex &current)
+{
+	timeline->setObject(current.row());
+	if (!quietListChange)
+		emit requestInfo(current.row());
+}
+
+// The edit tab shows the selected object as posed at the new time
+void Viewer::animationTimeChanged()
+{
+	if (currentRow() > -1)
+		emit requestInfo(currentRow());
+}
+
+// Only the first pairs are listed; a row per pair of a badly overlapping
+// scene would stall the UI
+void Viewer::interferenceChanged()
+{
+	TRACE_SCOPE("Viewer::interferenceChanged");
+	const QVector<ObjectPair> &pairs = scene->interference()->pairs();
+	ui.interferenceList->clear();
+	if (!scene->interference()->isEnabled())
+	{
+		ui.interferenceLabel->setText("Not checked");
+		return;
+	}
+	ui.interferenceLabel->setText(pairs.isEmpty() ? QString("No interference") : QString("%1 interfering pairs").arg(pairs.size()));
+	int listed = qMin(pairs.size(), maxListedPairs);
+	for (int p = 0; p < listed; p++)
+	{
+		QString first = objectList->data(objectList->index(pairs[p].first)).toString();
+		QString second = objectList->data(objectList->index(pairs[p].second)).toString();
+		ui.interferenceList->addItem(QString("%1 %2 - %3 %4").arg(first).arg(pairs[p].first).arg(second).arg(pairs[p].second));
+	}
+	if (pairs.size() > listed)
+		ui.interferenceList->addItem(QString("and %1 more").arg(pairs.size() - listed));
+}
+
+// Selects the first object of the pair, ready to be moved apart
+void Viewer::interferenceRowChanged(int row)
+{
+	const QVector<ObjectPair> &pairs = scene->interference()->pairs();
+	if (row >= 0 && row < qMin(pairs.size(), maxListedPairs))
+		setCurrentRow(pairs[row].first, true);
+}
+
+// Edits the selected object; unchecking ends the session and keeps the mesh
+void Viewer::meshEditToggled(bool checked)
+{
+	scene->meshEditor()->edit(checked ? currentRow() : -1);
+	meshChanged();
+}
+
+// Another object, topology or level: the cage's vertices and faces are
+// numbered afresh
+void Viewer::meshChanged()
+{
+	TRACE_SCOPE("Viewer::meshChanged");
+	MeshEditor *editor = scene->meshEditor();
+	const HalfEdgeMesh &cage = editor->cage();
+	bool editing = editor->object() >= 0;
+
+	ui.meshEditCheckBox->blockSignals(true);
+	ui.meshEditCheckBox->setChecked(editing);
+	ui.meshEditCheckBox->blockSignals(false);
+	ui.vertexSpinbox->blockSignals(true);
+	ui.vertexSpinbox->setMaximum(qMax(0, cage.vertexCount() - 1));
+	ui.vertexSpinbox->blockSignals(false);
+	ui.faceSpinbox->setMaximum(qMax(0, cage.faceCount() - 1));
+	ui.vertexSpinbox->setEnabled(editing);
+	ui.vertexXSpinbox->setEnabled(editing);
+	ui.vertexYSpinbox->setEnabled(editing);
+	ui.vertexZSpinbox->setEnabled(editing);
+	ui.faceSpinbox->setEnabled(editing);
+	ui.extrudeSpinbox->setEnabled(editing);
+	ui.extrudeButton->setEnabled(editing);
+	ui.removeFaceButton->setEnabled(editing);
+	ui.revertMeshButton->setEnabled(editing);
+	meshVertexChanged();
+
+	if (!editing)
+	{
+		ui.meshInfoLabel->setText("Not editing");
+		return;
+	}
+	QString name = objectList->data(objectList->index(editor->object())).toString();
+	ui.meshInfoLabel->setText(QString("%1 %2: cage of %3 vertices and %4 faces, %5 faces at level %6").arg(name).arg(editor->object())
+	                          .arg(cage.vertexCount()).arg(cage.faceCount()).arg(editor->surfaceFaces()).arg(editor->level()));
+}
+
+// Shows the chosen vertex's position without moving it
+void Viewer::meshVertexChanged()
+{
+	const HalfEdgeMesh &cage = scene->meshEditor()->cage();
+	int vertex = ui.vertexSpinbox->value();
+	QDoubleSpinBox *coords[3] = { ui.vertexXSpinbox, ui.vertexYSpinbox, ui.vertexZSpinbox };
+	for (int i = 0; i < 3; i++)
+	{
+		coords[i]->blockSignals(true);
+		coords[i]->setValue(vertex < cage.vertexCount() ? cage.position(vertex)[i] : 0.0);
+		coords[i]->blockSignals(false);
+	}
+}
+
+void Viewer::moveMeshVertex()
+{
+	scene->meshEditor()->moveVertex(ui.vertexSpinbox->value(), ui.vertexXSpinbox->value(), ui.vertexYSpinbox->value(), ui.vertexZSpinbox->value());
+}
+
+void Viewer::extrudeMeshFace()
+{
+	scene->meshEditor()->extrudeFace(ui.faceSpinbox->value(), ui.extrudeSpinbox->value());
+}
+
+void Viewer::removeMeshFace()
+{
+	scene->meshEditor()->removeFace(ui.faceSpinbox->value());
+}
+
+// The cage's edits can't be got back, so ask first
+void Viewer::revertMesh()
+{
+	if (QMessageBox::question(this, tr("Revert to Primitive"),
+		tr("Throw away this object's mesh edits and draw its primitive again?"),
+		QMessageBox::Yes | QMessageBox::No, QMessageBox::No) == QMessageBox::Yes)
+		scene->meshEditor()->revert();
+}
+
+void Viewer::generateClicked()
+{
+	TRACE_SCOPE("Viewer::generateClicked");
+	generate(ui.generatorCombo->currentIndex(), ui.generatorCountSpinbox->value(), ui.generatorSeedSpinbox->value());
+}
+
+void Viewer::generate(int kind, int count, int seed)
+{
+	emit callGenerate(kind, count, seed);
 }
 
 void Viewer::updateTranslation()
 {
-	emit sendTranslation(ui.infoListWidget->currentRow(), ui.translateXSpinbox->value(), ui.translateYSpinbox->value(), ui.translateZSpinbox->value());
+	TRACE_SCOPE("Viewer::updateTranslation");
+	emit sendTranslation(currentRow(), ui.translateXSpinbox->value(), ui.translateYSpinbox->value(), ui.translateZSpinbox->value());
 }
 
 void Viewer::updateRotation()
 {
-	emit sendRotation(ui.infoListWidget->currentRow(), ui.rotateXSpinbox->value(), ui.rotateYSpinbox->value(), ui.rotateZSpinbox->value());
+	TRACE_SCOPE("Viewer::updateRotation");
+	emit sendRotation(currentRow(), ui.rotateXSpinbox->value(), ui.rotateYSpinbox->value(), ui.rotateZSpinbox->value());
 }
 
 void Viewer::updateScale()
 {
-	emit sendScale(ui.infoListWidget->currentRow(), ui.scaleXSpinbox->value(), ui.scaleYSpinbox->value(), ui.scaleZSpinbox->value());
+	TRACE_SCOPE("Viewer::updateScale");
+	emit sendScale(currentRow(), ui.scaleXSpinbox->value(), ui.scaleYSpinbox->value(), ui.scaleZSpinbox->value());
 }
 
 void Viewer::receiveInfo(std::vector<double> info)
 {
+	TRACE_SCOPE("Viewer::receiveInfo");
 	// Temporarily block signals
 	ui.translateXSpinbox->blockSignals(true);
 	ui.translateYSpinbox->blockSignals(true);
@@ -127,8 +443,8 @@ void Viewer::receiveInfo(std::vector<double> info)
 	ui.rotateYSpinbox->blockSignals(true);
 	ui.rotateZSpinbox->blockSignals(true);
 	ui.scaleXSpinbox->blockSignals(true);
-	ui.scaleXSpinbox->blockSignals(true);
-	ui.scaleXSpinbox->blockSignals(true);
+	ui.scaleYSpinbox->blockSignals(true);
+	ui.scaleZSpinbox->blockSignals(true);
 
 	ui.translateXSpinbox->setValue(info[0]);
 	ui.translateYSpinbox->setValue(info[1]);
@@ -150,19 +466,15 @@ void Viewer::receiveInfo(std::vector<double> info)
 	ui.rotateYSpinbox->blockSignals(false);
 	ui.rotateZSpinbox->blockSignals(false);
 	ui.scaleXSpinbox->blockSignals(false);
-	ui.scaleXSpinbox->blockSignals(false);
-	ui.scaleXSpinbox->blockSignals(false);
+	ui.scaleYSpinbox->blockSignals(false);
+	ui.scaleZSpinbox->blockSignals(false);
 }
 
 void Viewer::newProject()
 {
 	//qDebug() << "newProject";
-	// Remove old OpenGL widget
-	ui.viewLayout->removeWidget(glViewer);
-	delete glViewer;
-
 	// Reset sidebar and all inputs
-	ui.infoListWidget->clear();
+	objectList->clear();
 	color = QColor(0.8 * 255.0, 0.8 * 255.0, 0.8 * 255.0);
 	ui.colorPreviewLabel->setPalette(QPalette(color));
 
@@ -175,50 +487,363 @@ void Viewer::newProject()
 	ui.scaleXSpinbox->setValue(0.0);
 	ui.scaleYSpinbox->setValue(0.0);
 	ui.scaleZSpinbox->setValue(0.0);
+}
+
+QList<GLViewer *> Viewer::views() const
+{
+	return QList<GLViewer *>() << glViewer << topViewer << frontViewer << sideViewer;
+}
 
-	// Add OpenGL widget
-	glViewer = new GLViewer;
-	ui.viewLayout->addWidget(glViewer);
+// Top, front and side views next to the perspective one, or just the latter
+void Viewer::setFourViews(bool enabled)
+{
+	topViewer->setVisible(enabled);
+	frontViewer->setVisible(enabled);
+	sideViewer->setVisible(enabled);
+}
+
+// Scripted edits from local tools, see command_protocol.h
+bool Viewer::startCommandServer(const QString &name)
+{
+	bool ok = commandServer->listen(name);
+	if (ok)
+		ui.statusBar->showMessage("Command server listening on " + commandServer->fullServerName(), 5000);
+	else
+		ui.statusBar->showMessage("Command server could not listen on " + name + ": " + commandServer->errorString(), 5000);
+
+	ui.actionCommandServer->blockSignals(true);
+	ui.actionCommandServer->setChecked(ok);
+	ui.actionCommandServer->blockSignals(false);
+	return ok;
+}
+
+void Viewer::setCommandServer(bool enabled)
+{
+	if (enabled)
+		startCommandServer(CommandProtocol::defaultServerName());
+	else
+		commandServer->close();
 }
 
 void Viewer::saveProject()
 {
+	TRACE_SCOPE("Viewer::saveProject");
 	//qDebug() << "saveProject";
 	QString fileName = QFileDialog::getSaveFileName(this, tr("Save Project"), "samples/untitled.vox", tr("VOX Files (*.vox)"));
-	emit callSave(fileName);
+	if (!fileName.isEmpty())
+		emit callSave(fileName);
 }
 
 void Viewer::loadProject()
 {
+	TRACE_SCOPE("Viewer::loadProject");
 
 	//qDebug() << "loadProject";
-	QString fileName = QFileDialog::getOpenFileName(this, tr("Open Project"), "samples/", tr("VOX Files (*.vox)"));
-	emit callLoad(fileName);
+	QString fileName = SceneOpenDialog::getOpenFileName(this, "samples/");
+	if (fileName.isEmpty())
+		return;
+
+	// Chunked files are shown next to the scene and stream in as needed
+	if (isStreamedSceneFile(fileName))
+	{
+		emit callOpenStreamed(fileName);
+		ui.actionCloseStreamed->setEnabled(scene->streaming()->isOpen());
+		return;
+	}
+
+	// Edits flushed to the journal but never saved mean the session crashed
+	int unsaved = SceneJournal::uncommittedRecords(fileName);
+	if (unsaved > 0 && QMessageBox::question(this, tr("Recover Edits"),
+		tr("%1 unsaved edits to this project were found in its journal. Recover them?").arg(unsaved),
+		QMessageBox::Yes | QMessageBox::No, QMessageBox::Yes) == QMessageBox::Yes)
+		emit callRecover(fileName);
+	else
+		emit callLoad(fileName);
+}
+
+// Offer to restore the autosave left behind by a crashed session; those
+// of sessions still running are theirs
+void Viewer::checkRecovery()
+{
+	QString fileName = AutoSaver::recoveryFile();
+	if (fileName.isEmpty())
+		return;
+
+	QMessageBox::StandardButton answer = QMessageBox::question(this, tr("Recover Scene"),
+		tr("An earlier session did not exit cleanly. Recover its autosaved scene?"),
+		QMessageBox::Yes | QMessageBox::No, QMessageBox::Yes);
+
+	if (answer != QMessageBox::Yes)
+		QFile::remove(fileName);
+	else if (AutoSaver::claim(fileName))
+		emit callLoad(AutoSaver::autosavePath());
+}
+
+void Viewer::autosaveFinished(bool ok, qint64 msec)
+{
+	if (ok)
+		ui.statusBar->showMessage("Autosaved (" + QString::number(msec) + " ms)", 3000);
+	else
+		ui.statusBar->showMessage("Autosave failed", 5000);
+}
+
+// Only one load or save runs at a time
+void Viewer::ioStarted(QString text)
+{
+	ui.actionSave->setEnabled(false);
+	ui.actionLoad->setEnabled(false);
+	ui.actionExportStreamed->setEnabled(false);
+	ui.statusBar->showMessage(text);
+	ioProgressBar->setValue(0);
+	ioProgressBar->show();
+	cancelIoButton->show();
+}
+
+void Viewer::ioProgress(QString phase, int percent)
+{
+	ioProgressBar->setFormat(phase + " %p%");
+	ioProgressBar->setValue(percent);
+}
+
+void Viewer::ioFinished(QString message)
+{
+	TRACE_SCOPE("Viewer::ioFinished");
+	ioProgressBar->hide();
+	cancelIoButton->hide();
+	ui.actionSave->setEnabled(true);
+	ui.actionLoad->setEnabled(true);
+	ui.actionExportStreamed->setEnabled(true);
+	ui.statusBar->showMessage(message, 5000);
+}
+
+void Viewer::setCullStats(int drawn, int culled)
+{
+	cullText = "Drawn: " + QString::number(drawn) + "  Occluded: " + QString::number(culled);
+}
+
+// Mesh and color changes of the sorted draw order, and of scene order for comparison
+void Viewer::setStateChanges(int sorted, int unsorted)
+{
+	stateText = "  State changes: " + QString::number(sorted) + " (unsorted " + QString::number(unsorted) + ")";
+}
+
+void Viewer::setTriangleCount(int triangles)
+{
+	triangleText = "  Triangles: " + QString::number(triangles);
+}
+
+void Viewer::setFrameTime(double msec)
+{
+	statsLabel->setText(cullText + stateText + triangleText + "  Frame: " + QString::number(msec, 'f', 1) + " ms");
+}
+
+// Scene and list are measured here, the rest is charged as it is allocated
+void Viewer::updateMemoryStats()
+{
+	static const char *names[MemorySubsystems] = { "Scene", "Meshes", "Render queues", "Streamed chunks", "Object list", "I/O buffers", "Baked lighting", "Interference checks" };
+	qint64 bytes[MemorySubsystems];
+	for (int i = 0; i < MemorySubsystems; i++)
+		bytes[i] = chargedMemory((MemorySubsystem)i);
+	bytes[SceneMemory] = sceneMemoryUsage(scene->data());
+	bytes[ObjectListMemory] = objectList->memoryUsage();
+
+	QString details;
+	for (int i = 0; i < MemorySubsystems; i++)
+	{
+		details += QString(names[i]) + ": " + formatBytes(bytes[i]);
+		if (i == IoMemory)
+			details += " (peak " + formatBytes(peakChargedMemory(IoMemory)) + ")";
+		details += "\n";
+	}
+
+	ProcessMemory process = processMemory();
+	QString text = "  Scene: " + formatBytes(bytes[SceneMemory]) + "  List: " + formatBytes(bytes[ObjectListMemory]);
+	if (process.resident > 0)
+		text += "  RSS: " + formatBytes(process.resident);
+	if (process.peakResident > 0)
+	{
+		text += " (peak " + formatBytes(process.peakResident) + ")";
+		details += "Peak resident: " + formatBytes(process.peakResident);
+	}
+	memoryLabel->setText(text);
+	memoryLabel->setToolTip(details.trimmed());
+}
+
+void Viewer::exportProject()
+{
+	TRACE_SCOPE("Viewer::exportProject");
+	QString fileName = QFileDialog::getSaveFileName(this, tr("Export OBJ"), "samples/untitled.obj", tr("OBJ Files (*.obj)"));
+	if (!fileName.isEmpty())
+		emit callExport(fileName);
+}
+
+// Chunked copy of the scene that other sessions can stream instead of loading
+void Viewer::exportStreamed()
+{
+	TRACE_SCOPE("Viewer::exportStreamed");
+	QString fileName = QFileDialog::getSaveFileName(this, tr("Export Streamed Scene"), "samples/untitled.voxs", tr("Streamed VOX Files (*.voxs)"));
+	if (!fileName.isEmpty())
+		emit callExportStreamed(fileName);
+}
+
+void Viewer::streamedClosed()
+{
+	ui.actionCloseStreamed->setEnabled(false);
+}
+
+/*********/
+/* VIDEO */
+/*********/
+
+void Viewer::exportTurntable()
+{
+	exportVideo(true);
+}
+
+void Viewer::exportFlythrough()
+{
+	exportVideo(false);
+}
+
+// Keys the perspective camera where it is now
+void Viewer::addFlythroughKey()
+{
+	flythroughKeys.append(glViewer->cameraKey());
+	ui.actionClearFlythroughKeys->setEnabled(true);
+	ui.actionExportFlythrough->setEnabled(!videoExporter && !posterRenderer);
+	ui.statusBar->showMessage(QString("Flythrough key %1 added").arg(flythroughKeys.size()), 5000);
+}
+
+void Viewer::clearFlythroughKeys()
+{
+	flythroughKeys.clear();
+	ui.actionClearFlythroughKeys->setEnabled(false);
+	ui.actionExportFlythrough->setEnabled(false);
+}
+
+// Renders the scene as it is now, with the lighting last baked, while
+// editing goes on; the progress bar's cancel button stops it
+void Viewer::exportVideo(bool turntable)
+{
+	TRACE_SCOPE("Viewer::exportVideo");
+	if (videoExporter || posterRenderer)
+		return;
+	bool ok;
+	double seconds = QInputDialog::getDouble(this, tr("Export Video"), tr("Length in seconds:"), turntable ? 10.0 : 2.0 * flythroughKeys.size(), 0.1, 600.0, 1, &ok);
+	if (!ok)
+		return;
+	QString fileName = QFileDialog::getSaveFileName(this, tr("Export Video Frames"), "samples/video.png", tr("PNG Sequences (*.png)"));
+	if (fileName.isEmpty())
+		return;
+
+	VideoSettings settings;
+	settings.fileName = fileName;
+	settings.width = videoWidth;
+	settings.height = videoHeight;
+	settings.seconds = seconds;
+	settings.frameRate = videoFrameRate;
+	settings.turntable = turntable;
+	settings.keys = flythroughKeys;
+	double animationLength = qMax(scene->animationLength(), scene->data().animation.duration());
+	videoExporter = new VideoExporter(settings, scene->data(), animationLength, scene->lighting()->colors(), glViewer, this);
+	connect(videoExporter, SIGNAL(progress(QString, int)), this, SLOT(ioProgress(QString, int)));
+	connect(videoExporter, SIGNAL(exported(QString)), this, SLOT(videoExported(QString)));
+	connect(cancelIoButton, SIGNAL(clicked()), videoExporter, SLOT(cancel()));
+
+	ui.actionExportTurntable->setEnabled(false);
+	ui.actionExportFlythrough->setEnabled(false);
+	ui.actionRenderPoster->setEnabled(false);
+	ioStarted(QString("Exporting %1 video frames...").arg(videoExporter->frameCount()));
+	videoExporter->start();
+}
+
+void Viewer::videoExported(QString report)
+{
+	videoExporter->wait();
+	videoExporter->deleteLater();
+	videoExporter = 0;
+	ioFinished(report);
+	ui.actionExportTurntable->setEnabled(true);
+	ui.actionExportFlythrough->setEnabled(!flythroughKeys.isEmpty());
+	ui.actionRenderPoster->setEnabled(true);
+}
+
+// The perspective view's camera and shape, at print sizes
+void Viewer::renderPoster()
+{
+	TRACE_SCOPE("Viewer::renderPoster");
+	if (videoExporter || posterRenderer)
+		return;
+	bool ok;
+	int width = QInputDialog::getInt(this, tr("Render Poster"), tr("Width in pixels:"), 16384, 256, maxPosterSize, 1, &ok);
+	if (!ok)
+		return;
+	QString fileName = QFileDialog::getSaveFileName(this, tr("Render Poster"), "samples/poster.ppm", tr("PPM Images (*.ppm)"));
+	if (fileName.isEmpty())
+		return;
+
+	PosterSettings settings;
+	settings.fileName = fileName;
+	settings.width = width;
+	settings.height = qBound(1, qRound(width * (double)glViewer->height() / qMax(1, glViewer->width())), maxPosterSize);
+	settings.camera = glViewer->cameraKey();
+	posterRenderer = new PosterRenderer(settings, scene->displayed(), scene->lighting()->colors(), glViewer, this);
+	connect(posterRenderer, SIGNAL(progress(QString, int)), this, SLOT(ioProgress(QString, int)));
+	connect(posterRenderer, SIGNAL(rendered(QString)), this, SLOT(posterRendered(QString)));
+	connect(cancelIoButton, SIGNAL(clicked()), posterRenderer, SLOT(cancel()));
+
+	ui.actionExportTurntable->setEnabled(false);
+	ui.actionExportFlythrough->setEnabled(false);
+	ui.actionRenderPoster->setEnabled(false);
+	ioStarted(QString("Rendering a %1 x %2 poster in %3 tiles...").arg(settings.width).arg(settings.height).arg(posterRenderer->tileCount()));
+	posterRenderer->start();
+}
+
+void Viewer::posterRendered(QString report)
+{
+	posterRenderer->wait();
+	posterRenderer->deleteLater();
+	posterRenderer = 0;
+	ioFinished(report);
+	ui.actionExportTurntable->setEnabled(true);
+	ui.actionExportFlythrough->setEnabled(!flythroughKeys.isEmpty());
+	ui.actionRenderPoster->setEnabled(true);
 }
 
 void Viewer::removeObjectClicked()
 {
-	int row = ui.infoListWidget->currentRow();
-	emit removeObject(row);
-	ui.infoListWidget->blockSignals(true);
-	delete ui.infoListWidget->item(row);
-	ui.infoListWidget->blockSignals(false);
-	emit manualListUpdate(ui.infoListWidget->currentRow());
+	TRACE_SCOPE("Viewer::removeObjectClicked");
+	int row = currentRow();
+	emit removeObject(row); // The scene takes the row out of the list
+	emit manualListUpdate(currentRow());
 	;
 }
 
 void Viewer::colorWheel()
 {
+	TRACE_SCOPE("Viewer::colorWheel");
 	QColor tempColor = QColorDialog::getColor(Qt::white, this);
 
 	if (tempColor.isValid())
 	{
 		color = tempColor;
 		ui.colorPreviewLabel->setPalette(QPalette(color));
-		emit sendColor(ui.infoListWidget->currentRow(), color.red() / 255.0, color.green() / 255.0, color.blue() / 255.0);
+		emit sendColor(currentRow(), color.red() / 255.0, color.green() / 255.0, color.blue() / 255.0);
 	}
 }
 
+// Timeline of the traced scopes, for chrome://tracing or Perfetto
+void Viewer::saveTrace()
+{
+	QString fileName = QFileDialog::getSaveFileName(this, tr("Save Trace"), "trace.json", tr("Trace Files (*.json)"));
+	if (fileName.isEmpty())
+		return;
+	if (dumpTrace(fileName))
+		ui.statusBar->showMessage("Trace saved to " + fileName, 5000);
+	else
+		ui.statusBar->showMessage("Could not save trace", 5000);
+}
+
 void Viewer::aboutInfo()
 {
 	QMessageBox *aboutDialog = new QMessageBox;
@@ -228,11 +853,51 @@ void Viewer::aboutInfo()
 	aboutDialog->exec();
 }
 
+// Vertex cache behaviour of the primitive meshes before and after
+// optimization, and their levels of detail
+void Viewer::meshInfo()
+{
+	static const char *names[7] = { "Plane", "Cube", "Sphere", "Cone", "Cylinder", "Pyramid", "Wedge" };
+	static const char *levels[TessellationLevels] = { "Coarse", "Default", "Fine" };
+	QString str = QString("Average cache misses per triangle (ACMR) with a %1 vertex FIFO cache:\n\n").arg((int)ReportCacheSize);
+	for (int level = 0; level < TessellationLevels; level++)
+	{
+		str += QString(levels[level]) + "\n";
+		for (int type = 0; type < 7; type++)
+		{
+			const MeshReport &report = primitiveMeshReport(type, (TessellationLevel)level);
+			str += QString("  %1: %2 triangles, %3 -> %4 vertices, ACMR %5 -> %6\n").arg(names[type]).arg(report.triangles)
+				.arg(report.verticesBefore).arg(report.verticesAfter)
+				.arg(report.acmrBefore, 0, 'f', 3).arg(report.acmrAfter, 0, 'f', 3);
+		}
+		str += "\n";
+	}
+
+	str += "Levels of detail, in triangles:\n";
+	for (int type = 0; type < 7; type++)
+	{
+		MeshLodChainPtr chain = MeshLodCache::instance().chain(primitiveMesh(type));
+		str += QString("  %1: ").arg(names[type]);
+		if (!chain)
+		{
+			str += "being built\n";
+			continue;
+		}
+		for (int level = 0; level < chain->levelCount(); level++)
+			str += (level > 0 ? ", " : "") + QString::number(chain->levels[level].triangleCount());
+		str += "\n";
+	}
+	QMessageBox *meshDialog = new QMessageBox;
+	meshDialog->setWindowTitle("Mesh Statistics");
+	meshDialog->setInformativeText(str);
+	meshDialog->exec();
+}
+
 void Viewer::helpInfo()
 {
 	QMessageBox *helpDialog = new QMessageBox;
 	helpDialog->setWindowTitle("Help");
-	QString str = "Inserting Objects:\n- Use the buttons under the create tab.\n\nDeleting Objects:\n- Use the delete button under the objects list.\n\nEdit Color:\n- Use Edit Color Button.\n\nEditting Objects:\n- Use the edit tab to control translation, rotation and scale of each object.\n\nCamera Movements:\n   - Move: Left click and drag.\n   - Zoom: Hold left and right mouse buttons and drag forward or back.\n   - Rotate: Right click and drag.\n\nLoad & Save: \n- Files are saved and loaded under a \"*.vox\" extension.\n- The Scene must be empty before perfoming a load operation.\n\nOther Notes: \n- Resizing window is possible.\n- Creating a new project was a buggy feature, so a program restart is required.\n\n";
+	QString str = "Inserting Objects:\n- Use the buttons under the create tab.\n- Generators fill the scene with grids, random scatters, fractal stacks or cities for stress testing; timings are shown in the status bar.\n\nDeleting Objects:\n- Use the delete button under the objects list.\n\nEdit Color:\n- Use Edit Color Button.\n\nEditting Objects:\n- Use the edit tab to control translation, rotation and scale of each object.\n\nCamera Movements:\n   - Move: Left click and drag.\n   - Zoom: Hold left and right mouse buttons and drag forward or back.\n   - Rotate: Right click and drag.\n   - Fly: W/A/S/D to move, Q/E for down/up, hold Shift to go faster.\n\nLoad & Save: \n- Files are saved and loaded under a \"*.vox\" extension.\n- Loading adds the file's objects to the current scene.\n- Loads and saves run in the background with progress in the status bar, and can be cancelled; a cancelled save leaves the old file untouched.\n- The scene is autosaved every 30 seconds and offered for recovery after a crash.\n- With File > Journaled Saves, saving again to the same file only appends the changes to a \"*.vox.journal\" file next to it.\n- File > Command Server lets local tools create, edit, query, remove and save objects in batches (see command_protocol.h and tools/).\n- File > Compact Encoding writes much smaller binary files with colors in 8 bits and transforms to 0.001 (or as half floats); both formats load the same way.\n- File > Export Streamed Scene writes a \"*.voxs\" file split into spatial chunks. Loading one shows it next to the scene without loading it whole: chunks near the camera load in the background, far ones are drawn as boxes, and memory stays under a budget. Streamed scenes can be viewed but not edited.\n\nAnimation:\n- Set Key under the views keys the selected object's translation, rotation, scale and color at the current time; ticks under the slider mark its keys.\n- Once an attribute has keys, editing it sets a key at the current time instead.\n- New keys lead to the next one in a straight line or along an eased Bezier curve, as chosen next to Set Key.\n- Play loops over the length set next to the slider, or to the last key if that is later, at 30 frames per second.\n- Keys are saved with the scene in both file formats.\n\nOther Notes: \n- View > Four Views adds top, front and side views; these pan with the left button and zoom with both buttons.\n- View > Level of Detail draws small or distant objects with simplified meshes, which are built in the background; Help > Mesh Statistics lists them.\n- View > Baked Lighting shades objects with soft shadows from nearby objects and hard shadows from the light, baked in the background. Edits re-bake only the objects around them; animation plays with the lighting last baked.\n- File > Export Turntable Video circles the scene once and writes the frames as a numbered PNG sequence (e.g. for ffmpeg). File > Add Flythrough Key keys the perspective camera where it is; File > Export Flythrough Video flies through the keys in order. Animated scenes play along. Exports render offscreen, so editing can go on.\n- File > Render Poster draws the perspective view at print sizes (up to 32768 pixels a side) into a \"*.ppm\" image, in tiles written straight to the file.\n- Check > Interference lists the objects whose shapes overlap; shapes that only touch don't count. After the first check, edits only re-check the objects around them. Selecting a pair selects its first object.\n- Mesh > Edit as mesh turns the selected object into a cage of vertices and faces drawn as a smooth subdivided surface. Move a cage vertex with its coordinates, or extrude or remove a face; the subdivision levels set how smooth the surface is. Unchecking it keeps the mesh, which is saved with the scene in both file formats; Revert to Primitive throws the edits away. Interference checks use the cage's outline; baked lighting and streamed exports still use the object's shape.\n- Resizing window is possible.\n- Creating a new project was a buggy feature, so a program restart is required.\n\n";
 	helpDialog->setInformativeText(str);
 	helpDialog->exec();
 }
\ No newline at end of file
@@ -4,6 +4,12 @@
 #include <QtGui>
 #include "ui_viewer.h"
 #include "gl_viewer.h"
+#include "command_server.h"
+#include "object_list_model.h"
+
+class TimelineWidget;
+class VideoExporter;
+class PosterRenderer;
 
 class Viewer : public QMainWindow
 {
@@ -13,10 +19,27 @@ class Viewer : public QMainWindow
 public:
 	Viewer(QWidget *parent = 0);
 
+	bool startCommandServer(const QString &name);
+
 public slots:
 	void setCoords(double x, double y);
 	void addToList(QString str);
 	void addToList();
+	void addToList(int count);
+	void removeFromList(int index);
+	void listRowChanged(const QModelIndex &current);
+	void animationTimeChanged();
+	void interferenceChanged();
+	void interferenceRowChanged(int row);
+	void meshEditToggled(bool checked);
+	void meshChanged();
+	void meshVertexChanged();
+	void moveMeshVertex();
+	void extrudeMeshFace();
+	void removeMeshFace();
+	void revertMesh();
+	void generateClicked();
+	void generate(int kind, int count, int seed);
 	void updateTranslation();
 	void updateRotation();
 	void updateScale();
@@ -24,10 +47,34 @@ public slots:
 	void newProject();
 	void saveProject();
 	void loadProject();
+	void exportProject();
+	void exportStreamed();
+	void streamedClosed();
+	void exportTurntable();
+	void exportFlythrough();
+	void addFlythroughKey();
+	void clearFlythroughKeys();
+	void videoExported(QString report);
+	void renderPoster();
+	void posterRendered(QString report);
 	void removeObjectClicked();
 	void colorWheel();
 	void aboutInfo();
 	void helpInfo();
+	void meshInfo();
+	void saveTrace();
+	void checkRecovery();
+	void autosaveFinished(bool ok, qint64 msec);
+	void ioStarted(QString text);
+	void ioProgress(QString phase, int percent);
+	void ioFinished(QString message);
+	void setCullStats(int drawn, int culled);
+	void setStateChanges(int sorted, int unsorted);
+	void setTriangleCount(int triangles);
+	void setFrameTime(double msec);
+	void updateMemoryStats();
+	void setFourViews(bool enabled);
+	void setCommandServer(bool enabled);
 
 signals:
 	void sendTranslation(int index, double x, double y, double z);
@@ -38,11 +85,39 @@ signals:
 	void removeObject(int index);
 	void callSave(QString fileName);
 	void callLoad(QString fileName);
+	void callRecover(QString fileName);
+	void callExport(QString fileName);
+	void callExportStreamed(QString fileName);
+	void callOpenStreamed(QString fileName);
+	void callGenerate(int kind, int count, int seed);
 	void manualListUpdate(int index);
 
 private:
 	Ui::Viewer ui;
-	GLViewer *glViewer;
+	QList<GLViewer *> views() const;
+	int currentRow() const;
+	void setCurrentRow(int row, bool notify);
+	void exportVideo(bool turntable);
+
+	Scene *scene;
+	CommandServer *commandServer;
+	GLViewer *glViewer; // Perspective
+	GLViewer *topViewer;
+	GLViewer *frontViewer;
+	GLViewer *sideViewer;
+	TimelineWidget *timeline;
+	QVector<CameraKey> flythroughKeys; // Of the perspective view, in order
+	VideoExporter *videoExporter;      // While a video is exported
+	PosterRenderer *posterRenderer;    // While a poster renders
 	QColor color;
+	ObjectListModel *objectList;
+	bool quietListChange; // Row changes the scene need not hear about
+	QLabel *statsLabel;
+	QLabel *memoryLabel;
+	QProgressBar *ioProgressBar;
+	QPushButton *cancelIoButton;
+	QString cullText;
+	QString stateText;
+	QString triangleText;
 
 };
\ No newline at end of file